@@ -0,0 +1,407 @@
+/*
+ * Nedflix retro benchmarks
+ * One port's listing and metadata parsing, fed from the JSON corpus
+ *
+ * Built once per port from that port's own api.c, which holds its schemas,
+ * its list handling and its limits (MAX_MEDIA_ITEMS and the rest of
+ * core_config.h). The HTTP client's http_get and http_get_conditional are
+ * replaced through linker wraps by ones that hand over a corpus document
+ * as the response body, and the listing cache by one that never hits, so
+ * only decoding is measured. Each document is run through the port's
+ * api_browse, api_search or api_get_media_info, whichever reads it.
+ *
+ * For every document the report gives the decode rate in MB/s of JSON,
+ * best of many runs, and the heap cost of a first visit: allocations and
+ * the peak of live heap above where it started, counted through wraps of
+ * malloc, calloc, realloc and free. The response body is the HTTP
+ * client's and is not counted; neither is list storage that the port's
+ * main.c sets up before any request.
+ *
+ * Usage: api_bench [corpus dir]
+ *
+ * Exits 1 if a call failed or kept the wrong number of items.
+ */
+
+#include "nedflix.h"
+
+#include <malloc.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define MIN_RUNS 20
+#define MAX_LINE 512
+
+#define BENCH_SERVER "http://127.0.0.1:8088"
+#define BENCH_TOKEN  "bench"
+#define BENCH_PATH   "/mnt/nfs/TV Shows/Star Trek"
+
+/*
+ * Port glue: the calls that read each kind of document. Only the PS3 has
+ * a media info call; the other ports show what the browse entry carries,
+ * so info.json has nothing to measure there.
+ */
+#if defined(BENCH_PORT_DREAMCAST)
+#define PORT_NAME      "dreamcast"
+#define port_browse(list) api_browse(BENCH_TOKEN, BENCH_PATH, list)
+#elif defined(BENCH_PORT_XBOX)
+#define PORT_NAME      "xbox"
+#define port_browse(list) api_browse(BENCH_TOKEN, BENCH_PATH, LIBRARY_TVSHOWS, list)
+#elif defined(BENCH_PORT_PS3)
+#define PORT_NAME      "ps3"
+#define port_browse(list) api_browse(BENCH_TOKEN, BENCH_PATH, LIBRARY_TVSHOWS, list)
+#define PORT_HAS_INFO
+#elif defined(BENCH_PORT_XBOX360)
+#define PORT_NAME      "xbox360"
+#define port_browse(list) api_browse(BENCH_TOKEN, BENCH_PATH, LIBRARY_TVSHOWS, list)
+#else
+#error "Define BENCH_PORT_DREAMCAST, BENCH_PORT_XBOX, BENCH_PORT_PS3 or BENCH_PORT_XBOX360"
+#endif
+
+#if defined(BENCH_PORT_PS3) || defined(BENCH_PORT_XBOX360)
+app_t g_app;
+#endif
+
+typedef enum {
+    DOC_BROWSE,
+    DOC_SEARCH,
+    DOC_INFO
+} doc_kind_t;
+
+/*
+ * Heap accounting. Live bytes are tracked all the time so that frees
+ * balance; allocations are counted and the peak kept only while a call
+ * is being measured.
+ */
+static bool g_counting;
+static int64_t g_live;
+static int64_t g_peak;
+static uint32_t g_allocs;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void __real_free(void *ptr);
+
+static void heap_grew(void *block)
+{
+    if (!block) return;
+    g_live += (int64_t)malloc_usable_size(block);
+    if (g_counting) {
+        g_allocs++;
+        if (g_live > g_peak) g_peak = g_live;
+    }
+}
+
+void *__wrap_malloc(size_t size)
+{
+    void *block = __real_malloc(size);
+    heap_grew(block);
+    return block;
+}
+
+void *__wrap_calloc(size_t count, size_t size)
+{
+    void *block = __real_calloc(count, size);
+    heap_grew(block);
+    return block;
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    int64_t held = ptr ? (int64_t)malloc_usable_size(ptr) : 0;
+    void *block = __real_realloc(ptr, size);
+    if (block || size == 0) g_live -= held;
+    heap_grew(block);
+    return block;
+}
+
+void __wrap_free(void *ptr)
+{
+    if (ptr) g_live -= (int64_t)malloc_usable_size(ptr);
+    __real_free(ptr);
+}
+
+/*
+ * The HTTP client: each GET is answered with the body queued by
+ * queue_reply(), or an empty object if there is none, handed over in a
+ * malloc'd block as the real client does
+ */
+static char *g_reply;
+static size_t g_reply_len;
+
+static void queue_reply(const char *text, size_t len)
+{
+    g_reply = (char *)malloc(len + 1);
+    memcpy(g_reply, text, len);
+    g_reply[len] = '\0';
+    g_reply_len = len;
+}
+
+static int hand_over(char **response, size_t *len)
+{
+    if (!g_reply) queue_reply("{}", 2);
+    *response = g_reply;
+    *len = g_reply_len;
+    g_reply = NULL;
+    return 0;
+}
+
+int __wrap_http_get(const char *url, char **response, size_t *len)
+{
+    (void)url;
+    return hand_over(response, len);
+}
+
+#if defined(BENCH_PORT_PS3)
+int __wrap_http_get_conditional(const char *url, http_validators_t *validators,
+                                char **response, size_t *len)
+#else
+int __wrap_http_get_conditional(const char *url, const char *token, http_validators_t *validators,
+                                char **response, size_t *len)
+#endif
+{
+    (void)url;
+#if !defined(BENCH_PORT_PS3)
+    (void)token;
+#endif
+    (void)validators;
+    return hand_over(response, len);
+}
+
+/* The listing cache, always empty, so every call decodes */
+bool __wrap_cache_validators(const char *url, const char *token, http_validators_t *validators)
+{
+    (void)url;
+    (void)token;
+    memset(validators, 0, sizeof(*validators));
+    return false;
+}
+
+int __wrap_cache_restore(const char *url, const char *token, void *items, size_t item_size,
+                         int max, int32_t *total)
+{
+    (void)url;
+    (void)token;
+    (void)items;
+    (void)item_size;
+    (void)max;
+    (void)total;
+    return -1;
+}
+
+void __wrap_cache_store(const char *url, const char *token, const http_validators_t *validators,
+                        const void *items, size_t item_size, int count, int32_t total)
+{
+    (void)url;
+    (void)token;
+    (void)validators;
+    (void)items;
+    (void)item_size;
+    (void)count;
+    (void)total;
+}
+
+void __wrap_cache_clear(void)
+{
+}
+
+/* The list as the port's main.c sets it up, before any request */
+static media_list_t *list_create(void)
+{
+    media_list_t *list = (media_list_t *)calloc(1, sizeof(media_list_t));
+#if defined(BENCH_PORT_XBOX) || defined(BENCH_PORT_XBOX360)
+    if (list) {
+        list->capacity = MAX_MEDIA_ITEMS;
+        list->items = (media_item_t *)malloc(sizeof(media_item_t) * list->capacity);
+    }
+#endif
+    return list;
+}
+
+static void list_destroy(media_list_t *list)
+{
+#if !defined(BENCH_PORT_DREAMCAST)
+    free(list->items);
+#endif
+    free(list);
+}
+
+/*
+ * Read the queued document the port's way. Returns the items kept, -1 if
+ * the call failed, or -2 if the port has no call for this kind.
+ */
+static int port_call(doc_kind_t kind, media_list_t *list, media_item_t *item)
+{
+    switch (kind) {
+    case DOC_BROWSE:
+        return port_browse(list) == 0 ? list->count : -1;
+    case DOC_SEARCH:
+        return api_search(BENCH_TOKEN, "star trek", list) == 0 ? list->count : -1;
+    case DOC_INFO:
+#if defined(PORT_HAS_INFO)
+        memset(item, 0, sizeof(*item));
+        return api_get_media_info(BENCH_TOKEN, BENCH_PATH, item) == 0 && item->name[0] ? 1 : -1;
+#else
+        break;
+#endif
+    }
+    (void)item;
+    return -2;
+}
+
+static uint64_t bench_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static char *load_file(const char *dir, const char *name, size_t *len)
+{
+    char path[MAX_LINE];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        fprintf(stderr, "Cannot open %s\n", path);
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    char *data = (char *)malloc(size + 1);
+    if (data && fread(data, 1, size, f) != (size_t)size) {
+        free(data);
+        data = NULL;
+    }
+    fclose(f);
+    if (data) data[size] = '\0';
+    *len = (size_t)size;
+    return data;
+}
+
+/*
+ * Measure one document and print its row. Returns 1 if the port read it
+ * wrongly, 0 otherwise.
+ */
+static int bench_document(const char *name, doc_kind_t kind, const char *text, size_t len,
+                          int expected)
+{
+    media_list_t *list = list_create();
+    media_item_t item;
+    if (!list) return 1;
+
+    /* First visit, on a fresh list */
+    queue_reply(text, len);
+    g_allocs = 0;
+    g_peak = g_live;
+    int64_t start = g_live;
+    g_counting = true;
+    int kept = port_call(kind, list, &item);
+    g_counting = false;
+    free(g_reply);
+    g_reply = NULL;
+
+    printf("%-24s %8zu", name, len);
+    if (kept == -2) {
+        printf(" %6s %9s %7s %10s\n", "-", "-", "-", "-");
+        list_destroy(list);
+        return 0;
+    }
+    if (kept < 0) {
+        printf(" %6s\n", "FAILED");
+        list_destroy(list);
+        return 1;
+    }
+
+    /* Then the same list again and again, as the port reuses it */
+    uint64_t best = UINT64_MAX;
+    int runs = MIN_RUNS + (int)(20000000 / (len + 1));
+    for (int i = 0; i < runs; i++) {
+        queue_reply(text, len);
+        uint64_t t0 = bench_now();
+        port_call(kind, list, &item);
+        uint64_t t = bench_now() - t0;
+        if (t < best) best = t;
+    }
+    list_destroy(list);
+
+    printf(" %6d %9.1f %7u %10lld", kept, best ? (double)len * 1000.0 / best : 0.0,
+           (unsigned)g_allocs, (long long)(g_peak - start));
+    if (kept != expected) {
+        printf("  expected %d items\n", expected);
+        return 1;
+    }
+    printf("\n");
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    const char *dir = argc > 1 ? argv[1] : "json_corpus";
+    char line[MAX_LINE];
+
+    snprintf(line, sizeof(line), "%s/manifest.tsv", dir);
+    FILE *manifest = fopen(line, "r");
+    if (!manifest) {
+        fprintf(stderr, "No manifest in %s; run json_corpus.js first\n", dir);
+        return 1;
+    }
+
+    /*
+     * Keep glibc from moving its mmap threshold once a large list is
+     * freed, which would change the usable size of every block after it
+     */
+    mallopt(M_MMAP_THRESHOLD, 64 * 1024 * 1024);
+
+    if (api_init(BENCH_SERVER) != 0) {
+        fprintf(stderr, "api_init failed\n");
+        fclose(manifest);
+        return 1;
+    }
+
+    printf("%s: MAX_MEDIA_ITEMS %d, MEDIA_PAGE_ITEMS %d, %zu-byte items, JSON_PUSH_TOKEN_MAX %d\n",
+           PORT_NAME, MAX_MEDIA_ITEMS, MEDIA_PAGE_ITEMS, sizeof(media_item_t),
+           JSON_PUSH_TOKEN_MAX);
+    printf("%-24s %8s %6s %9s %7s %10s\n", "document", "bytes", "items", "MB/s",
+           "allocs", "peak heap");
+
+    int failures = 0;
+    while (fgets(line, sizeof(line), manifest)) {
+        char name[128], array[32];
+        int items;
+        if (sscanf(line, "%127s\t%31s\t%d", name, array, &items) != 3) {
+            continue;
+        }
+
+        size_t len;
+        char *text = load_file(dir, name, &len);
+        if (!text) {
+            failures++;
+            continue;
+        }
+        doc_kind_t kind = strcmp(array, "results") == 0 ? DOC_SEARCH : DOC_BROWSE;
+        /* A port that pages its listings browses one page at a time */
+        int limit = kind == DOC_BROWSE ? MEDIA_PAGE_ITEMS : MAX_MEDIA_ITEMS;
+        int expected = items < limit ? items : limit;
+        failures += bench_document(name, kind, text, len, expected);
+        free(text);
+    }
+    fclose(manifest);
+
+    size_t len;
+    char *text = load_file(dir, "info.json", &len);
+    if (text) {
+        failures += bench_document("info.json", DOC_INFO, text, len, 1);
+        free(text);
+    } else {
+        failures++;
+    }
+
+    api_shutdown();
+    return failures ? 1 : 0;
+}
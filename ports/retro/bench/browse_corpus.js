@@ -0,0 +1,41 @@
+#!/usr/bin/env node
+/*
+ * Generate /api/browse responses of typical sizes and their compressed
+ * forms for inflate_bench.
+ *
+ * Usage: node browse_corpus.js [outdir]
+ *
+ * Bodies come from fixtures.js. Every payload is written raw and as gzip
+ * at each window size from 9 to 15 bits, and manifest.tsv lists them.
+ */
+
+const fs = require('fs');
+const path = require('path');
+const zlib = require('zlib');
+const { browse } = require('./fixtures');
+
+const outDir = process.argv[2] || path.join(__dirname, 'corpus');
+const ITEM_COUNTS = [8, 50, 200, 1000];
+const WINDOW_BITS = [9, 10, 11, 12, 13, 14, 15];
+const LEVELS = [1, 6, 9];
+
+fs.mkdirSync(outDir, { recursive: true });
+const manifest = [];
+
+for (const count of ITEM_COUNTS) {
+    const raw = Buffer.from(browse(count));
+    const rawName = `browse_${count}.json`;
+    fs.writeFileSync(path.join(outDir, rawName), raw);
+
+    for (const level of LEVELS) {
+        for (const windowBits of WINDOW_BITS) {
+            const wire = zlib.gzipSync(raw, { level, windowBits });
+            const wireName = `browse_${count}_l${level}_w${windowBits}.gz`;
+            fs.writeFileSync(path.join(outDir, wireName), wire);
+            manifest.push([count, level, windowBits, rawName, wireName].join('\t'));
+        }
+    }
+}
+
+fs.writeFileSync(path.join(outDir, 'manifest.tsv'), manifest.join('\n') + '\n');
+console.log(`Wrote ${manifest.length} payloads to ${outDir}`);
@@ -0,0 +1,124 @@
+/*
+ * Nedflix retro benchmarks
+ * Deterministic API response bodies shared by the corpus generator and
+ * the stand-in server.
+ *
+ * Items follow server.js: filesystem fields plus the cached metadata the
+ * browse handler merges in.
+ */
+
+// Deterministic so runs are comparable
+let seed = 12345;
+function rand(n) {
+    seed = (seed * 1103515245 + 12345) & 0x7fffffff;
+    return seed % n;
+}
+
+const SHOWS = ['Star Trek The Next Generation', 'Breaking Bad', 'The Wire',
+               'Battlestar Galactica', 'Doctor Who', 'Twin Peaks', 'The Expanse'];
+const GENRES = ['Drama', 'Sci-Fi', 'Crime, Drama, Thriller', 'Action, Adventure, Sci-Fi'];
+const WORDS = ['the', 'crew', 'discovers', 'a', 'strange', 'signal', 'while', 'an',
+               'old', 'friend', 'returns', 'with', 'news', 'of', 'war', 'and', 'betrayal'];
+
+function plot() {
+    const words = [];
+    for (let i = 0, n = 12 + rand(20); i < n; i++) words.push(WORDS[rand(WORDS.length)]);
+    return words.join(' ') + '.';
+}
+
+function browse(count, show = SHOWS[count % SHOWS.length]) {
+    const dir = `/mnt/nfs/TV Shows/${show}`;
+    const items = [];
+
+    for (let i = 0; i < count; i++) {
+        const season = 1 + Math.floor(i / 24);
+        const episode = 1 + (i % 24);
+        const tag = `S${String(season).padStart(2, '0')}E${String(episode).padStart(2, '0')}`;
+        const name = `${show.replace(/ /g, '.')}.${tag}.720p.WEB-DL.mkv`;
+        const item = {
+            name,
+            path: `${dir}/${name}`,
+            isDirectory: false,
+            isVideo: true,
+            isAudio: false,
+            size: 350000000 + rand(900000000),
+            cleanTitle: show,
+            year: 1987 + rand(30),
+            season,
+            episode,
+            type: 'series'
+        };
+        if (rand(4) !== 0) {
+            item.poster = `https://m.media-amazon.com/images/M/${rand(1e9).toString(36)}.jpg`;
+            item.rating = (5 + rand(50) / 10).toFixed(1);
+            item.genre = GENRES[rand(GENRES.length)];
+            item.plot = plot();
+            item.episodeTitle = `${WORDS[rand(WORDS.length)]} ${WORDS[rand(WORDS.length)]}`;
+            item.hasMetadata = true;
+        } else {
+            item.hasMetadata = false;
+        }
+        items.push(item);
+    }
+
+    return JSON.stringify({
+        currentPath: dir,
+        parentPath: '/mnt/nfs/TV Shows',
+        canGoUp: true,
+        items
+    });
+}
+
+function search(query, count) {
+    const results = JSON.parse(browse(count)).items.map(item => ({
+        name: item.name,
+        path: item.path,
+        isDirectory: item.isDirectory,
+        isVideo: item.isVideo,
+        isAudio: item.isAudio,
+        size: item.size,
+        library: 'tv'
+    }));
+    return JSON.stringify({ query, count: results.length, results });
+}
+
+function info(path) {
+    const name = path.split('/').pop() || path;
+    return JSON.stringify({
+        name,
+        path,
+        isDirectory: false,
+        isVideo: true,
+        size: 350000000 + rand(900000000),
+        duration: 1260 + rand(1800),
+        year: 1987 + rand(30),
+        rating: (5 + rand(50) / 10).toFixed(1),
+        genre: GENRES[rand(GENRES.length)],
+        description: plot(),
+        poster: `https://m.media-amazon.com/images/M/${rand(1e9).toString(36)}.jpg`
+    });
+}
+
+function user(name) {
+    return JSON.stringify({
+        authenticated: true,
+        user: {
+            id: `local-${name}`,
+            provider: 'local',
+            displayName: name,
+            avatar: 'bear',
+            isAdmin: false,
+            isAllowed: true,
+            profilePicture: 'bear',
+            libraryAccess: ['movies', 'tv', 'music', 'audiobooks']
+        },
+        settings: {
+            streamingQuality: 'auto',
+            subtitles: false,
+            volume: 80,
+            autoplay: true
+        }
+    });
+}
+
+module.exports = { browse, search, info, user };
@@ -0,0 +1,71 @@
+/*
+ * Nedflix retro benchmarks
+ * KallistiOS stand-in for host builds of dreamcast/src/network.c
+ *
+ * Only what the port header and the network code use: the integer
+ * types, the default network device, timers and sleeping.
+ */
+
+#ifndef NEDFLIX_HOST_KOS_H
+#define NEDFLIX_HOST_KOS_H
+
+#include <malloc.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef uint8_t  uint8;
+typedef uint16_t uint16;
+typedef uint32_t uint32;
+typedef uint64_t uint64;
+typedef int32_t  int32;
+
+enum {
+    CONT_C = 1, CONT_B = 2, CONT_A = 4, CONT_START = 8,
+    CONT_DPAD_UP = 16, CONT_DPAD_DOWN = 32, CONT_DPAD_LEFT = 64, CONT_DPAD_RIGHT = 128,
+    CONT_Z = 256, CONT_Y = 512, CONT_X = 1024, CONT_D = 2048
+};
+
+#define DBG_INFO  0
+#define DBG_ERROR 1
+#define dbglog(level, ...) fprintf(stderr, __VA_ARGS__)
+
+/* Loopback stands in for the Broadband Adapter */
+typedef struct {
+    uint8 ip_addr[4];
+} netif_t;
+
+static netif_t host_netif __attribute__((unused)) = { { 127, 0, 0, 1 } };
+#define net_default_dev (&host_netif)
+
+static inline int net_init(void) { return 0; }
+static inline void net_shutdown(void) { }
+
+static inline void thd_sleep(int ms) { usleep(ms * 1000); }
+
+static inline uint64 timer_ms_gettime64(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static inline uint64 timer_us_gettime64(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+typedef struct {
+    int unused;
+} mutex_t;
+
+#define MUTEX_INITIALIZER { 0 }
+static inline void mutex_lock(mutex_t *m) { (void)m; }
+static inline void mutex_unlock(mutex_t *m) { (void)m; }
+
+#endif /* NEDFLIX_HOST_KOS_H */
@@ -0,0 +1,2 @@
+/* Network declarations live in the host kos.h */
+#include "../kos.h"
@@ -0,0 +1,37 @@
+/*
+ * Nedflix retro benchmarks
+ * Network control stand-in: the connection is always up on loopback
+ */
+
+#ifndef NEDFLIX_HOST_NETCTL_H
+#define NEDFLIX_HOST_NETCTL_H
+
+#include <string.h>
+#include <psl1ght/lv2.h>
+
+#define NET_CTL_STATE_IPObtained 3
+#define NET_CTL_INFO_IP_ADDRESS  1
+
+typedef union {
+    char ip_address[16];
+} netCtlInfo;
+
+static inline int netInitialize(void) { return 0; }
+static inline int netDeinitialize(void) { return 0; }
+static inline int netCtlInit(void) { return 0; }
+static inline void netCtlTerm(void) { }
+
+static inline int netCtlGetState(s32 *state)
+{
+    *state = NET_CTL_STATE_IPObtained;
+    return 0;
+}
+
+static inline int netCtlGetInfo(int code, netCtlInfo *info)
+{
+    (void)code;
+    strcpy(info->ip_address, "127.0.0.1");
+    return 0;
+}
+
+#endif /* NEDFLIX_HOST_NETCTL_H */
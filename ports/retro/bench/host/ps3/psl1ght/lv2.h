@@ -0,0 +1,19 @@
+/*
+ * Nedflix retro benchmarks
+ * PSL1GHT stand-in for host builds of ps3/src/network.c
+ */
+
+#ifndef NEDFLIX_HOST_LV2_H
+#define NEDFLIX_HOST_LV2_H
+
+#include <stdint.h>
+#include <unistd.h>
+
+typedef uint8_t  u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int32_t  s32;
+typedef int64_t  s64;
+
+#endif /* NEDFLIX_HOST_LV2_H */
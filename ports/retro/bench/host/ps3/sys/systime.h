@@ -0,0 +1,26 @@
+/*
+ * Nedflix retro benchmarks
+ * System time stand-in over the host monotonic clock
+ */
+
+#ifndef NEDFLIX_HOST_SYSTIME_H
+#define NEDFLIX_HOST_SYSTIME_H
+
+#include <time.h>
+#include <unistd.h>
+#include <psl1ght/lv2.h>
+
+static inline u64 sysGetSystemTime(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static inline s32 sysUsleep(u64 usec)
+{
+    usleep(usec);
+    return 0;
+}
+
+#endif /* NEDFLIX_HOST_SYSTIME_H */
@@ -0,0 +1,15 @@
+/*
+ * Nedflix retro benchmarks
+ * lwIP sockets are BSD sockets; the host provides them directly
+ */
+
+#ifndef NEDFLIX_HOST_LWIP_SOCKETS_H
+#define NEDFLIX_HOST_LWIP_SOCKETS_H
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#endif /* NEDFLIX_HOST_LWIP_SOCKETS_H */
@@ -0,0 +1,34 @@
+/*
+ * Nedflix retro benchmarks
+ * libxenon network stand-in: the interface is up on loopback
+ */
+
+#ifndef NEDFLIX_HOST_NETWORK_H
+#define NEDFLIX_HOST_NETWORK_H
+
+#include <stdint.h>
+#include <unistd.h>
+
+struct ip_addr {
+    uint32_t addr;
+};
+
+#define ip4_addr1(a) (((const uint8_t *)&(a)->addr)[0])
+#define ip4_addr2(a) (((const uint8_t *)&(a)->addr)[1])
+#define ip4_addr3(a) (((const uint8_t *)&(a)->addr)[2])
+#define ip4_addr4(a) (((const uint8_t *)&(a)->addr)[3])
+
+static inline void network_init_sys(void) { }
+static inline void network_poll(void) { }
+static inline int network_is_ready(void) { return 1; }
+static inline void mdelay(int ms) { usleep(ms * 1000); }
+
+static inline void network_getip(struct ip_addr *ip, struct ip_addr *netmask,
+                                 struct ip_addr *gateway)
+{
+    ip->addr = 0x0100007f;
+    netmask->addr = 0x000000ff;
+    gateway->addr = 0x0100007f;
+}
+
+#endif /* NEDFLIX_HOST_NETWORK_H */
@@ -0,0 +1,21 @@
+/*
+ * Nedflix retro benchmarks
+ * Timebase stand-in over the host monotonic clock, ticking in microseconds
+ */
+
+#ifndef NEDFLIX_HOST_TIMEBASE_H
+#define NEDFLIX_HOST_TIMEBASE_H
+
+#include <stdint.h>
+#include <time.h>
+
+#define PPC_TIMEBASE_FREQ 1000000ULL
+
+static inline uint64_t mftb(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+#endif
@@ -0,0 +1 @@
+/* Not needed by the network code on the host */
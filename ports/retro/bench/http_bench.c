@@ -0,0 +1,387 @@
+/*
+ * Nedflix retro benchmarks
+ * One port's HTTP client against standin_server.js
+ *
+ * Built once per port from that port's own network source, with the
+ * console SDK headers replaced by the small shims under host/. Each
+ * endpoint is requested the way the port's api.c requests it, and every
+ * request is timed from the call until the body is in hand. Bytes the
+ * client moves with memcpy, memmove or a relocating realloc are counted
+ * through linker wraps, so the report shows how many times each body
+ * byte is copied after it leaves the socket.
+ *
+ * Usage: http_bench [--capture FILE | --replay FILE [--speed N]]
+ *                   <base url> [requests per endpoint] [timings.tsv]
+ *
+ * With a third argument the port's own per-phase request timings
+ * (netstats.c) are written there once the run is over. --capture records
+ * every exchange through the port's netreplay.c; --replay answers from
+ * such a recording instead of the server, N times faster than it was
+ * recorded (default 0, no waiting), so the numbers are the client's
+ * own. The Dreamcast's PCM stream is not recorded and is skipped in a
+ * replay.
+ *
+ * Exits 1 if any request came back short or failed, 2 if the benchmark
+ * could not start.
+ */
+
+#include "nedflix.h"
+
+#include <malloc.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define DEFAULT_REQUESTS 200
+#define WARMUP_REQUESTS  5
+#define TOKEN_MAX        128
+#define URL_MAX          512
+#define STREAM_READ_SIZE 4096    /* One audio buffer refill */
+
+#define BROWSE_PATH "%2Fmnt%2Fnfs%2FTV%20Shows%2FStar%20Trek"
+
+/*
+ * Port glue: what each client calls its init, login and user endpoints,
+ * and how it carries the session token
+ */
+#if defined(BENCH_PORT_DREAMCAST)
+#define PORT_NAME      "dreamcast"
+#define LOGIN_PATH     "/auth/local"
+#define USER_PATH      "/api/user"
+#define BROWSE_URL     "/api/browse?path=" BROWSE_PATH "&limit=200"
+#define PCM_URL        "/api/audio-transcode?path=%2Fmusic%2Ftrack.flac&format=mp3&bitrate=128"
+#define port_init()    network_init()
+#elif defined(BENCH_PORT_XBOX)
+#define PORT_NAME      "xbox"
+#define LOGIN_PATH     "/auth/local"
+#define USER_PATH      "/api/user"
+#define BROWSE_URL     "/api/browse?path=" BROWSE_PATH
+#define PCM_URL        "/api/pcm?path=%2Fmusic%2Ftrack.flac"
+#define port_init()    http_init()
+#elif defined(BENCH_PORT_PS3)
+#define PORT_NAME      "ps3"
+#define LOGIN_PATH     "/api/auth/login"
+#define USER_PATH      "/api/user"
+#define BROWSE_URL     "/api/browse/tvshows?path=" BROWSE_PATH
+#define PCM_URL        "/api/stream?path=%2Fmusic%2Ftrack.flac&quality=high"
+#define port_init()    network_init()
+#elif defined(BENCH_PORT_XBOX360)
+#define PORT_NAME      "xbox360"
+#define LOGIN_PATH     "/api/auth/login"
+#define USER_PATH      "/api/auth/me"
+#define BROWSE_URL     "/api/browse/tvshows?path=" BROWSE_PATH
+#define PCM_URL        "/api/stream?path=%2Fmusic%2Ftrack.flac"
+#define port_init()    network_init()
+#else
+#error "Define BENCH_PORT_DREAMCAST, BENCH_PORT_XBOX, BENCH_PORT_PS3 or BENCH_PORT_XBOX360"
+#endif
+
+#if defined(BENCH_PORT_PS3) || defined(BENCH_PORT_XBOX360)
+app_t g_app;
+#endif
+
+typedef enum {
+    KIND_LOGIN,
+    KIND_JSON,
+    KIND_PCM
+} endpoint_kind_t;
+
+typedef struct {
+    const char *name;
+    endpoint_kind_t kind;
+    const char *path;
+} endpoint_t;
+
+static const endpoint_t g_endpoints[] = {
+    { "login",  KIND_LOGIN, LOGIN_PATH },
+    { "user",   KIND_JSON,  USER_PATH },
+    { "browse", KIND_JSON,  BROWSE_URL },
+    { "search", KIND_JSON,  "/api/search?q=star+trek" },
+    { "pcm",    KIND_PCM,   PCM_URL },
+};
+
+/* Copy accounting, live only while a request is being timed */
+static bool g_counting;
+static uint64_t g_copied;
+
+void *__real_memcpy(void *dst, const void *src, size_t n);
+void *__real_memmove(void *dst, const void *src, size_t n);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_memcpy(void *dst, const void *src, size_t n)
+{
+    if (g_counting) g_copied += n;
+    return __real_memcpy(dst, src, n);
+}
+
+void *__wrap_memmove(void *dst, const void *src, size_t n)
+{
+    if (g_counting) g_copied += n;
+    return __real_memmove(dst, src, n);
+}
+
+/* A realloc that moves the block copies what it held */
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    size_t held = ptr ? malloc_usable_size(ptr) : 0;
+    void *moved = __real_realloc(ptr, size);
+    if (g_counting && moved && ptr && moved != ptr) {
+        g_copied += held < size ? held : size;
+    }
+    return moved;
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static int compare_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+/*
+ * GET through the port's normal buffered path. PS3 passes the token in
+ * the query string, as its api.c does; the others send a Bearer header.
+ */
+static int port_get(const char *url, const char *token, char **body, size_t *len)
+{
+#if defined(BENCH_PORT_PS3)
+    char with_token[URL_MAX + TOKEN_MAX + 8];
+    snprintf(with_token, sizeof(with_token), "%s%ctoken=%s",
+             url, strchr(url, '?') ? '&' : '?', token);
+    return http_get(with_token, body, len);
+#else
+    return http_get_with_auth(url, token, body, len);
+#endif
+}
+
+/* Total size of a WAV from its RIFF header, 0 if the header is missing */
+static size_t wav_size(const unsigned char *data, size_t len)
+{
+    if (len < 8 || strncmp((const char *)data, "RIFF", 4) != 0) return 0;
+    return 8 + ((size_t)data[4] | (size_t)data[5] << 8 |
+                (size_t)data[6] << 16 | (size_t)data[7] << 24);
+}
+
+static int ignore_event(const json_event_t *ev, void *user)
+{
+    (void)ev;
+    (void)user;
+    return 0;
+}
+
+/*
+ * A JSON body that made it through whole ends with its closing brace; a
+ * MessagePack one is read through to the end of its top-level map.
+ */
+static bool json_complete(const char *body, size_t len)
+{
+    if (len > 0 && msgpack_sniff((uint8_t)body[0])) {
+        msgpack_push_t *mp = msgpack_push_create(ignore_event, NULL);
+        bool whole = mp && msgpack_push_feed(mp, body, len) == 1;
+        msgpack_push_destroy(mp);
+        return whole;
+    }
+    while (len > 0 && (body[len - 1] == '\n' || body[len - 1] == ' ')) len--;
+    return len > 0 && body[0] == '{' && body[len - 1] == '}';
+}
+
+/*
+ * Log in and keep the session token. Returns 0 and the body size, or -1.
+ */
+static int run_login(const char *base, char *token, size_t *len)
+{
+    char url[URL_MAX];
+    snprintf(url, sizeof(url), "%s%s", base, LOGIN_PATH);
+
+    char *body = NULL;
+    *len = 0;
+    if (http_post(url, "{\"username\":\"bench\",\"password\":\"bench\"}", &body, len) != 0 || !body) {
+        return -1;
+    }
+
+    const char *start = strstr(body, "\"token\":\"");
+    const char *end = start ? strchr(start + 9, '"') : NULL;
+    int result = -1;
+    if (end && (size_t)(end - start - 9) < TOKEN_MAX) {
+        snprintf(token, TOKEN_MAX, "%.*s", (int)(end - start - 9), start + 9);
+        result = 0;
+    }
+    free(body);
+    return result;
+}
+
+static int run_json(const char *url, const char *token, size_t *len)
+{
+    char *body = NULL;
+    *len = 0;
+    if (port_get(url, token, &body, len) != 0 || !body) {
+        free(body);
+        return -1;
+    }
+    int result = json_complete(body, *len) ? 0 : -1;
+    free(body);
+    return result;
+}
+
+/*
+ * The PCM stream. The Dreamcast reads it through http_stream as its audio
+ * player does, one buffer refill at a time; the other ports have no
+ * streaming path and fetch it whole.
+ */
+static int run_pcm(const char *url, const char *token, size_t *len)
+{
+    *len = 0;
+
+#if defined(BENCH_PORT_DREAMCAST)
+    static unsigned char buf[STREAM_READ_SIZE];
+    http_stream_t stream;
+    size_t expected = 0;
+
+    if (http_stream_open(&stream, url, token, 0) != 0) return -1;
+    for (;;) {
+        int n = http_stream_read(&stream, buf, sizeof(buf));
+        if (n < 0) break;
+        if (n == 0) {
+            struct pollfd pfd = { stream.socket, POLLIN, 0 };
+            poll(&pfd, 1, 100);
+            continue;
+        }
+        if (*len == 0) expected = wav_size(buf, n);
+        *len += n;
+    }
+    http_stream_close(&stream);
+    return expected && *len == expected ? 0 : -1;
+#else
+    char *body = NULL;
+    if (port_get(url, token, &body, len) != 0 || !body) {
+        free(body);
+        return -1;
+    }
+    size_t expected = wav_size((const unsigned char *)body, *len);
+    free(body);
+    return expected && *len == expected ? 0 : -1;
+#endif
+}
+
+static int run_once(const endpoint_t *ep, const char *base, char *token, size_t *len)
+{
+    char url[URL_MAX];
+    snprintf(url, sizeof(url), "%s%s", base, ep->path);
+
+    switch (ep->kind) {
+    case KIND_LOGIN: return run_login(base, token, len);
+    case KIND_JSON:  return run_json(url, token, len);
+    case KIND_PCM:   return run_pcm(url, token, len);
+    }
+    return -1;
+}
+
+int main(int argc, char **argv)
+{
+    const char *capture = NULL, *replay = NULL;
+    unsigned speed = 0;
+
+    const char *prog = argv[0];
+    while (argc > 2 && strncmp(argv[1], "--", 2) == 0) {
+        if (strcmp(argv[1], "--capture") == 0) capture = argv[2];
+        else if (strcmp(argv[1], "--replay") == 0) replay = argv[2];
+        else if (strcmp(argv[1], "--speed") == 0) speed = (unsigned)atoi(argv[2]);
+        else break;
+        argc -= 2;
+        argv += 2;
+    }
+    if (argc < 2 || strncmp(argv[1], "--", 2) == 0) {
+        fprintf(stderr, "Usage: %s [--capture FILE | --replay FILE [--speed N]] "
+                "<base url> [requests per endpoint] [timings.tsv]\n", prog);
+        return 2;
+    }
+    if ((capture && netreplay_capture(capture) != 0) ||
+        (replay && netreplay_replay(replay, speed) != 0)) {
+        fprintf(stderr, "%s: cannot open %s\n", PORT_NAME, capture ? capture : replay);
+        return 2;
+    }
+    const char *base = argv[1];
+    int requests = argc > 2 ? atoi(argv[2]) : DEFAULT_REQUESTS;
+    if (requests < 1) requests = 1;
+
+    /* Keep the report apart from whatever the port prints */
+    FILE *report = fdopen(dup(STDOUT_FILENO), "w");
+    if (!report || !freopen("/dev/null", "w", stdout)) return 2;
+
+    if (port_init() != 0) {
+        fprintf(stderr, "%s: network init failed\n", PORT_NAME);
+        return 2;
+    }
+
+    char token[TOKEN_MAX] = "";
+    size_t len;
+    if (run_login(base, token, &len) != 0) {
+        fprintf(stderr, "%s: login to %s failed\n", PORT_NAME, base);
+        return 2;
+    }
+
+    uint64_t *samples = (uint64_t *)malloc(sizeof(uint64_t) * requests);
+    if (!samples) return 2;
+
+    int failures_total = 0;
+    for (size_t e = 0; e < sizeof(g_endpoints) / sizeof(g_endpoints[0]); e++) {
+        const endpoint_t *ep = &g_endpoints[e];
+        uint64_t body_bytes = 0, copied = 0, elapsed = 0;
+        int failures = 0;
+
+#if defined(BENCH_PORT_DREAMCAST)
+        if (replay && ep->kind == KIND_PCM) continue;
+#endif
+
+        for (int i = 0; i < WARMUP_REQUESTS; i++) {
+            run_once(ep, base, token, &len);
+        }
+
+        for (int i = 0; i < requests; i++) {
+            g_copied = 0;
+            g_counting = true;
+            uint64_t start = now_ns();
+            int result = run_once(ep, base, token, &len);
+            samples[i] = now_ns() - start;
+            g_counting = false;
+
+            elapsed += samples[i];
+            body_bytes += len;
+            copied += g_copied;
+            if (result != 0) failures++;
+        }
+
+        qsort(samples, requests, sizeof(samples[0]), compare_u64);
+        double per_body = (double)body_bytes / requests;
+        double per_copy = (double)copied / requests;
+
+        fprintf(report, "%-10s %-7s %6d %9.1f %8.3f %8.3f %9.0f %9.0f %6.2f %5d\n",
+                PORT_NAME, ep->name, requests,
+                requests / (elapsed / 1e9),
+                samples[requests / 2] / 1e6,
+                samples[(requests * 99) / 100] / 1e6,
+                per_body, per_copy,
+                per_body > 0 ? per_copy / per_body : 0.0,
+                failures);
+        failures_total += failures;
+    }
+
+    if (argc > 3 && netstats_dump(argv[3]) != 0) {
+        fprintf(stderr, "%s: cannot write %s\n", PORT_NAME, argv[3]);
+    }
+
+    netreplay_stop();
+    free(samples);
+    fclose(report);
+    return failures_total ? 1 : 0;
+}
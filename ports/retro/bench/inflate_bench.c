@@ -0,0 +1,192 @@
+/*
+ * Nedflix retro benchmarks
+ * Bytes on the wire versus decode cost for compressed /api/browse bodies
+ *
+ * Runs the shared core's inflate.c over the corpus written by
+ * browse_corpus.js. Input is fed in 1460-byte pieces, as it would come
+ * off one TCP segment at a time, and output is copied into a body buffer
+ * the way the HTTP client does. Each payload reports its wire size and
+ * the best-of-N decode time in CPU cycles (nanoseconds where the host
+ * has no cycle counter), next to a plain copy of the uncompressed body.
+ *
+ * Usage: inflate_bench [corpus dir]
+ */
+
+#include "core.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_UNIT "cycles"
+static uint64_t bench_now(void) { return __rdtsc(); }
+#else
+#define BENCH_UNIT "ns"
+static uint64_t bench_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+#endif
+
+#define SEGMENT_SIZE   1460
+#define MIN_RUNS       20
+#define MAX_LINE       512
+#define DC_WINDOW_BITS 12     /* Dreamcast HTTP_INFLATE_WINDOW_BITS in core/core_config.h */
+
+/* Decoded body being rebuilt, as in HTTP_BODY_CALLER mode */
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+} body_t;
+
+static int body_sink(const char *data, size_t len, void *user)
+{
+    body_t *body = (body_t *)user;
+    if (body->len + len > body->cap) return -1;
+    memcpy(body->data + body->len, data, len);
+    body->len += len;
+    return 0;
+}
+
+static char *load_file(const char *dir, const char *name, size_t *len)
+{
+    char path[MAX_LINE];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        fprintf(stderr, "Cannot open %s\n", path);
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    char *data = (char *)malloc(size > 0 ? size : 1);
+    if (data && fread(data, 1, size, f) != (size_t)size) {
+        free(data);
+        data = NULL;
+    }
+    fclose(f);
+    *len = (size_t)size;
+    return data;
+}
+
+/*
+ * Decode one payload once. Returns elapsed time, or 0 on a decode error.
+ */
+static uint64_t decode_once(const char *wire, size_t wire_len, body_t *body)
+{
+    body->len = 0;
+
+    uint64_t start = bench_now();
+    inflate_t *z = inflate_create(INFLATE_GZIP, body_sink, body);
+    if (!z) return 0;
+
+    int result = 0;
+    for (size_t pos = 0; pos < wire_len && result == 0; pos += SEGMENT_SIZE) {
+        size_t n = wire_len - pos < SEGMENT_SIZE ? wire_len - pos : SEGMENT_SIZE;
+        result = inflate_feed(z, wire + pos, n);
+    }
+    inflate_destroy(z);
+    uint64_t elapsed = bench_now() - start;
+
+    return result == 1 ? elapsed : 0;
+}
+
+/*
+ * Cost of receiving the same body uncompressed: one copy into the buffer
+ */
+static uint64_t copy_once(const char *raw, size_t raw_len, body_t *body)
+{
+    uint64_t start = bench_now();
+    for (size_t pos = 0; pos < raw_len; pos += SEGMENT_SIZE) {
+        size_t n = raw_len - pos < SEGMENT_SIZE ? raw_len - pos : SEGMENT_SIZE;
+        memcpy(body->data + pos, raw + pos, n);
+    }
+    body->len = raw_len;
+    return bench_now() - start;
+}
+
+int main(int argc, char **argv)
+{
+    const char *dir = argc > 1 ? argv[1] : "corpus";
+    char line[MAX_LINE];
+
+    snprintf(line, sizeof(line), "%s/manifest.tsv", dir);
+    FILE *manifest = fopen(line, "r");
+    if (!manifest) {
+        fprintf(stderr, "No manifest in %s; run browse_corpus.js first\n", dir);
+        return 1;
+    }
+
+    printf("Decoder window: %d bits (%u bytes), Dreamcast build: %d bits\n",
+           HTTP_INFLATE_WINDOW_BITS, 1u << HTTP_INFLATE_WINDOW_BITS, DC_WINDOW_BITS);
+    printf("%6s %8s %3s %4s %8s %6s %12s %12s %8s %4s\n",
+           "items", "raw", "lvl", "win", "wire", "ratio",
+           "copy " BENCH_UNIT, "inflate", "per byte", "DC");
+
+    int failures = 0;
+    while (fgets(line, sizeof(line), manifest)) {
+        int items, level, window_bits;
+        char raw_name[128], wire_name[128];
+        if (sscanf(line, "%d\t%d\t%d\t%127s\t%127s", &items, &level, &window_bits,
+                   raw_name, wire_name) != 5) {
+            continue;
+        }
+        if (window_bits > HTTP_INFLATE_WINDOW_BITS) continue;
+
+        size_t raw_len, wire_len;
+        char *raw = load_file(dir, raw_name, &raw_len);
+        char *wire = load_file(dir, wire_name, &wire_len);
+        body_t body = { (char *)malloc(raw_len + 1), 0, raw_len };
+        if (!raw || !wire || !body.data) {
+            return 1;
+        }
+
+        /* Enough runs for a stable minimum, more for small payloads */
+        int runs = MIN_RUNS + (int)(2000000 / (raw_len + 1));
+        uint64_t best_copy = UINT64_MAX, best_inflate = UINT64_MAX;
+        bool ok = true;
+
+        for (int i = 0; i < runs; i++) {
+            uint64_t t = copy_once(raw, raw_len, &body);
+            if (t < best_copy) best_copy = t;
+
+            t = decode_once(wire, wire_len, &body);
+            if (t == 0 || body.len != raw_len || memcmp(body.data, raw, raw_len) != 0) {
+                ok = false;
+                break;
+            }
+            if (t < best_inflate) best_inflate = t;
+        }
+
+        if (!ok) {
+            printf("%6d %8zu %3d %4d %8zu  DECODE FAILED\n",
+                   items, raw_len, level, window_bits, wire_len);
+            failures++;
+        } else {
+            printf("%6d %8zu %3d %4d %8zu %5.1fx %12llu %12llu %8.1f %4s\n",
+                   items, raw_len, level, window_bits, wire_len,
+                   (double)raw_len / wire_len,
+                   (unsigned long long)best_copy, (unsigned long long)best_inflate,
+                   (double)best_inflate / raw_len,
+                   window_bits <= DC_WINDOW_BITS ? "yes" : "no");
+        }
+
+        free(raw);
+        free(wire);
+        free(body.data);
+    }
+
+    fclose(manifest);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,348 @@
+/*
+ * Nedflix retro benchmarks
+ * JSON parse throughput with and without the block string scan
+ *
+ * Runs the shared core's json.c over the corpus written by
+ * json_corpus.js, twice over: as built for the Xbox, PS3 and 360
+ * (JSON_SIMD_SCAN, strings found 16 bytes at a time) and as built for the
+ * Dreamcast (byte at a time). Each is timed copying strings into the
+ * document and decoding them in place. Reports the best-of-N parse rate
+ * in MB/s and checks that both builds find every item.
+ *
+ * The scan build is also timed decoding the listing as it would arrive,
+ * a TCP segment at a time through a schema decoder writing each item into
+ * a list as the PS3 port does, along with how far into the body the first
+ * item could be shown.
+ *
+ * A second table compares each listing with the MessagePack copy that
+ * json_corpus.js writes beside it: bytes on the wire, and the time to
+ * decode the whole response into the list through the same schema.
+ *
+ * Usage: json_bench [corpus dir]
+ */
+
+#include "core.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define MIN_RUNS 20
+#define MAX_LINE 512
+#define SEGMENT  1460   /* Ethernet MSS; the modem's PPP frames are smaller still */
+
+/* The same json.c built with JSON_SIMD_SCAN=0 and these names (see the Makefile) */
+json_value_t *bytewise_json_parse(const char *text);
+json_value_t *bytewise_json_parse_insitu(char *text);
+void bytewise_json_free(json_value_t *v);
+json_value_t *bytewise_json_get_array(json_value_t *obj, const char *key);
+int bytewise_json_array_length(json_value_t *arr);
+
+typedef struct {
+    const char *name;
+    json_value_t *(*parse)(const char *text);
+    json_value_t *(*parse_insitu)(char *text);
+    void (*free)(json_value_t *v);
+    json_value_t *(*get_array)(json_value_t *obj, const char *key);
+    int (*array_length)(json_value_t *arr);
+} parser_build_t;
+
+static const parser_build_t builds[] = {
+    { "bytewise", bytewise_json_parse, bytewise_json_parse_insitu, bytewise_json_free,
+      bytewise_json_get_array, bytewise_json_array_length },
+    { "scan", json_parse, json_parse_insitu, json_free,
+      json_get_array, json_array_length },
+};
+#define BUILD_COUNT (int)(sizeof(builds) / sizeof(builds[0]))
+
+static uint64_t bench_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static char *load_file(const char *dir, const char *name, size_t *len)
+{
+    char path[MAX_LINE];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        fprintf(stderr, "Cannot open %s\n", path);
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    char *data = (char *)malloc(size + 1);
+    if (data && fread(data, 1, size, f) != (size_t)size) {
+        free(data);
+        data = NULL;
+    }
+    fclose(f);
+    if (data) data[size] = '\0';
+    *len = (size_t)size;
+    return data;
+}
+
+/*
+ * Parse one document once. Returns elapsed nanoseconds, or 0 if the
+ * document did not parse or had the wrong number of items. In place,
+ * work is refilled from text before the clock starts.
+ */
+static uint64_t parse_once(const parser_build_t *b, bool insitu, const char *text,
+                           char *work, size_t len, const char *array, int items)
+{
+    if (insitu) memcpy(work, text, len + 1);
+
+    uint64_t start = bench_now();
+    json_value_t *json = insitu ? b->parse_insitu(work) : b->parse(text);
+    uint64_t elapsed = bench_now() - start;
+
+    int found = b->array_length(b->get_array(json, array));
+    b->free(json);
+    if (!json || found != items) return 0;
+    return elapsed > 0 ? elapsed : 1;
+}
+
+/* The fields of the PS3 port's media_item_t that a listing fills in */
+typedef struct {
+    char name[256];
+    char path[1024];
+    media_type_t type;
+    uint32_t duration;
+    uint64_t size;
+} bench_item_t;
+
+static const json_field_t bench_item_fields[] = {
+    JSON_FIELD(bench_item_t, name, "name", STRING),
+    JSON_FIELD(bench_item_t, path, "path", STRING),
+    JSON_FIELD(bench_item_t, duration, "duration", UINT),
+    JSON_FIELD(bench_item_t, size, "size", UINT),
+    MEDIA_HINT_FIELDS
+};
+static json_schema_t bench_item_schema = JSON_SCHEMA_SCRATCH(bench_item_fields, media_hints_t);
+
+/* Items decoded by the streamed parse, and the body offset of the first */
+typedef struct {
+    bench_item_t *list;
+    int capacity;
+    int items;
+    size_t fed;
+    size_t first_at;
+} stream_count_t;
+
+static void *next_item(void *user)
+{
+    stream_count_t *count = (stream_count_t *)user;
+    if (count->items >= count->capacity) return NULL;
+
+    bench_item_t *item = &count->list[count->items];
+    memset(item, 0, sizeof(*item));
+    return item;
+}
+
+static int item_done(void *record, void *scratch, void *user)
+{
+    stream_count_t *count = (stream_count_t *)user;
+    bench_item_t *item = (bench_item_t *)record;
+
+    item->type = media_hints_type((const media_hints_t *)scratch, item->name);
+    if (count->items++ == 0) count->first_at = count->fed;
+    return 0;
+}
+
+/*
+ * Read one document a segment at a time. Returns elapsed nanoseconds, or
+ * 0 if it did not parse or had the wrong number of items. *first_at is
+ * how many bytes had arrived when the first item was complete.
+ */
+static uint64_t stream_once(const char *text, size_t len, const char *array, int items,
+                            bench_item_t *list, size_t *first_at)
+{
+    stream_count_t count = { list, items, 0, 0, 0 };
+    json_decode_t spec = { &bench_item_schema, array, next_item, item_done, &count, NULL, NULL };
+
+    uint64_t start = bench_now();
+    json_decoder_t *d = json_decoder_create(&spec);
+    int result = 0;
+    while (d && count.fed < len && result == 0) {
+        size_t n = len - count.fed < SEGMENT ? len - count.fed : SEGMENT;
+        count.fed += n;
+        result = json_decoder_feed(d, text + count.fed - n, n);
+    }
+    json_decoder_destroy(d);
+    uint64_t elapsed = bench_now() - start;
+
+    *first_at = count.first_at;
+    if (result != 1 || count.items != items) return 0;
+    return elapsed > 0 ? elapsed : 1;
+}
+
+/*
+ * Decode a whole response into list. Returns elapsed nanoseconds, or 0
+ * if it failed or had the wrong number of items.
+ */
+static uint64_t decode_once(const char *text, size_t len, const char *array, int items,
+                            bench_item_t *list)
+{
+    stream_count_t count = { list, items, 0, 0, 0 };
+    json_decode_t spec = { &bench_item_schema, array, next_item, item_done, &count, NULL, NULL };
+
+    uint64_t start = bench_now();
+    int result = json_decode(&spec, text, len);
+    uint64_t elapsed = bench_now() - start;
+
+    if (result < 0 || count.items != items) return 0;
+    return elapsed > 0 ? elapsed : 1;
+}
+
+static uint64_t best_decode(const char *text, size_t len, const char *array, int items,
+                            bench_item_t *list, int runs)
+{
+    uint64_t best = UINT64_MAX;
+    for (int i = 0; i < runs && best; i++) {
+        uint64_t t = decode_once(text, len, array, items, list);
+        if (t < best) best = t;
+    }
+    return best;
+}
+
+/*
+ * Size and schema decode time of each listing as JSON and as MessagePack
+ */
+static int compare_formats(const char *dir)
+{
+    char line[MAX_LINE];
+    snprintf(line, sizeof(line), "%s/manifest.tsv", dir);
+    FILE *manifest = fopen(line, "r");
+    if (!manifest) return 1;
+
+    printf("\n%-24s %10s %10s %6s %10s %10s %8s\n", "document", "json", "msgpack", "size",
+           "json us", "msgpack us", "speedup");
+
+    int failures = 0;
+    while (fgets(line, sizeof(line), manifest)) {
+        char name[128], array[32], packed[160];
+        int items;
+        if (sscanf(line, "%127s\t%31s\t%d", name, array, &items) != 3) {
+            continue;
+        }
+        snprintf(packed, sizeof(packed), "%.*s.msgpack", (int)(strlen(name) - 5), name);
+
+        size_t json_len, mp_len;
+        char *json = load_file(dir, name, &json_len);
+        char *mp = load_file(dir, packed, &mp_len);
+        bench_item_t *list = (bench_item_t *)malloc((items + 1) * sizeof(bench_item_t));
+        if (!json || !mp || !list) {
+            free(json);
+            free(mp);
+            free(list);
+            fclose(manifest);
+            return 1;
+        }
+
+        int runs = MIN_RUNS + (int)(20000000 / (json_len + 1));
+        uint64_t t_json = best_decode(json, json_len, array, items, list, runs);
+        uint64_t t_mp = best_decode(mp, mp_len, array, items, list, runs);
+
+        printf("%-24s %10zu %10zu %5.0f%%", name, json_len, mp_len, 100.0 * mp_len / json_len);
+        if (t_json == 0 || t_mp == 0) {
+            printf(" %10s\n", "FAILED");
+            failures++;
+        } else {
+            printf(" %10.1f %10.1f %7.1fx\n", t_json / 1000.0, t_mp / 1000.0,
+                   (double)t_json / t_mp);
+        }
+
+        free(json);
+        free(mp);
+        free(list);
+    }
+
+    fclose(manifest);
+    return failures;
+}
+
+int main(int argc, char **argv)
+{
+    const char *dir = argc > 1 ? argv[1] : "json_corpus";
+    char line[MAX_LINE];
+
+    snprintf(line, sizeof(line), "%s/manifest.tsv", dir);
+    FILE *manifest = fopen(line, "r");
+    if (!manifest) {
+        fprintf(stderr, "No manifest in %s; run json_corpus.js first\n", dir);
+        return 1;
+    }
+
+    printf("%-24s %8s %6s", "document", "bytes", "items");
+    for (int b = 0; b < BUILD_COUNT; b++) {
+        printf(" %10s %10s", builds[b].name, "in place");
+    }
+    printf(" %10s  (MB/s) %10s\n", "stream", "1st item");
+
+    int failures = 0;
+    while (fgets(line, sizeof(line), manifest)) {
+        char name[128], array[32];
+        int items;
+        if (sscanf(line, "%127s\t%31s\t%d", name, array, &items) != 3) {
+            continue;
+        }
+
+        size_t len;
+        char *text = load_file(dir, name, &len);
+        char *work = (char *)malloc(len + 1);
+        bench_item_t *list = (bench_item_t *)malloc((items + 1) * sizeof(bench_item_t));
+        if (!text || !work || !list) {
+            return 1;
+        }
+
+        /* Enough runs for a stable minimum, more for small documents */
+        int runs = MIN_RUNS + (int)(20000000 / (len + 1));
+
+        printf("%-24s %8zu %6d", name, len, items);
+        for (int b = 0; b < BUILD_COUNT; b++) {
+            for (int insitu = 0; insitu < 2; insitu++) {
+                uint64_t best = UINT64_MAX;
+                for (int i = 0; i < runs && best; i++) {
+                    uint64_t t = parse_once(&builds[b], insitu, text, work, len, array, items);
+                    if (t < best) best = t;
+                }
+                if (best == 0) {
+                    printf(" %10s", "FAILED");
+                    failures++;
+                } else {
+                    printf(" %10.1f", (double)len * 1000.0 / best);
+                }
+            }
+        }
+
+        uint64_t best = UINT64_MAX;
+        size_t first_at = 0;
+        for (int i = 0; i < runs && best; i++) {
+            uint64_t t = stream_once(text, len, array, items, list, &first_at);
+            if (t < best) best = t;
+        }
+        if (best == 0) {
+            printf(" %10s", "FAILED");
+            failures++;
+        } else {
+            printf(" %10.1f", (double)len * 1000.0 / best);
+        }
+        printf("        %10zu\n", first_at);
+
+        free(text);
+        free(work);
+        free(list);
+    }
+
+    fclose(manifest);
+    failures += compare_formats(dir);
+    return failures ? 1 : 0;
+}
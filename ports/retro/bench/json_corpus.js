@@ -0,0 +1,58 @@
+#!/usr/bin/env node
+/*
+ * Generate /api/browse, /api/search and /api/info responses for
+ * json_bench, api_bench and json_fuzz.
+ *
+ * Usage: node json_corpus.js [outdir]
+ *
+ * Bodies come from fixtures.js, at the listing sizes the ports ask for
+ * (50 on the Dreamcast, 500 on the PS3) and one far past them, plus a
+ * listing from a server that writes everything outside ASCII as \u
+ * escapes, as Python's json module does by default. Each is also written
+ * in MessagePack as the stand-in server sends it, with the same name
+ * ending in .msgpack. manifest.tsv names each listing and the array that
+ * holds its items; info.json, one file's metadata, is not a listing and
+ * is left out of it.
+ */
+
+const fs = require('fs');
+const path = require('path');
+const { browse, search, info } = require('./fixtures');
+const msgpack = require('./msgpack');
+
+const outDir = process.argv[2] || path.join(__dirname, 'json_corpus');
+const BROWSE_COUNTS = [50, 500, 5000];
+const SEARCH_COUNTS = [200];
+const ESCAPED_SHOW = 'Shōgun 将軍';
+
+/* JSON with every character outside ASCII written as \u escapes */
+function asciiOnly(json) {
+    return json.replace(/[\u0080-\uffff]/g,
+                        c => '\\u' + c.charCodeAt(0).toString(16).padStart(4, '0'));
+}
+
+function write(name, body) {
+    fs.writeFileSync(path.join(outDir, name), body);
+    fs.writeFileSync(path.join(outDir, name.replace(/\.json$/, '.msgpack')), msgpack.fromJson(body));
+}
+
+fs.mkdirSync(outDir, { recursive: true });
+const manifest = [];
+
+for (const count of BROWSE_COUNTS) {
+    const name = `browse_${count}.json`;
+    write(name, browse(count));
+    manifest.push([name, 'items', count].join('\t'));
+}
+for (const count of SEARCH_COUNTS) {
+    const name = `search_${count}.json`;
+    write(name, search('bad', count));
+    manifest.push([name, 'results', count].join('\t'));
+}
+write('browse_escaped_200.json', asciiOnly(browse(200, ESCAPED_SHOW)));
+manifest.push(['browse_escaped_200.json', 'items', 200].join('\t'));
+
+write('info.json', info('/mnt/nfs/Movies/Blade Runner (1982)/Blade.Runner.1982.Final.Cut.1080p.mkv'));
+
+fs.writeFileSync(path.join(outDir, 'manifest.tsv'), manifest.join('\n') + '\n');
+console.log(`Wrote ${manifest.length + 1} documents to ${outDir}`);
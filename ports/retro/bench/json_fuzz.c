@@ -0,0 +1,589 @@
+/*
+ * Nedflix retro benchmarks
+ * Fuzz target for the JSON and MessagePack readers
+ *
+ * Every input goes down each path a response can take through the core,
+ * and the paths that should agree are checked against each other:
+ *
+ *   - json_parse and json_parse_insitu, as built with the block string
+ *     scan and byte at a time, must find the same listing
+ *   - json_push_t and msgpack_push_t must report the same events whether
+ *     the input arrives whole or in small pieces
+ *   - json_decode on the whole input must fill the same records as a
+ *     json_decoder_t fed the same pieces
+ *   - json_number_scan must agree bit for bit with strtod wherever both
+ *     read the same characters
+ *
+ * The piece sizes are drawn from the input's own hash, so a failure
+ * reproduces from the input alone.
+ *
+ * Built with clang and -fsanitize=fuzzer this is a libFuzzer target (make
+ * json_fuzz CC=clang FUZZ_ENGINE=libfuzzer). Otherwise main() below
+ * drives it under ASan and UBSan: each file in the given directories is
+ * run as it is, then the smaller ones through random mutations. A failing
+ * input is written to json_fuzz_failure.bin before aborting.
+ *
+ * Usage: json_fuzz [-runs N] [-seed S] <corpus dir or file>...
+ */
+
+#include "core.h"
+
+#include <dirent.h>
+#include <float.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define FUZZ_MAX_ITEMS   64
+#define FUZZ_MUTATE_MAX  (64 * 1024)    /* Larger seeds are only run as they are */
+#define FUZZ_NUMBER_MAX  64
+
+/* The same json.c built with JSON_SIMD_SCAN=0 and these names (see the Makefile) */
+json_value_t *bytewise_json_parse(const char *text);
+json_value_t *bytewise_json_parse_insitu(char *text);
+void bytewise_json_free(json_value_t *v);
+const char *bytewise_json_get_string(json_value_t *obj, const char *key);
+int bytewise_json_get_int(json_value_t *obj, const char *key, int def);
+double bytewise_json_get_double(json_value_t *obj, const char *key, double def);
+bool bytewise_json_get_bool(json_value_t *obj, const char *key, bool def);
+json_value_t *bytewise_json_get_array(json_value_t *obj, const char *key);
+int bytewise_json_array_length(json_value_t *arr);
+json_value_t *bytewise_json_array_get(json_value_t *arr, int i);
+
+typedef struct {
+    json_value_t *(*parse)(const char *text);
+    json_value_t *(*parse_insitu)(char *text);
+    void (*free)(json_value_t *v);
+    const char *(*get_string)(json_value_t *obj, const char *key);
+    int (*get_int)(json_value_t *obj, const char *key, int def);
+    double (*get_double)(json_value_t *obj, const char *key, double def);
+    bool (*get_bool)(json_value_t *obj, const char *key, bool def);
+    json_value_t *(*get_array)(json_value_t *obj, const char *key);
+    int (*array_length)(json_value_t *arr);
+    json_value_t *(*array_get)(json_value_t *arr, int i);
+} parser_build_t;
+
+static const parser_build_t builds[] = {
+    { json_parse, json_parse_insitu, json_free, json_get_string, json_get_int,
+      json_get_double, json_get_bool, json_get_array, json_array_length, json_array_get },
+    { bytewise_json_parse, bytewise_json_parse_insitu, bytewise_json_free,
+      bytewise_json_get_string, bytewise_json_get_int, bytewise_json_get_double,
+      bytewise_json_get_bool, bytewise_json_get_array, bytewise_json_array_length,
+      bytewise_json_array_get },
+};
+#define BUILD_COUNT (int)(sizeof(builds) / sizeof(builds[0]))
+
+/* The input being run, kept for the failure report */
+static const uint8_t *g_input;
+static size_t g_input_len;
+
+static void fail(const char *what)
+{
+    fprintf(stderr, "json_fuzz: %s (%zu-byte input, saved to json_fuzz_failure.bin)\n",
+            what, g_input_len);
+    FILE *f = fopen("json_fuzz_failure.bin", "wb");
+    if (f) {
+        fwrite(g_input, 1, g_input_len, f);
+        fclose(f);
+    }
+    abort();
+}
+
+/* FNV-1a, for comparing what two paths produced */
+static uint64_t hash_bytes(uint64_t h, const void *data, size_t len)
+{
+    const uint8_t *p = (const uint8_t *)data;
+    for (size_t i = 0; i < len; i++) {
+        h = (h ^ p[i]) * 0x100000001b3ull;
+    }
+    return h;
+}
+
+#define HASH_INIT 0xcbf29ce484222325ull
+#define HASH_VALUE(h, v) hash_bytes((h), &(v), sizeof(v))
+
+static uint64_t hash_string(uint64_t h, const char *s)
+{
+    return s ? hash_bytes(h, s, strlen(s) + 1) : hash_bytes(h, "", 0) + 1;
+}
+
+/* Pieces of 1 to 64 bytes, the same ones every time for a given input */
+typedef struct {
+    uint64_t state;
+} pieces_t;
+
+static size_t next_piece(pieces_t *p)
+{
+    p->state ^= p->state << 13;
+    p->state ^= p->state >> 7;
+    p->state ^= p->state << 17;
+    return 1 + (size_t)(p->state % 64);
+}
+
+static pieces_t pieces_for(const uint8_t *data, size_t len)
+{
+    pieces_t p = { hash_bytes(HASH_INIT, data, len) | 1 };
+    return p;
+}
+
+/*
+ * The DOM, walked as the ports used to read a listing and an info reply
+ */
+static uint64_t walk_document(const parser_build_t *b, json_value_t *root)
+{
+    uint64_t h = HASH_INIT;
+    bool parsed = root != NULL;
+    h = HASH_VALUE(h, parsed);
+    if (!root) return h;
+
+    static const char *const arrays[] = { "items", "results" };
+    for (int a = 0; a < 2; a++) {
+        json_value_t *arr = b->get_array(root, arrays[a]);
+        int n = b->array_length(arr);
+        h = HASH_VALUE(h, n);
+        for (int i = 0; i < n; i++) {
+            json_value_t *item = b->array_get(arr, i);
+            double size = b->get_double(item, "size", -1);
+            int year = b->get_int(item, "year", -1);
+            bool dir = b->get_bool(item, "isDirectory", false);
+            h = hash_string(h, b->get_string(item, "name"));
+            h = hash_string(h, b->get_string(item, "path"));
+            h = HASH_VALUE(h, size);
+            h = HASH_VALUE(h, year);
+            h = HASH_VALUE(h, dir);
+        }
+    }
+
+    int duration = b->get_int(root, "duration", -1);
+    h = hash_string(h, b->get_string(root, "name"));
+    h = HASH_VALUE(h, duration);
+    return h;
+}
+
+static void check_dom(const uint8_t *data, size_t len)
+{
+    char *text = (char *)malloc(len + 1);
+    if (!text) return;
+
+    uint64_t first = 0;
+    for (int b = 0; b < BUILD_COUNT; b++) {
+        for (int insitu = 0; insitu < 2; insitu++) {
+            memcpy(text, data, len);
+            text[len] = '\0';
+            json_value_t *root = insitu ? builds[b].parse_insitu(text) : builds[b].parse(text);
+            uint64_t h = walk_document(&builds[b], root);
+            builds[b].free(root);
+
+            if (b == 0 && insitu == 0) first = h;
+            else if (h != first) fail("json_parse builds disagree");
+        }
+    }
+    free(text);
+}
+
+/*
+ * Push parser events, hashed. Strings longer than the token buffer come
+ * whole when they lie in one piece and cut short when split, so only
+ * what both keep is compared.
+ */
+typedef struct {
+    uint64_t hash;
+    size_t events;
+} event_log_t;
+
+#define KEPT_MAX (JSON_PUSH_TOKEN_MAX - 4)
+
+static int log_event(const json_event_t *ev, void *user)
+{
+    event_log_t *log = (event_log_t *)user;
+    size_t len = ev->len < KEPT_MAX ? ev->len : KEPT_MAX;
+    uint64_t h = log->hash;
+
+    h = HASH_VALUE(h, ev->type);
+    h = HASH_VALUE(h, ev->depth);
+    h = HASH_VALUE(h, len);
+    if (ev->str) h = hash_bytes(h, ev->str, len);
+    if (ev->type == JSON_EVENT_NUMBER || ev->type == JSON_EVENT_BOOL) {
+        h = HASH_VALUE(h, ev->num);
+        h = HASH_VALUE(h, ev->is_integer);
+        if (ev->is_integer) h = HASH_VALUE(h, ev->integer);
+    }
+    log->hash = h;
+    log->events++;
+    return 0;
+}
+
+typedef struct {
+    void *(*create)(json_event_fn fn, void *user);
+    int (*feed)(void *p, const void *data, size_t len);
+    bool (*done)(const void *p);
+    void (*destroy)(void *p);
+} push_reader_t;
+
+static void *json_create(json_event_fn fn, void *user) { return json_push_create(fn, user); }
+static int json_feed(void *p, const void *data, size_t len) { return json_push_feed((json_push_t *)p, data, len); }
+static bool json_done(const void *p) { return json_push_done((const json_push_t *)p); }
+static void json_destroy(void *p) { json_push_destroy((json_push_t *)p); }
+
+static void *msgpack_create(json_event_fn fn, void *user) { return msgpack_push_create(fn, user); }
+static int msgpack_feed(void *p, const void *data, size_t len) { return msgpack_push_feed((msgpack_push_t *)p, data, len); }
+static bool msgpack_done(const void *p) { return msgpack_push_done((const msgpack_push_t *)p); }
+static void msgpack_destroy(void *p) { msgpack_push_destroy((msgpack_push_t *)p); }
+
+static const push_reader_t readers[] = {
+    { json_create, json_feed, json_done, json_destroy },
+    { msgpack_create, msgpack_feed, msgpack_done, msgpack_destroy },
+};
+
+/*
+ * Feed the input in one go, or in pieces, up to the first error. Returns
+ * 1 if it held a whole document, 0 if it was cut short, -1 on an error.
+ */
+static int push_run(const push_reader_t *r, const uint8_t *data, size_t len,
+                    pieces_t *pieces, event_log_t *log)
+{
+    void *p = r->create(log_event, log);
+    if (!p) return -2;
+
+    int result = 0;
+    size_t off = 0;
+    while (off < len && result >= 0) {
+        size_t n = pieces ? next_piece(pieces) : len;
+        if (n > len - off) n = len - off;
+        result = r->feed(p, data + off, n);
+        off += n;
+    }
+    if (result >= 0) result = r->done(p) ? 1 : 0;
+    r->destroy(p);
+    return result;
+}
+
+static void check_push(const uint8_t *data, size_t len)
+{
+    for (int i = 0; i < 2; i++) {
+        event_log_t whole = { HASH_INIT, 0 }, split = { HASH_INIT, 0 };
+        pieces_t pieces = pieces_for(data, len);
+
+        int a = push_run(&readers[i], data, len, NULL, &whole);
+        int b = push_run(&readers[i], data, len, &pieces, &split);
+        if (a == -2 || b == -2) continue;   /* Out of memory */
+
+        /* After an error only the outcome is compared */
+        if (a != b) fail(i ? "msgpack_push differs when split" : "json_push differs when split");
+        if (a >= 0 && (whole.hash != split.hash || whole.events != split.events)) {
+            fail(i ? "msgpack_push events differ when split" : "json_push events differ when split");
+        }
+    }
+}
+
+/*
+ * Records of every field kind, with members small enough that the
+ * decoder has to cut strings and clamp numbers
+ */
+typedef struct {
+    char name[24];
+    char path[MAX_PATH_LENGTH];
+    int8_t season;
+    uint16_t duration;
+    uint64_t size;
+    int year;
+    float rating;
+    double episode;
+    bool has_metadata;
+    media_type_t type;
+} fuzz_item_t;
+
+static const json_field_t fuzz_item_fields[] = {
+    JSON_FIELD(fuzz_item_t, name, "name", STRING),
+    JSON_FIELD(fuzz_item_t, path, "path", STRING),
+    JSON_FIELD(fuzz_item_t, season, "season", INT),
+    JSON_FIELD(fuzz_item_t, duration, "duration", UINT),
+    JSON_FIELD(fuzz_item_t, size, "size", UINT),
+    JSON_FIELD(fuzz_item_t, year, "year", INT),
+    JSON_FIELD(fuzz_item_t, rating, "rating", REAL),
+    JSON_FIELD(fuzz_item_t, episode, "episode", REAL),
+    JSON_FIELD(fuzz_item_t, has_metadata, "hasMetadata", BOOL),
+    MEDIA_HINT_FIELDS
+};
+static json_schema_t fuzz_item_schema = JSON_SCHEMA_SCRATCH(fuzz_item_fields, media_hints_t);
+
+typedef struct {
+    fuzz_item_t items[FUZZ_MAX_ITEMS];
+    int count;
+    int32_t total;          /* Root members, as a paged listing sends */
+    char path[32];
+} fuzz_list_t;
+
+static const json_field_t fuzz_root_fields[] = {
+    JSON_FIELD(fuzz_list_t, total, "total", INT),
+    JSON_FIELD(fuzz_list_t, path, "currentPath", STRING),
+};
+static json_schema_t fuzz_root_schema = JSON_SCHEMA(fuzz_root_fields);
+
+static void *next_item(void *user)
+{
+    fuzz_list_t *list = (fuzz_list_t *)user;
+    if (list->count >= FUZZ_MAX_ITEMS) return NULL;
+
+    fuzz_item_t *item = &list->items[list->count];
+    memset(item, 0, sizeof(*item));
+    return item;
+}
+
+static int item_done(void *record, void *scratch, void *user)
+{
+    fuzz_item_t *item = (fuzz_item_t *)record;
+    item->type = media_hints_type((const media_hints_t *)scratch, item->name);
+    ((fuzz_list_t *)user)->count++;
+    return 0;
+}
+
+static void check_decode(const uint8_t *data, size_t len)
+{
+    static fuzz_list_t whole, split;
+    static const char *const arrays[] = { "items", "results" };
+
+    for (int a = 0; a < 2; a++) {
+        json_decode_t spec = { &fuzz_item_schema, arrays[a], next_item, item_done, &whole,
+                               &fuzz_root_schema, &whole };
+        memset(&whole, 0, sizeof(whole));
+        int a_ok = json_decode(&spec, (const char *)data, len) == 0;
+
+        spec.user = &split;
+        spec.root_out = &split;
+        memset(&split, 0, sizeof(split));
+        json_decoder_t *d = json_decoder_create(&spec);
+        if (!d) continue;
+        pieces_t pieces = pieces_for(data, len);
+        int result = 0;
+        size_t off = 0;
+        while (off < len && result >= 0) {
+            size_t n = next_piece(&pieces);
+            if (n > len - off) n = len - off;
+            result = json_decoder_feed(d, data + off, n);
+            off += n;
+        }
+        int b_ok = result >= 0 && json_decoder_done(d);
+        json_decoder_destroy(d);
+
+        if (a_ok != b_ok || (a_ok && (whole.count != split.count ||
+                                      whole.total != split.total ||
+                                      strcmp(whole.path, split.path) != 0 ||
+                                      memcmp(whole.items, split.items,
+                                             whole.count * sizeof(fuzz_item_t)) != 0))) {
+            fail("json_decoder differs when split");
+        }
+    }
+
+    fuzz_item_t one;
+    memset(&one, 0, sizeof(one));
+    json_decode_object(&fuzz_item_schema, (const char *)data, len, &one);
+}
+
+/*
+ * A short input as one number. Where the host's double is the IEEE one
+ * the ports assume, the integer path must round exactly as strtod does.
+ */
+static void check_number(const uint8_t *data, size_t len)
+{
+    if (len == 0 || len >= FUZZ_NUMBER_MAX) return;
+
+    char text[FUZZ_NUMBER_MAX];
+    memcpy(text, data, len);
+    text[len] = '\0';
+
+    json_number_t n;
+    const char *end = json_number_scan(text, &n);
+    if (end == text) return;
+    if (n.is_integer && (double)n.integer != n.real) {
+        fail("json_number_scan integer and real disagree");
+    }
+
+#if DBL_MANT_DIG == 53 && FLT_EVAL_METHOD == 0
+    char *strtod_end;
+    double d = strtod(text, &strtod_end);
+    if (strtod_end == end && memcmp(&d, &n.real, sizeof(d)) != 0) {
+        fail("json_number_scan differs from strtod");
+    }
+#endif
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    g_input = data;
+    g_input_len = size;
+
+    check_dom(data, size);
+    check_push(data, size);
+    check_decode(data, size);
+    check_number(data, size);
+    return 0;
+}
+
+#ifndef JSON_FUZZ_LIBFUZZER
+
+#define DEFAULT_RUNS 500
+
+/* Bytes a mutation writes: JSON punctuation, escapes, and MessagePack type bytes */
+static const uint8_t interesting[] = {
+    '{', '}', '[', ']', '"', ',', ':', '\\', 'u', '0', '9', '-', '+', '.', 'e', 'E',
+    't', 'f', 'n', ' ', 0x00, 0x7f, 0x80, 0x8f, 0x90, 0x9f, 0xa0, 0xbf, 0xc0, 0xc1,
+    0xc3, 0xca, 0xcb, 0xcf, 0xd3, 0xd9, 0xdb, 0xdc, 0xdf, 0xe0, 0xed, 0xf0, 0xff
+};
+
+static uint64_t g_rng = 0x9e3779b97f4a7c15ull;
+
+static uint64_t rng(void)
+{
+    g_rng ^= g_rng << 13;
+    g_rng ^= g_rng >> 7;
+    g_rng ^= g_rng << 17;
+    return g_rng;
+}
+
+/*
+ * Change buf in place: a handful of byte writes, a slice moved or
+ * dropped, or the end cut off. Returns the new length, at most cap.
+ */
+static size_t mutate(uint8_t *buf, size_t len, size_t cap)
+{
+    int edits = 1 + (int)(rng() % 4);
+    for (int e = 0; e < edits && len > 0; e++) {
+        size_t at = rng() % len;
+        switch (rng() % 6) {
+            case 0:
+                buf[at] = (uint8_t)rng();
+                break;
+            case 1:
+            case 2:
+                buf[at] = interesting[rng() % sizeof(interesting)];
+                break;
+            case 3: {
+                /* Repeat a slice, as a duplicated key or item would */
+                size_t n = 1 + rng() % 32;
+                if (n > len - at) n = len - at;
+                if (len + n > cap) break;
+                memmove(buf + at + n, buf + at, len - at);
+                len += n;
+                break;
+            }
+            case 4: {
+                size_t n = 1 + rng() % 32;
+                if (n > len - at) n = len - at;
+                memmove(buf + at, buf + at + n, len - at - n);
+                len -= n;
+                break;
+            }
+            default:
+                len = at;
+                break;
+        }
+    }
+    return len;
+}
+
+static uint8_t *load_file(const char *path, size_t *len)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    uint8_t *data = (uint8_t *)malloc(size > 0 ? size : 1);
+    if (data && fread(data, 1, size, f) != (size_t)size) {
+        free(data);
+        data = NULL;
+    }
+    fclose(f);
+    *len = (size_t)size;
+    return data;
+}
+
+/* Run one seed as it is, then mutated; returns the inputs run */
+static long fuzz_file(const char *path, int runs)
+{
+    size_t len;
+    uint8_t *seed = load_file(path, &len);
+    if (!seed) {
+        fprintf(stderr, "Cannot read %s\n", path);
+        return 0;
+    }
+
+    LLVMFuzzerTestOneInput(seed, len);
+    long inputs = 1;
+
+    if (len <= FUZZ_MUTATE_MAX) {
+        size_t cap = len + 1024;
+        uint8_t *buf = (uint8_t *)malloc(cap);
+        for (int i = 0; buf && i < runs; i++) {
+            memcpy(buf, seed, len);
+            size_t n = mutate(buf, len, cap);
+
+            /* An exact-size copy, so ASan sees any read past the end */
+            uint8_t *input = (uint8_t *)malloc(n ? n : 1);
+            memcpy(input, buf, n);
+            LLVMFuzzerTestOneInput(input, n);
+            free(input);
+            inputs++;
+        }
+        free(buf);
+    }
+
+    free(seed);
+    return inputs;
+}
+
+int main(int argc, char **argv)
+{
+    int runs = DEFAULT_RUNS;
+    long inputs = 0;
+    int seeds = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-runs") == 0 && i + 1 < argc) {
+            runs = atoi(argv[++i]);
+            continue;
+        }
+        if (strcmp(argv[i], "-seed") == 0 && i + 1 < argc) {
+            g_rng = strtoull(argv[++i], NULL, 0) | 1;
+            continue;
+        }
+
+        struct stat st;
+        if (stat(argv[i], &st) != 0) {
+            fprintf(stderr, "Cannot read %s\n", argv[i]);
+            return 2;
+        }
+        if (!S_ISDIR(st.st_mode)) {
+            inputs += fuzz_file(argv[i], runs);
+            seeds++;
+            continue;
+        }
+
+        DIR *dir = opendir(argv[i]);
+        struct dirent *de;
+        while (dir && (de = readdir(dir)) != NULL) {
+            if (de->d_name[0] == '.') continue;
+            char path[1024];
+            snprintf(path, sizeof(path), "%s/%s", argv[i], de->d_name);
+            inputs += fuzz_file(path, runs);
+            seeds++;
+        }
+        if (dir) closedir(dir);
+    }
+
+    if (seeds == 0) {
+        fprintf(stderr, "Usage: %s [-runs N] [-seed S] <corpus dir or file>...\n", argv[0]);
+        return 2;
+    }
+    printf("%ld inputs from %d seeds, no failures\n", inputs, seeds);
+    return 0;
+}
+
+#endif /* JSON_FUZZ_LIBFUZZER */
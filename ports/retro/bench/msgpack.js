@@ -0,0 +1,102 @@
+/*
+ * Nedflix retro benchmarks
+ * MessagePack encoder for the stand-in server and the corpus generator.
+ *
+ * Covers what JSON.parse() can produce: null, booleans, numbers (whole
+ * ones in the smallest integer type, the rest as float64), strings,
+ * arrays and plain objects. Object members that are undefined are left
+ * out, as JSON.stringify() does.
+ */
+
+function encode(value) {
+    const parts = [];
+    let size = 0;
+
+    const push = buf => {
+        parts.push(buf);
+        size += buf.length;
+    };
+    const header = (bytes) => push(Buffer.from(bytes));
+    const withLength = (type8, type16, type32, len) => {
+        if (type8 !== null && len < 0x100) return header([type8, len]);
+        if (len < 0x10000) return header([type16, len >> 8, len & 0xff]);
+        const b = Buffer.alloc(5);
+        b[0] = type32;
+        b.writeUInt32BE(len, 1);
+        push(b);
+    };
+
+    const write = v => {
+        if (v === null || v === undefined) {
+            header([0xc0]);
+        } else if (v === true || v === false) {
+            header([v ? 0xc3 : 0xc2]);
+        } else if (typeof v === 'number') {
+            writeNumber(v);
+        } else if (typeof v === 'string') {
+            const s = Buffer.from(v, 'utf8');
+            if (s.length < 32) header([0xa0 | s.length]);
+            else withLength(0xd9, 0xda, 0xdb, s.length);
+            push(s);
+        } else if (Array.isArray(v)) {
+            if (v.length < 16) header([0x90 | v.length]);
+            else withLength(null, 0xdc, 0xdd, v.length);
+            v.forEach(write);
+        } else if (typeof v === 'object') {
+            const keys = Object.keys(v).filter(k => v[k] !== undefined);
+            if (keys.length < 16) header([0x80 | keys.length]);
+            else withLength(null, 0xde, 0xdf, keys.length);
+            for (const k of keys) {
+                write(k);
+                write(v[k]);
+            }
+        } else {
+            throw new TypeError(`Cannot encode ${typeof v}`);
+        }
+    };
+
+    const writeNumber = n => {
+        if (!Number.isSafeInteger(n)) {
+            const b = Buffer.alloc(9);
+            b[0] = 0xcb;
+            b.writeDoubleBE(n, 1);
+            return push(b);
+        }
+        if (n >= 0) {
+            if (n < 0x80) return header([n]);
+            if (n < 0x100) return header([0xcc, n]);
+            if (n < 0x10000) return header([0xcd, n >> 8, n & 0xff]);
+            const b = Buffer.alloc(n < 0x100000000 ? 5 : 9);
+            if (b.length === 5) {
+                b[0] = 0xce;
+                b.writeUInt32BE(n, 1);
+            } else {
+                b[0] = 0xcf;
+                b.writeBigUInt64BE(BigInt(n), 1);
+            }
+            return push(b);
+        }
+        if (n >= -32) return header([n & 0xff]);
+        if (n >= -0x80) return header([0xd0, n & 0xff]);
+        if (n >= -0x8000) return header([0xd1, (n >> 8) & 0xff, n & 0xff]);
+        const b = Buffer.alloc(n >= -0x80000000 ? 5 : 9);
+        if (b.length === 5) {
+            b[0] = 0xd2;
+            b.writeInt32BE(n, 1);
+        } else {
+            b[0] = 0xd3;
+            b.writeBigInt64BE(BigInt(n), 1);
+        }
+        push(b);
+    };
+
+    write(value);
+    return Buffer.concat(parts, size);
+}
+
+/* A JSON body, re-encoded */
+function fromJson(text) {
+    return encode(JSON.parse(text));
+}
+
+module.exports = { encode, fromJson };
@@ -0,0 +1,190 @@
+/*
+ * Nedflix retro benchmarks
+ * Number conversion: json_number_scan() against strtod()
+ *
+ * Generates numbers shaped like the ones the API sends - file sizes,
+ * durations, years, item counts, one-decimal ratings - and some real
+ * floats that the fast path hands back to strtod(). Each set is read
+ * with both and timed best-of-N, in nanoseconds per number. Every result
+ * is also checked bit for bit against strtod(), and whole numbers against
+ * the exact integer.
+ *
+ * Usage: number_bench [count]
+ */
+
+#include "core.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define RUNS 20
+#define MAX_TEXT 32
+
+typedef struct {
+    const char *name;
+    void (*make)(char *out, size_t size);
+} number_set_t;
+
+static uint64_t bench_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+/* xorshift64, so every run sees the same numbers */
+static uint64_t g_rng = 0x9e3779b97f4a7c15ull;
+
+static uint64_t next_random(void)
+{
+    g_rng ^= g_rng << 13;
+    g_rng ^= g_rng >> 7;
+    g_rng ^= g_rng << 17;
+    return g_rng;
+}
+
+static void make_size(char *out, size_t size)
+{
+    /* 1 KB to 8 GB, spread over the magnitudes */
+    uint64_t v = next_random() % (1ull << (10 + next_random() % 24));
+    snprintf(out, size, "%llu", (unsigned long long)(v + 1024));
+}
+
+static void make_duration(char *out, size_t size)
+{
+    snprintf(out, size, "%u", (unsigned)(next_random() % 20000));
+}
+
+static void make_year(char *out, size_t size)
+{
+    snprintf(out, size, "%u", (unsigned)(1920 + next_random() % 106));
+}
+
+static void make_count(char *out, size_t size)
+{
+    snprintf(out, size, "%u", (unsigned)(next_random() % 5000));
+}
+
+static void make_rating(char *out, size_t size)
+{
+    snprintf(out, size, "%u.%u", (unsigned)(next_random() % 10), (unsigned)(next_random() % 10));
+}
+
+static void make_negative(char *out, size_t size)
+{
+    snprintf(out, size, "-%u", (unsigned)(next_random() % 100000));
+}
+
+static void make_real(char *out, size_t size)
+{
+    double v = (double)(next_random() >> 11) / (double)(1ull << 53);
+    snprintf(out, size, "%.17g", v * 1000.0);
+}
+
+static void make_exponent(char *out, size_t size)
+{
+    snprintf(out, size, "%.3e", (double)(next_random() % 100000) * 1e-40);
+}
+
+static const number_set_t sets[] = {
+    { "size", make_size },
+    { "duration", make_duration },
+    { "year", make_year },
+    { "count", make_count },
+    { "rating", make_rating },
+    { "negative", make_negative },
+    { "real 17 digits", make_real },
+    { "exponent", make_exponent },
+};
+#define SET_COUNT (int)(sizeof(sets) / sizeof(sets[0]))
+
+/* Keeps the conversions from being optimised away */
+static volatile double g_sink;
+
+static uint64_t time_strtod(const char *text, int count)
+{
+    uint64_t start = bench_now();
+    double sum = 0.0;
+    for (int i = 0; i < count; i++) {
+        sum += strtod(text + (size_t)i * MAX_TEXT, NULL);
+    }
+    g_sink = sum;
+    return bench_now() - start;
+}
+
+static uint64_t time_scan(const char *text, int count)
+{
+    uint64_t start = bench_now();
+    double sum = 0.0;
+    for (int i = 0; i < count; i++) {
+        json_number_t num;
+        json_number_scan(text + (size_t)i * MAX_TEXT, &num);
+        sum += num.real;
+    }
+    g_sink = sum;
+    return bench_now() - start;
+}
+
+/*
+ * Numbers whose scan differs from strtod(), or whose integer is wrong
+ */
+static int check(const char *text, int count)
+{
+    int wrong = 0;
+    for (int i = 0; i < count; i++) {
+        const char *s = text + (size_t)i * MAX_TEXT;
+        char *end;
+        double expect = strtod(s, &end);
+
+        json_number_t num;
+        const char *scan_end = json_number_scan(s, &num);
+        if (memcmp(&num.real, &expect, sizeof(expect)) != 0 || scan_end != end) {
+            if (wrong++ < 3) fprintf(stderr, "Mismatch on %s: %.17g, strtod %.17g\n",
+                                     s, num.real, expect);
+        }
+        if (num.is_integer && num.integer != strtoll(s, NULL, 10)) {
+            wrong++;
+        }
+    }
+    return wrong;
+}
+
+int main(int argc, char **argv)
+{
+    int count = argc > 1 ? atoi(argv[1]) : 100000;
+    if (count <= 0) return 1;
+
+    char *text = (char *)malloc((size_t)count * MAX_TEXT);
+    if (!text) return 1;
+
+    printf("%-16s %10s %10s %8s %8s\n", "numbers", "strtod", "scan", "speedup", "wrong");
+
+    int failures = 0;
+    for (int s = 0; s < SET_COUNT; s++) {
+        for (int i = 0; i < count; i++) {
+            sets[s].make(text + (size_t)i * MAX_TEXT, MAX_TEXT);
+        }
+
+        uint64_t best_strtod = UINT64_MAX, best_scan = UINT64_MAX;
+        for (int r = 0; r < RUNS; r++) {
+            uint64_t t = time_strtod(text, count);
+            if (t < best_strtod) best_strtod = t;
+            t = time_scan(text, count);
+            if (t < best_scan) best_scan = t;
+        }
+
+        int wrong = check(text, count);
+        failures += wrong;
+        printf("%-16s %10.1f %10.1f %7.1fx %8d\n", sets[s].name,
+               (double)best_strtod / count, (double)best_scan / count,
+               (double)best_strtod / (best_scan ? best_scan : 1), wrong);
+    }
+    printf("(ns per number)\n");
+
+    free(text);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,97 @@
+#!/usr/bin/env node
+/*
+ * Run the per-port HTTP benchmarks against standin_server.js under a set
+ * of network conditions and print one table per condition.
+ *
+ * Usage: node run_http_bench.js <http_bench binary>...
+ *
+ * REQUESTS sets the requests per endpoint on the local scenarios (default
+ * 200); the shaped ones use a tenth of that. Requests a client gets wrong
+ * show in the fail column, and any non-zero count fails the run, as does a
+ * client that cannot run. The failing cells are listed after the tables.
+ */
+
+const { spawn, spawnSync } = require('child_process');
+const path = require('path');
+
+const REQUESTS = parseInt(process.env.REQUESTS, 10) || 200;
+
+const SCENARIOS = [
+    { name: 'keep-alive', args: [], requests: REQUESTS },
+    { name: 'json', args: ['--no-msgpack'], requests: REQUESTS },
+    { name: 'connection: close', args: ['--no-keepalive'], requests: REQUESTS },
+    { name: 'chunked 1KB', args: ['--chunked', '1024'], requests: REQUESTS },
+    { name: 'gzip', args: ['--gzip'], requests: REQUESTS },
+    { name: '20ms latency, 1MB/s', args: ['--latency', '20', '--bandwidth', '1000000'],
+      requests: Math.max(1, Math.floor(REQUESTS / 10)) }
+];
+
+const HEADER = ['port', 'endpoint', 'reqs', 'req/s', 'p50 ms', 'p99 ms',
+                'body B', 'copied B', 'copies', 'fail'];
+
+function startServer(args) {
+    return new Promise((resolve, reject) => {
+        const server = spawn(process.execPath,
+                             [path.join(__dirname, 'standin_server.js'), '--port', '0', ...args],
+                             { stdio: ['ignore', 'pipe', 'inherit'] });
+        server.once('error', reject);
+        server.stdout.once('data', data => {
+            const match = /listening (\d+)/.exec(data.toString());
+            if (!match) return reject(new Error(`Unexpected server output: ${data}`));
+            resolve({ server, port: match[1] });
+        });
+    });
+}
+
+async function main() {
+    const binaries = process.argv.slice(2);
+    if (binaries.length === 0) {
+        console.error('Usage: node run_http_bench.js <http_bench binary>...');
+        process.exit(2);
+    }
+
+    const failures = [];
+    for (const scenario of SCENARIOS) {
+        const { server, port } = await startServer(scenario.args);
+
+        console.log(`\n== ${scenario.name}`);
+        console.log(`${HEADER[0].padEnd(10)} ${HEADER[1].padEnd(7)} ` +
+                    HEADER.slice(2).map((h, i) => h.padStart([6, 9, 8, 8, 9, 9, 6, 5][i])).join(' '));
+
+        for (const binary of binaries) {
+            const run = spawnSync(path.resolve(binary),
+                                  [`http://127.0.0.1:${port}`, String(scenario.requests)],
+                                  { stdio: ['ignore', 'pipe', 'inherit'], timeout: 300000 });
+            const out = (run.stdout || '').toString();
+            process.stdout.write(out);
+            if (run.status !== 0 && run.status !== 1) {
+                failures.push(`${scenario.name}: ${path.basename(binary)} exited with ` +
+                              (run.status === null ? `signal ${run.signal}` : `status ${run.status}`));
+            }
+            for (const line of out.split('\n')) {
+                const cells = line.trim().split(/\s+/);
+                if (cells.length !== HEADER.length) continue;
+                const fail = parseInt(cells[cells.length - 1], 10);
+                if (fail > 0) {
+                    failures.push(`${scenario.name}: ${cells[0]} ${cells[1]} failed ${fail} ` +
+                                  `of ${cells[2]} requests`);
+                }
+            }
+            if (run.status === 1 && !failures.some(f => f.startsWith(`${scenario.name}: `))) {
+                failures.push(`${scenario.name}: ${path.basename(binary)} reported failures`);
+            }
+        }
+        server.kill();
+    }
+
+    if (failures.length) {
+        console.error(`\n${failures.length} failing cell(s):`);
+        for (const failure of failures) console.error(`  ${failure}`);
+    }
+    process.exit(failures.length ? 1 : 0);
+}
+
+main().catch(err => {
+    console.error(err.message);
+    process.exit(1);
+});
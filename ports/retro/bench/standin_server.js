@@ -0,0 +1,305 @@
+#!/usr/bin/env node
+/*
+ * Loopback stand-in for the Nedflix server
+ *
+ * Serves the endpoints the retro clients call with fixed bodies from
+ * fixtures.js, so their HTTP code can be measured without the real server,
+ * its database or a media library. Network conditions are set from the
+ * command line:
+ *
+ *   --port N              Listen port, 0 for any (default 8088)
+ *   --latency MS          Delay before each response starts (default 0)
+ *   --bandwidth BYTES     Per-response send rate in bytes/s (default unlimited)
+ *   --chunked [SIZE]      Chunked transfer encoding in SIZE-byte chunks
+ *                         (default 1024) for HTTP/1.1 requests
+ *   --no-keepalive        Close the connection after every response
+ *   --keepalive-ms MS     Idle keep-alive timeout (default 5000)
+ *   --gzip                Compress JSON for clients that send Accept-Encoding,
+ *                         with the same window as server.js
+ *   --no-msgpack          Send JSON even to clients that accept MessagePack
+ *   --items N             Entries per browse response (default 200)
+ *   --pcm-bytes N         Size of the PCM stream (default 262144)
+ *
+ * Browse, search and info are sent as MessagePack (msgpack.js) to a
+ * client whose Accept lists application/msgpack, and as JSON otherwise.
+ * Every body carries a weak ETag as Express sends it, and a request whose
+ * If-None-Match matches gets an empty 304.
+ *
+ * Prints "listening <port>" once ready.
+ *
+ * Endpoints:
+ *   POST /auth/local, /api/auth/login     {token}
+ *   GET  /api/user, /api/auth/me          401 without a token
+ *   GET  /api/browse[/<library>]          ?path=
+ *   GET  /api/search                      ?q=
+ *   GET  /api/info                        ?path=
+ *   GET  /api/health
+ *   GET  /api/pcm, /api/audio-transcode,  16-bit stereo 44.1kHz WAV, with Range
+ *        /api/stream
+ */
+
+const http = require('http');
+const zlib = require('zlib');
+const crypto = require('crypto');
+const fixtures = require('./fixtures');
+const msgpack = require('./msgpack');
+
+const JSON_COMPRESS_WINDOW_BITS = 12;   /* JSON_COMPRESS_WINDOW_BITS in server.js */
+const PCM_RATE = 44100;
+const PCM_CHANNELS = 2;
+const SEND_SLICE = 1460;                /* Throttled sends go out a segment at a time */
+
+function parseArgs(argv) {
+    const opts = {
+        port: 8088,
+        latency: 0,
+        bandwidth: 0,
+        chunked: 0,
+        keepAlive: true,
+        keepAliveMs: 5000,
+        gzip: false,
+        msgpack: true,
+        items: 200,
+        pcmBytes: 262144
+    };
+
+    for (let i = 0; i < argv.length; i++) {
+        const arg = argv[i];
+        const next = () => parseInt(argv[++i], 10);
+
+        if (arg === '--port') opts.port = next();
+        else if (arg === '--latency') opts.latency = next();
+        else if (arg === '--bandwidth') opts.bandwidth = next();
+        else if (arg === '--chunked') {
+            opts.chunked = /^\d+$/.test(argv[i + 1] || '') ? next() : 1024;
+        }
+        else if (arg === '--no-keepalive') opts.keepAlive = false;
+        else if (arg === '--keepalive-ms') opts.keepAliveMs = next();
+        else if (arg === '--gzip') opts.gzip = true;
+        else if (arg === '--no-msgpack') opts.msgpack = false;
+        else if (arg === '--items') opts.items = next();
+        else if (arg === '--pcm-bytes') opts.pcmBytes = next();
+        else {
+            console.error(`Unknown option: ${arg}`);
+            process.exit(2);
+        }
+    }
+    return opts;
+}
+
+const opts = parseArgs(process.argv.slice(2));
+
+/* Bodies are built once so the server's own cost stays out of the numbers */
+const bodies = {
+    browse: Buffer.from(fixtures.browse(opts.items)),
+    search: Buffer.from(fixtures.search('star trek', Math.min(opts.items, 50))),
+    info: Buffer.from(fixtures.info('/mnt/nfs/TV Shows/The Wire/The.Wire.S01E01.720p.WEB-DL.mkv')),
+    user: Buffer.from(fixtures.user('bench')),
+    health: Buffer.from(JSON.stringify({ status: 'ok', version: 'standin' })),
+    unauthorized: Buffer.from(JSON.stringify({ error: 'Not authenticated' })),
+    notFound: Buffer.from(JSON.stringify({ error: 'Not found' }))
+};
+/* The same bodies in MessagePack, for the responses the clients decode with schemas */
+const packed = {};
+for (const name of ['browse', 'search', 'info']) {
+    packed[name] = msgpack.fromJson(bodies[name].toString());
+}
+const gzipped = new Map();
+const etags = new Map();
+const pcm = makePcm(opts.pcmBytes);
+const tokens = new Set();
+
+/* A 440Hz tone behind a canonical 44-byte WAV header */
+function makePcm(size) {
+    const dataLen = Math.max(0, size - 44) & ~3;
+    const wav = Buffer.alloc(44 + dataLen);
+
+    wav.write('RIFF', 0);
+    wav.writeUInt32LE(36 + dataLen, 4);
+    wav.write('WAVEfmt ', 8);
+    wav.writeUInt32LE(16, 16);
+    wav.writeUInt16LE(1, 20);
+    wav.writeUInt16LE(PCM_CHANNELS, 22);
+    wav.writeUInt32LE(PCM_RATE, 24);
+    wav.writeUInt32LE(PCM_RATE * PCM_CHANNELS * 2, 28);
+    wav.writeUInt16LE(PCM_CHANNELS * 2, 32);
+    wav.writeUInt16LE(16, 34);
+    wav.write('data', 36);
+    wav.writeUInt32LE(dataLen, 40);
+
+    for (let i = 0, pos = 44; pos < wav.length; i++, pos += 4) {
+        const sample = Math.round(Math.sin(2 * Math.PI * 440 * i / PCM_RATE) * 12000);
+        wav.writeInt16LE(sample, pos);
+        wav.writeInt16LE(sample, pos + 2);
+    }
+    return wav;
+}
+
+function tokenFrom(req, url) {
+    const auth = req.headers.authorization || '';
+    if (auth.startsWith('Bearer ')) return auth.slice(7);
+    return url.searchParams.get('token');
+}
+
+/*
+ * Write a body under the configured network conditions: chunked framing
+ * when asked for and the client speaks HTTP/1.1, and paced to the
+ * bandwidth cap.
+ */
+function send(req, res, status, type, body, extra = {}) {
+    const chunked = opts.chunked > 0 && req.httpVersion === '1.1';
+    const headers = { 'Content-Type': type, ...extra };
+
+    if (!opts.keepAlive) headers['Connection'] = 'close';
+    if (!chunked) headers['Content-Length'] = body.length;
+
+    const respond = () => {
+        res.writeHead(status, headers);
+        if (req.method === 'HEAD') return res.end();
+
+        const slice = chunked ? opts.chunked : (opts.bandwidth ? SEND_SLICE : body.length);
+        const start = Date.now();
+        let pos = 0;
+
+        const pump = () => {
+            while (pos < body.length) {
+                if (opts.bandwidth) {
+                    const due = start + (pos * 1000) / opts.bandwidth;
+                    const wait = due - Date.now();
+                    if (wait > 0) return setTimeout(pump, wait);
+                }
+                const end = Math.min(pos + slice, body.length);
+                const more = res.write(body.subarray(pos, end));
+                pos = end;
+                if (!more) return res.once('drain', pump);
+            }
+            res.end();
+        };
+        pump();
+    };
+
+    /* A zero timeout still costs a timer tick, so only wait when asked to */
+    if (opts.latency > 0) setTimeout(respond, opts.latency);
+    else respond();
+}
+
+/* Express's default: weak, from the length and SHA-1 of the bytes sent */
+function etagOf(key, body) {
+    if (!etags.has(key)) {
+        const hash = crypto.createHash('sha1').update(body).digest('base64').substring(0, 27);
+        etags.set(key, `W/"${body.length.toString(16)}-${hash}"`);
+    }
+    return etags.get(key);
+}
+
+function sendJson(req, res, status, name) {
+    let body = bodies[name];
+    let key = name;
+    let type = 'application/json; charset=utf-8';
+    const extra = {};
+    const vary = [];
+
+    if (packed[name]) {
+        vary.push('Accept');
+        if (opts.msgpack && /\bapplication\/msgpack\b/.test(req.headers.accept || '')) {
+            body = packed[name];
+            key += '.mp';
+            type = 'application/msgpack';
+        }
+    }
+    if (opts.gzip && body.length >= 1024 && /\bgzip\b/.test(req.headers['accept-encoding'] || '')) {
+        if (!gzipped.has(key)) {
+            gzipped.set(key, zlib.gzipSync(body, { windowBits: JSON_COMPRESS_WINDOW_BITS }));
+        }
+        body = gzipped.get(key);
+        key += '.gz';
+        extra['Content-Encoding'] = 'gzip';
+        vary.push('Accept-Encoding');
+    }
+    if (vary.length) extra['Vary'] = vary.join(', ');
+
+    if (status === 200) {
+        extra['ETag'] = etagOf(key, body);
+        const match = req.headers['if-none-match'];
+        if (match && match.split(/\s*,\s*/).includes(extra['ETag'])) {
+            delete extra['Content-Encoding'];
+            return send(req, res, 304, type, Buffer.alloc(0), extra);
+        }
+    }
+    send(req, res, status, type, body, extra);
+}
+
+function sendPcm(req, res) {
+    const range = /^bytes=(\d+)-(\d*)$/.exec(req.headers.range || '');
+    if (!range) {
+        return send(req, res, 200, 'audio/wav', pcm, { 'Accept-Ranges': 'bytes' });
+    }
+
+    const first = parseInt(range[1], 10);
+    const last = range[2] ? Math.min(parseInt(range[2], 10), pcm.length - 1) : pcm.length - 1;
+    if (first >= pcm.length || first > last) {
+        return send(req, res, 416, 'text/plain', Buffer.alloc(0),
+                    { 'Content-Range': `bytes */${pcm.length}` });
+    }
+    send(req, res, 206, 'audio/wav', pcm.subarray(first, last + 1), {
+        'Accept-Ranges': 'bytes',
+        'Content-Range': `bytes ${first}-${last}/${pcm.length}`
+    });
+}
+
+function login(req, res) {
+    let raw = '';
+    req.on('data', data => { raw += data; });
+    req.on('end', () => {
+        let username = '';
+        try {
+            username = JSON.parse(raw).username;
+        } catch (e) {
+            username = new URLSearchParams(raw).get('username');
+        }
+        if (!username) {
+            return sendJson(req, res, 400, 'unauthorized');
+        }
+
+        const token = crypto.randomBytes(16).toString('hex');
+        tokens.add(token);
+        const body = Buffer.from(JSON.stringify({ success: true, token, user: { username } }));
+        send(req, res, 200, 'application/json; charset=utf-8', body);
+    });
+}
+
+const server = http.createServer((req, res) => {
+    const url = new URL(req.url, 'http://standin');
+    const route = url.pathname;
+
+    if (req.method === 'POST' && (route === '/auth/local' || route === '/api/auth/login')) {
+        return login(req, res);
+    }
+    if (route === '/api/health') {
+        return sendJson(req, res, 200, 'health');
+    }
+
+    const token = tokenFrom(req, url);
+    if (!token || !tokens.has(token)) {
+        return sendJson(req, res, 401, 'unauthorized');
+    }
+
+    if (route === '/api/user' || route === '/api/auth/me') {
+        sendJson(req, res, 200, 'user');
+    } else if (route === '/api/browse' || route.startsWith('/api/browse/')) {
+        sendJson(req, res, 200, 'browse');
+    } else if (route === '/api/search') {
+        sendJson(req, res, 200, 'search');
+    } else if (route === '/api/info') {
+        sendJson(req, res, 200, 'info');
+    } else if (route === '/api/pcm' || route === '/api/audio-transcode' || route === '/api/stream') {
+        sendPcm(req, res);
+    } else {
+        sendJson(req, res, 404, 'notFound');
+    }
+});
+
+server.keepAliveTimeout = opts.keepAliveMs;
+server.listen(opts.port, '127.0.0.1', () => {
+    console.log(`listening ${server.address().port}`);
+});
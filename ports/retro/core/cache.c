@@ -0,0 +1,170 @@
+/*
+ * Nedflix retro ports - shared core
+ * Browse/search response cache
+ *
+ * Listings, and pages of the longer ones, are kept already parsed,
+ * together with the ETag and Last-Modified the server sent with them.
+ * Going back to a directory sends those as a conditional GET; a 304
+ * means the kept items are still current and they are copied out with
+ * nothing downloaded or parsed. Items are opaque here: each port passes
+ * the size of its own media_item_t. Entries are keyed by URL and session
+ * token, and the least recently used go first once CACHE_BUDGET_BYTES
+ * of items are held in at most CACHE_MAX_ENTRIES entries.
+ */
+
+#include "core.h"
+#include <string.h>
+
+/* One cached listing; url[0] == '\0' marks a free slot */
+typedef struct {
+    char url[MAX_URL_LENGTH];
+    uint32_t token_hash;
+    http_validators_t validators;
+    void *items;
+    size_t bytes;
+    int count;
+    int32_t total;          /* Size of the whole listing the items are from */
+    uint32_t last_used;
+} cache_entry_t;
+
+static cache_entry_t g_cache[CACHE_MAX_ENTRIES];
+static size_t g_cache_bytes;
+static uint32_t g_cache_clock;
+
+/*
+ * FNV-1a of the session token, so entries need not keep a copy of it
+ */
+static uint32_t token_hash(const char *token)
+{
+    uint32_t hash = 2166136261u;
+    for (; token && *token; token++) {
+        hash = (hash ^ (uint8_t)*token) * 16777619u;
+    }
+    return hash;
+}
+
+static cache_entry_t *cache_find(const char *url, const char *token)
+{
+    uint32_t hash = token_hash(token);
+
+    for (int i = 0; i < CACHE_MAX_ENTRIES; i++) {
+        cache_entry_t *e = &g_cache[i];
+        if (e->url[0] && e->token_hash == hash && strcmp(e->url, url) == 0) {
+            return e;
+        }
+    }
+    return NULL;
+}
+
+static void cache_evict(cache_entry_t *e)
+{
+    g_cache_bytes -= e->bytes;
+    core_free(e->items);
+    memset(e, 0, sizeof(*e));
+}
+
+/*
+ * Validators to revalidate url with. Clears them and returns false when
+ * nothing is cached for it.
+ */
+bool cache_validators(const char *url, const char *token, http_validators_t *validators)
+{
+    cache_entry_t *e = cache_find(url, token);
+    if (!e) {
+        memset(validators, 0, sizeof(*validators));
+        return false;
+    }
+
+    *validators = e->validators;
+    return true;
+}
+
+/*
+ * Copy up to max cached items of item_size bytes into items once the
+ * server has answered 304, and the size of the listing they are from
+ * into *total when it is not NULL. Returns the number copied, or -1 if
+ * nothing is cached for url.
+ */
+int cache_restore(const char *url, const char *token, void *items, size_t item_size, int max,
+                  int32_t *total)
+{
+    cache_entry_t *e = cache_find(url, token);
+    if (!e || e->bytes != (size_t)e->count * item_size) return -1;
+
+    e->last_used = ++g_cache_clock;
+    int count = e->count < max ? e->count : max;
+    memcpy(items, e->items, (size_t)count * item_size);
+    if (total) *total = e->total;
+    return count;
+}
+
+/*
+ * Keep freshly parsed items in place of any older copy. Responses
+ * without a validator could never be revalidated, so are not kept.
+ */
+void cache_store(const char *url, const char *token, const http_validators_t *validators,
+                 const void *items, size_t item_size, int count, int32_t total)
+{
+    cache_entry_t *e = cache_find(url, token);
+    if (e) {
+        cache_evict(e);
+    }
+
+    if (count < 0 || (item_size && (size_t)count > CACHE_BUDGET_BYTES / item_size)) {
+        return;
+    }
+    size_t bytes = (size_t)count * item_size;
+    if ((!validators->etag[0] && !validators->last_modified[0]) ||
+        strlen(url) >= MAX_URL_LENGTH) {
+        return;
+    }
+
+    /* Evict least recently used entries until a slot and the bytes are free */
+    for (;;) {
+        cache_entry_t *free_slot = NULL;
+        cache_entry_t *oldest = NULL;
+
+        for (int i = 0; i < CACHE_MAX_ENTRIES; i++) {
+            cache_entry_t *c = &g_cache[i];
+            if (!c->url[0]) {
+                if (!free_slot) free_slot = c;
+            } else if (!oldest || c->last_used < oldest->last_used) {
+                oldest = c;
+            }
+        }
+
+        if (free_slot && g_cache_bytes + bytes <= CACHE_BUDGET_BYTES) {
+            e = free_slot;
+            break;
+        }
+        cache_evict(oldest);
+    }
+
+    if (bytes > 0) {
+        e->items = core_malloc(bytes);
+        if (!e->items) return;
+        memcpy(e->items, items, bytes);
+    }
+
+    strcpy(e->url, url);
+    e->token_hash = token_hash(token);
+    e->validators = *validators;
+    e->bytes = bytes;
+    e->count = count;
+    e->total = total;
+    e->last_used = ++g_cache_clock;
+    g_cache_bytes += bytes;
+}
+
+/*
+ * Drop every cached listing, e.g. when leaving the server
+ */
+void cache_clear(void)
+{
+    for (int i = 0; i < CACHE_MAX_ENTRIES; i++) {
+        if (g_cache[i].url[0]) {
+            cache_evict(&g_cache[i]);
+        }
+    }
+    g_cache_bytes = 0;
+}
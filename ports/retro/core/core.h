@@ -0,0 +1,529 @@
+/*
+ * Nedflix retro ports - shared core
+ * Network, JSON and API pieces common to every port
+ *
+ * One copy of the code each console port used to carry on its own: URL
+ * handling, name lookups, request heads, HTTP/1.1 header and body
+ * plumbing, non-blocking requests driven from each port's main loop,
+ * request timing, capture and replay, gzip decoding, the JSON
+ * parser, the schema decoders that fill each port's structs from API
+ * responses and the cache of parsed listings. Sockets, the clock,
+ * threads and allocation come from the platform shim, sizes from
+ * core_config.h, and the same sources build on Linux (core/Makefile) for
+ * benchmarking.
+ *
+ * Each port's nedflix.h includes this ahead of its own declarations.
+ */
+
+#ifndef NEDFLIX_CORE_H
+#define NEDFLIX_CORE_H
+
+#include "core_platform.h"
+#include "core_config.h"
+
+/* Media types */
+typedef enum {
+    MEDIA_TYPE_UNKNOWN,
+    MEDIA_TYPE_DIRECTORY,
+    MEDIA_TYPE_AUDIO,
+    MEDIA_TYPE_VIDEO
+} media_type_t;
+
+/* url.c */
+int url_parse(const char *url, char *host, size_t host_len, int *port,
+              char *path, size_t path_len);
+void url_encode(const char *src, char *dst, size_t dst_size);
+
+/* netstats.c - where request time goes, per endpoint */
+typedef enum {
+    NET_PHASE_DNS,
+    NET_PHASE_CONNECT,
+    NET_PHASE_SEND,
+    NET_PHASE_TTFB,         /* Last request byte out to first response byte in */
+    NET_PHASE_TRANSFER,     /* First response byte to the end of the body */
+    NET_PHASE_PARSE,        /* Client-side parsing, reported by api.c */
+    NET_PHASE_COUNT
+} net_phase_t;
+
+/* One request being timed */
+typedef struct {
+    uint64_t mark;          /* Microseconds at the last phase boundary */
+    uint32_t phase_us[NET_PHASE_COUNT];
+    uint32_t bytes;         /* Received, headers included, before decoding */
+    bool responded;
+} net_timing_t;
+
+/* Totals for one endpoint (URL path without the query) */
+typedef struct {
+    char name[NETSTATS_NAME_MAX];
+    uint32_t requests;
+    uint32_t failures;
+    uint32_t parses;
+    uint64_t phase_us[NET_PHASE_COUNT];
+    uint64_t bytes;
+    uint32_t histogram[NETSTATS_BUCKETS];
+} netstats_endpoint_t;
+
+uint64_t netstats_now_us(void);
+void netstats_start(net_timing_t *t);
+void netstats_phase(net_timing_t *t, net_phase_t phase);
+void netstats_first_byte(net_timing_t *t);
+void netstats_record(const char *url, net_timing_t *t, bool ok);
+void netstats_parse(const char *url, uint64_t started_us);
+int netstats_count(void);
+const netstats_endpoint_t *netstats_endpoint(int index);
+uint32_t netstats_percentile_ms(const netstats_endpoint_t *e, int percent);
+int netstats_format(int index, char *line1, char *line2, size_t size);
+void netstats_reset(void);
+int netstats_dump(const char *path);
+
+/* http.c - HTTP/1.1 pieces every client shares */
+
+/* Validators of a cached response, sent back as If-None-Match / If-Modified-Since */
+typedef struct {
+    char etag[HTTP_ETAG_MAX];
+    char last_modified[HTTP_DATE_MAX];
+} http_validators_t;
+
+bool http_header_is(const char *name, size_t name_len, const char *lower);
+bool http_value_has(const char *value, size_t value_len, const char *lower);
+void http_copy_validator(char *dst, size_t dst_size, const char *value, size_t value_len);
+void http_validators_update(http_validators_t *validators, int status,
+                            const http_validators_t *got);
+int http_conditional_headers(char *buf, size_t size, const http_validators_t *validators);
+int http_body_reserve(char **body, size_t *cap, size_t used, size_t need);
+
+/* Accept for API requests: MessagePack where the server has it (msgpack.c) */
+#if API_MSGPACK
+#define HTTP_ACCEPT_HEADER "Accept: application/msgpack, application/json;q=0.5\r\n"
+#else
+#define HTTP_ACCEPT_HEADER "Accept: application/json\r\n"
+#endif
+
+/* Throughput estimate (bytes/sec, 0 until measured) for picking bitrates */
+void http_throughput_sample(size_t bytes, uint64_t usec);
+uint32_t http_throughput_estimate(void);
+
+/*
+ * Buffered reads off a keep-alive connection. Bytes belonging to the
+ * next response stay in the buffer rather than going out with the
+ * previous one, which is what lets responses be pipelined.
+ */
+typedef struct {
+    int sock;
+    size_t pos;
+    size_t len;
+    size_t consumed;        /* Bytes handed out so far, for request timing */
+    char buf[RECV_BUFFER_SIZE];
+} http_reader_t;
+
+/* One request of a pipelined batch; status is -1 when nothing answered
+ * it. With validators the GET is conditional, and they are updated from
+ * the response. */
+typedef struct {
+    const char *url;
+    char *response;
+    size_t len;
+    int status;
+    http_validators_t *validators;
+} http_batch_t;
+
+void http_reader_init(http_reader_t *r, int sock);
+int http_reader_fill(http_reader_t *r);
+int http_reader_line(http_reader_t *r, char *line, size_t size);
+int http_reader_read(http_reader_t *r, char *dst, size_t len);
+int http_read_response(http_reader_t *r, http_batch_t *req, int *keep_alive,
+                       net_timing_t *timing);
+
+/*
+ * Name lookups, cached for DNS_CACHE_TTL_MS (failures for
+ * DNS_NEGATIVE_TTL_MS). Addresses are IPv4 in network byte order.
+ */
+int http_resolve(const char *host, uint32_t *addr);
+void http_resolve_forget(const char *host);
+int http_open(const char *host, int port, net_timing_t *timing);
+
+/* One request to build; fields a request does not use stay NULL or 0 */
+#define HTTP_REQ_KEEP_ALIVE 0x01    /* Connection: keep-alive rather than close */
+#define HTTP_REQ_ENCODED    0x02    /* Accept-Encoding: gzip, deflate */
+
+typedef struct {
+    const char *method;
+    const char *host;
+    const char *path;
+    const char *token;                  /* Sent as Authorization: Bearer */
+    unsigned flags;                     /* HTTP_REQ_* */
+    const http_validators_t *conditions;/* Makes a GET conditional */
+    const char *extra_headers;          /* Further lines, each ending in CRLF */
+    const char *body;                   /* JSON; NULL for none */
+} http_request_t;
+
+/* The per-request lines of a request head, kept by the caller until sent */
+typedef struct {
+    char line[HTTP_REQUEST_LINE_MAX];
+    char tail[HTTP_REQUEST_TAIL_MAX];
+} http_request_head_t;
+
+int http_build_request(const http_request_t *req, http_request_head_t *head,
+                       core_piece_t piece[4]);
+int http_format_request(const http_request_t *req, char *buf, size_t size);
+int http_send_pieces(int sock, core_piece_t *piece, int count);
+
+/* Blocking requests read with http_read_response, for the PS3 and 360 */
+int http_fetch(const char *method, http_batch_t *req, const char *token, const char *body);
+int http_fetch_body(const char *method, const char *url, const char *token,
+                    http_validators_t *validators, const char *body,
+                    char **response, size_t *len);
+int http_fetch_pipelined(http_batch_t *batch, int count, const char *token);
+
+/* Resolver and header counters since start-up */
+typedef struct {
+    uint32_t dns_lookups;       /* Names looked up on the network */
+    uint32_t dns_cache_hits;    /* Names answered from the cache */
+    uint32_t header_builds;     /* Times the session headers were serialized */
+} http_request_stats_t;
+
+void http_request_stats(http_request_stats_t *stats);
+
+/* netreplay.c - HTTP exchanges captured to a file and served back offline */
+typedef struct {
+    int status;             /* HTTP status, or -1 for a request that failed */
+    http_validators_t validators;
+    uint32_t phase_us[NET_PHASE_PARSE]; /* DNS to transfer, as first timed */
+    uint32_t bytes;         /* Received on the wire */
+    const char *body;       /* NUL-terminated */
+    size_t body_len;
+} netreplay_exchange_t;
+
+int netreplay_capture(const char *path);
+int netreplay_replay(const char *path, uint32_t speed);
+void netreplay_stop(void);
+bool netreplay_capturing(void);
+bool netreplay_replaying(void);
+void netreplay_record(const char *method, const char *url, int status,
+                      const http_validators_t *validators, const net_timing_t *timing,
+                      const char *body, size_t body_len);
+const netreplay_exchange_t *netreplay_lookup(const char *method, const char *url);
+uint32_t netreplay_delay_us(const netreplay_exchange_t *x);
+void netreplay_wait(const netreplay_exchange_t *x);
+void netreplay_timing(const netreplay_exchange_t *x, net_timing_t *t);
+const netreplay_exchange_t *netreplay_answer(const char *method, const char *url);
+char *netreplay_body_copy(const netreplay_exchange_t *x);
+
+/* inflate.c - streaming gzip/deflate decoder */
+#define INFLATE_AUTO 0      /* Sniff gzip, zlib or raw deflate */
+#define INFLATE_GZIP 1
+#define INFLATE_ZLIB 2
+#define INFLATE_RAW  3
+
+typedef struct inflate_ctx inflate_t;
+typedef int (*inflate_sink_t)(const char *data, size_t len, void *user);
+inflate_t *inflate_create(int format, inflate_sink_t sink, void *user);
+int inflate_feed(inflate_t *z, const void *data, size_t len);
+bool inflate_done(const inflate_t *z);
+void inflate_destroy(inflate_t *z);
+
+/* http_async.c - resumable response parser */
+typedef enum {
+    HTTP_PARSE_STATUS,
+    HTTP_PARSE_HEADERS,
+    HTTP_PARSE_BODY,
+    HTTP_PARSE_DONE
+} http_parse_state_t;
+
+/* Where decoded body bytes go */
+typedef enum {
+    HTTP_BODY_ALLOC,    /* Malloc'd buffer, capped at HTTP_MAX_BUFFERED_BODY */
+    HTTP_BODY_CALLER,   /* Fixed caller-owned buffer */
+    HTTP_BODY_SINK      /* Streamed to a callback, no size cap */
+} http_body_mode_t;
+
+/* Content-Encoding of a response body */
+typedef enum {
+    CODING_IDENTITY,
+    CODING_GZIP,
+    CODING_DEFLATE,     /* zlib-wrapped, or raw from some servers */
+    CODING_OTHER        /* Anything we never advertise */
+} http_coding_t;
+
+/* Chunked transfer-encoding decoder states */
+typedef enum {
+    CHUNK_SIZE,         /* Hex size digits */
+    CHUNK_EXT,          /* ";name=value" extensions up to LF */
+    CHUNK_DATA,         /* Payload bytes */
+    CHUNK_DATA_END,     /* CRLF after payload */
+    CHUNK_TRAILER       /* Trailer lines after the zero-length chunk */
+} http_chunk_state_t;
+
+/* Streaming body consumer: return <0 to abort the transfer */
+typedef int (*http_body_sink_t)(const char *data, size_t len, void *user);
+
+/*
+ * HTTP response parsing state.
+ * Bytes are fed in as they arrive from recv(); headers are parsed a line
+ * at a time and never rescanned, body bytes go straight to the destination.
+ */
+typedef struct {
+    http_parse_state_t state;
+    char line[HTTP_HEADER_LINE_MAX];
+    size_t line_len;
+    size_t header_bytes;
+
+    int status_code;
+    size_t content_length;
+    bool has_content_length;
+    bool chunked;
+    bool has_content_range;
+    size_t range_start;
+    size_t range_total;
+
+    http_chunk_state_t chunk_state;
+    size_t chunk_left;
+    bool chunk_digits;
+    size_t trailer_line_len;
+
+    /* Content-Encoding is only undone when the request advertised it */
+    bool accept_encoding;
+    http_coding_t coding;
+    inflate_t *inflate;
+    size_t wire_len;        /* Body bytes as framed, before decoding */
+
+    http_validators_t validators;   /* ETag / Last-Modified, if sent */
+
+    http_body_mode_t mode;
+    http_body_sink_t sink;
+    void *sink_user;
+    char *body;
+    size_t body_len;
+    size_t body_cap;
+} http_response_t;
+
+int http_response_feed(http_response_t *resp, char *data, size_t len);
+int http_response_receive(int sock, http_response_t *resp, bool wait);
+int http_response_deliver(http_response_t *resp, const char *data, size_t len);
+int http_chunk_decode(http_response_t *resp, char *data, size_t len, size_t *out);
+void http_response_release(http_response_t *resp);
+void http_response_capture(const char *method, const char *url, int status,
+                           const http_response_t *resp, const net_timing_t *timing);
+
+/* Non-blocking requests, driven by http_update() once per frame */
+#define HTTP_IN_PROGRESS 1
+
+typedef int http_handle_t;
+
+http_handle_t http_submit(const char *method, const char *url, const char *token,
+                          const char *body);
+http_handle_t http_submit_conditional(const char *url, const char *token,
+                                      const http_validators_t *validators);
+http_handle_t http_submit_stream(const char *url, const char *token,
+                                 const http_validators_t *validators,
+                                 http_body_sink_t sink, void *user);
+void http_update(void);
+int http_poll(http_handle_t handle, char **response, size_t *len);
+int http_poll_conditional(http_handle_t handle, http_validators_t *validators,
+                          char **response, size_t *len);
+void http_cancel(http_handle_t handle);
+void http_cancel_all(void);
+
+/*
+ * json.c - minimal parser. json_parse() copies the strings it keeps, so
+ * the text can be freed straight away. json_parse_insitu() decodes them
+ * inside the text instead, which costs no copies but overwrites the text
+ * and ties every string in the document to it: free the text only after
+ * json_free(). Either way, pointers from json_get_* last until json_free().
+ */
+typedef struct json_value json_value_t;
+json_value_t *json_parse(const char *text);
+json_value_t *json_parse_insitu(char *text);
+void json_free(json_value_t *v);
+const char *json_get_string(json_value_t *obj, const char *key);
+int json_get_int(json_value_t *obj, const char *key, int def);
+double json_get_double(json_value_t *obj, const char *key, double def);
+bool json_get_bool(json_value_t *obj, const char *key, bool def);
+json_value_t *json_get_object(json_value_t *obj, const char *key);
+json_value_t *json_get_array(json_value_t *obj, const char *key);
+int json_array_length(json_value_t *arr);
+json_value_t *json_array_get(json_value_t *arr, int i);
+
+/*
+ * json.c - one number. Whole numbers of up to 18 digits are also kept
+ * exactly in integer, which a double cannot promise where the Dreamcast
+ * builds double as single precision. Returns the end of the number, or
+ * text itself if there is none.
+ */
+typedef struct {
+    double real;
+    int64_t integer;
+    bool is_integer;
+} json_number_t;
+
+const char *json_number_scan(const char *text, json_number_t *out);
+
+/*
+ * json.c - incremental parsing. A json_push_t takes the text in chunks
+ * split anywhere, such as each recv() as it returns, and reports every
+ * key, scalar and container boundary to a callback as soon as it is
+ * complete. Only the current token is buffered; strings longer than
+ * JSON_PUSH_TOKEN_MAX are cut short.
+ */
+typedef enum {
+    JSON_EVENT_OBJECT_START,
+    JSON_EVENT_OBJECT_END,
+    JSON_EVENT_ARRAY_START,
+    JSON_EVENT_ARRAY_END,
+    JSON_EVENT_KEY,
+    JSON_EVENT_STRING,
+    JSON_EVENT_NUMBER,
+    JSON_EVENT_BOOL,
+    JSON_EVENT_NULL
+} json_event_type_t;
+
+typedef struct {
+    json_event_type_t type;
+    int depth;              /* Containers around it; the root is at 0 */
+    const char *str;        /* KEY and STRING, decoded; valid during the callback */
+    size_t len;
+    double num;             /* NUMBER, or 1/0 for BOOL */
+    int64_t integer;        /* NUMBER, exactly, when is_integer */
+    bool is_integer;
+} json_event_t;
+
+typedef int (*json_event_fn)(const json_event_t *ev, void *user);
+typedef struct json_push json_push_t;
+json_push_t *json_push_create(json_event_fn fn, void *user);
+int json_push_feed(json_push_t *jp, const void *data, size_t len);
+bool json_push_done(const json_push_t *jp);
+void json_push_destroy(json_push_t *jp);
+
+/*
+ * msgpack.c - MessagePack, read in chunks like json_push_t and reported
+ * as the same events, maps as objects. Strings point into the chunk fed
+ * unless one was split between chunks, and are not NUL-terminated.
+ * msgpack_sniff() tells a response's format from its first byte.
+ */
+typedef struct msgpack_push msgpack_push_t;
+bool msgpack_sniff(uint8_t first);
+msgpack_push_t *msgpack_push_create(json_event_fn fn, void *user);
+int msgpack_push_feed(msgpack_push_t *mp, const void *data, size_t len);
+bool msgpack_push_done(const msgpack_push_t *mp);
+void msgpack_push_destroy(msgpack_push_t *mp);
+
+/*
+ * schema.c - decoders described by field tables. A schema lists the keys
+ * of one kind of JSON object and the struct member each one fills; the
+ * decoder runs on json_push_t events, or msgpack_push_t ones when the
+ * response is MessagePack, finds each key with a perfect hash
+ * and writes its value straight into the member, so no document is ever
+ * built. Fields can instead go to a scratch struct that is cleared for
+ * every object, for values that only matter together (see media.c).
+ *
+ *   static const json_field_t fields[] = {
+ *       JSON_FIELD(media_item_t, name, "name", STRING),
+ *       JSON_FIELD(media_item_t, duration, "duration", UINT),
+ *       MEDIA_HINT_FIELDS
+ *   };
+ *   static json_schema_t schema = JSON_SCHEMA_SCRATCH(fields, media_hints_t);
+ */
+typedef enum {
+    JSON_FIELD_STRING,      /* char[]; cut to fit, always terminated */
+    JSON_FIELD_INT,         /* Signed integer of the member's size */
+    JSON_FIELD_UINT,        /* Unsigned; negative numbers store 0 */
+    JSON_FIELD_REAL,        /* float or double */
+    JSON_FIELD_BOOL
+} json_field_kind_t;
+
+typedef struct {
+    const char *key;
+    uint8_t kind;           /* json_field_kind_t */
+    uint8_t scratch;        /* Member of the scratch struct, not the record */
+    uint16_t offset;
+    uint16_t size;
+} json_field_t;
+
+#define JSON_FIELD_ENTRY(type, member, key, kind, scratch) \
+    { key, JSON_FIELD_##kind, scratch, (uint16_t)offsetof(type, member), \
+      (uint16_t)sizeof(((type *)0)->member) }
+#define JSON_FIELD(type, member, key, kind)   JSON_FIELD_ENTRY(type, member, key, kind, 0)
+#define JSON_SCRATCH(type, member, key, kind) JSON_FIELD_ENTRY(type, member, key, kind, 1)
+
+/* Hash slots per schema; a schema may have up to half as many fields */
+#define JSON_SCHEMA_SLOTS 64
+
+typedef struct {
+    const json_field_t *fields;
+    int count;
+    size_t scratch_size;
+    /* Perfect hash of the keys, built by the first decoder */
+    bool ready;
+    uint32_t seed;
+    uint32_t mask;
+    int8_t slot[JSON_SCHEMA_SLOTS];
+} json_schema_t;
+
+#define JSON_SCHEMA_SCRATCH(fields, scratch_type) \
+    { fields, (int)(sizeof(fields) / sizeof((fields)[0])), sizeof(scratch_type), false, 0, 0, { 0 } }
+#define JSON_SCHEMA(fields) \
+    { fields, (int)(sizeof(fields) / sizeof((fields)[0])), 0, false, 0, 0, { 0 } }
+
+/*
+ * What to decode. With array set, each object in the root's member of
+ * that name is a record; without, the root object itself is the one
+ * record. record() returns the storage for the next record, or NULL to
+ * skip it; done() is called once the record's closing brace is parsed,
+ * with the scratch struct, and returns <0 to stop. With array set, root
+ * may also name plain members of the root object, such as a listing's
+ * total, to be stored in root_out as they are parsed; its fields may
+ * not use scratch.
+ */
+typedef struct {
+    json_schema_t *schema;
+    const char *array;
+    void *(*record)(void *user);
+    int (*done)(void *record, void *scratch, void *user);
+    void *user;
+    json_schema_t *root;
+    void *root_out;
+} json_decode_t;
+
+typedef struct json_decoder json_decoder_t;
+json_decoder_t *json_decoder_create(const json_decode_t *spec);
+int json_decoder_feed(json_decoder_t *d, const void *data, size_t len);
+bool json_decoder_done(const json_decoder_t *d);
+void json_decoder_destroy(json_decoder_t *d);
+int json_decode(const json_decode_t *spec, const char *text, size_t len);
+int json_decode_object(json_schema_t *schema, const char *text, size_t len, void *out);
+
+/*
+ * media.c - the type of a listing item. The server marks it several
+ * ways depending on its version, so the schema of an item sends those
+ * keys to a media_hints_t and media_hints_type() settles them once the
+ * item is complete.
+ */
+typedef struct {
+    char type[16];          /* "directory", "video", "audio" */
+    bool is_directory;
+    bool is_video;
+    bool is_audio;
+} media_hints_t;
+
+#define MEDIA_HINT_FIELDS \
+    JSON_SCRATCH(media_hints_t, type, "type", STRING), \
+    JSON_SCRATCH(media_hints_t, is_directory, "isDirectory", BOOL), \
+    JSON_SCRATCH(media_hints_t, is_video, "isVideo", BOOL), \
+    JSON_SCRATCH(media_hints_t, is_audio, "isAudio", BOOL)
+
+media_type_t media_hints_type(const media_hints_t *hints, const char *name);
+media_type_t media_type_from_name(const char *name);
+
+/*
+ * cache.c - parsed listings kept with their validators for revalidation.
+ * Items are copied as item_size-byte records, the port's media_item_t.
+ */
+bool cache_validators(const char *url, const char *token, http_validators_t *validators);
+int cache_restore(const char *url, const char *token, void *items, size_t item_size, int max,
+                  int32_t *total);
+void cache_store(const char *url, const char *token, const http_validators_t *validators,
+                 const void *items, size_t item_size, int count, int32_t total);
+void cache_clear(void);
+
+#endif /* NEDFLIX_CORE_H */
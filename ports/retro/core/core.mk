@@ -0,0 +1,10 @@
+#
+# Nedflix retro ports - shared core
+# Source list, included by the port Makefiles, bench/ and the host build
+#
+# Set CORE_DIR to this directory before including.
+#
+
+CORE_FILES = platform.c url.c http.c http_async.c netstats.c netreplay.c inflate.c json.c msgpack.c schema.c media.c cache.c
+CORE_SRCS = $(addprefix $(CORE_DIR)/,$(CORE_FILES))
+CORE_HEADERS = $(addprefix $(CORE_DIR)/,core.h core_config.h core_platform.h)
@@ -0,0 +1,313 @@
+/*
+ * Nedflix retro ports - shared core
+ * Per-port tuning
+ *
+ * Buffer sizes and item limits for each port, picked by the same
+ * NEDFLIX_<PORT> define as the platform shim. Every value can still be
+ * overridden from the command line, e.g. -DMAX_MEDIA_ITEMS=100. A host
+ * build with no port selected gets the defaults at the bottom.
+ */
+
+#ifndef NEDFLIX_CORE_CONFIG_H
+#define NEDFLIX_CORE_CONFIG_H
+
+#if defined(NEDFLIX_DREAMCAST)
+
+/* 16MB of RAM: be VERY conservative */
+#ifndef MAX_PATH_LENGTH
+#define MAX_PATH_LENGTH     256
+#endif
+#ifndef MAX_URL_LENGTH
+#define MAX_URL_LENGTH      384
+#endif
+#ifndef MAX_TITLE_LENGTH
+#define MAX_TITLE_LENGTH    128
+#endif
+#ifndef MAX_MEDIA_ITEMS
+#define MAX_MEDIA_ITEMS     50      /* Limited list size to save RAM */
+#endif
+#ifndef MEDIA_PAGE_ITEMS
+#define MEDIA_PAGE_ITEMS    25      /* Browse page; the list holds two around the cursor */
+#endif
+#ifndef RECV_BUFFER_SIZE
+#define RECV_BUFFER_SIZE    4096
+#endif
+#ifndef HTTP_INFLATE_WINDOW_BITS
+#define HTTP_INFLATE_WINDOW_BITS 12 /* 4KB history per compressed response */
+#endif
+#ifndef HTTP_MAX_BUFFERED_BODY
+#define HTTP_MAX_BUFFERED_BODY (256 * 1024) /* Cap for malloc'd responses only */
+#endif
+#ifndef CACHE_MAX_ENTRIES
+#define CACHE_MAX_ENTRIES   16
+#endif
+#ifndef CACHE_BUDGET_BYTES
+#define CACHE_BUDGET_BYTES  (64 * 1024)     /* Items held across all entries */
+#endif
+#ifndef HTTP_TIMEOUT_MS
+#define HTTP_TIMEOUT_MS     10000
+#endif
+#ifndef HTTP_USER_AGENT
+#define HTTP_USER_AGENT     "Nedflix-DC/1.0"
+#endif
+#ifndef HTTP_SESSION_HEADERS_MAX
+#define HTTP_SESSION_HEADERS_MAX 448
+#endif
+#ifndef HTTP_REQUEST_LINE_MAX
+#define HTTP_REQUEST_LINE_MAX 576
+#endif
+#ifndef HTTP_REQUEST_MAX
+#define HTTP_REQUEST_MAX    1280    /* Whole request held by a non-blocking slot */
+#endif
+#ifndef HTTP_MAX_ASYNC
+#define HTTP_MAX_ASYNC      4       /* Non-blocking requests in flight */
+#endif
+#ifndef ABR_MIN_SAMPLE_BYTES
+#define ABR_MIN_SAMPLE_BYTES 4096   /* Smaller responses measure round trips, not rate */
+#endif
+#ifndef JSON_SIMD_SCAN
+#define JSON_SIMD_SCAN      0       /* No vector unit; 50-item listings parse fast enough */
+#endif
+#ifndef JSON_PUSH_TOKEN_MAX
+#define JSON_PUSH_TOKEN_MAX 512     /* Longest string kept while streaming; paths fit */
+#endif
+
+#elif defined(NEDFLIX_XBOX)
+
+/* 64MB */
+#ifndef MAX_PATH_LENGTH
+#define MAX_PATH_LENGTH     260
+#endif
+#ifndef MAX_URL_LENGTH
+#define MAX_URL_LENGTH      512
+#endif
+#ifndef MAX_TITLE_LENGTH
+#define MAX_TITLE_LENGTH    256
+#endif
+#ifndef MAX_MEDIA_ITEMS
+#define MAX_MEDIA_ITEMS     100
+#endif
+#ifndef RECV_BUFFER_SIZE
+#define RECV_BUFFER_SIZE    4096
+#endif
+#ifndef HTTP_INFLATE_WINDOW_BITS
+#define HTTP_INFLATE_WINDOW_BITS 15
+#endif
+#ifndef HTTP_MAX_BUFFERED_BODY
+#define HTTP_MAX_BUFFERED_BODY (4 * 1024 * 1024)
+#endif
+#ifndef CACHE_MAX_ENTRIES
+#define CACHE_MAX_ENTRIES   16
+#endif
+#ifndef CACHE_BUDGET_BYTES
+#define CACHE_BUDGET_BYTES  (256 * 1024)
+#endif
+#ifndef HTTP_TIMEOUT_MS
+#define HTTP_TIMEOUT_MS     5000
+#endif
+#ifndef HTTP_USER_AGENT
+#define HTTP_USER_AGENT     "Nedflix-Xbox/1.0"
+#endif
+
+#elif defined(NEDFLIX_PS3)
+
+/* 256MB: large listings and buffers */
+#ifndef MAX_PATH_LENGTH
+#define MAX_PATH_LENGTH     512
+#endif
+#ifndef MAX_URL_LENGTH
+#define MAX_URL_LENGTH      512
+#endif
+#ifndef MAX_TITLE_LENGTH
+#define MAX_TITLE_LENGTH    256
+#endif
+#ifndef MAX_MEDIA_ITEMS
+#define MAX_MEDIA_ITEMS     500
+#endif
+#ifndef RECV_BUFFER_SIZE
+#define RECV_BUFFER_SIZE    65536
+#endif
+#ifndef HTTP_PIPELINE_MAX
+#define HTTP_PIPELINE_MAX   8       /* GETs sent ahead on one connection */
+#endif
+#ifndef HTTP_MAX_BUFFERED_BODY
+#define HTTP_MAX_BUFFERED_BODY (32 * 1024 * 1024)
+#endif
+#ifndef HTTP_TIMEOUT_MS
+#define HTTP_TIMEOUT_MS     30000
+#endif
+#ifndef HTTP_USER_AGENT
+#define HTTP_USER_AGENT     "Nedflix-PS3/1.0"
+#endif
+#ifndef HTTP_SESSION_HEADERS_MAX
+#define HTTP_SESSION_HEADERS_MAX 384 /* No Authorization; the token rides in the URL */
+#endif
+#ifndef DNS_CACHE_SIZE
+#define DNS_CACHE_SIZE      8
+#endif
+#ifndef ABR_MIN_SAMPLE_BYTES
+#define ABR_MIN_SAMPLE_BYTES 16384  /* Smaller responses measure round trips, not rate */
+#endif
+
+#elif defined(NEDFLIX_XBOX360)
+
+/* 512MB, but a novelty port: moderate limits */
+#ifndef MAX_PATH_LENGTH
+#define MAX_PATH_LENGTH     512
+#endif
+#ifndef MAX_URL_LENGTH
+#define MAX_URL_LENGTH      512
+#endif
+#ifndef MAX_TITLE_LENGTH
+#define MAX_TITLE_LENGTH    256
+#endif
+#ifndef MAX_MEDIA_ITEMS
+#define MAX_MEDIA_ITEMS     200
+#endif
+#ifndef RECV_BUFFER_SIZE
+#define RECV_BUFFER_SIZE    32768
+#endif
+#ifndef HTTP_PIPELINE_MAX
+#define HTTP_PIPELINE_MAX   8       /* GETs sent ahead on one connection */
+#endif
+#ifndef HTTP_TIMEOUT_MS
+#define HTTP_TIMEOUT_MS     15000
+#endif
+#ifndef HTTP_USER_AGENT
+#define HTTP_USER_AGENT     "Nedflix-360/1.0"
+#endif
+
+#endif
+
+/* Defaults: the host build, and anything a port leaves alone */
+#ifndef MAX_PATH_LENGTH
+#define MAX_PATH_LENGTH     512
+#endif
+#ifndef MAX_URL_LENGTH
+#define MAX_URL_LENGTH      512
+#endif
+#ifndef MAX_TITLE_LENGTH
+#define MAX_TITLE_LENGTH    256
+#endif
+#ifndef MAX_MEDIA_ITEMS
+#define MAX_MEDIA_ITEMS     500
+#endif
+#ifndef MEDIA_PAGE_ITEMS
+#define MEDIA_PAGE_ITEMS    MAX_MEDIA_ITEMS
+#endif
+#ifndef MEDIA_PREFETCH_ITEMS
+#define MEDIA_PREFETCH_ITEMS 8      /* Fetch the next page this close to the end of the list */
+#endif
+#ifndef RECV_BUFFER_SIZE
+#define RECV_BUFFER_SIZE    32768
+#endif
+#ifndef HTTP_PIPELINE_MAX
+#define HTTP_PIPELINE_MAX   8
+#endif
+#ifndef HTTP_INFLATE_WINDOW_BITS
+#define HTTP_INFLATE_WINDOW_BITS 15
+#endif
+#ifndef HTTP_ETAG_MAX
+#define HTTP_ETAG_MAX       72      /* Longer ETags are not cached */
+#endif
+#ifndef HTTP_MAX_BUFFERED_BODY
+#define HTTP_MAX_BUFFERED_BODY (16 * 1024 * 1024) /* Larger responses fail, not wrap */
+#endif
+#ifndef HTTP_DATE_MAX
+#define HTTP_DATE_MAX       32      /* "Wed, 21 Oct 2015 07:28:00 GMT" */
+#endif
+#ifndef HTTP_HOST_MAX
+#define HTTP_HOST_MAX       256
+#endif
+
+/* Request heads, built without touching the heap (http.c) */
+#ifndef HTTP_USER_AGENT
+#define HTTP_USER_AGENT     "Nedflix/1.0"
+#endif
+#ifndef HTTP_TIMEOUT_MS
+#define HTTP_TIMEOUT_MS     30000   /* Socket send and receive timeouts */
+#endif
+#ifndef HTTP_SESSION_HEADERS_MAX
+#define HTTP_SESSION_HEADERS_MAX 512 /* Host, User-Agent, Accept, Authorization */
+#endif
+#ifndef HTTP_REQUEST_LINE_MAX
+#define HTTP_REQUEST_LINE_MAX 640   /* Method, path and version */
+#endif
+#ifndef HTTP_REQUEST_TAIL_MAX
+#define HTTP_REQUEST_TAIL_MAX 256   /* Connection, validators, Content-Length and the like */
+#endif
+#ifndef HTTP_SEND_GATHER
+#define HTTP_SEND_GATHER    1460    /* One Ethernet segment, where there is no writev */
+#endif
+
+/* Response parsing and non-blocking request slots (http_async.c) */
+#ifndef HTTP_MAX_HEADER_BYTES
+#define HTTP_MAX_HEADER_BYTES 8192
+#endif
+#ifndef HTTP_HEADER_LINE_MAX
+#define HTTP_HEADER_LINE_MAX 256
+#endif
+#ifndef HTTP_CHUNK_SLACK
+#define HTTP_CHUNK_SLACK    64      /* Min caller room to decode chunks in place */
+#endif
+#ifndef HTTP_REQUEST_MAX
+#define HTTP_REQUEST_MAX    2048    /* Whole request, body included, held by a slot */
+#endif
+#ifndef HTTP_MAX_ASYNC
+#define HTTP_MAX_ASYNC      8       /* Non-blocking requests in flight */
+#endif
+
+/* Resolver cache; gethostbyname gives no TTL, so entries get a fixed bound (http.c) */
+#ifndef DNS_CACHE_SIZE
+#define DNS_CACHE_SIZE      4
+#endif
+#ifndef DNS_CACHE_TTL_MS
+#define DNS_CACHE_TTL_MS    (5 * 60 * 1000)
+#endif
+#ifndef DNS_NEGATIVE_TTL_MS
+#define DNS_NEGATIVE_TTL_MS (10 * 1000)
+#endif
+
+/* Parsed listings kept for revalidation (cache.c) */
+#ifndef CACHE_MAX_ENTRIES
+#define CACHE_MAX_ENTRIES   32
+#endif
+#ifndef CACHE_BUDGET_BYTES
+#define CACHE_BUDGET_BYTES  (2 * 1024 * 1024) /* Items held across all entries */
+#endif
+
+/* Throughput estimate for picking stream bitrates (http.c) */
+#ifndef ABR_EWMA_SHIFT
+#define ABR_EWMA_SHIFT      2       /* Each transfer moves the estimate 1/4 of the way */
+#endif
+#ifndef ABR_MIN_SAMPLE_BYTES
+#define ABR_MIN_SAMPLE_BYTES 4096
+#endif
+
+/* Find the end of each JSON string 16 bytes at a time (json.c) */
+#ifndef JSON_SIMD_SCAN
+#define JSON_SIMD_SCAN      1
+#endif
+
+/* Incremental parsing (json.c, msgpack.c) */
+#ifndef JSON_PUSH_TOKEN_MAX
+#define JSON_PUSH_TOKEN_MAX 2048    /* Longer strings are cut short */
+#endif
+
+/* Ask for MessagePack instead of JSON where the server offers it (http.c) */
+#ifndef API_MSGPACK
+#define API_MSGPACK         1
+#endif
+
+/* Per-request timing (netstats.c) */
+#ifndef NETSTATS_MAX_ENDPOINTS
+#define NETSTATS_MAX_ENDPOINTS 8    /* Later paths share the last slot */
+#endif
+#ifndef NETSTATS_NAME_MAX
+#define NETSTATS_NAME_MAX   24
+#endif
+#ifndef NETSTATS_BUCKETS
+#define NETSTATS_BUCKETS    12      /* Bucket i counts requests under 2^i ms */
+#endif
+
+#endif /* NEDFLIX_CORE_CONFIG_H */
@@ -0,0 +1,149 @@
+/*
+ * Nedflix retro ports - shared core
+ * Platform shim
+ *
+ * Everything the core needs from a console SDK goes through here: the
+ * clock, sleeping, name lookups, sockets, a lock and allocation. Exactly one port is
+ * selected with -DNEDFLIX_DREAMCAST, -DNEDFLIX_XBOX, -DNEDFLIX_PS3 or
+ * -DNEDFLIX_XBOX360; adding -DNEDFLIX_HOST keeps that port's tuning
+ * (core_config.h) but runs the shim on POSIX, which is how the Linux host
+ * build and the benchmarks compile it. The functions live in platform.c.
+ */
+
+#ifndef NEDFLIX_CORE_PLATFORM_H
+#define NEDFLIX_CORE_PLATFORM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#if !defined(NEDFLIX_DREAMCAST) && !defined(NEDFLIX_XBOX) && \
+    !defined(NEDFLIX_PS3) && !defined(NEDFLIX_XBOX360) && !defined(NEDFLIX_HOST)
+#error "Select a port: NEDFLIX_DREAMCAST, NEDFLIX_XBOX, NEDFLIX_PS3, NEDFLIX_XBOX360 or NEDFLIX_HOST"
+#endif
+
+/*
+ * nxdk compatibility: snprintf is not available in nxdk's C library.
+ * Provide a simple implementation using vsprintf.
+ * Note: This is not buffer-overflow safe like real snprintf,
+ * but works for our controlled use cases.
+ */
+#if defined(NEDFLIX_XBOX) && defined(NXDK)
+#include <stdarg.h>
+static inline int nxdk_snprintf(char *buf, size_t size, const char *fmt, ...) {
+    va_list args;
+    int ret;
+    va_start(args, fmt);
+    ret = vsprintf(buf, fmt, args);
+    va_end(args);
+    /* Ensure null termination */
+    if (size > 0) {
+        buf[size - 1] = '\0';
+    }
+    return ret;
+}
+#define snprintf nxdk_snprintf
+#endif
+
+/* Monotonic microseconds, for request timing */
+uint64_t core_now_us(void);
+
+/* Block the calling thread; rounded down to the platform's granularity */
+void core_sleep_us(uint32_t us);
+
+/* One contiguous piece of a gather write */
+typedef struct {
+    const void *data;
+    size_t len;
+} core_piece_t;
+
+/* Socket I/O on a connected descriptor; BSD return conventions */
+int core_sock_send(int sock, const void *data, size_t len);
+int core_sock_sendv(int sock, const core_piece_t *piece, int count);
+int core_sock_recv(int sock, void *buf, size_t len);
+void core_sock_close(int sock);
+
+/*
+ * A blocking TCP connect to an IPv4 address in network byte order, with
+ * send and receive timeouts where the stack has them. Returns the socket
+ * or -1.
+ */
+int core_sock_connect(uint32_t addr, int port, uint32_t timeout_ms);
+
+/*
+ * Non-blocking sockets, for requests driven a frame at a time
+ * (http_async.c). core_sock_connect_start begins a connect and returns
+ * the socket at once, or -1; *connected says whether it is done already.
+ * Otherwise the socket turns writable once it is, and
+ * core_sock_connect_result then gives 0 or the error.
+ */
+int core_sock_connect_start(uint32_t addr, int port, bool *connected);
+int core_sock_connect_result(int sock);
+
+/* Sends and receives that never wait; CORE_SOCK_AGAIN when they would */
+#define CORE_SOCK_AGAIN (-2)
+
+int core_sock_send_nowait(int sock, const void *data, size_t len);
+int core_sock_recv_nowait(int sock, void *buf, size_t len);
+
+/* What each socket is ready for, checked without waiting */
+#define CORE_POLL_READ  0x01
+#define CORE_POLL_WRITE 0x02
+#define CORE_POLL_ERROR 0x04
+
+typedef struct {
+    int sock;
+    int events;             /* CORE_POLL_READ or CORE_POLL_WRITE */
+    int ready;              /* Set by core_sock_poll */
+} core_poll_t;
+
+int core_sock_poll(core_poll_t *fds, int count);
+
+/* One uncached name lookup; 0 and the first IPv4 address, or -1 */
+int core_resolve(const char *host, uint32_t *addr);
+
+/*
+ * A spinlock that yields while contended. It needs no setup, so module
+ * state can hold one statically. Only threads outside the main loop,
+ * such as the PS3 downloads, ever contend for one.
+ */
+typedef volatile int core_lock_t;
+#define CORE_LOCK_INIT 0
+
+void core_lock(core_lock_t *lock);
+void core_unlock(core_lock_t *lock);
+
+/*
+ * Allocation. Override all four together with -D to route the core's
+ * heap use through a port allocator or a counting wrapper.
+ */
+#ifndef core_malloc
+#define core_malloc(size)       malloc(size)
+#define core_calloc(n, size)    calloc(n, size)
+#define core_realloc(p, size)   realloc(p, size)
+#define core_free(p)            free(p)
+#endif
+
+/* Logging, in each port's own style */
+#if defined(NEDFLIX_PS3) && !defined(NEDFLIX_HOST)
+/* The PS3 port prints unconditionally */
+#define CORE_LOG(fmt, ...) printf(fmt "\n", ##__VA_ARGS__)
+#define CORE_LOG_ERROR(fmt, ...) printf(fmt "\n", ##__VA_ARGS__)
+#elif !defined(DEBUG)
+#define CORE_LOG(fmt, ...)
+#define CORE_LOG_ERROR(fmt, ...)
+#elif defined(NEDFLIX_DREAMCAST) && !defined(NEDFLIX_HOST)
+#include <kos/dbglog.h>
+#define CORE_LOG(fmt, ...) dbglog(DBG_INFO, "[NEDFLIX] " fmt "\n", ##__VA_ARGS__)
+#define CORE_LOG_ERROR(fmt, ...) dbglog(DBG_ERROR, "[ERROR] " fmt "\n", ##__VA_ARGS__)
+#elif defined(NEDFLIX_HOST)
+#define CORE_LOG(fmt, ...) fprintf(stderr, "[NEDFLIX] " fmt "\n", ##__VA_ARGS__)
+#define CORE_LOG_ERROR(fmt, ...) fprintf(stderr, "[ERROR] " fmt "\n", ##__VA_ARGS__)
+#else
+#define CORE_LOG(fmt, ...) printf("[NEDFLIX] " fmt "\n", ##__VA_ARGS__)
+#define CORE_LOG_ERROR(fmt, ...) printf("[ERROR] " fmt "\n", ##__VA_ARGS__)
+#endif
+
+#endif /* NEDFLIX_CORE_PLATFORM_H */
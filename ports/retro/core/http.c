@@ -0,0 +1,962 @@
+/*
+ * Nedflix retro ports - shared core
+ * HTTP/1.1 pieces every client shares
+ *
+ * The ports drive their sockets differently (a connection pool on the
+ * Xbox, pipelined batches on the PS3 and 360, and the non-blocking slots
+ * of http_async.c from every main loop), but they agree on how names are resolved, how a request head
+ * is laid out, how headers are matched, how validators are carried
+ * between a cached listing and its revalidation, how response bodies
+ * grow, and how transfer rates are averaged. Those live here, along with
+ * the buffered reader and the blocking fetches of the pipelining ports.
+ */
+
+#include "core.h"
+#include <string.h>
+
+/* Recent transfer rate, for picking stream bitrates */
+static struct {
+    uint32_t bytes_per_sec;
+    uint32_t samples;
+    core_lock_t lock;
+} g_throughput;
+
+/* Cached name lookup; addr == 0 records a failed lookup */
+typedef struct {
+    char host[HTTP_HOST_MAX];
+    uint32_t addr;
+    uint64_t expires_ms;
+    uint64_t last_used_ms;
+} dns_entry_t;
+
+/* PS3 download threads resolve too, so the cache has a lock */
+static struct {
+    dns_entry_t entries[DNS_CACHE_SIZE];
+    core_lock_t lock;
+} g_dns;
+
+/*
+ * Host, User-Agent, Accept and Authorization are the same for every
+ * request to one server, so they are serialized once and reused until
+ * the host or token changes. The main loop sends straight from this
+ * copy; other threads take theirs under the lock (http_format_request).
+ */
+static struct {
+    bool valid;
+    char host[HTTP_HOST_MAX];
+    char token[HTTP_SESSION_HEADERS_MAX];
+    char text[HTTP_SESSION_HEADERS_MAX];
+    size_t len;
+    core_lock_t lock;
+} g_session;
+
+static http_request_stats_t g_request_stats;
+
+/*
+ * Case-insensitive compare of a header name against a lowercase literal
+ */
+bool http_header_is(const char *name, size_t name_len, const char *lower)
+{
+    size_t i;
+    for (i = 0; i < name_len && lower[i]; i++) {
+        char c = name[i];
+        if (c >= 'A' && c <= 'Z') c += 'a' - 'A';
+        if (c != lower[i]) return false;
+    }
+    return i == name_len && lower[i] == '\0';
+}
+
+/*
+ * Case-insensitive substring test within a header value
+ */
+bool http_value_has(const char *value, size_t value_len, const char *lower)
+{
+    size_t n = strlen(lower);
+    for (size_t i = 0; i + n <= value_len; i++) {
+        if (http_header_is(value + i, n, lower)) return true;
+    }
+    return false;
+}
+
+/*
+ * Keep a validator header value, if it fits
+ */
+void http_copy_validator(char *dst, size_t dst_size, const char *value, size_t value_len)
+{
+    if (value_len < dst_size) {
+        memcpy(dst, value, value_len);
+        dst[value_len] = '\0';
+    }
+}
+
+/*
+ * Carry validators over from a response: a 2xx replaces them, while a
+ * 304 keeps the old ones except where it repeats a newer value
+ */
+void http_validators_update(http_validators_t *validators, int status,
+                            const http_validators_t *got)
+{
+    if (status >= 200 && status < 300) {
+        *validators = *got;
+    } else if (status == 304) {
+        if (got->etag[0]) strcpy(validators->etag, got->etag);
+        if (got->last_modified[0]) strcpy(validators->last_modified, got->last_modified);
+    }
+}
+
+/*
+ * Request headers for a conditional GET: If-None-Match and
+ * If-Modified-Since for whichever validators are set. Writes an empty
+ * string without validators or if they do not fit; returns the length.
+ */
+int http_conditional_headers(char *buf, size_t size, const http_validators_t *validators)
+{
+    buf[0] = '\0';
+    if (!validators) return 0;
+
+    int n = snprintf(buf, size, "%s%s%s%s%s%s",
+                     validators->etag[0] ? "If-None-Match: " : "",
+                     validators->etag,
+                     validators->etag[0] ? "\r\n" : "",
+                     validators->last_modified[0] ? "If-Modified-Since: " : "",
+                     validators->last_modified,
+                     validators->last_modified[0] ? "\r\n" : "");
+    if (n < 0 || (size_t)n >= size) {
+        buf[0] = '\0';
+        return 0;
+    }
+    return n;
+}
+
+/*
+ * Grow a response body so that it can hold need more bytes plus a NUL.
+ * Fails, rather than wrapping, once the body would pass HTTP_MAX_BUFFERED_BODY.
+ */
+int http_body_reserve(char **body, size_t *cap, size_t used, size_t need)
+{
+    if (used > HTTP_MAX_BUFFERED_BODY || need > HTTP_MAX_BUFFERED_BODY - used) {
+        CORE_LOG_ERROR("Response body over %u bytes", (unsigned)HTTP_MAX_BUFFERED_BODY);
+        return -1;
+    }
+    if (used + need + 1 <= *cap) {
+        return 0;
+    }
+    size_t new_cap = *cap ? *cap : RECV_BUFFER_SIZE;
+    while (new_cap < used + need + 1) {
+        new_cap *= 2;
+    }
+    if (new_cap > (size_t)HTTP_MAX_BUFFERED_BODY + 1) {
+        new_cap = (size_t)HTTP_MAX_BUFFERED_BODY + 1;
+    }
+    char *p = (char *)core_realloc(*body, new_cap);
+    if (!p) {
+        return -1;
+    }
+    *body = p;
+    *cap = new_cap;
+    return 0;
+}
+
+/*
+ * Throughput estimate for choosing stream bitrates
+ *
+ * An exponentially weighted moving average of bytes per second, so the
+ * last few transfers outweigh everything before them. Callers time from
+ * the request going out to the last byte arriving, which counts one
+ * round trip against every sample; responses too small for that to wash
+ * out are skipped.
+ */
+void http_throughput_sample(size_t bytes, uint64_t usec)
+{
+    if (bytes < ABR_MIN_SAMPLE_BYTES) return;
+
+    uint64_t rate = (uint64_t)bytes * 1000000 / (usec > 0 ? usec : 1);
+    if (rate > 0xFFFFFFFFu) rate = 0xFFFFFFFFu;
+
+    core_lock(&g_throughput.lock);
+    if (g_throughput.samples++ == 0) {
+        g_throughput.bytes_per_sec = (uint32_t)rate;
+    } else {
+        g_throughput.bytes_per_sec += ((uint32_t)rate >> ABR_EWMA_SHIFT) -
+                                      (g_throughput.bytes_per_sec >> ABR_EWMA_SHIFT);
+    }
+    core_unlock(&g_throughput.lock);
+}
+
+/*
+ * Estimated bytes per second, or 0 before any transfer has been measured
+ */
+uint32_t http_throughput_estimate(void)
+{
+    return g_throughput.bytes_per_sec;
+}
+
+void http_reader_init(http_reader_t *r, int sock)
+{
+    r->sock = sock;
+    r->pos = 0;
+    r->len = 0;
+    r->consumed = 0;
+}
+
+/*
+ * Pull more bytes from the socket; returns bytes read, 0 on close, -1 on error
+ */
+int http_reader_fill(http_reader_t *r)
+{
+    if (r->pos > 0) {
+        memmove(r->buf, r->buf + r->pos, r->len - r->pos);
+        r->len -= r->pos;
+        r->pos = 0;
+    }
+    if (r->len == sizeof(r->buf)) {
+        return -1;
+    }
+
+    int n = core_sock_recv(r->sock, r->buf + r->len, sizeof(r->buf) - r->len);
+    if (n > 0) {
+        r->len += n;
+    }
+    return n;
+}
+
+/*
+ * Read one CRLF-terminated line, truncated to size - 1 characters
+ */
+int http_reader_line(http_reader_t *r, char *line, size_t size)
+{
+    for (;;) {
+        char *start = r->buf + r->pos;
+        char *nl = memchr(start, '\n', r->len - r->pos);
+        if (nl) {
+            size_t n = nl - start;
+            if (n > 0 && start[n - 1] == '\r') n--;
+            if (n >= size) n = size - 1;
+            memcpy(line, start, n);
+            line[n] = '\0';
+            r->consumed += (nl + 1) - start;
+            r->pos = (nl + 1) - r->buf;
+            return (int)n;
+        }
+        if (http_reader_fill(r) <= 0) {
+            return -1;
+        }
+    }
+}
+
+/*
+ * Copy exactly len bytes of body into dst
+ */
+int http_reader_read(http_reader_t *r, char *dst, size_t len)
+{
+    while (len > 0) {
+        if (r->pos == r->len && http_reader_fill(r) <= 0) {
+            return -1;
+        }
+        size_t n = r->len - r->pos;
+        if (n > len) n = len;
+        memcpy(dst, r->buf + r->pos, n);
+        r->pos += n;
+        r->consumed += n;
+        dst += n;
+        len -= n;
+    }
+    return 0;
+}
+
+/*
+ * Read the next response off a connection into req. Clears *keep_alive
+ * when the server will not answer anything further on this connection.
+ */
+int http_read_response(http_reader_t *r, http_batch_t *req, int *keep_alive,
+                       net_timing_t *timing)
+{
+    char line[512];
+    long long content_length = -1;
+    int chunked = 0;
+    http_validators_t got;
+
+    memset(&got, 0, sizeof(got));
+
+    if (http_reader_line(r, line, sizeof(line)) < 0) {
+        return -1;
+    }
+    netstats_first_byte(timing);
+
+    int minor = 0;
+    if (sscanf(line, "HTTP/1.%d %d", &minor, &req->status) != 2) {
+        return -1;
+    }
+    if (minor == 0) {
+        *keep_alive = 0;
+    }
+
+    for (;;) {
+        int n = http_reader_line(r, line, sizeof(line));
+        if (n < 0) return -1;
+        if (n == 0) break;
+
+        char *colon = strchr(line, ':');
+        if (!colon) continue;
+        size_t name_len = colon - line;
+        char *value = colon + 1;
+        while (*value == ' ' || *value == '\t') value++;
+        size_t value_len = (line + n) - value;
+
+        if (http_header_is(line, name_len, "content-length")) {
+            content_length = strtoll(value, NULL, 10);
+            if (content_length < 0) return -1;
+        } else if (http_header_is(line, name_len, "transfer-encoding")) {
+            chunked = http_value_has(value, value_len, "chunked");
+        } else if (http_header_is(line, name_len, "connection")) {
+            if (http_value_has(value, value_len, "close")) *keep_alive = 0;
+            else if (http_value_has(value, value_len, "keep-alive")) *keep_alive = 1;
+        } else if (http_header_is(line, name_len, "etag")) {
+            http_copy_validator(got.etag, sizeof(got.etag), value, value_len);
+        } else if (http_header_is(line, name_len, "last-modified")) {
+            http_copy_validator(got.last_modified, sizeof(got.last_modified), value, value_len);
+        }
+    }
+
+    if (req->validators) {
+        http_validators_update(req->validators, req->status, &got);
+    }
+
+    char *body = NULL;
+    size_t cap = 0;
+    size_t used = 0;
+
+    if (req->status == 204 || req->status == 304 || (req->status >= 100 && req->status < 200)) {
+        content_length = 0;
+        chunked = 0;
+    }
+
+    if (chunked) {
+        for (;;) {
+            if (http_reader_line(r, line, sizeof(line)) < 0) goto fail;
+            char *end;
+            unsigned long size = strtoul(line, &end, 16);
+            if (end == line || size > HTTP_MAX_BUFFERED_BODY) goto fail;
+            if (size == 0) break;
+            if (http_body_reserve(&body, &cap, used, size) != 0) goto fail;
+            if (http_reader_read(r, body + used, size) != 0) goto fail;
+            used += size;
+            if (http_reader_line(r, line, sizeof(line)) < 0) goto fail;
+        }
+        /* Trailers end with an empty line */
+        int n;
+        while ((n = http_reader_line(r, line, sizeof(line))) > 0) {}
+        if (n < 0) goto fail;
+    } else if (content_length >= 0) {
+        if (content_length > HTTP_MAX_BUFFERED_BODY) goto fail;
+        if (http_body_reserve(&body, &cap, 0, content_length) != 0) goto fail;
+        if (http_reader_read(r, body, content_length) != 0) goto fail;
+        used = content_length;
+    } else {
+        /* No framing: the body runs to the end of the connection */
+        *keep_alive = 0;
+        for (;;) {
+            if (http_body_reserve(&body, &cap, used, r->len - r->pos) != 0) goto fail;
+            memcpy(body + used, r->buf + r->pos, r->len - r->pos);
+            used += r->len - r->pos;
+            r->consumed += r->len - r->pos;
+            r->pos = r->len;
+            int n = http_reader_fill(r);
+            if (n == 0) break;
+            if (n < 0) goto fail;
+        }
+    }
+
+    if (http_body_reserve(&body, &cap, used, 0) != 0) goto fail;
+    body[used] = '\0';
+    req->response = body;
+    req->len = used;
+    return 0;
+
+fail:
+    core_free(body);
+    return -1;
+}
+
+/*
+ * Parse a dotted quad into a network byte order address
+ */
+static bool parse_ipv4(const char *host, uint32_t *addr)
+{
+    uint8_t octet[4];
+
+    for (int i = 0; i < 4; i++) {
+        unsigned value = 0;
+        int digits = 0;
+        while (*host >= '0' && *host <= '9' && digits < 3) {
+            value = value * 10 + (*host++ - '0');
+            digits++;
+        }
+        if (digits == 0 || value > 255) return false;
+        octet[i] = (uint8_t)value;
+        if (i < 3 && *host++ != '.') return false;
+    }
+    if (*host) return false;
+
+    memcpy(addr, octet, sizeof(octet));
+    return true;
+}
+
+static dns_entry_t *dns_find(const char *host)
+{
+    for (int i = 0; i < DNS_CACHE_SIZE; i++) {
+        dns_entry_t *e = &g_dns.entries[i];
+        if (e->host[0] && strcmp(e->host, host) == 0) {
+            return e;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Resolve a hostname through the cache. Dotted quads skip it, and the
+ * lookup itself runs without the lock held.
+ */
+int http_resolve(const char *host, uint32_t *addr)
+{
+    if (parse_ipv4(host, addr)) {
+        return 0;
+    }
+
+    uint64_t now = core_now_us() / 1000;
+
+    core_lock(&g_dns.lock);
+    dns_entry_t *e = dns_find(host);
+    if (e && now < e->expires_ms) {
+        e->last_used_ms = now;
+        *addr = e->addr;
+        g_request_stats.dns_cache_hits++;
+        core_unlock(&g_dns.lock);
+        if (*addr == 0) {
+            CORE_LOG_ERROR("DNS lookup failed for %s (cached)", host);
+            return -1;
+        }
+        return 0;
+    }
+    g_request_stats.dns_lookups++;
+    core_unlock(&g_dns.lock);
+
+    uint32_t found = 0;
+    if (core_resolve(host, &found) != 0) {
+        found = 0;
+    }
+
+    core_lock(&g_dns.lock);
+    e = dns_find(host);
+    if (!e) {
+        /* Otherwise take an empty slot, or the least recently used one */
+        e = &g_dns.entries[0];
+        for (int i = 1; i < DNS_CACHE_SIZE && e->host[0]; i++) {
+            dns_entry_t *c = &g_dns.entries[i];
+            if (!c->host[0] || c->last_used_ms < e->last_used_ms) {
+                e = c;
+            }
+        }
+    }
+    if (strlen(host) < sizeof(e->host)) {
+        strcpy(e->host, host);
+        e->addr = found;
+        e->expires_ms = now + (found ? DNS_CACHE_TTL_MS : DNS_NEGATIVE_TTL_MS);
+        e->last_used_ms = now;
+    }
+    core_unlock(&g_dns.lock);
+
+    if (found == 0) {
+        CORE_LOG_ERROR("DNS lookup failed for %s", host);
+        return -1;
+    }
+    *addr = found;
+    return 0;
+}
+
+/*
+ * Drop a cached name, e.g. after its address refused a connection
+ */
+void http_resolve_forget(const char *host)
+{
+    core_lock(&g_dns.lock);
+    for (int i = 0; i < DNS_CACHE_SIZE; i++) {
+        if (strcmp(g_dns.entries[i].host, host) == 0) {
+            g_dns.entries[i].host[0] = '\0';
+        }
+    }
+    core_unlock(&g_dns.lock);
+}
+
+/*
+ * Resolve host and open a blocking connection, charging the lookup and
+ * the handshake to timing unless it is NULL. A failed connect drops the
+ * cached name, since the server may have moved.
+ */
+int http_open(const char *host, int port, net_timing_t *timing)
+{
+    uint32_t addr;
+    int resolved = http_resolve(host, &addr);
+    if (timing) netstats_phase(timing, NET_PHASE_DNS);
+    if (resolved != 0) {
+        return -1;
+    }
+
+    int sock = core_sock_connect(addr, port, HTTP_TIMEOUT_MS);
+    if (sock < 0) {
+        CORE_LOG_ERROR("Failed to connect to %s:%d", host, port);
+        http_resolve_forget(host);
+        return -1;
+    }
+    if (timing) netstats_phase(timing, NET_PHASE_CONNECT);
+    return sock;
+}
+
+void http_request_stats(http_request_stats_t *stats)
+{
+    core_lock(&g_dns.lock);
+    *stats = g_request_stats;
+    core_unlock(&g_dns.lock);
+}
+
+static const char *session_headers(const char *host, const char *token, size_t *len)
+{
+    if (!token) token = "";
+
+    if (!g_session.valid || strcmp(g_session.host, host) != 0 ||
+        strcmp(g_session.token, token) != 0) {
+        g_session.valid = false;
+        if (strlen(host) >= sizeof(g_session.host) || strlen(token) >= sizeof(g_session.token)) {
+            return NULL;
+        }
+
+        int n = snprintf(g_session.text, sizeof(g_session.text),
+                         "Host: %s\r\n"
+                         "User-Agent: " HTTP_USER_AGENT "\r\n"
+                         HTTP_ACCEPT_HEADER
+                         "%s%s%s",
+                         host,
+                         token[0] ? "Authorization: Bearer " : "",
+                         token,
+                         token[0] ? "\r\n" : "");
+        if (n < 0 || (size_t)n >= sizeof(g_session.text)) {
+            return NULL;
+        }
+
+        strcpy(g_session.host, host);
+        strcpy(g_session.token, token);
+        g_session.len = n;
+        g_session.valid = true;
+        g_request_stats.header_builds++;
+    }
+
+    *len = g_session.len;
+    return g_session.text;
+}
+
+/*
+ * Lay a request out as pieces for a gather write: the request line, the
+ * shared session headers, the per-request headers (Connection, then
+ * Accept-Encoding, extra headers, Content-Type and Content-Length for a
+ * body, validators for a conditional GET) and the body, which is never
+ * copied. Validators that would not fit are dropped, leaving a plain
+ * GET. The pieces point into head and the session headers, so they are
+ * good until the next request is built. Returns the number of pieces,
+ * or -1 if a part does not fit.
+ */
+static int build_request(const http_request_t *req, http_request_head_t *head,
+                         core_piece_t piece[4])
+{
+    size_t headers_len;
+    const char *headers = session_headers(req->host, req->token, &headers_len);
+    if (!headers) {
+        CORE_LOG_ERROR("Request headers too large");
+        return -1;
+    }
+
+    int line_len = snprintf(head->line, sizeof(head->line), "%s %s HTTP/1.1\r\n",
+                            req->method, req->path);
+    if (line_len < 0 || (size_t)line_len >= sizeof(head->line)) {
+        CORE_LOG_ERROR("Request path too long");
+        return -1;
+    }
+
+    /* Leave room for the blank line that ends the head */
+    size_t body_len = req->body ? strlen(req->body) : 0;
+    size_t size = sizeof(head->tail) - 2;
+    int n = snprintf(head->tail, size, "Connection: %s\r\n%s%s",
+                     (req->flags & HTTP_REQ_KEEP_ALIVE) ? "keep-alive" : "close",
+                     (req->flags & HTTP_REQ_ENCODED) ? "Accept-Encoding: gzip, deflate\r\n" : "",
+                     req->extra_headers ? req->extra_headers : "");
+    if (n >= 0 && (size_t)n < size && req->body) {
+        n += snprintf(head->tail + n, size - n,
+                      "Content-Type: application/json\r\n"
+                      "Content-Length: %lu\r\n",
+                      (unsigned long)body_len);
+    }
+    if (n < 0 || (size_t)n >= size) {
+        CORE_LOG_ERROR("Request headers too large");
+        return -1;
+    }
+    n += http_conditional_headers(head->tail + n, size - n, req->conditions);
+    memcpy(head->tail + n, "\r\n", 3);
+    n += 2;
+
+    piece[0].data = head->line;
+    piece[0].len = line_len;
+    piece[1].data = headers;
+    piece[1].len = headers_len;
+    piece[2].data = head->tail;
+    piece[2].len = n;
+    piece[3].data = req->body;
+    piece[3].len = body_len;
+    return req->body ? 4 : 3;
+}
+
+int http_build_request(const http_request_t *req, http_request_head_t *head,
+                       core_piece_t piece[4])
+{
+    core_lock(&g_session.lock);
+    int count = build_request(req, head, piece);
+    core_unlock(&g_session.lock);
+    return count;
+}
+
+/*
+ * The same request laid out whole in buf, for threads other than the
+ * main loop: the session headers are copied under the lock, so a later
+ * request to another server cannot change them mid-send. Returns the
+ * length, or -1 if it does not fit.
+ */
+int http_format_request(const http_request_t *req, char *buf, size_t size)
+{
+    http_request_head_t head;
+    core_piece_t piece[4];
+    size_t len = 0;
+
+    core_lock(&g_session.lock);
+    int count = build_request(req, &head, piece);
+    for (int i = 0; i < count; i++) {
+        if (piece[i].len >= size - len) {
+            count = -1;
+            break;
+        }
+        memcpy(buf + len, piece[i].data, piece[i].len);
+        len += piece[i].len;
+    }
+    core_unlock(&g_session.lock);
+
+    if (count < 0) {
+        CORE_LOG_ERROR("Request headers too large");
+        return -1;
+    }
+    buf[len] = '\0';
+    return (int)len;
+}
+
+/*
+ * Write every piece, resuming after short writes. The pieces are
+ * advanced past whatever went out, so on failure they show what did not.
+ */
+int http_send_pieces(int sock, core_piece_t *piece, int count)
+{
+    while (count > 0) {
+        if (piece->len == 0) {
+            piece++;
+            count--;
+            continue;
+        }
+
+        int n = core_sock_sendv(sock, piece, count);
+        if (n <= 0) {
+            return -1;
+        }
+
+        size_t left = (size_t)n;
+        while (count > 0 && left >= piece->len) {
+            left -= piece->len;
+            piece++;
+            count--;
+        }
+        if (count > 0) {
+            piece->data = (const char *)piece->data + left;
+            piece->len -= left;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Blocking fetches
+ *
+ * The PS3 and 360 run every API call from the main loop as blocking
+ * requests on fresh connections, and send batches of GETs to one server
+ * pipelined: all requests are written back-to-back on one keep-alive
+ * connection before the first response is read, and the responses come
+ * back in order through one http_reader_t. The reader and the request
+ * heads are allocated on first use, so the ports that never fetch this
+ * way carry none of it.
+ */
+typedef struct {
+    http_reader_t reader;
+    http_request_head_t head[HTTP_PIPELINE_MAX];
+} fetch_state_t;
+
+static fetch_state_t *g_fetch;
+
+static fetch_state_t *fetch_state(void)
+{
+    if (!g_fetch) {
+        g_fetch = (fetch_state_t *)core_malloc(sizeof(*g_fetch));
+    }
+    return g_fetch;
+}
+
+static void fetch_reset(http_batch_t *req)
+{
+    req->response = NULL;
+    req->len = 0;
+    req->status = -1;
+}
+
+/*
+ * Run one request on a fresh connection. req->status is the HTTP status;
+ * returns -1 if nothing usable came back. With req->validators the GET
+ * is conditional, and they are updated from the response.
+ */
+int http_fetch(const char *method, http_batch_t *req, const char *token, const char *body)
+{
+    char host[HTTP_HOST_MAX];
+    char path[MAX_URL_LENGTH];
+    int port;
+
+    fetch_reset(req);
+
+    fetch_state_t *f = fetch_state();
+    if (!f) {
+        return -1;
+    }
+    if (url_parse(req->url, host, sizeof(host), &port, path, sizeof(path)) != 0) {
+        CORE_LOG_ERROR("Invalid URL: %s", req->url);
+        return -1;
+    }
+
+    CORE_LOG("HTTP %s %s:%d%s", method, host, port, path);
+
+    http_request_t r = { method, host, path, token, 0, req->validators, NULL, body };
+    core_piece_t piece[4];
+    int count = http_build_request(&r, &f->head[0], piece);
+    if (count < 0) {
+        return -1;
+    }
+
+    net_timing_t timing;
+    netstats_start(&timing);
+
+    int sock = http_open(host, port, &timing);
+    if (sock >= 0 && http_send_pieces(sock, piece, count) != 0) {
+        CORE_LOG_ERROR("Failed to send request");
+        core_sock_close(sock);
+        sock = -1;
+    }
+    if (sock < 0) {
+        netstats_record(req->url, &timing, false);
+        if (netreplay_capturing()) {
+            netreplay_record(method, req->url, -1, NULL, &timing, NULL, 0);
+        }
+        return -1;
+    }
+    netstats_phase(&timing, NET_PHASE_SEND);
+
+    uint64_t sent_at = core_now_us();
+    int keep_alive = 0;
+    http_reader_init(&f->reader, sock);
+    int result = http_read_response(&f->reader, req, &keep_alive, &timing);
+    core_sock_close(sock);
+
+    timing.bytes = f->reader.consumed;
+    netstats_record(req->url, &timing, result == 0);
+    if (netreplay_capturing()) {
+        netreplay_record(method, req->url, result == 0 ? req->status : -1, req->validators,
+                         &timing, req->response, req->len);
+    }
+    if (result != 0) {
+        return -1;
+    }
+    http_throughput_sample(f->reader.consumed, core_now_us() - sent_at);
+    return 0;
+}
+
+/*
+ * Run a request and hand back the body of a 2xx. Other statuses, such as
+ * the 304 of a conditional GET, come back with no body, failures as -1.
+ * A replay answers from the capture.
+ */
+int http_fetch_body(const char *method, const char *url, const char *token,
+                    http_validators_t *validators, const char *body,
+                    char **response, size_t *len)
+{
+    *response = NULL;
+    *len = 0;
+
+    if (netreplay_replaying()) {
+        const netreplay_exchange_t *x = netreplay_answer(method, url);
+        if (!x) return -1;
+        if (validators) {
+            http_validators_update(validators, x->status, &x->validators);
+        }
+        if (x->status < 200 || x->status >= 300) return x->status;
+        if (!(*response = netreplay_body_copy(x))) return -1;
+        *len = x->body_len;
+        return 0;
+    }
+
+    http_batch_t req;
+    memset(&req, 0, sizeof(req));
+    req.url = url;
+    req.validators = validators;
+    if (http_fetch(method, &req, token, body) != 0) {
+        return -1;
+    }
+
+    if (req.status < 200 || req.status >= 300) {
+        core_free(req.response);
+        return req.status;
+    }
+
+    *response = req.response;
+    *len = req.len;
+    return 0;
+}
+
+/*
+ * Fetch several URLs on the same server over one connection, so the
+ * whole batch costs a single round trip instead of one connect plus one
+ * round trip per URL. Requests the connection could not answer (another
+ * host, the server closing early) are retried one at a time, each on its
+ * own connection. Returns the number of requests that received a
+ * response.
+ */
+int http_fetch_pipelined(http_batch_t *batch, int count, const char *token)
+{
+    char host[HTTP_HOST_MAX], first_host[HTTP_HOST_MAX];
+    char path[MAX_URL_LENGTH];
+    int port, first_port;
+
+    if (!batch || count <= 0 || count > HTTP_PIPELINE_MAX) {
+        return -1;
+    }
+
+    for (int i = 0; i < count; i++) {
+        fetch_reset(&batch[i]);
+    }
+
+    /* A replay answers each request from the capture, one after another */
+    if (netreplay_replaying()) {
+        int answered = 0;
+        for (int i = 0; i < count; i++) {
+            const netreplay_exchange_t *x = netreplay_answer("GET", batch[i].url);
+            if (!x || !(batch[i].response = netreplay_body_copy(x))) continue;
+            batch[i].status = x->status;
+            batch[i].len = x->body_len;
+            if (batch[i].validators) {
+                http_validators_update(batch[i].validators, x->status, &x->validators);
+            }
+            answered++;
+        }
+        return answered;
+    }
+
+    fetch_state_t *f = fetch_state();
+    if (!f || url_parse(batch[0].url, first_host, sizeof(first_host), &first_port,
+                        path, sizeof(path)) != 0) {
+        return -1;
+    }
+
+    /* Pipeline the leading run of requests that share the first host */
+    int piped = 0;
+    while (piped < count &&
+           url_parse(batch[piped].url, host, sizeof(host), &port, path, sizeof(path)) == 0 &&
+           port == first_port && strcmp(host, first_host) == 0) {
+        piped++;
+    }
+
+    /*
+     * Each request is its own line and per-request headers around the
+     * one copy of the session headers; the last asks the server to close
+     * and the batch goes out in a single gather write. The spare piece
+     * takes the empty body of the last request.
+     */
+    core_piece_t piece[3 * HTTP_PIPELINE_MAX + 1];
+    for (int i = 0; i < piped; i++) {
+        url_parse(batch[i].url, host, sizeof(host), &port, path, sizeof(path));
+        http_request_t r = { "GET", host, path, token,
+                             (i < piped - 1) ? HTTP_REQ_KEEP_ALIVE : 0u,
+                             batch[i].validators, NULL, NULL };
+        if (http_build_request(&r, &f->head[i], &piece[3 * i]) < 0) {
+            piped = i;
+            break;
+        }
+    }
+
+    /*
+     * The connection and the batched send are charged to the first
+     * request; each later one is timed from the end of the response
+     * before it, so its TTFB is how long it waited behind that one.
+     */
+    net_timing_t timing;
+    netstats_start(&timing);
+
+    int answered = 0;
+    int sock = (piped > 0) ? http_open(first_host, first_port, &timing) : -1;
+
+    if (sock >= 0) {
+        CORE_LOG("HTTP pipeline %s:%d (%d requests)", first_host, first_port, piped);
+
+        if (http_send_pieces(sock, piece, 3 * piped) == 0) {
+            int keep_alive = 1;
+            http_reader_init(&f->reader, sock);
+            netstats_phase(&timing, NET_PHASE_SEND);
+
+            uint64_t sent_at = core_now_us();
+            size_t bytes = 0;
+            while (answered < piped && keep_alive) {
+                http_batch_t *req = &batch[answered];
+                size_t before = f->reader.consumed;
+                if (http_read_response(&f->reader, req, &keep_alive, &timing) != 0) {
+                    netstats_record(req->url, &timing, false);
+                    break;
+                }
+                timing.bytes = f->reader.consumed - before;
+                netstats_record(req->url, &timing, true);
+                if (netreplay_capturing()) {
+                    netreplay_record("GET", req->url, req->status, req->validators, &timing,
+                                     req->response, req->len);
+                }
+                netstats_start(&timing);
+                bytes += f->reader.consumed - before;
+                answered++;
+            }
+            http_throughput_sample(bytes, core_now_us() - sent_at);
+        } else {
+            CORE_LOG_ERROR("Failed to send request");
+            netstats_record(batch[0].url, &timing, false);
+        }
+        core_sock_close(sock);
+    } else if (piped > 0) {
+        netstats_record(batch[0].url, &timing, false);
+    }
+
+    if (answered < count) {
+        CORE_LOG("HTTP pipeline: %d of %d answered, fetching the rest", answered, count);
+    }
+
+    /* Whatever was not answered goes out one connection at a time */
+    for (int i = answered; i < count; i++) {
+        if (http_fetch("GET", &batch[i], token, NULL) == 0) {
+            answered++;
+        }
+    }
+
+    return answered;
+}
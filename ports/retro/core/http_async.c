@@ -0,0 +1,927 @@
+/*
+ * Nedflix retro ports - shared core
+ * Resumable response parser and non-blocking requests
+ *
+ * The parser takes a response in whatever pieces recv() hands over:
+ * the status line and headers are collected a line at a time and never
+ * rescanned, chunked framing is decoded in place, compressed bodies go
+ * through inflate.c, and body bytes land in a malloc'd buffer, a caller's
+ * buffer or a sink callback without a second copy.
+ *
+ * On top of it sit HTTP_MAX_ASYNC request slots. http_submit() connects
+ * without waiting and returns a handle; http_update(), called once per
+ * frame from each port's app_run(), polls every slot's socket without
+ * blocking and moves it along: connect, send, then receive what is there.
+ * The main loop keeps drawing and reading input while requests are in
+ * flight, and collects results with http_poll(). Only the main loop
+ * touches the slots, so they take no lock.
+ */
+
+#include "core.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Parse one complete header line (CRLF already stripped)
+ */
+static void parse_header_line(const char *line, size_t len, http_response_t *resp)
+{
+    const char *colon = memchr(line, ':', len);
+    if (!colon) return;
+
+    size_t name_len = colon - line;
+    const char *value = colon + 1;
+    while (*value == ' ') value++;
+
+    if (http_header_is(line, name_len, "content-length")) {
+        resp->content_length = strtoul(value, NULL, 10);
+        resp->has_content_length = true;
+    } else if (http_header_is(line, name_len, "transfer-encoding")) {
+        if (strstr(value, "chunked")) {
+            resp->chunked = true;
+        }
+    } else if (http_header_is(line, name_len, "content-encoding")) {
+        if (strncmp(value, "gzip", 4) == 0 || strncmp(value, "x-gzip", 6) == 0) {
+            resp->coding = CODING_GZIP;
+        } else if (strncmp(value, "deflate", 7) == 0) {
+            resp->coding = CODING_DEFLATE;
+        } else if (strncmp(value, "identity", 8) != 0) {
+            resp->coding = CODING_OTHER;
+        }
+    } else if (http_header_is(line, name_len, "etag")) {
+        http_copy_validator(resp->validators.etag, sizeof(resp->validators.etag),
+                            value, len - (value - line));
+    } else if (http_header_is(line, name_len, "last-modified")) {
+        http_copy_validator(resp->validators.last_modified, sizeof(resp->validators.last_modified),
+                            value, len - (value - line));
+    } else if (http_header_is(line, name_len, "content-range")) {
+        /* "bytes <start>-<end>/<total>", total may be "*" */
+        if (strncmp(value, "bytes ", 6) != 0) return;
+        const char *slash = strchr(value, '/');
+        resp->range_start = strtoul(value + 6, NULL, 10);
+        resp->range_total = (slash && slash[1] != '*') ? strtoul(slash + 1, NULL, 10) : 0;
+        resp->has_content_range = true;
+    }
+}
+
+/*
+ * Make sure an owned body buffer can take `extra` more bytes plus a NUL
+ */
+static int body_reserve(http_response_t *resp, size_t extra)
+{
+    size_t need = resp->body_len + extra + 1;
+    if (need <= resp->body_cap) return 0;
+
+    if (resp->mode != HTTP_BODY_ALLOC || need > HTTP_MAX_BUFFERED_BODY + 1) {
+        CORE_LOG_ERROR("Response too large");
+        return -1;
+    }
+
+    size_t new_cap = resp->body_cap ? resp->body_cap : 8192;
+    while (new_cap < need) new_cap *= 2;
+    if (new_cap > HTTP_MAX_BUFFERED_BODY + 1) new_cap = HTTP_MAX_BUFFERED_BODY + 1;
+
+    char *new_body = (char *)core_realloc(resp->body, new_cap);
+    if (!new_body) {
+        CORE_LOG_ERROR("Failed to allocate response body");
+        return -1;
+    }
+    new_body[resp->body_len] = '\0';
+    resp->body = new_body;
+    resp->body_cap = new_cap;
+    return 0;
+}
+
+/*
+ * Decoder output goes where an uncompressed body would have
+ */
+static int inflate_sink(const char *data, size_t len, void *user)
+{
+    return http_response_deliver((http_response_t *)user, data, len);
+}
+
+/*
+ * Called once when the blank line ending the headers arrives
+ */
+static int headers_complete(http_response_t *resp)
+{
+    /* These statuses never carry a body */
+    if (resp->status_code == 204 || resp->status_code == 304 ||
+        (resp->status_code >= 100 && resp->status_code < 200)) {
+        resp->has_content_length = true;
+        resp->content_length = 0;
+        resp->chunked = false;
+    }
+
+    /* Chunked framing takes precedence over any Content-Length */
+    if (resp->chunked) {
+        resp->has_content_length = false;
+        resp->chunk_state = CHUNK_SIZE;
+    }
+
+    /* Size owned buffers once from Content-Length instead of doubling */
+    if (resp->mode == HTTP_BODY_ALLOC && resp->has_content_length && !resp->chunked) {
+        if (body_reserve(resp, resp->content_length) < 0) return -1;
+    }
+
+    resp->state = (resp->has_content_length && resp->content_length == 0 && !resp->chunked)
+                  ? HTTP_PARSE_DONE : HTTP_PARSE_BODY;
+
+    /* Compressed bodies pass through a decoder on their way to the destination */
+    if (resp->state == HTTP_PARSE_BODY && resp->accept_encoding &&
+        resp->coding != CODING_IDENTITY) {
+        if (resp->coding == CODING_OTHER) {
+            CORE_LOG_ERROR("Unsupported Content-Encoding");
+            return -1;
+        }
+        resp->inflate = inflate_create(resp->coding == CODING_GZIP ? INFLATE_GZIP : INFLATE_AUTO,
+                                       inflate_sink, resp);
+        if (!resp->inflate) return -1;
+    }
+    return 0;
+}
+
+/*
+ * Deliver decoded body bytes to the response destination
+ */
+int http_response_deliver(http_response_t *resp, const char *data, size_t len)
+{
+    if (len == 0) return 0;
+
+    if (resp->mode == HTTP_BODY_SINK) {
+        if (resp->sink(data, len, resp->sink_user) < 0) return -1;
+        resp->body_len += len;
+        return 0;
+    }
+
+    if (body_reserve(resp, len) < 0) return -1;
+    memcpy(resp->body + resp->body_len, data, len);
+    resp->body_len += len;
+    resp->body[resp->body_len] = '\0';
+    return 0;
+}
+
+/*
+ * Deliver framed body bytes, decompressing them first if needed
+ */
+static int body_write(http_response_t *resp, const char *data, size_t len)
+{
+    resp->wire_len += len;
+    if (resp->inflate) {
+        return inflate_feed(resp->inflate, data, len) < 0 ? -1 : 0;
+    }
+    return http_response_deliver(resp, data, len);
+}
+
+/*
+ * Decode chunked framing in place.
+ * Payload bytes are compacted to the front of `data` and framing bytes are
+ * dropped, so no second buffer is needed. `*out` receives the payload length.
+ * Resumable at any byte boundary; sets HTTP_PARSE_DONE after the trailers.
+ */
+int http_chunk_decode(http_response_t *resp, char *data, size_t len, size_t *out)
+{
+    size_t in = 0;
+    size_t o = 0;
+
+    while (in < len && resp->state != HTTP_PARSE_DONE) {
+        char c = data[in];
+
+        switch (resp->chunk_state) {
+        case CHUNK_SIZE: {
+            int digit = -1;
+            if (c >= '0' && c <= '9') digit = c - '0';
+            else if (c >= 'a' && c <= 'f') digit = c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F') digit = c - 'A' + 10;
+
+            in++;
+            if (digit >= 0) {
+                if (resp->chunk_left > ((size_t)-1 >> 4)) {
+                    CORE_LOG_ERROR("Chunk size overflow");
+                    return -1;
+                }
+                resp->chunk_left = (resp->chunk_left << 4) | digit;
+                resp->chunk_digits = true;
+                break;
+            }
+            if (!resp->chunk_digits) {
+                CORE_LOG_ERROR("Malformed chunk size");
+                return -1;
+            }
+            if (c == '\n') {
+                resp->chunk_state = resp->chunk_left ? CHUNK_DATA : CHUNK_TRAILER;
+            } else {
+                resp->chunk_state = CHUNK_EXT;
+            }
+            break;
+        }
+
+        case CHUNK_EXT:
+            in++;
+            if (c == '\n') {
+                resp->chunk_state = resp->chunk_left ? CHUNK_DATA : CHUNK_TRAILER;
+            }
+            break;
+
+        case CHUNK_DATA: {
+            size_t take = len - in;
+            if (take > resp->chunk_left) take = resp->chunk_left;
+            if (o != in) memmove(data + o, data + in, take);
+            o += take;
+            in += take;
+            resp->chunk_left -= take;
+            if (resp->chunk_left == 0) {
+                resp->chunk_state = CHUNK_DATA_END;
+            }
+            break;
+        }
+
+        case CHUNK_DATA_END:
+            in++;
+            if (c == '\n') {
+                resp->chunk_state = CHUNK_SIZE;
+                resp->chunk_digits = false;
+            } else if (c != '\r') {
+                CORE_LOG_ERROR("Missing CRLF after chunk");
+                return -1;
+            }
+            break;
+
+        case CHUNK_TRAILER:
+            /* Trailer fields are consumed but not interpreted */
+            in++;
+            if (++resp->header_bytes > HTTP_MAX_HEADER_BYTES) {
+                CORE_LOG_ERROR("Response trailers too large");
+                return -1;
+            }
+            if (c == '\n') {
+                if (resp->trailer_line_len == 0) {
+                    resp->state = HTTP_PARSE_DONE;
+                }
+                resp->trailer_line_len = 0;
+            } else if (c != '\r') {
+                resp->trailer_line_len++;
+            }
+            break;
+        }
+    }
+
+    *out = o;
+    return 0;
+}
+
+/*
+ * Account for body bytes received straight into the body buffer
+ */
+static void body_commit(http_response_t *resp, size_t len)
+{
+    resp->body_len += len;
+    resp->wire_len += len;
+    resp->body[resp->body_len] = '\0';
+
+    if (resp->has_content_length && resp->wire_len >= resp->content_length) {
+        resp->state = HTTP_PARSE_DONE;
+    }
+}
+
+/*
+ * Feed received bytes through the parser.
+ * Resumable: can be called with any split of the byte stream.
+ * Chunked bodies are decoded in place, so `data` is modified.
+ */
+int http_response_feed(http_response_t *resp, char *data, size_t len)
+{
+    while (len > 0 && resp->state != HTTP_PARSE_DONE) {
+        if (resp->state == HTTP_PARSE_BODY && resp->chunked) {
+            size_t decoded;
+            if (http_chunk_decode(resp, data, len, &decoded) < 0) return -1;
+            return body_write(resp, data, decoded);
+        }
+
+        if (resp->state == HTTP_PARSE_BODY) {
+            size_t take = len;
+            if (resp->has_content_length) {
+                size_t left = resp->content_length - resp->wire_len;
+                if (take > left) take = left;
+            }
+            if (body_write(resp, data, take) < 0) return -1;
+            if (resp->has_content_length && resp->wire_len >= resp->content_length) {
+                resp->state = HTTP_PARSE_DONE;
+            }
+            return 0;
+        }
+
+        /* Status line or header: collect up to LF */
+        const char *lf = memchr(data, '\n', len);
+        size_t take = lf ? (size_t)(lf - data) + 1 : len;
+
+        resp->header_bytes += take;
+        if (resp->header_bytes > HTTP_MAX_HEADER_BYTES) {
+            CORE_LOG_ERROR("Response headers too large");
+            return -1;
+        }
+
+        /* Overlong lines are truncated; nothing we parse needs them whole */
+        size_t room = sizeof(resp->line) - 1 - resp->line_len;
+        size_t copy = take < room ? take : room;
+        memcpy(resp->line + resp->line_len, data, copy);
+        resp->line_len += copy;
+        data += take;
+        len -= take;
+
+        if (!lf) break;
+
+        /* Strip CRLF */
+        size_t line_len = resp->line_len;
+        while (line_len > 0 && (resp->line[line_len - 1] == '\n' ||
+                                resp->line[line_len - 1] == '\r')) {
+            line_len--;
+        }
+        resp->line[line_len] = '\0';
+        resp->line_len = 0;
+
+        if (resp->state == HTTP_PARSE_STATUS) {
+            if (strncmp(resp->line, "HTTP/1.", 7) != 0 || line_len < 12) {
+                CORE_LOG_ERROR("Malformed status line");
+                return -1;
+            }
+            resp->status_code = atoi(resp->line + 9);
+            resp->state = HTTP_PARSE_HEADERS;
+        } else if (line_len == 0) {
+            if (headers_complete(resp) < 0) return -1;
+        } else {
+            parse_header_line(resp->line, line_len, resp);
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Check a complete response for a compressed body cut short.
+ * Returns 1 if the body is whole, -1 if not.
+ */
+static int body_finished(http_response_t *resp)
+{
+    if (resp->inflate && !inflate_done(resp->inflate)) {
+        CORE_LOG_ERROR("Compressed body truncated");
+        return -1;
+    }
+    return 1;
+}
+
+/*
+ * Drop a response's decoder once the body is complete or abandoned
+ */
+void http_response_release(http_response_t *resp)
+{
+    if (resp->inflate) {
+        inflate_destroy(resp->inflate);
+        resp->inflate = NULL;
+    }
+}
+
+/*
+ * Receive part of an HTTP response: one recv() through the parser.
+ * Returns 1 on progress, 0 if a recv without waiting had nothing, -1 on
+ * error.
+ *
+ * Until the headers are done, bytes land in a small stack buffer and go
+ * through the parser. After that, buffered responses are received straight
+ * into the body buffer, so each body byte is copied at most once. Chunked
+ * bodies are decoded in place as they arrive and the response ends at the
+ * zero-length chunk, without waiting for the server to close.
+ */
+int http_response_receive(int sock, http_response_t *resp, bool wait)
+{
+    char scratch[RECV_BUFFER_SIZE];
+    char *dst = scratch;
+    size_t room = sizeof(scratch);
+    bool direct = (resp->state == HTTP_PARSE_BODY && resp->mode != HTTP_BODY_SINK &&
+                   !resp->inflate);
+
+    /*
+     * Chunk framing lands in the body buffer before being squeezed out,
+     * so a nearly full caller buffer falls back to the scratch buffer.
+     */
+    if (direct && resp->chunked && resp->mode == HTTP_BODY_CALLER &&
+        resp->body_cap - resp->body_len - 1 < HTTP_CHUNK_SLACK) {
+        direct = false;
+    }
+
+    size_t want = RECV_BUFFER_SIZE;
+    if (resp->has_content_length) {
+        want = resp->content_length - resp->wire_len;
+    } else if (resp->mode == HTTP_BODY_ALLOC &&
+               HTTP_MAX_BUFFERED_BODY - resp->body_len < want) {
+        /* Unframed tail near the cap: let body_write judge the real bytes */
+        want = HTTP_MAX_BUFFERED_BODY - resp->body_len;
+        if (want == 0) direct = false;
+    }
+
+    if (direct) {
+        /* Caller buffers just need room for one more byte */
+        if (body_reserve(resp, resp->mode == HTTP_BODY_ALLOC ? want : 1) < 0) {
+            return -1;
+        }
+        dst = resp->body + resp->body_len;
+        room = resp->body_cap - resp->body_len - 1;
+        if (room > want) room = want;
+    }
+
+    int n = wait ? core_sock_recv(sock, dst, room) : core_sock_recv_nowait(sock, dst, room);
+    if (n == CORE_SOCK_AGAIN) {
+        return 0;
+    }
+    if (n <= 0) {
+        /* Without framing, the body is delimited by connection close */
+        if (resp->state == HTTP_PARSE_BODY && !resp->has_content_length &&
+            !resp->chunked) {
+            resp->state = HTTP_PARSE_DONE;
+            return body_finished(resp);
+        }
+        CORE_LOG_ERROR("Connection closed mid-response");
+        return -1;
+    }
+
+    if (direct && resp->chunked) {
+        size_t decoded;
+        if (http_chunk_decode(resp, dst, n, &decoded) < 0) return -1;
+        resp->body_len += decoded;
+        resp->body[resp->body_len] = '\0';
+    } else if (direct) {
+        body_commit(resp, n);
+    } else if (http_response_feed(resp, scratch, n) < 0) {
+        return -1;
+    }
+
+    return resp->state == HTTP_PARSE_DONE ? body_finished(resp) : 1;
+}
+
+/*
+ * Add a finished exchange to the capture, if one is running. Streamed
+ * bodies are not kept, so those exchanges are left out.
+ */
+void http_response_capture(const char *method, const char *url, int status,
+                           const http_response_t *resp, const net_timing_t *timing)
+{
+    if (netreplay_capturing() && resp->mode != HTTP_BODY_SINK) {
+        netreplay_record(method, url, status, &resp->validators, timing,
+                         resp->body, resp->body_len);
+    }
+}
+
+/* Non-blocking request slot states */
+typedef enum {
+    ASYNC_FREE,
+    ASYNC_CONNECTING,   /* Waiting for the socket to become writable */
+    ASYNC_SENDING,
+    ASYNC_RECEIVING,
+    ASYNC_REPLAY,       /* Answered from a capture once the deadline passes */
+    ASYNC_DONE          /* Result ready for http_poll() */
+} http_async_state_t;
+
+/* One in-flight non-blocking request */
+typedef struct {
+    http_async_state_t state;
+    uint16_t generation;
+    int sock;
+    uint64_t deadline_us;
+    char host[HTTP_HOST_MAX];
+    char out[HTTP_REQUEST_MAX];
+    int out_len;
+    int out_sent;
+    http_response_t resp;
+    uint64_t sent_us;       /* When the last request byte went out */
+    net_timing_t timing;    /* Phases end at the frame that notices them */
+    const netreplay_exchange_t *replay;
+    int result;
+
+    /* Streamed requests: the caller's sink, and the body kept for a capture */
+    http_body_sink_t sink;
+    void *sink_user;
+    char *kept;
+    size_t kept_len;
+} http_async_t;
+
+static http_async_t g_async[HTTP_MAX_ASYNC];
+
+/*
+ * Map a handle to its slot; stale or finished-and-collected handles fail
+ */
+static http_async_t *async_lookup(http_handle_t handle)
+{
+    if (handle < 0) return NULL;
+
+    int idx = handle & 0xFF;
+    if (idx >= HTTP_MAX_ASYNC) return NULL;
+
+    http_async_t *req = &g_async[idx];
+    if (req->state == ASYNC_FREE || req->generation != (handle >> 8)) return NULL;
+    return req;
+}
+
+/*
+ * Close the socket and record the final result
+ */
+static void async_finish(http_async_t *req, int status)
+{
+    if (req->sock >= 0) {
+        core_sock_close(req->sock);
+        req->sock = -1;
+    }
+    http_response_release(&req->resp);
+
+    /* The request line's method and target stand in for the URL */
+    const char *target = strchr(req->out, ' ') + 1;
+    req->timing.bytes = req->resp.header_bytes + req->resp.wire_len;
+    netstats_record(target, &req->timing, status >= 0);
+    if (req->sink && netreplay_capturing()) {
+        /* A streamed body was kept aside by async_sink() */
+        netreplay_record(req->out, target, status, &req->resp.validators, &req->timing,
+                         req->kept, req->kept_len);
+    } else {
+        http_response_capture(req->out, target, status, &req->resp, &req->timing);
+    }
+
+    if (status < 0) {
+        req->result = -1;
+    } else {
+        req->result = (status >= 200 && status < 300) ? 0 : status;
+        http_throughput_sample(req->resp.header_bytes + req->resp.wire_len,
+                               core_now_us() - req->sent_us);
+    }
+    req->state = ASYNC_DONE;
+}
+
+/*
+ * Hand over the recorded response of a replayed request
+ */
+static void async_replay_finish(http_async_t *req)
+{
+    const netreplay_exchange_t *x = req->replay;
+
+    netreplay_timing(x, &req->timing);
+    netstats_record(strchr(req->out, ' ') + 1, &req->timing, x->status >= 0);
+
+    /* The status goes first, since a streamed body is only delivered on success */
+    req->resp.status_code = x->status;
+    req->resp.validators = x->validators;
+    if (x->status < 0 || http_response_deliver(&req->resp, x->body, x->body_len) < 0) {
+        req->result = -1;
+    } else {
+        req->result = (x->status >= 200 && x->status < 300) ? 0 : x->status;
+    }
+    req->state = ASYNC_DONE;
+}
+
+/*
+ * Return a slot to the free list
+ */
+static void async_release(http_async_t *req)
+{
+    if (req->sock >= 0) {
+        core_sock_close(req->sock);
+    }
+    http_response_release(&req->resp);
+    core_free(req->resp.body);
+    memset(&req->resp, 0, sizeof(req->resp));
+    core_free(req->kept);
+    req->kept = NULL;
+    req->kept_len = 0;
+    req->sink = NULL;
+    req->sock = -1;
+    req->state = ASYNC_FREE;
+}
+
+/*
+ * Drop every request, e.g. on network shutdown
+ */
+void http_cancel_all(void)
+{
+    for (int i = 0; i < HTTP_MAX_ASYNC; i++) {
+        if (g_async[i].state != ASYNC_FREE) {
+            async_release(&g_async[i]);
+        }
+    }
+}
+
+/*
+ * Give a newly set up slot a fresh generation and return its handle
+ */
+static http_handle_t async_handle(http_async_t *req, int idx)
+{
+    req->generation = (req->generation + 1) & 0x7FFF;
+    if (req->generation == 0) req->generation = 1;
+
+    return (req->generation << 8) | idx;
+}
+
+/*
+ * Set up a slot and start connecting; the request goes out from http_update()
+ */
+static http_handle_t async_submit(const char *method, const char *url, const char *token,
+                                  const http_validators_t *conditions, const char *body)
+{
+    int idx;
+    for (idx = 0; idx < HTTP_MAX_ASYNC; idx++) {
+        if (g_async[idx].state == ASYNC_FREE) break;
+    }
+    if (idx == HTTP_MAX_ASYNC) {
+        CORE_LOG_ERROR("Too many requests in flight");
+        return -1;
+    }
+    http_async_t *req = &g_async[idx];
+
+    if (netreplay_replaying()) {
+        const netreplay_exchange_t *x = netreplay_lookup(method, url);
+        if (!x) {
+            return -1;
+        }
+        memset(&req->resp, 0, sizeof(req->resp));
+        req->resp.mode = HTTP_BODY_ALLOC;
+        snprintf(req->out, sizeof(req->out), "%s %s", method, url);
+        req->sock = -1;
+        req->replay = x;
+        req->state = ASYNC_REPLAY;
+        req->deadline_us = core_now_us() + netreplay_delay_us(x);
+        return async_handle(req, idx);
+    }
+
+    char path[512];
+    int port;
+
+    if (url_parse(url, req->host, sizeof(req->host), &port, path, sizeof(path)) < 0) {
+        return -1;
+    }
+
+    /* The slot keeps its own copy since the caller's body may not outlive this call */
+    http_request_t request = { method, req->host, path, token, HTTP_REQ_ENCODED,
+                               conditions, NULL, body };
+    req->out_len = http_format_request(&request, req->out, sizeof(req->out));
+    if (req->out_len < 0) {
+        CORE_LOG_ERROR("Request too large");
+        return -1;
+    }
+    req->out_sent = 0;
+
+    netstats_start(&req->timing);
+    uint32_t ip;
+    int resolved = http_resolve(req->host, &ip);
+    netstats_phase(&req->timing, NET_PHASE_DNS);
+    if (resolved != 0) {
+        netstats_record(url, &req->timing, false);
+        return -1;
+    }
+
+    bool connected;
+    int sock = core_sock_connect_start(ip, port, &connected);
+    if (sock < 0) {
+        CORE_LOG_ERROR("Failed to connect to %s:%d", req->host, port);
+        http_resolve_forget(req->host);
+        netstats_record(url, &req->timing, false);
+        return -1;
+    }
+    if (connected) {
+        req->state = ASYNC_SENDING;
+        netstats_phase(&req->timing, NET_PHASE_CONNECT);
+    } else {
+        req->state = ASYNC_CONNECTING;
+    }
+
+    memset(&req->resp, 0, sizeof(req->resp));
+    req->resp.mode = HTTP_BODY_ALLOC;
+    req->resp.accept_encoding = true;
+    req->sock = sock;
+    req->deadline_us = core_now_us() + (uint64_t)HTTP_TIMEOUT_MS * 1000;
+
+    return async_handle(req, idx);
+}
+
+/*
+ * Start a request without blocking on connect, send or receive.
+ * Only an uncached DNS lookup can block; http_resolve() caches the answer.
+ * Returns a handle for http_poll()/http_cancel(), or -1.
+ */
+http_handle_t http_submit(const char *method, const char *url, const char *token,
+                          const char *body)
+{
+    return async_submit(method, url, token, NULL, body);
+}
+
+/*
+ * Start a conditional GET; collect it with http_poll_conditional()
+ */
+http_handle_t http_submit_conditional(const char *url, const char *token,
+                                      const http_validators_t *validators)
+{
+    return async_submit("GET", url, token, validators, NULL);
+}
+
+/*
+ * Body sink of a streamed request. Only a successful response's body
+ * reaches the caller; an error page has nothing for it to parse. While
+ * capturing, every body is also kept whole for the recording.
+ */
+static int async_sink(const char *data, size_t len, void *user)
+{
+    http_async_t *req = (http_async_t *)user;
+
+    if (netreplay_capturing()) {
+        char *kept = (char *)core_realloc(req->kept, req->kept_len + len);
+        if (!kept) {
+            CORE_LOG_ERROR("Failed to keep response for capture");
+            return -1;
+        }
+        memcpy(kept + req->kept_len, data, len);
+        req->kept = kept;
+        req->kept_len += len;
+    }
+
+    if (req->resp.status_code < 200 || req->resp.status_code >= 300) {
+        return 0;
+    }
+    return req->sink(data, len, req->sink_user);
+}
+
+/*
+ * Start a conditional GET whose body goes to sink as it arrives, a
+ * recv() at a time, instead of being collected. Only a 2xx body is
+ * passed on. Collect the result with http_poll_conditional(), which
+ * returns no body.
+ */
+http_handle_t http_submit_stream(const char *url, const char *token,
+                                 const http_validators_t *validators,
+                                 http_body_sink_t sink, void *user)
+{
+    if (!sink) return -1;
+
+    http_handle_t handle = async_submit("GET", url, token, validators, NULL);
+    http_async_t *req = async_lookup(handle);
+    if (!req) return -1;
+
+    /* Nothing is received before the next http_update() */
+    req->resp.mode = HTTP_BODY_SINK;
+    req->resp.sink = async_sink;
+    req->resp.sink_user = req;
+    req->sink = sink;
+    req->sink_user = user;
+    return handle;
+}
+
+/*
+ * Advance one request whose socket core_sock_poll() reported ready
+ */
+static void async_step(http_async_t *req, int ready)
+{
+    if (req->state == ASYNC_CONNECTING) {
+        if ((ready & CORE_POLL_ERROR) || core_sock_connect_result(req->sock) != 0) {
+            CORE_LOG_ERROR("Failed to connect to %s", req->host);
+            http_resolve_forget(req->host);
+            async_finish(req, -1);
+            return;
+        }
+        /* Writable now, so go straight on to sending */
+        req->state = ASYNC_SENDING;
+        netstats_phase(&req->timing, NET_PHASE_CONNECT);
+    }
+
+    if (req->state == ASYNC_SENDING) {
+        int n = core_sock_send_nowait(req->sock, req->out + req->out_sent,
+                                      req->out_len - req->out_sent);
+        if (n == CORE_SOCK_AGAIN) {
+            return;
+        }
+        if (n < 0) {
+            CORE_LOG_ERROR("Failed to send request");
+            async_finish(req, -1);
+            return;
+        }
+        req->out_sent += n;
+        if (req->out_sent == req->out_len) {
+            req->state = ASYNC_RECEIVING;
+            req->sent_us = core_now_us();
+            netstats_phase(&req->timing, NET_PHASE_SEND);
+        }
+        return;
+    }
+
+    if (req->state == ASYNC_RECEIVING) {
+        /* Drain whatever is readable now */
+        for (;;) {
+            int r = http_response_receive(req->sock, &req->resp, false);
+            if (r < 0) {
+                async_finish(req, -1);
+                return;
+            }
+            if (r > 0) {
+                netstats_first_byte(&req->timing);
+            }
+            if (req->resp.state == HTTP_PARSE_DONE) {
+                async_finish(req, req->resp.status_code);
+                return;
+            }
+            if (r == 0) return;
+        }
+    }
+}
+
+/*
+ * Drive all in-flight requests. Never blocks; call once per frame.
+ */
+void http_update(void)
+{
+    core_poll_t fds[HTTP_MAX_ASYNC];
+    http_async_t *reqs[HTTP_MAX_ASYNC];
+    int nfds = 0;
+    uint64_t now = core_now_us();
+
+    for (int i = 0; i < HTTP_MAX_ASYNC; i++) {
+        http_async_t *req = &g_async[i];
+        if (req->state == ASYNC_FREE || req->state == ASYNC_DONE) continue;
+
+        if (req->state == ASYNC_REPLAY) {
+            if (now >= req->deadline_us) {
+                async_replay_finish(req);
+            }
+            continue;
+        }
+
+        if (now >= req->deadline_us) {
+            CORE_LOG_ERROR("Request to %s timed out", req->host);
+            async_finish(req, -1);
+            continue;
+        }
+
+        fds[nfds].sock = req->sock;
+        fds[nfds].events = (req->state == ASYNC_RECEIVING) ? CORE_POLL_READ : CORE_POLL_WRITE;
+        reqs[nfds] = req;
+        nfds++;
+    }
+
+    if (nfds == 0 || core_sock_poll(fds, nfds) <= 0) {
+        return;
+    }
+
+    for (int i = 0; i < nfds; i++) {
+        if (fds[i].ready) {
+            async_step(reqs[i], fds[i].ready);
+        }
+    }
+}
+
+/*
+ * Collect a request's result.
+ * Returns HTTP_IN_PROGRESS while it is in flight; afterwards the same
+ * result as the blocking calls (0, HTTP status, or -1) and the malloc'd
+ * body, after which the handle is no longer valid.
+ */
+int http_poll(http_handle_t handle, char **response, size_t *response_len)
+{
+    return http_poll_conditional(handle, NULL, response, response_len);
+}
+
+/*
+ * Collect a request started with http_submit_conditional(), updating
+ * the validators it was sent with from the response
+ */
+int http_poll_conditional(http_handle_t handle, http_validators_t *validators,
+                          char **response, size_t *response_len)
+{
+    http_async_t *req = async_lookup(handle);
+    if (!req) return -1;
+
+    if (req->state != ASYNC_DONE) {
+        return HTTP_IN_PROGRESS;
+    }
+
+    int result = req->result;
+    if (result >= 0 && validators) {
+        http_validators_update(validators, req->resp.status_code, &req->resp.validators);
+    }
+    if (response) {
+        if (result >= 0 && req->resp.body) {
+            *response = req->resp.body;
+            *response_len = req->resp.body_len;
+            req->resp.body = NULL;
+        } else {
+            *response = NULL;
+            *response_len = 0;
+        }
+    }
+
+    async_release(req);
+    return result;
+}
+
+/*
+ * Abandon a request; its handle is no longer valid
+ */
+void http_cancel(http_handle_t handle)
+{
+    http_async_t *req = async_lookup(handle);
+    if (req) {
+        async_release(req);
+    }
+}
@@ -0,0 +1,703 @@
+/*
+ * Nedflix retro ports - shared core
+ * Streaming inflate (RFC 1950/1951/1952)
+ *
+ * Decodes gzip, zlib and raw deflate bodies as they come off the wire.
+ * Input can be split at any byte; output is pushed to a sink through a
+ * ring window of 1 << HTTP_INFLATE_WINDOW_BITS bytes, so a decoder costs
+ * the window plus about 3KB of tables regardless of the body size.
+ * Streams compressed with a larger window than ours are rejected instead
+ * of being decoded wrongly.
+ */
+
+#include "core.h"
+#include <string.h>
+#include <stdlib.h>
+
+#define INFLATE_WINDOW     (1u << HTTP_INFLATE_WINDOW_BITS)
+#define INFLATE_MAX_BITS   15
+#define INFLATE_FAST_BITS  9      /* First-level lookup covers most codes */
+
+/* Canonical Huffman code with a direct lookup for short codes */
+typedef struct {
+    uint16_t count[INFLATE_MAX_BITS + 1];
+    uint16_t symbol[288];
+    uint16_t fast[1 << INFLATE_FAST_BITS];  /* symbol << 4 | length, 0 = long code */
+} huffman_t;
+
+typedef enum {
+    INF_WRAPPER,        /* Sniff gzip / zlib / raw */
+    INF_GZIP_HEADER,
+    INF_GZIP_EXTRA_LEN,
+    INF_GZIP_EXTRA,
+    INF_GZIP_NAME,
+    INF_GZIP_COMMENT,
+    INF_GZIP_HCRC,
+    INF_ZLIB_HEADER,
+    INF_BLOCK,
+    INF_STORED_LEN,
+    INF_STORED,
+    INF_TABLE_COUNTS,
+    INF_TABLE_CLEN,
+    INF_TABLE_LENS,
+    INF_CODES,
+    INF_LEN_EXTRA,
+    INF_DIST,
+    INF_DIST_EXTRA,
+    INF_COPY,
+    INF_TRAILER,
+    INF_DONE
+} inflate_state_t;
+
+struct inflate_ctx {
+    inflate_state_t state;
+    int format;
+    inflate_sink_t sink;
+    void *sink_user;
+
+    const uint8_t *in;
+    size_t in_left;
+    uint32_t bitbuf;
+    int bitcnt;
+
+    /* Wrapper parsing */
+    uint8_t header[10];
+    int header_len;
+    int gzip_flags;
+    uint32_t skip;
+    uint32_t crc;
+    uint32_t adler_a, adler_b;
+    uint32_t total_out;
+
+    /* Block decoding */
+    int last_block;
+    uint32_t stored_left;
+    int hlit, hdist, hclen, index;
+    uint8_t lens[320];
+    int length;
+    uint32_t distance;
+    int extra_sym;
+    huffman_t lencode;
+    huffman_t distcode;
+
+    /* Output ring; bytes in [flushed, wpos) have not reached the sink */
+    uint32_t wpos;
+    uint32_t flushed;
+    uint32_t filled;    /* Valid history bytes, up to INFLATE_WINDOW */
+    uint8_t window[INFLATE_WINDOW];
+};
+
+static const uint16_t g_len_base[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const uint8_t g_len_extra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const uint16_t g_dist_base[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+    8193, 12289, 16385, 24577
+};
+static const uint8_t g_dist_extra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+static const uint8_t g_clen_order[19] = {
+    16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+/* CRC-32 a nibble at a time: 64 bytes of table instead of 1KB */
+static const uint32_t g_crc_nibble[16] = {
+    0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac,
+    0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+    0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c,
+    0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c
+};
+
+/*
+ * Build the canonical code for `n` code lengths.
+ * Incomplete codes are allowed (a single distance code is legal);
+ * over-subscribed ones are not.
+ */
+static int huffman_build(huffman_t *h, const uint8_t *lens, int n)
+{
+    uint16_t offs[INFLATE_MAX_BITS + 2];
+    uint16_t next[INFLATE_MAX_BITS + 1];
+    int left = 1;
+
+    memset(h->count, 0, sizeof(h->count));
+    for (int i = 0; i < n; i++) h->count[lens[i]]++;
+    h->count[0] = 0;
+
+    for (int len = 1; len <= INFLATE_MAX_BITS; len++) {
+        left <<= 1;
+        left -= h->count[len];
+        if (left < 0) return -1;
+    }
+
+    offs[1] = 0;
+    for (int len = 1; len <= INFLATE_MAX_BITS; len++) {
+        offs[len + 1] = offs[len] + h->count[len];
+    }
+    for (int i = 0; i < n; i++) {
+        if (lens[i]) h->symbol[offs[lens[i]]++] = (uint16_t)i;
+    }
+
+    /* Short codes get every fast-table slot whose low bits match them */
+    memset(h->fast, 0, sizeof(h->fast));
+    int code = 0;
+    for (int len = 1; len <= INFLATE_MAX_BITS; len++) {
+        code = (code + h->count[len - 1]) << 1;
+        next[len] = (uint16_t)code;
+    }
+    for (int i = 0; i < n; i++) {
+        int len = lens[i];
+        if (len == 0 || len > INFLATE_FAST_BITS) continue;
+
+        int c = next[len]++;
+        int rev = 0;
+        for (int b = 0; b < len; b++) {
+            rev = (rev << 1) | (c & 1);
+            c >>= 1;
+        }
+        for (int slot = rev; slot < (1 << INFLATE_FAST_BITS); slot += 1 << len) {
+            h->fast[slot] = (uint16_t)((i << 4) | len);
+        }
+    }
+    return 0;
+}
+
+/* Top up the bit buffer from the current input */
+static void pull_bits(struct inflate_ctx *z)
+{
+    while (z->bitcnt <= 24 && z->in_left) {
+        z->bitbuf |= (uint32_t)*z->in++ << z->bitcnt;
+        z->bitcnt += 8;
+        z->in_left--;
+    }
+}
+
+/* Consume `n` bits, least significant first */
+static uint32_t take_bits(struct inflate_ctx *z, int n)
+{
+    uint32_t v = z->bitbuf & ((1u << n) - 1);
+    z->bitbuf >>= n;
+    z->bitcnt -= n;
+    return v;
+}
+
+/*
+ * Decode one symbol without consuming anything unless it is complete.
+ * Returns the symbol, -1 if more input is needed, -2 on a bad code.
+ */
+static int huffman_decode(struct inflate_ctx *z, const huffman_t *h)
+{
+    uint16_t e = h->fast[z->bitbuf & ((1 << INFLATE_FAST_BITS) - 1)];
+    if (e) {
+        int len = e & 15;
+        if (len > z->bitcnt) return -1;
+        take_bits(z, len);
+        return e >> 4;
+    }
+
+    /* Long code: walk the canonical code a bit at a time */
+    int code = 0, first = 0, index = 0;
+    uint32_t bits = z->bitbuf;
+    for (int len = 1; len <= INFLATE_MAX_BITS; len++) {
+        if (len > z->bitcnt) return -1;
+        code |= bits & 1;
+        bits >>= 1;
+        int count = h->count[len];
+        if (code - count < first) {
+            take_bits(z, len);
+            return h->symbol[index + (code - first)];
+        }
+        index += count;
+        first += count;
+        first <<= 1;
+        code <<= 1;
+    }
+    return -2;
+}
+
+/* Running gzip CRC-32 or zlib Adler-32 over decoded bytes */
+static void check_bytes(struct inflate_ctx *z, const uint8_t *p, size_t len)
+{
+    if (z->format == INFLATE_GZIP) {
+        uint32_t crc = z->crc;
+        for (size_t i = 0; i < len; i++) {
+            crc ^= p[i];
+            crc = (crc >> 4) ^ g_crc_nibble[crc & 15];
+            crc = (crc >> 4) ^ g_crc_nibble[crc & 15];
+        }
+        z->crc = crc;
+    } else if (z->format == INFLATE_ZLIB) {
+        uint32_t a = z->adler_a, b = z->adler_b;
+        for (size_t i = 0; i < len; i++) {
+            a += p[i];
+            if (a >= 65521) a -= 65521;
+            b += a;
+            if (b >= 65521) b -= 65521;
+        }
+        z->adler_a = a;
+        z->adler_b = b;
+    }
+}
+
+/* Hand undelivered window bytes to the sink, wrapping the ring when full */
+static int flush_window(struct inflate_ctx *z)
+{
+    if (z->wpos > z->flushed) {
+        check_bytes(z, z->window + z->flushed, z->wpos - z->flushed);
+        if (z->sink((const char *)z->window + z->flushed, z->wpos - z->flushed,
+                    z->sink_user) < 0) {
+            return -1;
+        }
+    }
+    z->flushed = z->wpos;
+    if (z->wpos == INFLATE_WINDOW) {
+        z->wpos = 0;
+        z->flushed = 0;
+    }
+    return 0;
+}
+
+/* Append one decoded byte to the window */
+static int put_byte(struct inflate_ctx *z, uint8_t c)
+{
+    z->window[z->wpos++] = c;
+    if (z->filled < INFLATE_WINDOW) z->filled++;
+    z->total_out++;
+    if (z->wpos == INFLATE_WINDOW) return flush_window(z);
+    return 0;
+}
+
+/* Next whole byte, from leftover bits first. -1 if none yet. */
+static int next_byte(struct inflate_ctx *z)
+{
+    if (z->bitcnt >= 8) return (int)take_bits(z, 8);
+    if (!z->in_left) return -1;
+    z->in_left--;
+    return *z->in++;
+}
+
+/* Fixed Huffman codes of a type 1 block */
+static void fixed_tables(struct inflate_ctx *z)
+{
+    int i = 0;
+    for (; i < 144; i++) z->lens[i] = 8;
+    for (; i < 256; i++) z->lens[i] = 9;
+    for (; i < 280; i++) z->lens[i] = 7;
+    for (; i < 288; i++) z->lens[i] = 8;
+    huffman_build(&z->lencode, z->lens, 288);
+    for (i = 0; i < 30; i++) z->lens[i] = 5;
+    huffman_build(&z->distcode, z->lens, 30);
+}
+
+/*
+ * Run the decoder until input runs out or the stream ends.
+ * Returns 0 when it needs more input, 1 at the end, -1 on error.
+ */
+static int inflate_run(struct inflate_ctx *z)
+{
+    int c, sym;
+
+    for (;;) {
+        switch (z->state) {
+        case INF_WRAPPER:
+            if (!z->in_left) return 0;
+            if (z->format == INFLATE_GZIP || z->in[0] == 0x1f) {
+                z->format = INFLATE_GZIP;
+                z->state = INF_GZIP_HEADER;
+            } else if ((z->in[0] & 0x0f) == 8) {
+                /* "deflate" is meant to be zlib-wrapped; some servers send it raw */
+                z->format = INFLATE_ZLIB;
+                z->state = INF_ZLIB_HEADER;
+            } else {
+                z->format = INFLATE_RAW;
+                z->state = INF_BLOCK;
+            }
+            break;
+
+        case INF_GZIP_HEADER:
+            while (z->header_len < 10) {
+                if ((c = next_byte(z)) < 0) return 0;
+                z->header[z->header_len++] = (uint8_t)c;
+            }
+            if (z->header[0] != 0x1f || z->header[1] != 0x8b || z->header[2] != 8) {
+                CORE_LOG_ERROR("Bad gzip header");
+                return -1;
+            }
+            z->gzip_flags = z->header[3];
+            z->header_len = 0;
+            z->skip = 0;
+            z->state = INF_GZIP_EXTRA_LEN;
+            break;
+
+        case INF_GZIP_EXTRA_LEN:
+            if (!(z->gzip_flags & 4)) {
+                z->state = INF_GZIP_NAME;
+                break;
+            }
+            while (z->header_len < 2) {
+                if ((c = next_byte(z)) < 0) return 0;
+                z->skip |= (uint32_t)c << (8 * z->header_len++);
+            }
+            z->state = INF_GZIP_EXTRA;
+            break;
+
+        case INF_GZIP_EXTRA:
+            while (z->skip) {
+                if (next_byte(z) < 0) return 0;
+                z->skip--;
+            }
+            z->state = INF_GZIP_NAME;
+            break;
+
+        case INF_GZIP_NAME:
+        case INF_GZIP_COMMENT: {
+            int flag = (z->state == INF_GZIP_NAME) ? 8 : 16;
+            if (z->gzip_flags & flag) {
+                do {
+                    if ((c = next_byte(z)) < 0) return 0;
+                } while (c != 0);
+                z->gzip_flags &= ~flag;
+            }
+            z->state = (z->state == INF_GZIP_NAME) ? INF_GZIP_COMMENT : INF_GZIP_HCRC;
+            z->header_len = 0;
+            break;
+        }
+
+        case INF_GZIP_HCRC:
+            if (z->gzip_flags & 2) {
+                while (z->header_len < 2) {
+                    if (next_byte(z) < 0) return 0;
+                    z->header_len++;
+                }
+            }
+            z->crc = 0xffffffff;
+            z->header_len = 0;
+            z->state = INF_BLOCK;
+            break;
+
+        case INF_ZLIB_HEADER:
+            while (z->header_len < 2) {
+                if ((c = next_byte(z)) < 0) return 0;
+                z->header[z->header_len++] = (uint8_t)c;
+            }
+            if ((z->header[0] & 0x0f) != 8 ||
+                ((z->header[0] << 8) | z->header[1]) % 31 != 0 ||
+                (z->header[1] & 0x20)) {
+                CORE_LOG_ERROR("Bad zlib header");
+                return -1;
+            }
+            if ((z->header[0] >> 4) + 8 > HTTP_INFLATE_WINDOW_BITS) {
+                CORE_LOG_ERROR("Compressed with a %d-bit window, we have %d",
+                          (z->header[0] >> 4) + 8, HTTP_INFLATE_WINDOW_BITS);
+                return -1;
+            }
+            z->adler_a = 1;
+            z->adler_b = 0;
+            z->header_len = 0;
+            z->state = INF_BLOCK;
+            break;
+
+        case INF_BLOCK:
+            pull_bits(z);
+            if (z->bitcnt < 3) return 0;
+            z->last_block = (int)take_bits(z, 1);
+            switch (take_bits(z, 2)) {
+            case 0:
+                take_bits(z, z->bitcnt & 7);
+                z->header_len = 0;
+                z->state = INF_STORED_LEN;
+                break;
+            case 1:
+                fixed_tables(z);
+                z->state = INF_CODES;
+                break;
+            case 2:
+                z->state = INF_TABLE_COUNTS;
+                break;
+            default:
+                CORE_LOG_ERROR("Bad deflate block type");
+                return -1;
+            }
+            break;
+
+        case INF_STORED_LEN:
+            while (z->header_len < 4) {
+                if ((c = next_byte(z)) < 0) return 0;
+                z->header[z->header_len++] = (uint8_t)c;
+            }
+            z->stored_left = z->header[0] | (z->header[1] << 8);
+            if ((z->stored_left ^ 0xffff) != (uint32_t)(z->header[2] | (z->header[3] << 8))) {
+                CORE_LOG_ERROR("Bad stored block length");
+                return -1;
+            }
+            z->header_len = 0;
+            z->state = INF_STORED;
+            break;
+
+        case INF_STORED:
+            while (z->stored_left) {
+                if ((c = next_byte(z)) < 0) return 0;
+                if (put_byte(z, (uint8_t)c) < 0) return -1;
+                z->stored_left--;
+            }
+            z->state = z->last_block ? INF_TRAILER : INF_BLOCK;
+            break;
+
+        case INF_TABLE_COUNTS:
+            pull_bits(z);
+            if (z->bitcnt < 14) return 0;
+            z->hlit = (int)take_bits(z, 5) + 257;
+            z->hdist = (int)take_bits(z, 5) + 1;
+            z->hclen = (int)take_bits(z, 4) + 4;
+            if (z->hlit > 286 || z->hdist > 30) {
+                CORE_LOG_ERROR("Bad deflate table counts");
+                return -1;
+            }
+            memset(z->lens, 0, 19);
+            z->index = 0;
+            z->state = INF_TABLE_CLEN;
+            break;
+
+        case INF_TABLE_CLEN:
+            while (z->index < z->hclen) {
+                pull_bits(z);
+                if (z->bitcnt < 3) return 0;
+                z->lens[g_clen_order[z->index++]] = (uint8_t)take_bits(z, 3);
+            }
+            /* The code-length code borrows the literal table until it is built */
+            if (huffman_build(&z->lencode, z->lens, 19) < 0) {
+                CORE_LOG_ERROR("Bad code length code");
+                return -1;
+            }
+            z->index = 0;
+            z->state = INF_TABLE_LENS;
+            break;
+
+        case INF_TABLE_LENS:
+            while (z->index < z->hlit + z->hdist) {
+                int save_cnt, repeat, value;
+                uint32_t save_buf;
+
+                pull_bits(z);
+                save_buf = z->bitbuf;
+                save_cnt = z->bitcnt;
+                sym = huffman_decode(z, &z->lencode);
+                if (sym == -1) return 0;
+                if (sym < 0) {
+                    CORE_LOG_ERROR("Bad code length");
+                    return -1;
+                }
+                if (sym < 16) {
+                    z->lens[z->index++] = (uint8_t)sym;
+                    continue;
+                }
+
+                /* A repeat needs its extra bits too; back out until they arrive */
+                int extra = (sym == 16) ? 2 : (sym == 17) ? 3 : 7;
+                if (z->bitcnt < extra) {
+                    z->bitbuf = save_buf;
+                    z->bitcnt = save_cnt;
+                    return 0;
+                }
+                if (sym == 16) {
+                    if (z->index == 0) {
+                        CORE_LOG_ERROR("Repeat with no previous length");
+                        return -1;
+                    }
+                    value = z->lens[z->index - 1];
+                    repeat = 3 + (int)take_bits(z, 2);
+                } else {
+                    value = 0;
+                    repeat = (sym == 17) ? 3 + (int)take_bits(z, 3) : 11 + (int)take_bits(z, 7);
+                }
+                if (z->index + repeat > z->hlit + z->hdist) {
+                    CORE_LOG_ERROR("Code lengths overrun");
+                    return -1;
+                }
+                while (repeat--) z->lens[z->index++] = (uint8_t)value;
+            }
+            if (z->lens[256] == 0 ||
+                huffman_build(&z->lencode, z->lens, z->hlit) < 0 ||
+                huffman_build(&z->distcode, z->lens + z->hlit, z->hdist) < 0) {
+                CORE_LOG_ERROR("Bad deflate tables");
+                return -1;
+            }
+            z->state = INF_CODES;
+            break;
+
+        case INF_CODES:
+            /* Literals are most symbols; stay in this loop for them */
+            for (;;) {
+                pull_bits(z);
+                sym = huffman_decode(z, &z->lencode);
+                if (sym == -1) return 0;
+                if (sym < 0 || sym > 285) {
+                    CORE_LOG_ERROR("Bad literal/length code");
+                    return -1;
+                }
+                if (sym >= 256) break;
+                if (put_byte(z, (uint8_t)sym) < 0) return -1;
+            }
+            if (sym == 256) {
+                z->state = z->last_block ? INF_TRAILER : INF_BLOCK;
+                break;
+            }
+            z->extra_sym = sym - 257;
+            z->state = INF_LEN_EXTRA;
+            break;
+
+        case INF_LEN_EXTRA: {
+            int extra = g_len_extra[z->extra_sym];
+            pull_bits(z);
+            if (z->bitcnt < extra) return 0;
+            z->length = g_len_base[z->extra_sym] + (int)take_bits(z, extra);
+            z->state = INF_DIST;
+            break;
+        }
+
+        case INF_DIST:
+            pull_bits(z);
+            sym = huffman_decode(z, &z->distcode);
+            if (sym == -1) return 0;
+            if (sym < 0 || sym > 29) {
+                CORE_LOG_ERROR("Bad distance code");
+                return -1;
+            }
+            z->extra_sym = sym;
+            z->state = INF_DIST_EXTRA;
+            break;
+
+        case INF_DIST_EXTRA: {
+            int extra = g_dist_extra[z->extra_sym];
+            pull_bits(z);
+            if (z->bitcnt < extra) return 0;
+            z->distance = g_dist_base[z->extra_sym] + take_bits(z, extra);
+            if (z->distance > z->filled) {
+                if (z->distance > INFLATE_WINDOW) {
+                    CORE_LOG_ERROR("Match beyond the %u byte window", INFLATE_WINDOW);
+                } else {
+                    CORE_LOG_ERROR("Match before start of stream");
+                }
+                return -1;
+            }
+            z->state = INF_COPY;
+            break;
+        }
+
+        case INF_COPY:
+            /* Copy in runs that stop at either end of the ring */
+            while (z->length > 0) {
+                uint32_t from = (z->wpos - z->distance) & (INFLATE_WINDOW - 1);
+                uint32_t run = (uint32_t)z->length;
+                if (run > INFLATE_WINDOW - z->wpos) run = INFLATE_WINDOW - z->wpos;
+                if (run > INFLATE_WINDOW - from) run = INFLATE_WINDOW - from;
+
+                uint8_t *dst = z->window + z->wpos;
+                const uint8_t *src = z->window + from;
+                if (z->distance >= run) {
+                    memmove(dst, src, run);
+                } else {
+                    /* Overlapping match repeats the last `distance` bytes */
+                    for (uint32_t i = 0; i < run; i++) dst[i] = src[i];
+                }
+
+                z->wpos += run;
+                z->total_out += run;
+                z->filled = (z->filled + run < INFLATE_WINDOW) ? z->filled + run : INFLATE_WINDOW;
+                z->length -= (int)run;
+                if (z->wpos == INFLATE_WINDOW && flush_window(z) < 0) return -1;
+            }
+            z->state = INF_CODES;
+            break;
+
+        case INF_TRAILER: {
+            int need = (z->format == INFLATE_GZIP) ? 8 : (z->format == INFLATE_ZLIB) ? 4 : 0;
+            if (z->header_len == 0) take_bits(z, z->bitcnt & 7);
+            while (z->header_len < need) {
+                if ((c = next_byte(z)) < 0) return 0;
+                z->header[z->header_len++] = (uint8_t)c;
+            }
+            if (flush_window(z) < 0) return -1;
+
+            const uint8_t *t = z->header;
+            if (z->format == INFLATE_GZIP) {
+                uint32_t crc = t[0] | (t[1] << 8) | (t[2] << 16) | ((uint32_t)t[3] << 24);
+                uint32_t size = t[4] | (t[5] << 8) | (t[6] << 16) | ((uint32_t)t[7] << 24);
+                if (crc != (z->crc ^ 0xffffffff) || size != z->total_out) {
+                    CORE_LOG_ERROR("gzip checksum mismatch");
+                    return -1;
+                }
+            } else if (z->format == INFLATE_ZLIB) {
+                uint32_t adler = ((uint32_t)t[0] << 24) | (t[1] << 16) | (t[2] << 8) | t[3];
+                if (adler != ((z->adler_b << 16) | z->adler_a)) {
+                    CORE_LOG_ERROR("zlib checksum mismatch");
+                    return -1;
+                }
+            }
+            z->state = INF_DONE;
+            return 1;
+        }
+
+        case INF_DONE:
+            return 1;
+        }
+    }
+}
+
+/*
+ * Create a decoder. `format` is INFLATE_AUTO to sniff the wrapper, or the
+ * wrapper named by Content-Encoding. Decoded bytes are passed to `sink`.
+ */
+inflate_t *inflate_create(int format, inflate_sink_t sink, void *user)
+{
+    inflate_t *z = (inflate_t *)core_malloc(sizeof(*z));
+    if (!z) {
+        CORE_LOG_ERROR("Failed to allocate inflate state");
+        return NULL;
+    }
+    /* The window is only read after it has been written */
+    memset(z, 0, offsetof(struct inflate_ctx, window));
+    z->state = INF_WRAPPER;
+    z->format = format;
+    z->sink = sink;
+    z->sink_user = user;
+    return z;
+}
+
+/*
+ * Feed compressed bytes. Returns 0 if more input is expected, 1 once the
+ * stream (and its trailer) is complete, -1 on corrupt data or sink error.
+ */
+int inflate_feed(inflate_t *z, const void *data, size_t len)
+{
+    if (z->state == INF_DONE) return 1;
+
+    z->in = (const uint8_t *)data;
+    z->in_left = len;
+
+    /* Whatever this call decoded reaches the sink before it returns */
+    int result = inflate_run(z);
+    if (result == 0 && flush_window(z) < 0) return -1;
+    return result;
+}
+
+/*
+ * True once the final block and trailer have been decoded
+ */
+bool inflate_done(const inflate_t *z)
+{
+    return z->state == INF_DONE;
+}
+
+/* Free a decoder */
+void inflate_destroy(inflate_t *z)
+{
+    core_free(z);
+}
@@ -0,0 +1,1264 @@
+/*
+ * Nedflix retro ports - shared core
+ * Minimal JSON parser
+ *
+ * This is a simple, memory-efficient JSON parser sized for the
+ * Dreamcast's 16MB of RAM and shared by every port. It only supports the
+ * subset of JSON needed for the Nedflix API responses.
+ *
+ * A document lives in one arena: values, member tables and decoded
+ * strings are bump-allocated from a block sized from the input length,
+ * with further blocks chained on only if that estimate runs short. The
+ * elements of an array and the members of an object sit next to each
+ * other, so indexing is O(1), and json_free() releases the blocks without
+ * walking the tree.
+ *
+ * json_push_* (at the end) reads the same text as it arrives instead,
+ * reporting events rather than building a document.
+ */
+
+#include "core.h"
+#include <string.h>
+#include <ctype.h>
+#include <float.h>
+#include <limits.h>
+
+/* Deepest nesting accepted; the parser recurses once per level */
+#define JSON_MAX_DEPTH 64
+
+/* Alignment of values in the arena */
+#define JSON_ALIGN sizeof(double)
+
+/*
+ * Block scan for strings (JSON_SIMD_SCAN, core_config.h). The end of each
+ * string is found sixteen bytes at a time by comparing against '"' and
+ * '\\' with whatever vector unit the port has: SSE2 on the host, MMX with
+ * SSE's pmovmskb on the Xbox (its Pentium III predates SSE2), VMX on Cell
+ * and Xenon. Anything else takes the scalar version of the same test.
+ */
+#if JSON_SIMD_SCAN
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define JSON_SCAN_SSE2
+#elif defined(__SSE__) && defined(__MMX__)
+#include <xmmintrin.h>
+#define JSON_SCAN_MMX
+#elif defined(__ALTIVEC__)
+#include <altivec.h>
+#undef bool             /* altivec.h takes it for "vector bool" */
+#define bool _Bool
+#define JSON_SCAN_VMX
+#endif
+
+#define JSON_SCAN_BLOCK 16
+#endif
+
+/* JSON value types */
+typedef enum {
+    JSON_NULL,
+    JSON_BOOL,
+    JSON_NUMBER,
+    JSON_INTEGER,       /* A number that json_number_scan() read exactly */
+    JSON_STRING,
+    JSON_ARRAY,
+    JSON_OBJECT
+} json_type_t;
+
+typedef struct json_member json_member_t;
+
+/* JSON value structure */
+struct json_value {
+    json_type_t type;
+    int count;                      /* Array elements or object members */
+    union {
+        bool bool_val;
+        double num_val;
+        int64_t int_val;
+        const char *str_val;
+        struct json_value *items;   /* count values */
+        json_member_t *members;     /* count members */
+    } data;
+};
+
+struct json_member {
+    const char *key;
+    json_value_t value;
+};
+
+/* An arena block taken after the first one ran out */
+typedef struct json_block {
+    struct json_block *next;
+} json_block_t;
+
+/*
+ * One parsed document. The root comes first so that the pointer handed
+ * out by json_parse() is also the document, and json_free() can find the
+ * blocks from it.
+ */
+typedef struct {
+    json_value_t root;
+    json_block_t *blocks;
+    char *next;
+    char *end;
+    size_t block_size;
+} json_doc_t;
+
+/* Parser state */
+typedef struct {
+    const char *json;
+    const char *ptr;
+    json_doc_t *doc;
+    json_member_t *stack;           /* Children of the open containers */
+    int stack_count;
+    int stack_capacity;
+    int depth;
+    bool insitu;                    /* Strings are decoded over the input */
+#if JSON_SIMD_SCAN
+    const char *end;                /* The terminating NUL */
+#endif
+    char error[128];
+} parser_t;
+
+/* Forward declarations */
+static bool parse_value(parser_t *p, json_value_t *out);
+
+/*
+ * Bump-allocate from the document, chaining on a new block when the
+ * current one is full
+ */
+static void *arena_alloc(json_doc_t *doc, size_t size, size_t align)
+{
+    uintptr_t at = ((uintptr_t)doc->next + align - 1) & ~(uintptr_t)(align - 1);
+    if (at + size > (uintptr_t)doc->end) {
+        size_t block = doc->block_size;
+        if (block < size + align) block = size + align;
+        json_block_t *b = (json_block_t *)core_malloc(sizeof(json_block_t) + block);
+        if (!b) return NULL;
+        b->next = doc->blocks;
+        doc->blocks = b;
+        doc->next = (char *)(b + 1);
+        doc->end = doc->next + block;
+        at = ((uintptr_t)doc->next + align - 1) & ~(uintptr_t)(align - 1);
+    }
+    doc->next = (char *)(at + size);
+    return (void *)at;
+}
+
+/*
+ * Push a finished child of the innermost open container
+ */
+static bool stack_push(parser_t *p, const char *key, const json_value_t *value)
+{
+    if (p->stack_count == p->stack_capacity) {
+        int new_cap = p->stack_capacity * 2;
+        json_member_t *s = (json_member_t *)core_realloc(p->stack,
+                                                         new_cap * sizeof(json_member_t));
+        if (!s) return false;
+        p->stack = s;
+        p->stack_capacity = new_cap;
+    }
+    p->stack[p->stack_count].key = key;
+    p->stack[p->stack_count].value = *value;
+    p->stack_count++;
+    return true;
+}
+
+/*
+ * Skip whitespace
+ */
+static void skip_whitespace(parser_t *p)
+{
+    while (*p->ptr == ' ' || *p->ptr == '\n' || *p->ptr == '\r' || *p->ptr == '\t') {
+        p->ptr++;
+    }
+}
+
+/*
+ * Read the four hex digits of a \u escape; -1 if they are not hex
+ */
+static long parse_hex4(const char *s)
+{
+    long v = 0;
+    for (int i = 0; i < 4; i++) {
+        char c = s[i];
+        v <<= 4;
+        if (c >= '0' && c <= '9') v |= c - '0';
+        else if (c >= 'a' && c <= 'f') v |= c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F') v |= c - 'A' + 10;
+        else return -1;
+    }
+    return v;
+}
+
+/*
+ * Decode the escapes in src..end into dst, which may be src itself: every
+ * escape is at least as long as what it decodes to (\uXXXX is at most
+ * three bytes of UTF-8, a surrogate pair four). Returns the end of dst.
+ */
+static char *decode_escapes(const char *src, const char *end, char *dst)
+{
+    while (src < end) {
+        if (*src != '\\' || src + 1 >= end) {
+            *dst++ = *src++;
+            continue;
+        }
+        src++;
+        switch (*src) {
+            case 'b': *dst++ = '\b'; break;
+            case 'f': *dst++ = '\f'; break;
+            case 'n': *dst++ = '\n'; break;
+            case 'r': *dst++ = '\r'; break;
+            case 't': *dst++ = '\t'; break;
+            case 'u': {
+                long cp = end - src > 4 ? parse_hex4(src + 1) : -1;
+                if (cp < 0) {
+                    *dst++ = 'u';
+                    break;
+                }
+                src += 4;
+                if (cp >= 0xD800 && cp < 0xDC00 && end - src > 6 &&
+                    src[1] == '\\' && src[2] == 'u') {
+                    long lo = parse_hex4(src + 3);
+                    if (lo >= 0xDC00 && lo < 0xE000) {
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                        src += 6;
+                    }
+                }
+                if (cp >= 0xD800 && cp < 0xE000) {
+                    cp = 0xFFFD;    /* Unpaired surrogate */
+                }
+                if (cp < 0x80) {
+                    *dst++ = (char)cp;
+                } else if (cp < 0x800) {
+                    *dst++ = (char)(0xC0 | (cp >> 6));
+                    *dst++ = (char)(0x80 | (cp & 0x3F));
+                } else if (cp < 0x10000) {
+                    *dst++ = (char)(0xE0 | (cp >> 12));
+                    *dst++ = (char)(0x80 | ((cp >> 6) & 0x3F));
+                    *dst++ = (char)(0x80 | (cp & 0x3F));
+                } else {
+                    *dst++ = (char)(0xF0 | (cp >> 18));
+                    *dst++ = (char)(0x80 | ((cp >> 12) & 0x3F));
+                    *dst++ = (char)(0x80 | ((cp >> 6) & 0x3F));
+                    *dst++ = (char)(0x80 | (cp & 0x3F));
+                }
+                break;
+            }
+            default: *dst++ = *src; break;     /* \" \\ \/ */
+        }
+        src++;
+    }
+    return dst;
+}
+
+#if JSON_SIMD_SCAN
+/*
+ * Bit i set where byte i of the 16 bytes at s is a quote or a backslash
+ */
+static uint32_t scan_block(const char *s)
+{
+#if defined(JSON_SCAN_SSE2)
+    __m128i v = _mm_loadu_si128((const __m128i *)s);
+    __m128i hit = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('"')),
+                               _mm_cmpeq_epi8(v, _mm_set1_epi8('\\')));
+    return (uint32_t)_mm_movemask_epi8(hit);
+#elif defined(JSON_SCAN_MMX)
+    __m64 quote = _mm_set1_pi8('"');
+    __m64 backslash = _mm_set1_pi8('\\');
+    __m64 lo, hi;
+    memcpy(&lo, s, 8);
+    memcpy(&hi, s + 8, 8);
+    uint32_t mask = (uint32_t)_mm_movemask_pi8(_mm_or_si64(_mm_cmpeq_pi8(lo, quote),
+                                                           _mm_cmpeq_pi8(lo, backslash)));
+    mask |= (uint32_t)_mm_movemask_pi8(_mm_or_si64(_mm_cmpeq_pi8(hi, quote),
+                                                   _mm_cmpeq_pi8(hi, backslash))) << 8;
+    return mask;
+#elif defined(JSON_SCAN_VMX)
+    /* No unaligned load and no movemask: merge the two aligned blocks
+     * around s, then weight each hit by its bit and add the bytes up */
+    static const vector unsigned char quote = {
+        '"', '"', '"', '"', '"', '"', '"', '"', '"', '"', '"', '"', '"', '"', '"', '"' };
+    static const vector unsigned char backslash = {
+        '\\', '\\', '\\', '\\', '\\', '\\', '\\', '\\',
+        '\\', '\\', '\\', '\\', '\\', '\\', '\\', '\\' };
+    static const vector unsigned char weight = {
+        1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+    const unsigned char *u = (const unsigned char *)s;
+    vector unsigned char v = vec_perm(vec_ld(0, u), vec_ld(15, u), vec_lvsl(0, u));
+    if (!vec_any_eq(v, quote) && !vec_any_eq(v, backslash)) {
+        return 0;
+    }
+    vector unsigned char hit = vec_or((vector unsigned char)vec_cmpeq(v, quote),
+                                      (vector unsigned char)vec_cmpeq(v, backslash));
+    uint32_t word[4] __attribute__((aligned(16)));
+    vec_st(vec_sum4s(vec_and(hit, weight), vec_splat_u32(0)), 0, word);
+    return (word[0] | word[1]) | (word[2] | word[3]) << 8;
+#else
+    /* Eight bytes at a time: skip the block if no byte matches */
+    const uint64_t ones = 0x0101010101010101ull;
+    uint64_t x, y;
+    memcpy(&x, s, 8);
+    memcpy(&y, s + 8, 8);
+    uint64_t q = x ^ (ones * '"'), b = x ^ (ones * '\\');
+    uint64_t q2 = y ^ (ones * '"'), b2 = y ^ (ones * '\\');
+    uint64_t any = ((q - ones) & ~q) | ((b - ones) & ~b) |
+                   ((q2 - ones) & ~q2) | ((b2 - ones) & ~b2);
+    if (!(any & (ones << 7))) {
+        return 0;
+    }
+    uint32_t mask = 0;
+    for (int i = 0; i < JSON_SCAN_BLOCK; i++) {
+        if (s[i] == '"' || s[i] == '\\') mask |= 1u << i;
+    }
+    return mask;
+#endif
+}
+
+/*
+ * Find the closing quote of the string whose contents start at s, a
+ * block at a time while whole blocks remain. Sets *escape to the first
+ * backslash, if there is one. Returns NULL if the text ends first.
+ */
+static const char *scan_string_end(parser_t *p, const char *s, const char **escape)
+{
+    const char *found = NULL;
+
+    while (s + JSON_SCAN_BLOCK <= p->end) {
+        uint32_t mask = scan_block(s);
+        if (!mask) {
+            s += JSON_SCAN_BLOCK;
+            continue;
+        }
+        s += __builtin_ctz(mask);
+        if (*s == '"') {
+            found = s;
+            break;
+        }
+        if (!s[1]) break;
+        if (!*escape) *escape = s;
+        s += 2;     /* Past the backslash and what it escapes */
+    }
+#if defined(JSON_SCAN_MMX)
+    _mm_empty();    /* Hand the x87 registers back for strtod */
+#endif
+    if (found) return found;
+
+    /* The tail, byte at a time */
+    while (*s && *s != '"') {
+        if (*s == '\\' && *(s + 1)) {
+            if (!*escape) *escape = s;
+            s += 2;
+        } else {
+            s++;
+        }
+    }
+    return *s == '"' ? s : NULL;
+}
+#endif
+
+/*
+ * Parse a string (including quotes). In place, it is decoded over the
+ * input in one pass and terminated where its closing quote was; otherwise
+ * it is copied into the arena.
+ */
+static char *parse_string_value(parser_t *p)
+{
+    if (*p->ptr != '"') return NULL;
+    p->ptr++;
+
+    const char *start = p->ptr;
+    const char *escape = NULL;
+
+#if JSON_SIMD_SCAN
+    const char *end = scan_string_end(p, start, &escape);
+    if (!end) return NULL;
+#else
+    /* Find end of string */
+    while (*p->ptr && *p->ptr != '"') {
+        if (*p->ptr == '\\' && *(p->ptr + 1)) {
+            if (!escape) escape = p->ptr;
+            p->ptr += 2;
+        } else {
+            p->ptr++;
+        }
+    }
+    if (*p->ptr != '"') return NULL;
+    const char *end = p->ptr;
+#endif
+
+    char *str;
+    char *dst;
+    if (p->insitu) {
+        str = (char *)start;
+        dst = escape ? decode_escapes(escape, end, (char *)escape) : (char *)end;
+    } else {
+        /* Escapes only ever shorten the string */
+        str = (char *)arena_alloc(p->doc, end - start + 1, 1);
+        if (!str) return NULL;
+        if (escape) {
+            memcpy(str, start, escape - start);
+            dst = decode_escapes(escape, end, str + (escape - start));
+        } else {
+            memcpy(str, start, end - start);
+            dst = str + (end - start);
+        }
+    }
+    *dst = '\0';
+
+    p->ptr = end + 1;  /* Skip closing quote */
+    return str;
+}
+
+/*
+ * Number scanning. Sizes, durations, counts, years and one-decimal
+ * ratings are what the API sends, and strtod() is a heavy way to read
+ * them: newlib's goes through multiple-precision arithmetic, which the
+ * SH-4 runs entirely in software. Instead the digits are gathered into
+ * a 64-bit integer, and a decimal point or exponent is applied with one
+ * multiply or divide by a power of ten. While the digits and the power
+ * are both exact in a double that one operation is correctly rounded,
+ * so the result is the one strtod() would give (an x87 build, as on the
+ * Xbox, may round twice and land one unit off). Anything else - more
+ * digits, a larger exponent, text strtod() reads but JSON does not,
+ * such as hex - still goes to strtod().
+ */
+#define NUMBER_MAX_DIGITS 19    /* Any 19 digits fit in a uint64_t */
+#define NUMBER_MAX_INTEGER 18   /* and any 18 in an int64_t */
+#define NUMBER_MAX_MANTISSA (1ull << DBL_MANT_DIG)
+
+/* Largest exact power of ten: 5^22 < 2^53, and 5^10 < 2^24 where double is float */
+#if DBL_MANT_DIG >= 53
+#define NUMBER_MAX_POW10 22
+#else
+#define NUMBER_MAX_POW10 10
+#endif
+
+static const double g_pow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+#if NUMBER_MAX_POW10 > 10
+    1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+#endif
+};
+
+/* Hand a number the fast path cannot take to strtod() */
+static const char *number_fallback(const char *text, json_number_t *out)
+{
+    char *end;
+    out->real = strtod(text, &end);
+    out->integer = 0;
+    out->is_integer = false;
+    return end;
+}
+
+/*
+ * Read one number; see core.h
+ */
+const char *json_number_scan(const char *text, json_number_t *out)
+{
+    const char *s = text;
+    bool negative = *s == '-';
+    if (negative) s++;
+
+    uint64_t mantissa = 0;
+    int digits = 0;
+    while (*s >= '0' && *s <= '9') {
+        mantissa = mantissa * 10 + (uint64_t)(*s++ - '0');
+        digits++;
+    }
+    if (digits == 0 || digits > NUMBER_MAX_DIGITS) {
+        return number_fallback(text, out);
+    }
+
+    int exponent = 0;
+    bool whole = true;
+    if (*s == '.') {
+        s++;
+        const char *frac = s;
+        while (*s >= '0' && *s <= '9') {
+            mantissa = mantissa * 10 + (uint64_t)(*s++ - '0');
+        }
+        digits += (int)(s - frac);
+        exponent = -(int)(s - frac);
+        whole = false;
+        if (s == frac || digits > NUMBER_MAX_DIGITS) {
+            return number_fallback(text, out);
+        }
+    }
+    if (*s == 'e' || *s == 'E') {
+        s++;
+        bool minus = *s == '-';
+        if (*s == '-' || *s == '+') s++;
+        int e = 0;
+        const char *exp = s;
+        while (*s >= '0' && *s <= '9' && s - exp < 4) {
+            e = e * 10 + (*s++ - '0');
+        }
+        exponent += minus ? -e : e;
+        whole = false;
+        if (s == exp) {
+            return number_fallback(text, out);
+        }
+    }
+
+    /* Whatever strtod() would carry on reading, it should read */
+    if (isalnum((unsigned char)*s) || *s == '.') {
+        return number_fallback(text, out);
+    }
+
+    if (whole && digits <= NUMBER_MAX_INTEGER) {
+        out->integer = negative ? -(int64_t)mantissa : (int64_t)mantissa;
+        out->real = negative ? -(double)mantissa : (double)mantissa;
+        out->is_integer = true;
+        return s;
+    }
+    if (mantissa > NUMBER_MAX_MANTISSA ||
+        exponent < -NUMBER_MAX_POW10 || exponent > NUMBER_MAX_POW10) {
+        return number_fallback(text, out);
+    }
+
+    double real = (double)mantissa;
+    real = exponent < 0 ? real / g_pow10[-exponent] : real * g_pow10[exponent];
+    out->real = negative ? -real : real;
+    out->integer = 0;
+    out->is_integer = false;
+    return s;
+}
+
+/*
+ * Parse a number
+ */
+static bool parse_number_value(parser_t *p, json_value_t *out)
+{
+    json_number_t num;
+    const char *end = json_number_scan(p->ptr, &num);
+    /* A lone '-' reads nothing, and an array would push it forever */
+    if (end == p->ptr) return false;
+    p->ptr = (char *)end;
+    if (num.is_integer) {
+        out->type = JSON_INTEGER;
+        out->data.int_val = num.integer;
+    } else {
+        out->type = JSON_NUMBER;
+        out->data.num_val = num.real;
+    }
+    return true;
+}
+
+/*
+ * Move the children pushed since base into one block of the arena
+ */
+static bool close_container(parser_t *p, json_value_t *out, int base)
+{
+    int count = p->stack_count - base;
+    json_member_t *children = p->stack + base;
+
+    out->count = count;
+    p->stack_count = base;
+    if (count == 0) {
+        return true;
+    }
+
+    if (out->type == JSON_ARRAY) {
+        json_value_t *items = (json_value_t *)arena_alloc(
+            p->doc, count * sizeof(json_value_t), JSON_ALIGN);
+        if (!items) return false;
+        for (int i = 0; i < count; i++) {
+            items[i] = children[i].value;
+        }
+        out->data.items = items;
+    } else {
+        json_member_t *members = (json_member_t *)arena_alloc(
+            p->doc, count * sizeof(json_member_t), JSON_ALIGN);
+        if (!members) return false;
+        memcpy(members, children, count * sizeof(json_member_t));
+        out->data.members = members;
+    }
+    return true;
+}
+
+/*
+ * Parse an array
+ */
+static bool parse_array(parser_t *p, json_value_t *out)
+{
+    if (*p->ptr != '[') return false;
+    p->ptr++;
+
+    int base = p->stack_count;
+    out->type = JSON_ARRAY;
+
+    skip_whitespace(p);
+
+    while (*p->ptr && *p->ptr != ']') {
+        json_value_t item;
+        if (!parse_value(p, &item)) break;
+        if (!stack_push(p, NULL, &item)) break;
+
+        skip_whitespace(p);
+        if (*p->ptr == ',') {
+            p->ptr++;
+            skip_whitespace(p);
+        }
+    }
+
+    if (*p->ptr == ']') p->ptr++;
+
+    return close_container(p, out, base);
+}
+
+/*
+ * Parse an object
+ */
+static bool parse_object(parser_t *p, json_value_t *out)
+{
+    if (*p->ptr != '{') return false;
+    p->ptr++;
+
+    int base = p->stack_count;
+    out->type = JSON_OBJECT;
+
+    skip_whitespace(p);
+
+    while (*p->ptr && *p->ptr != '}') {
+        /* Parse key */
+        char *key = parse_string_value(p);
+        if (!key) break;
+
+        skip_whitespace(p);
+        if (*p->ptr != ':') break;
+        p->ptr++;
+        skip_whitespace(p);
+
+        /* Parse value */
+        json_value_t value;
+        if (!parse_value(p, &value)) break;
+        if (!stack_push(p, key, &value)) break;
+
+        skip_whitespace(p);
+        if (*p->ptr == ',') {
+            p->ptr++;
+            skip_whitespace(p);
+        }
+    }
+
+    if (*p->ptr == '}') p->ptr++;
+
+    return close_container(p, out, base);
+}
+
+/*
+ * Parse a JSON value into out
+ */
+static bool parse_value(parser_t *p, json_value_t *out)
+{
+    skip_whitespace(p);
+
+    memset(out, 0, sizeof(*out));
+
+    switch (*p->ptr) {
+        case '{':
+        case '[': {
+            if (p->depth >= JSON_MAX_DEPTH) return false;
+            p->depth++;
+            bool ok = *p->ptr == '{' ? parse_object(p, out) : parse_array(p, out);
+            p->depth--;
+            return ok;
+        }
+
+        case '"':
+            out->type = JSON_STRING;
+            out->data.str_val = parse_string_value(p);
+            return out->data.str_val != NULL;
+
+        case 't':
+            if (strncmp(p->ptr, "true", 4) != 0) return false;
+            out->type = JSON_BOOL;
+            out->data.bool_val = true;
+            p->ptr += 4;
+            return true;
+
+        case 'f':
+            if (strncmp(p->ptr, "false", 5) != 0) return false;
+            out->type = JSON_BOOL;
+            out->data.bool_val = false;
+            p->ptr += 5;
+            return true;
+
+        case 'n':
+            if (strncmp(p->ptr, "null", 4) != 0) return false;
+            out->type = JSON_NULL;
+            p->ptr += 4;
+            return true;
+
+        default:
+            if (*p->ptr == '-' || isdigit((unsigned char)*p->ptr)) {
+                return parse_number_value(p, out);
+            }
+            return false;
+    }
+}
+
+/*
+ * Parse a whole document. The first arena block holds about what a
+ * Nedflix listing needs for its length (one value and key per 24 bytes
+ * of text plus the strings, or per 16 bytes when the strings stay in
+ * place and there is no copy to absorb a dense stretch), so most
+ * documents take a single allocation.
+ */
+static json_value_t *parse_document(const char *json_str, bool insitu)
+{
+    if (!json_str) return NULL;
+
+    size_t len = strlen(json_str);
+    size_t block = insitu ? (len / 16 + 8) * sizeof(json_member_t)
+                          : len + (len / 24 + 8) * sizeof(json_member_t);
+    json_doc_t *doc = (json_doc_t *)core_malloc(sizeof(json_doc_t) + block);
+    if (!doc) return NULL;
+
+    doc->blocks = NULL;
+    doc->next = (char *)(doc + 1);
+    doc->end = doc->next + block;
+    doc->block_size = block / 2 > 4096 ? block / 2 : 4096;
+
+    /* Room for an array of listing items (about 250 bytes each) and the members of one */
+    parser_t parser = {
+        .json = json_str,
+        .ptr = json_str,
+        .doc = doc,
+        .stack_capacity = (int)(len / 128) + 32,
+        .insitu = insitu,
+        .error = ""
+    };
+#if JSON_SIMD_SCAN
+    parser.end = json_str + len;
+#endif
+    parser.stack = (json_member_t *)core_malloc(parser.stack_capacity * sizeof(json_member_t));
+    if (!parser.stack) {
+        core_free(doc);
+        return NULL;
+    }
+
+    bool ok = parse_value(&parser, &doc->root);
+    core_free(parser.stack);
+    if (!ok) {
+        json_free(&doc->root);
+        return NULL;
+    }
+    return &doc->root;
+}
+
+/*
+ * Parse JSON string. The document copies what it needs, so json_str may
+ * be freed as soon as this returns. Returns NULL on malformed input or
+ * when memory runs out.
+ */
+json_value_t *json_parse(const char *json_str)
+{
+    return parse_document(json_str, false);
+}
+
+/*
+ * Parse JSON string in place: strings are decoded inside json_str and
+ * the document points into it instead of keeping copies. json_str is
+ * overwritten, so it no longer holds the original text, and it must stay
+ * allocated until json_free(); freeing it is still up to the caller.
+ */
+json_value_t *json_parse_insitu(char *json_str)
+{
+    return parse_document(json_str, true);
+}
+
+/*
+ * Free a document returned by json_parse(), along with every value and
+ * string in it. Values found inside it must not be passed here.
+ */
+void json_free(json_value_t *value)
+{
+    if (!value) return;
+
+    json_doc_t *doc = (json_doc_t *)value;
+    json_block_t *b = doc->blocks;
+    while (b) {
+        json_block_t *next = b->next;
+        core_free(b);
+        b = next;
+    }
+    core_free(doc);
+}
+
+/*
+ * Look up a member of an object
+ */
+static json_value_t *find_member(json_value_t *obj, const char *key)
+{
+    if (!obj || obj->type != JSON_OBJECT || !key) return NULL;
+
+    for (int i = 0; i < obj->count; i++) {
+        if (strcmp(obj->data.members[i].key, key) == 0) {
+            return &obj->data.members[i].value;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Get string value from object
+ */
+const char *json_get_string(json_value_t *obj, const char *key)
+{
+    json_value_t *val = find_member(obj, key);
+    if (val && val->type == JSON_STRING) {
+        return val->data.str_val;
+    }
+    return NULL;
+}
+
+/*
+ * Get integer value from object
+ */
+int json_get_int(json_value_t *obj, const char *key, int default_val)
+{
+    json_value_t *val = find_member(obj, key);
+    if (val && val->type == JSON_INTEGER) {
+        int64_t i = val->data.int_val;
+        return i > INT_MAX ? INT_MAX : i < INT_MIN ? INT_MIN : (int)i;
+    }
+    if (val && val->type == JSON_NUMBER) {
+        return (int)val->data.num_val;
+    }
+    return default_val;
+}
+
+/*
+ * Get floating-point value from object
+ */
+double json_get_double(json_value_t *obj, const char *key, double default_val)
+{
+    json_value_t *val = find_member(obj, key);
+    if (val && val->type == JSON_INTEGER) {
+        return (double)val->data.int_val;
+    }
+    if (val && val->type == JSON_NUMBER) {
+        return val->data.num_val;
+    }
+    return default_val;
+}
+
+/*
+ * Get boolean value from object
+ */
+bool json_get_bool(json_value_t *obj, const char *key, bool default_val)
+{
+    json_value_t *val = find_member(obj, key);
+    if (val && val->type == JSON_BOOL) {
+        return val->data.bool_val;
+    }
+    return default_val;
+}
+
+/*
+ * Get array from object
+ */
+json_value_t *json_get_array(json_value_t *obj, const char *key)
+{
+    json_value_t *val = find_member(obj, key);
+    if (val && val->type == JSON_ARRAY) {
+        return val;
+    }
+    return NULL;
+}
+
+/*
+ * Get object from object
+ */
+json_value_t *json_get_object(json_value_t *obj, const char *key)
+{
+    json_value_t *val = find_member(obj, key);
+    if (val && val->type == JSON_OBJECT) {
+        return val;
+    }
+    return NULL;
+}
+
+/*
+ * Get array length
+ */
+int json_array_length(json_value_t *arr)
+{
+    if (!arr || arr->type != JSON_ARRAY) return 0;
+    return arr->count;
+}
+
+/*
+ * Get array element
+ */
+json_value_t *json_array_get(json_value_t *arr, int index)
+{
+    if (!arr || arr->type != JSON_ARRAY) return NULL;
+    if (index < 0 || index >= arr->count) return NULL;
+    return &arr->data.items[index];
+}
+
+/*
+ * Incremental parsing. Text is taken in chunks split at any byte and each
+ * key, scalar and container boundary is reported as soon as its last byte
+ * arrives. Only the token being read is buffered, so a document of any
+ * length parses in the fixed size of a json_push_t.
+ */
+
+/* What the next byte may be */
+typedef enum {
+    PUSH_VALUE,         /* Any value */
+    PUSH_FIRST_VALUE,   /* A value, or ']' straight after '[' */
+    PUSH_FIRST_KEY,     /* A key, or '}' straight after '{' */
+    PUSH_KEY,           /* A key, after ',' in an object */
+    PUSH_COLON,
+    PUSH_NEXT,          /* ',' or the end of the innermost container */
+    PUSH_STRING,        /* Inside a string or key */
+    PUSH_NUMBER,
+    PUSH_LITERAL,       /* true, false or null */
+    PUSH_DONE,
+    PUSH_ERROR
+} push_state_t;
+
+/* Longest number accepted; a JSON double never needs more */
+#define JSON_PUSH_NUMBER_MAX 64
+
+struct json_push {
+    push_state_t state;
+    json_event_fn fn;
+    void *user;
+    char open[JSON_MAX_DEPTH];      /* '{' or '[' per open container */
+    int depth;
+    bool is_key;                    /* The string being read is a key */
+    bool escaped;                   /* The last string byte was a lone backslash */
+    bool has_escape;
+    bool truncated;
+    const char *literal;            /* Rest of "true", "false" or "null" */
+    size_t token_len;
+    char token[JSON_PUSH_TOKEN_MAX + 1];
+};
+
+/*
+ * Report one event; a callback that returns <0 stops the parse
+ */
+static int push_emit(json_push_t *jp, json_event_type_t type, double num)
+{
+    json_event_t ev;
+    ev.type = type;
+    ev.depth = jp->depth;
+    bool text = (type == JSON_EVENT_KEY || type == JSON_EVENT_STRING);
+    ev.str = text ? jp->token : NULL;
+    ev.len = text ? jp->token_len : 0;
+    ev.num = num;
+    ev.integer = 0;
+    ev.is_integer = false;
+    return jp->fn(&ev, jp->user);
+}
+
+/*
+ * A value has been completed: the document ends with the root, anything
+ * else is followed by a comma or the end of its container
+ */
+static void push_value_done(json_push_t *jp)
+{
+    jp->state = jp->depth == 0 ? PUSH_DONE : PUSH_NEXT;
+}
+
+/*
+ * Add string bytes to the token, dropping what does not fit
+ */
+static void push_append(json_push_t *jp, const char *s, size_t len)
+{
+    size_t room = JSON_PUSH_TOKEN_MAX - jp->token_len;
+    if (len > room) {
+        len = room;
+        jp->truncated = true;
+    }
+    memcpy(jp->token + jp->token_len, s, len);
+    jp->token_len += len;
+}
+
+/*
+ * Find the first quote or backslash in s..end, or end
+ */
+static const char *push_string_run(const char *s, const char *end)
+{
+#if JSON_SIMD_SCAN
+    while (end - s >= JSON_SCAN_BLOCK) {
+        uint32_t mask = scan_block(s);
+        if (mask) {
+            s += __builtin_ctz(mask);
+            break;
+        }
+        s += JSON_SCAN_BLOCK;
+    }
+#if defined(JSON_SCAN_MMX)
+    _mm_empty();
+#endif
+#endif
+    while (s < end && *s != '"' && *s != '\\') {
+        s++;
+    }
+    return s;
+}
+
+/*
+ * The closing quote has arrived: decode the token and report it. A cut
+ * string also loses any character its last bytes only began.
+ */
+static int push_string_done(json_push_t *jp)
+{
+    char *end = jp->token + jp->token_len;
+    if (jp->has_escape) {
+        end = decode_escapes(jp->token, end, jp->token);
+    }
+    if (jp->truncated) {
+        char *lead = end;
+        while (lead > jp->token && ((unsigned char)lead[-1] & 0xC0) == 0x80 &&
+               end - lead < 3) {
+            lead--;
+        }
+        if (lead > jp->token && ((unsigned char)lead[-1] & 0x80)) {
+            unsigned char c = (unsigned char)lead[-1];
+            int need = c >= 0xF0 ? 4 : c >= 0xE0 ? 3 : c >= 0xC0 ? 2 : 1;
+            if (end - lead + 1 < need) end = lead - 1;
+        }
+    }
+    *end = '\0';
+    jp->token_len = end - jp->token;
+
+    if (jp->is_key) {
+        jp->state = PUSH_COLON;
+        return push_emit(jp, JSON_EVENT_KEY, 0);
+    }
+    push_value_done(jp);
+    return push_emit(jp, JSON_EVENT_STRING, 0);
+}
+
+/*
+ * The number has ended at a delimiter: convert and report it
+ */
+static int push_number_done(json_push_t *jp)
+{
+    json_number_t num;
+    jp->token[jp->token_len] = '\0';
+    const char *end = json_number_scan(jp->token, &num);
+    if (jp->token_len == 0 || end != jp->token + jp->token_len) {
+        return -1;
+    }
+    push_value_done(jp);
+
+    json_event_t ev;
+    ev.type = JSON_EVENT_NUMBER;
+    ev.depth = jp->depth;
+    ev.str = NULL;
+    ev.len = 0;
+    ev.num = num.real;
+    ev.integer = num.integer;
+    ev.is_integer = num.is_integer;
+    return jp->fn(&ev, jp->user);
+}
+
+/*
+ * Open a container
+ */
+static int push_open(json_push_t *jp, char c)
+{
+    if (jp->depth == JSON_MAX_DEPTH) {
+        return -1;
+    }
+    jp->token_len = 0;
+    int result = push_emit(jp, c == '{' ? JSON_EVENT_OBJECT_START : JSON_EVENT_ARRAY_START, 0);
+    jp->open[jp->depth++] = c;
+    jp->state = c == '{' ? PUSH_FIRST_KEY : PUSH_FIRST_VALUE;
+    return result;
+}
+
+/*
+ * Close the innermost container, which must be the kind c closes
+ */
+static int push_close(json_push_t *jp, char c)
+{
+    if (jp->depth == 0 || jp->open[jp->depth - 1] != (c == '}' ? '{' : '[')) {
+        return -1;
+    }
+    jp->depth--;
+    jp->token_len = 0;
+    push_value_done(jp);
+    return push_emit(jp, c == '}' ? JSON_EVENT_OBJECT_END : JSON_EVENT_ARRAY_END, 0);
+}
+
+/*
+ * Start on the first byte of a value
+ */
+static int push_value_start(json_push_t *jp, char c)
+{
+    jp->token_len = 0;
+    switch (c) {
+        case '{':
+        case '[':
+            return push_open(jp, c);
+        case '"':
+            jp->state = PUSH_STRING;
+            jp->is_key = false;
+            jp->escaped = jp->has_escape = jp->truncated = false;
+            return 0;
+        case 't': jp->literal = "rue"; break;
+        case 'f': jp->literal = "alse"; break;
+        case 'n': jp->literal = "ull"; break;
+        default:
+            if (c != '-' && (c < '0' || c > '9')) {
+                return -1;
+            }
+            jp->state = PUSH_NUMBER;
+            jp->token[jp->token_len++] = c;
+            return 0;
+    }
+    jp->state = PUSH_LITERAL;
+    jp->token[jp->token_len++] = c;
+    return 0;
+}
+
+/*
+ * Run a chunk through the state machine
+ */
+static int push_run(json_push_t *jp, const char *s, const char *end)
+{
+    while (s < end) {
+        char c = *s;
+
+        switch (jp->state) {
+            case PUSH_STRING: {
+                if (jp->escaped) {
+                    push_append(jp, s++, 1);
+                    jp->escaped = false;
+                    break;
+                }
+                const char *run = push_string_run(s, end);
+                push_append(jp, s, run - s);
+                s = run;
+                if (s == end) break;
+                if (*s == '\\') {
+                    push_append(jp, s++, 1);
+                    jp->escaped = jp->has_escape = true;
+                    break;
+                }
+                s++;
+                if (push_string_done(jp) < 0) return -1;
+                break;
+            }
+
+            case PUSH_NUMBER:
+                while ((c >= '0' && c <= '9') || c == '.' || c == '-' || c == '+' ||
+                       c == 'e' || c == 'E') {
+                    if (jp->token_len == JSON_PUSH_NUMBER_MAX) return -1;
+                    jp->token[jp->token_len++] = c;
+                    if (++s == end) return 0;
+                    c = *s;
+                }
+                /* The delimiter is looked at again in the new state */
+                if (push_number_done(jp) < 0) return -1;
+                break;
+
+            case PUSH_LITERAL:
+                if (c != *jp->literal) return -1;
+                jp->token[jp->token_len++] = c;
+                jp->literal++;
+                s++;
+                if (!*jp->literal) {
+                    jp->token[jp->token_len] = '\0';
+                    push_value_done(jp);
+                    int result = jp->token[0] == 'n'
+                                 ? push_emit(jp, JSON_EVENT_NULL, 0)
+                                 : push_emit(jp, JSON_EVENT_BOOL, jp->token[0] == 't');
+                    if (result < 0) return -1;
+                }
+                break;
+
+            case PUSH_DONE:
+                return 0;   /* Whatever follows the document is ignored */
+
+            default:
+                s++;
+                if (c == ' ' || c == '\n' || c == '\r' || c == '\t') {
+                    break;
+                }
+                if (jp->state == PUSH_COLON) {
+                    if (c != ':') return -1;
+                    jp->state = PUSH_VALUE;
+                } else if (jp->state == PUSH_NEXT) {
+                    if (c == ',') {
+                        jp->state = jp->open[jp->depth - 1] == '{' ? PUSH_KEY : PUSH_VALUE;
+                    } else if (push_close(jp, c) < 0) {
+                        return -1;
+                    }
+                } else if ((c == '}' && jp->state == PUSH_FIRST_KEY) ||
+                           (c == ']' && jp->state == PUSH_FIRST_VALUE)) {
+                    if (push_close(jp, c) < 0) return -1;
+                } else if (jp->state == PUSH_FIRST_KEY || jp->state == PUSH_KEY) {
+                    if (c != '"') return -1;
+                    jp->state = PUSH_STRING;
+                    jp->is_key = true;
+                    jp->token_len = 0;
+                    jp->escaped = jp->has_escape = jp->truncated = false;
+                } else if (push_value_start(jp, c) < 0) {
+                    return -1;
+                }
+                break;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Start an incremental parse that reports to fn. Returns NULL when
+ * memory runs out.
+ */
+json_push_t *json_push_create(json_event_fn fn, void *user)
+{
+    if (!fn) return NULL;
+
+    json_push_t *jp = (json_push_t *)core_malloc(sizeof(json_push_t));
+    if (!jp) return NULL;
+
+    memset(jp, 0, offsetof(json_push_t, token));
+    jp->state = PUSH_VALUE;
+    jp->fn = fn;
+    jp->user = user;
+    return jp;
+}
+
+/*
+ * Parse the next chunk of text. Events for everything the chunk
+ * completes are reported before this returns. Returns 0 while more text
+ * is expected, 1 once the document is complete and -1 on malformed text
+ * or when the callback stopped the parse; after -1, every later call
+ * fails too. A number that is the whole document is only reported once
+ * something follows it.
+ */
+int json_push_feed(json_push_t *jp, const void *data, size_t len)
+{
+    if (jp->state == PUSH_ERROR) return -1;
+
+    const char *s = (const char *)data;
+    if (push_run(jp, s, s + len) < 0) {
+        jp->state = PUSH_ERROR;
+        return -1;
+    }
+    return jp->state == PUSH_DONE ? 1 : 0;
+}
+
+/*
+ * True once the root value has been completed
+ */
+bool json_push_done(const json_push_t *jp)
+{
+    return jp->state == PUSH_DONE;
+}
+
+/* Free a parser */
+void json_push_destroy(json_push_t *jp)
+{
+    core_free(jp);
+}
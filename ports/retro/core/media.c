@@ -0,0 +1,55 @@
+/*
+ * Nedflix retro ports - shared core
+ * Listing items
+ *
+ * Browse and search results carry the same item object on every port;
+ * only the array it sits in ("files", "items", "results") and which
+ * fields a port keeps differ. Each port decodes items straight into its
+ * own media_item_t with a schema (schema.c) and settles the type here.
+ */
+
+#include "core.h"
+#include <string.h>
+
+/*
+ * Guess the media type from a file extension
+ */
+media_type_t media_type_from_name(const char *name)
+{
+    const char *ext = strrchr(name ? name : "", '.');
+    if (!ext || !ext[1]) {
+        return MEDIA_TYPE_UNKNOWN;
+    }
+    if (strstr(".mp3.m4a.flac.wav.aac.ogg.wma.opus", ext)) {
+        return MEDIA_TYPE_AUDIO;
+    }
+    if (strstr(".mp4.mkv.avi.mov.webm.m4v.flv.wmv", ext)) {
+        return MEDIA_TYPE_VIDEO;
+    }
+    return MEDIA_TYPE_UNKNOWN;
+}
+
+/*
+ * Settle an item's type from its hints, most specific first:
+ * isDirectory, the "type" string, then the isVideo/isAudio flags;
+ * without any of them the extension of name decides.
+ */
+media_type_t media_hints_type(const media_hints_t *hints, const char *name)
+{
+    if (hints->is_directory || strcmp(hints->type, "directory") == 0) {
+        return MEDIA_TYPE_DIRECTORY;
+    }
+    if (strcmp(hints->type, "video") == 0) {
+        return MEDIA_TYPE_VIDEO;
+    }
+    if (strcmp(hints->type, "audio") == 0) {
+        return MEDIA_TYPE_AUDIO;
+    }
+    if (hints->is_video) {
+        return MEDIA_TYPE_VIDEO;
+    }
+    if (hints->is_audio) {
+        return MEDIA_TYPE_AUDIO;
+    }
+    return media_type_from_name(name);
+}
@@ -0,0 +1,403 @@
+/*
+ * Nedflix retro ports - shared core
+ * MessagePack reader
+ *
+ * The ports ask for MessagePack ahead of JSON (HTTP_ACCEPT_HEADER), so a
+ * server that has it can answer browse, search and info requests with
+ * the same maps and arrays as the JSON, with lengths up front instead of
+ * quotes and escapes, and numbers in binary. One that does not sends JSON
+ * as before. This reads it the way json_push_t
+ * reads JSON, in chunks split anywhere, and reports the same events, so
+ * the schema decoders take either without knowing which arrived.
+ *
+ * Nothing is copied that does not have to be: a string that lies whole
+ * within the chunk being fed is reported where it lies, and only one
+ * split across chunks is gathered into the token buffer. Strings are
+ * therefore not NUL-terminated; use ev->len.
+ */
+
+#include "core.h"
+#include <string.h>
+#include <float.h>
+#if DBL_MANT_DIG < 53
+#include <math.h>
+#endif
+
+/* Deepest nesting accepted, as for JSON */
+#define MSGPACK_MAX_DEPTH 64
+
+typedef enum {
+    MSGPACK_HEADER,         /* Type byte and its length or value */
+    MSGPACK_PAYLOAD,        /* String bytes */
+    MSGPACK_DONE,
+    MSGPACK_ERROR
+} msgpack_state_t;
+
+typedef struct {
+    uint32_t remaining;     /* Elements still to come; keys and values for a map */
+    bool map;
+} msgpack_frame_t;
+
+struct msgpack_push {
+    msgpack_state_t state;
+    json_event_fn fn;
+    void *user;
+    msgpack_frame_t frames[MSGPACK_MAX_DEPTH];
+    int depth;
+    uint8_t head[9];        /* Type byte and up to 8 bytes after it */
+    int head_len;
+    int head_need;
+    uint32_t payload;       /* String bytes still to come */
+    uint32_t string_len;    /* Length of the whole string */
+    size_t token_len;
+    char token[JSON_PUSH_TOKEN_MAX];
+};
+
+/*
+ * True if a response starting with this byte is MessagePack rather than
+ * JSON: every API response is a map or an array, and neither of those
+ * can start a JSON document.
+ */
+bool msgpack_sniff(uint8_t first)
+{
+    return (first >= 0x80 && first <= 0x9f) || (first >= 0xdc && first <= 0xdf);
+}
+
+msgpack_push_t *msgpack_push_create(json_event_fn fn, void *user)
+{
+    msgpack_push_t *mp = (msgpack_push_t *)core_calloc(1, sizeof(msgpack_push_t));
+    if (!mp) return NULL;
+    mp->fn = fn;
+    mp->user = user;
+    mp->state = MSGPACK_HEADER;
+    return mp;
+}
+
+static uint64_t read_be(const uint8_t *p, int n)
+{
+    uint64_t v = 0;
+    for (int i = 0; i < n; i++) {
+        v = (v << 8) | p[i];
+    }
+    return v;
+}
+
+/*
+ * A float64 as a double. Where double is single precision (Dreamcast
+ * toolchains built for -m4-single-only) the bits are rebuilt by hand.
+ */
+static double read_float64(const uint8_t *p)
+{
+    uint64_t bits = read_be(p, 8);
+#if DBL_MANT_DIG >= 53
+    double d;
+    memcpy(&d, &bits, sizeof(d));
+    return d;
+#else
+    int exp = (int)((bits >> 52) & 0x7ff);
+    uint64_t frac = bits & ((1ull << 52) - 1);
+    double d;
+    if (exp == 0x7ff) {
+        d = frac ? 0.0 : HUGE_VAL;      /* NaN is stored as 0 anyway */
+    } else if (exp == 0) {
+        d = ldexp((double)frac, -1074);
+    } else {
+        d = ldexp((double)(frac | (1ull << 52)), exp - 1075);
+    }
+    return (bits >> 63) ? -d : d;
+#endif
+}
+
+static double read_float32(const uint8_t *p)
+{
+    uint32_t bits = (uint32_t)read_be(p, 4);
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+/*
+ * Report one event at the current depth
+ */
+static int emit(msgpack_push_t *mp, json_event_type_t type, const char *str, size_t len,
+                double num, int64_t integer, bool is_integer)
+{
+    json_event_t ev;
+    ev.type = type;
+    ev.depth = mp->depth;
+    ev.str = str;
+    ev.len = len;
+    ev.num = num;
+    ev.integer = integer;
+    ev.is_integer = is_integer;
+    return mp->fn(&ev, mp->user);
+}
+
+/* True if the next element of the innermost container is a map key */
+static bool at_key(const msgpack_push_t *mp)
+{
+    const msgpack_frame_t *f = mp->depth ? &mp->frames[mp->depth - 1] : NULL;
+    return f && f->map && (f->remaining & 1) == 0;
+}
+
+/*
+ * An element is complete: count it off its container, closing every
+ * container that it finishes. The document ends with the root.
+ */
+static int element_done(msgpack_push_t *mp)
+{
+    while (mp->depth > 0) {
+        msgpack_frame_t *f = &mp->frames[mp->depth - 1];
+        if (--f->remaining > 0) {
+            mp->state = MSGPACK_HEADER;
+            return 0;
+        }
+        mp->depth--;
+        if (emit(mp, f->map ? JSON_EVENT_OBJECT_END : JSON_EVENT_ARRAY_END,
+                 NULL, 0, 0, 0, false) < 0) {
+            return -1;
+        }
+    }
+    mp->state = MSGPACK_DONE;
+    return 0;
+}
+
+/*
+ * Open an array or map of count elements
+ */
+static int open_container(msgpack_push_t *mp, bool map, uint32_t count)
+{
+    if (mp->depth == MSGPACK_MAX_DEPTH || (map && count > UINT32_MAX / 2)) {
+        return -1;
+    }
+    if (emit(mp, map ? JSON_EVENT_OBJECT_START : JSON_EVENT_ARRAY_START,
+             NULL, 0, 0, 0, false) < 0) {
+        return -1;
+    }
+    if (count == 0) {
+        if (emit(mp, map ? JSON_EVENT_OBJECT_END : JSON_EVENT_ARRAY_END,
+                 NULL, 0, 0, 0, false) < 0) {
+            return -1;
+        }
+        return element_done(mp);
+    }
+    mp->frames[mp->depth].remaining = map ? count * 2 : count;
+    mp->frames[mp->depth].map = map;
+    mp->depth++;
+    mp->state = MSGPACK_HEADER;
+    return 0;
+}
+
+/*
+ * A string is complete, from wherever it was read
+ */
+static int string_done(msgpack_push_t *mp, const char *str, size_t len)
+{
+    json_event_type_t type = at_key(mp) ? JSON_EVENT_KEY : JSON_EVENT_STRING;
+    if (emit(mp, type, str, len, 0, 0, false) < 0) {
+        return -1;
+    }
+    return element_done(mp);
+}
+
+/*
+ * Bytes that follow each type byte from 0xc0 up before its payload; -1
+ * for types the server never sends (extensions and the unused 0xc1).
+ * Everything below 0xc0, and the negative fixints, is the byte alone.
+ */
+static const int8_t g_header_extra[32] = {
+    0, -1, 0, 0, 1, 2, 4, -1, -1, -1, 4, 8, 1, 2, 4, 8,    /* 0xc0 */
+    1, 2, 4, 8, -1, -1, -1, -1, -1, 1, 2, 4, 2, 4, 2, 4    /* 0xd0 */
+};
+
+static int header_size(uint8_t t)
+{
+    if (t < 0xc0 || t >= 0xe0) return 1;
+    int extra = g_header_extra[t - 0xc0];
+    return extra < 0 ? -1 : 1 + extra;
+}
+
+/*
+ * A header is complete: report a scalar, open a container, or start on
+ * a string's payload
+ */
+static int header_done(msgpack_push_t *mp, const uint8_t *h, int size)
+{
+    uint8_t t = h[0];
+    uint64_t n = read_be(h + 1, size - 1);
+
+    if (at_key(mp) && !((t >= 0xa0 && t <= 0xbf) || (t >= 0xd9 && t <= 0xdb))) {
+        return -1;      /* JSON has only string keys, and so do the schemas */
+    }
+
+    if (t <= 0x7f) {
+        return emit(mp, JSON_EVENT_NUMBER, NULL, 0, t, t, true) < 0 ? -1 : element_done(mp);
+    }
+    if (t >= 0xe0) {
+        int64_t v = (int8_t)t;
+        return emit(mp, JSON_EVENT_NUMBER, NULL, 0, (double)v, v, true) < 0 ? -1 : element_done(mp);
+    }
+    if (t <= 0x8f) return open_container(mp, true, t & 0x0f);
+    if (t <= 0x9f) return open_container(mp, false, t & 0x0f);
+
+    uint32_t len;
+    if (t <= 0xbf) {
+        len = t & 0x1f;
+    } else if (t == 0xc4 || t == 0xc5 || t == 0xc6 || t == 0xd9 || t == 0xda || t == 0xdb) {
+        len = (uint32_t)n;      /* bin is read as a string */
+    } else {
+        int result;
+        switch (t) {
+            case 0xc0:
+                result = emit(mp, JSON_EVENT_NULL, NULL, 0, 0, 0, false);
+                break;
+            case 0xc2:
+            case 0xc3:
+                result = emit(mp, JSON_EVENT_BOOL, NULL, 0, t == 0xc3, 0, false);
+                break;
+            case 0xca:
+                result = emit(mp, JSON_EVENT_NUMBER, NULL, 0, read_float32(h + 1), 0, false);
+                break;
+            case 0xcb:
+                result = emit(mp, JSON_EVENT_NUMBER, NULL, 0, read_float64(h + 1), 0, false);
+                break;
+            case 0xcc: case 0xcd: case 0xce: case 0xcf:
+                result = emit(mp, JSON_EVENT_NUMBER, NULL, 0, (double)n,
+                              n <= (uint64_t)INT64_MAX ? (int64_t)n : 0,
+                              n <= (uint64_t)INT64_MAX);
+                break;
+            case 0xd0: case 0xd1: case 0xd2: case 0xd3: {
+                /* Sign-extend from the width read */
+                int bits = (size - 1) * 8;
+                int64_t v = bits == 64 ? (int64_t)n
+                                       : (int64_t)(n ^ (1ull << (bits - 1))) - (int64_t)(1ull << (bits - 1));
+                result = emit(mp, JSON_EVENT_NUMBER, NULL, 0, (double)v, v, true);
+                break;
+            }
+            case 0xdc: case 0xdd:
+                return open_container(mp, false, (uint32_t)n);
+            case 0xde: case 0xdf:
+                return open_container(mp, true, (uint32_t)n);
+            default:
+                return -1;
+        }
+        return result < 0 ? -1 : element_done(mp);
+    }
+
+    if (len == 0) {
+        return string_done(mp, "", 0);
+    }
+    mp->payload = len;
+    mp->string_len = len;
+    mp->token_len = 0;
+    mp->state = MSGPACK_PAYLOAD;
+    return 0;
+}
+
+/*
+ * Keep what fits of a split string; the cut is moved back off any
+ * partial UTF-8 sequence once the string is complete
+ */
+static void token_append(msgpack_push_t *mp, const uint8_t *s, size_t n)
+{
+    size_t room = sizeof(mp->token) - mp->token_len;
+    if (n > room) n = room;
+    memcpy(mp->token + mp->token_len, s, n);
+    mp->token_len += n;
+}
+
+static size_t utf8_trim(const char *s, size_t len, size_t full)
+{
+    if (len == full) return len;
+    size_t cut = len;
+    while (cut > 0 && ((uint8_t)s[cut - 1] & 0xc0) == 0x80) cut--;
+    if (cut > 0 && (uint8_t)s[cut - 1] >= 0xc0) {
+        /* A lead byte whose sequence was cut off goes too */
+        uint8_t lead = (uint8_t)s[cut - 1];
+        size_t want = lead >= 0xf0 ? 4 : lead >= 0xe0 ? 3 : 2;
+        if (len - (cut - 1) < want) return cut - 1;
+    }
+    return len;
+}
+
+/*
+ * Read the next chunk. Returns 1 once the document is complete, 0 while
+ * more is expected, -1 if it is malformed or the callback stopped it.
+ */
+int msgpack_push_feed(msgpack_push_t *mp, const void *data, size_t len)
+{
+    const uint8_t *s = (const uint8_t *)data;
+    const uint8_t *end = s + len;
+
+    if (mp->state == MSGPACK_ERROR) return -1;
+
+    while (s < end) {
+        switch (mp->state) {
+            case MSGPACK_HEADER: {
+                const uint8_t *h;
+                if (mp->head_len == 0) {
+                    mp->head_need = header_size(*s);
+                    if (mp->head_need < 0) goto fail;
+                }
+                if (mp->head_len == 0 && end - s >= mp->head_need) {
+                    /* Whole in this chunk: read it in place */
+                    h = s;
+                    s += mp->head_need;
+                } else {
+                    while (s < end && mp->head_len < mp->head_need) {
+                        mp->head[mp->head_len++] = *s++;
+                    }
+                    if (mp->head_len < mp->head_need) break;
+                    h = mp->head;
+                    mp->head_len = 0;
+                }
+                if (header_done(mp, h, mp->head_need) < 0) goto fail;
+                break;
+            }
+
+            case MSGPACK_PAYLOAD: {
+                size_t avail = (size_t)(end - s);
+                if (mp->token_len == 0 && avail >= mp->payload) {
+                    /* Whole in this chunk: report it in place */
+                    uint32_t n = mp->payload;
+                    s += n;
+                    if (string_done(mp, (const char *)s - n, n) < 0) goto fail;
+                    break;
+                }
+                size_t n = avail < mp->payload ? avail : mp->payload;
+                token_append(mp, s, n);
+                s += n;
+                mp->payload -= (uint32_t)n;
+                if (mp->payload == 0) {
+                    size_t kept = utf8_trim(mp->token, mp->token_len, mp->string_len);
+                    if (string_done(mp, mp->token, kept) < 0) goto fail;
+                }
+                break;
+            }
+
+            case MSGPACK_DONE:
+                return 1;   /* Whatever follows the document is ignored, as for JSON */
+
+            case MSGPACK_ERROR:
+                goto fail;
+        }
+    }
+    return mp->state == MSGPACK_DONE ? 1 : 0;
+
+fail:
+    mp->state = MSGPACK_ERROR;
+    return -1;
+}
+
+/*
+ * True once a whole document has been read
+ */
+bool msgpack_push_done(const msgpack_push_t *mp)
+{
+    return mp->state == MSGPACK_DONE;
+}
+
+void msgpack_push_destroy(msgpack_push_t *mp)
+{
+    core_free(mp);
+}
@@ -0,0 +1,345 @@
+/*
+ * Nedflix retro ports - shared core
+ * HTTP capture and replay
+ *
+ * Capturing appends every request the HTTP layer completes to a file:
+ * method and target, status, validators, the phases netstats.c timed
+ * and the decoded body. Replaying loads such a file and answers requests
+ * from memory instead of the network, taking as long as the original
+ * exchange did divided by a speed factor (speed 0 answers at once). The
+ * API, the JSON parser and the UI then see the same responses on every
+ * run, with or without a server.
+ *
+ * One record per exchange:
+ *
+ *   GET /api/browse?path=%2F 200 14840 12 340 95 5781 119 14651
+ *   ETag: "1f-abc"
+ *   Last-Modified: Wed, 21 Oct 2015 07:28:00 GMT
+ *
+ *   <body bytes>
+ *
+ * After the status come the bytes received, the DNS, connect, send,
+ * TTFB and transfer microseconds, and the body length. The validator
+ * lines appear only when the response had them; a status of -1 records
+ * a request that failed. Requests are matched on method and target, the
+ * host is ignored, and recordings of the same target are handed out in
+ * turn.
+ */
+
+#include "core.h"
+#include <stdio.h>
+#include <string.h>
+
+#define REPLAY_KEY_MAX  576     /* Method, space and target */
+
+/* One loaded exchange; the key and body point into the loaded file */
+typedef struct {
+    uint32_t hash;
+    const char *key;
+    uint32_t uses;
+    netreplay_exchange_t x;
+} replay_entry_t;
+
+static struct {
+    FILE *out;                  /* Capturing */
+    char *file;                 /* Replaying */
+    replay_entry_t *entries;
+    int count;
+    uint32_t speed;
+} g_replay;
+
+/*
+ * "METHOD /target?query" from a method and a URL or request target.
+ * Either may run on past a space, as in a request line.
+ */
+static int make_key(const char *method, const char *url, char *key, size_t size)
+{
+    const char *target = strstr(url, "://");
+    target = target ? strchr(target + 3, '/') : url;
+    if (!target) target = "/";
+
+    size_t method_len = strcspn(method, " ");
+    size_t target_len = strcspn(target, " #");
+    if (method_len + 1 + target_len >= size) return -1;
+
+    memcpy(key, method, method_len);
+    key[method_len] = ' ';
+    memcpy(key + method_len + 1, target, target_len);
+    key[method_len + 1 + target_len] = '\0';
+    return 0;
+}
+
+static uint32_t key_hash(const char *key)
+{
+    uint32_t h = 2166136261u;
+    while (*key) {
+        h = (h ^ (uint8_t)*key++) * 16777619u;
+    }
+    return h;
+}
+
+/*
+ * Start appending exchanges to path, replacing what it held
+ */
+int netreplay_capture(const char *path)
+{
+    netreplay_stop();
+
+    g_replay.out = fopen(path, "wb");
+    if (!g_replay.out) {
+        CORE_LOG_ERROR("Cannot write %s", path);
+        return -1;
+    }
+    CORE_LOG("Capturing HTTP to %s", path);
+    return 0;
+}
+
+/*
+ * Split the next line off a loaded file; NULL at the end
+ */
+static char *next_line(char **p, char *end)
+{
+    char *line = *p;
+    char *nl = memchr(line, '\n', end - line);
+    if (!nl) return NULL;
+    *nl = '\0';
+    *p = nl + 1;
+    return line;
+}
+
+/*
+ * Load a capture and answer requests from it from now on
+ */
+int netreplay_replay(const char *path, uint32_t speed)
+{
+    netreplay_stop();
+
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        CORE_LOG_ERROR("Cannot read %s", path);
+        return -1;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    g_replay.file = (size >= 0) ? core_malloc(size + 1) : NULL;
+    if (!g_replay.file || fread(g_replay.file, 1, size, f) != (size_t)size) {
+        fclose(f);
+        netreplay_stop();
+        return -1;
+    }
+    fclose(f);
+
+    char *p = g_replay.file;
+    char *end = p + size;
+    int cap = 0;
+    char *line;
+
+    while ((line = next_line(&p, end)) != NULL) {
+        /* The key is the first two fields */
+        char *space = strchr(line, ' ');
+        char *fields = space ? strchr(space + 1, ' ') : NULL;
+        if (!fields) break;
+        *fields++ = '\0';
+
+        netreplay_exchange_t x;
+        memset(&x, 0, sizeof(x));
+        unsigned long bytes, phase[NET_PHASE_PARSE], body_len;
+        if (sscanf(fields, "%d %lu %lu %lu %lu %lu %lu %lu", &x.status, &bytes,
+                   &phase[0], &phase[1], &phase[2], &phase[3], &phase[4], &body_len) != 8) {
+            break;
+        }
+        x.bytes = bytes;
+        for (int i = 0; i < NET_PHASE_PARSE; i++) {
+            x.phase_us[i] = phase[i];
+        }
+
+        char *header;
+        while ((header = next_line(&p, end)) != NULL && header[0] != '\0') {
+            if (strncmp(header, "ETag: ", 6) == 0) {
+                strncpy(x.validators.etag, header + 6, HTTP_ETAG_MAX - 1);
+            } else if (strncmp(header, "Last-Modified: ", 15) == 0) {
+                strncpy(x.validators.last_modified, header + 15, HTTP_DATE_MAX - 1);
+            }
+        }
+        if (!header || body_len >= (size_t)(end - p)) break;
+
+        /* The newline after the body becomes its terminator */
+        x.body = p;
+        x.body_len = body_len;
+        p[body_len] = '\0';
+        p += body_len + 1;
+
+        if (g_replay.count == cap) {
+            int grown = cap ? cap * 2 : 64;
+            replay_entry_t *entries = core_realloc(g_replay.entries, grown * sizeof(*entries));
+            if (!entries) break;
+            g_replay.entries = entries;
+            cap = grown;
+        }
+        replay_entry_t *e = &g_replay.entries[g_replay.count++];
+        e->key = line;
+        e->hash = key_hash(line);
+        e->uses = 0;
+        e->x = x;
+    }
+
+    if (g_replay.count == 0) {
+        CORE_LOG_ERROR("No exchanges in %s", path);
+        netreplay_stop();
+        return -1;
+    }
+
+    g_replay.speed = speed;
+    CORE_LOG("Replaying %d HTTP exchanges from %s", g_replay.count, path);
+    return 0;
+}
+
+/*
+ * Back to the network
+ */
+void netreplay_stop(void)
+{
+    if (g_replay.out) {
+        fclose(g_replay.out);
+    }
+    core_free(g_replay.entries);
+    core_free(g_replay.file);
+    memset(&g_replay, 0, sizeof(g_replay));
+}
+
+bool netreplay_capturing(void)
+{
+    return g_replay.out != NULL;
+}
+
+bool netreplay_replaying(void)
+{
+    return g_replay.file != NULL;
+}
+
+/*
+ * Append one finished exchange to the capture. Call it after
+ * netstats_record(), which closes the last phase of the timing.
+ */
+void netreplay_record(const char *method, const char *url, int status,
+                      const http_validators_t *validators, const net_timing_t *timing,
+                      const char *body, size_t body_len)
+{
+    char key[REPLAY_KEY_MAX];
+
+    if (!g_replay.out || make_key(method, url, key, sizeof(key)) < 0) return;
+    if (status < 0 || !body) body_len = 0;
+
+    fprintf(g_replay.out, "%s %d %lu", key, status < 0 ? -1 : status,
+            (unsigned long)timing->bytes);
+    for (int i = 0; i < NET_PHASE_PARSE; i++) {
+        fprintf(g_replay.out, " %lu", (unsigned long)timing->phase_us[i]);
+    }
+    fprintf(g_replay.out, " %lu\n", (unsigned long)body_len);
+
+    if (status >= 0 && validators) {
+        if (validators->etag[0]) {
+            fprintf(g_replay.out, "ETag: %s\n", validators->etag);
+        }
+        if (validators->last_modified[0]) {
+            fprintf(g_replay.out, "Last-Modified: %s\n", validators->last_modified);
+        }
+    }
+    fputc('\n', g_replay.out);
+    fwrite(body, 1, body_len, g_replay.out);
+    fputc('\n', g_replay.out);
+    fflush(g_replay.out);
+}
+
+/*
+ * The recorded answer to a request, or NULL if the capture has none.
+ * Of several recordings for one target, the least used is returned.
+ */
+const netreplay_exchange_t *netreplay_lookup(const char *method, const char *url)
+{
+    char key[REPLAY_KEY_MAX];
+
+    if (!g_replay.file || make_key(method, url, key, sizeof(key)) < 0) return NULL;
+
+    uint32_t hash = key_hash(key);
+    replay_entry_t *best = NULL;
+    for (int i = 0; i < g_replay.count; i++) {
+        replay_entry_t *e = &g_replay.entries[i];
+        if (e->hash == hash && (!best || e->uses < best->uses) && strcmp(e->key, key) == 0) {
+            best = e;
+        }
+    }
+
+    if (!best) {
+        CORE_LOG_ERROR("Not in the capture: %s", key);
+        return NULL;
+    }
+    best->uses++;
+    return &best->x;
+}
+
+/*
+ * How long the exchange should take at the replay speed
+ */
+uint32_t netreplay_delay_us(const netreplay_exchange_t *x)
+{
+    if (g_replay.speed == 0) return 0;
+
+    uint32_t total = 0;
+    for (int i = 0; i < NET_PHASE_PARSE; i++) {
+        total += x->phase_us[i];
+    }
+    return total / g_replay.speed;
+}
+
+/*
+ * Block for as long as the exchange should take
+ */
+void netreplay_wait(const netreplay_exchange_t *x)
+{
+    core_sleep_us(netreplay_delay_us(x));
+}
+
+/*
+ * Timing for netstats_record() that repeats the recorded phases
+ */
+void netreplay_timing(const netreplay_exchange_t *x, net_timing_t *t)
+{
+    netstats_start(t);
+    for (int i = 0; i < NET_PHASE_PARSE; i++) {
+        t->phase_us[i] = x->phase_us[i];
+    }
+    t->bytes = x->bytes;
+    t->responded = true;
+}
+
+/*
+ * The recorded answer to a blocking request, once it has taken as long
+ * as the replay speed says, with its timing recorded against url. NULL
+ * if the capture has none or the request failed when it was captured.
+ */
+const netreplay_exchange_t *netreplay_answer(const char *method, const char *url)
+{
+    const netreplay_exchange_t *x = netreplay_lookup(method, url);
+    if (!x) return NULL;
+    netreplay_wait(x);
+
+    net_timing_t timing;
+    netreplay_timing(x, &timing);
+    netstats_record(url, &timing, x->status >= 0);
+    return (x->status >= 0) ? x : NULL;
+}
+
+/*
+ * A heap copy of a recorded body, NUL-terminated like the original
+ */
+char *netreplay_body_copy(const netreplay_exchange_t *x)
+{
+    char *copy = (char *)core_malloc(x->body_len + 1);
+    if (copy) {
+        memcpy(copy, x->body, x->body_len + 1);
+    }
+    return copy;
+}
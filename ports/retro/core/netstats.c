@@ -0,0 +1,240 @@
+/*
+ * Nedflix retro ports - shared core
+ * Per-request network timing
+ *
+ * Every HTTP request is split into DNS, connect, send, time to first byte
+ * and transfer, and api.c adds the time spent parsing what came back.
+ * Requests are totalled per endpoint along with a histogram of their
+ * overall time, which is what the debug overlay shows and netstats_dump()
+ * writes out. A slow listing can then be put down to the server (TTFB),
+ * the link (transfer) or the client (parse).
+ */
+
+#include "core.h"
+#include <stdio.h>
+#include <string.h>
+
+static netstats_endpoint_t g_endpoints[NETSTATS_MAX_ENDPOINTS];
+static int g_endpoint_count;
+static core_lock_t g_lock = CORE_LOCK_INIT;   /* Requests may finish on any thread */
+
+static const char *const g_phase_names[NET_PHASE_COUNT] = {
+    "dns", "connect", "send", "ttfb", "transfer", "parse"
+};
+
+uint64_t netstats_now_us(void)
+{
+    return core_now_us();
+}
+
+/*
+ * Begin timing a request; the first phase runs from here
+ */
+void netstats_start(net_timing_t *t)
+{
+    memset(t, 0, sizeof(*t));
+    t->mark = netstats_now_us();
+}
+
+/*
+ * Charge the time since the last boundary to phase
+ */
+void netstats_phase(net_timing_t *t, net_phase_t phase)
+{
+    uint64_t now = netstats_now_us();
+    t->phase_us[phase] += (uint32_t)(now - t->mark);
+    t->mark = now;
+}
+
+/*
+ * The first response bytes are in; only the first call counts
+ */
+void netstats_first_byte(net_timing_t *t)
+{
+    if (!t->responded) {
+        t->responded = true;
+        netstats_phase(t, NET_PHASE_TTFB);
+    }
+}
+
+/*
+ * Endpoint for a URL, or a request target: its path without the query
+ * string. Paths beyond NETSTATS_MAX_ENDPOINTS are totalled in the last
+ * slot.
+ */
+static netstats_endpoint_t *endpoint_for(const char *url)
+{
+    const char *path = strstr(url, "://");
+    path = path ? strchr(path + 3, '/') : url;
+    if (!path) path = "/";
+
+    size_t len = strcspn(path, "?# ");
+    if (len >= NETSTATS_NAME_MAX) len = NETSTATS_NAME_MAX - 1;
+
+    for (int i = 0; i < g_endpoint_count; i++) {
+        if (strncmp(g_endpoints[i].name, path, len) == 0 && g_endpoints[i].name[len] == '\0') {
+            return &g_endpoints[i];
+        }
+    }
+
+    if (g_endpoint_count == NETSTATS_MAX_ENDPOINTS) {
+        netstats_endpoint_t *other = &g_endpoints[NETSTATS_MAX_ENDPOINTS - 1];
+        strcpy(other->name, "(other)");
+        return other;
+    }
+
+    netstats_endpoint_t *e = &g_endpoints[g_endpoint_count++];
+    memcpy(e->name, path, len);
+    e->name[len] = '\0';
+    return e;
+}
+
+/*
+ * Close the last phase of a request and add it to its endpoint. Failed
+ * requests are only counted, so averages describe completed ones.
+ */
+void netstats_record(const char *url, net_timing_t *t, bool ok)
+{
+    if (ok) {
+        netstats_phase(t, t->responded ? NET_PHASE_TRANSFER : NET_PHASE_TTFB);
+    }
+
+    core_lock(&g_lock);
+    netstats_endpoint_t *e = endpoint_for(url);
+
+    if (!ok) {
+        e->failures++;
+        core_unlock(&g_lock);
+        return;
+    }
+
+    uint32_t total_us = 0;
+    for (int p = 0; p < NET_PHASE_COUNT; p++) {
+        e->phase_us[p] += t->phase_us[p];
+        if (p != NET_PHASE_PARSE) total_us += t->phase_us[p];
+    }
+    e->requests++;
+    e->bytes += t->bytes;
+
+    int bucket = 0;
+    for (uint32_t ms = total_us / 1000; ms > 0 && bucket < NETSTATS_BUCKETS - 1; ms >>= 1) {
+        bucket++;
+    }
+    e->histogram[bucket]++;
+    core_unlock(&g_lock);
+}
+
+/*
+ * Charge parsing that began at started_us to the endpoint of url
+ */
+void netstats_parse(const char *url, uint64_t started_us)
+{
+    uint64_t elapsed = netstats_now_us() - started_us;
+
+    core_lock(&g_lock);
+    netstats_endpoint_t *e = endpoint_for(url);
+    e->phase_us[NET_PHASE_PARSE] += elapsed;
+    e->parses++;
+    core_unlock(&g_lock);
+}
+
+int netstats_count(void)
+{
+    return g_endpoint_count;
+}
+
+const netstats_endpoint_t *netstats_endpoint(int index)
+{
+    if (index < 0 || index >= g_endpoint_count) return NULL;
+    return &g_endpoints[index];
+}
+
+/*
+ * Upper bound in ms of the histogram bucket holding the given percentile
+ */
+uint32_t netstats_percentile_ms(const netstats_endpoint_t *e, int percent)
+{
+    uint32_t want = (e->requests * percent + 99) / 100;
+    uint32_t seen = 0;
+
+    for (int i = 0; i < NETSTATS_BUCKETS; i++) {
+        seen += e->histogram[i];
+        if (seen >= want && seen > 0) return 1u << i;
+    }
+    return 1u << (NETSTATS_BUCKETS - 1);
+}
+
+/*
+ * Two overlay lines for one endpoint: counts and percentiles, then the
+ * average milliseconds spent in each phase
+ */
+int netstats_format(int index, char *line1, char *line2, size_t size)
+{
+    const netstats_endpoint_t *e = netstats_endpoint(index);
+    if (!e) return -1;
+
+    uint32_t n = e->requests ? e->requests : 1;
+    uint32_t parses = e->parses ? e->parses : 1;
+
+    snprintf(line1, size, "%-14.14s n%-3lu e%-2lu %4luK p50<%lu p90<%lu",
+             e->name, (unsigned long)e->requests, (unsigned long)e->failures,
+             (unsigned long)(e->bytes / n / 1024),
+             (unsigned long)netstats_percentile_ms(e, 50),
+             (unsigned long)netstats_percentile_ms(e, 90));
+    snprintf(line2, size, " dns%3lu con%3lu snd%3lu ttfb%4lu xfer%4lu prs%4lu",
+             (unsigned long)(e->phase_us[NET_PHASE_DNS] / n / 1000),
+             (unsigned long)(e->phase_us[NET_PHASE_CONNECT] / n / 1000),
+             (unsigned long)(e->phase_us[NET_PHASE_SEND] / n / 1000),
+             (unsigned long)(e->phase_us[NET_PHASE_TTFB] / n / 1000),
+             (unsigned long)(e->phase_us[NET_PHASE_TRANSFER] / n / 1000),
+             (unsigned long)(e->phase_us[NET_PHASE_PARSE] / parses / 1000));
+    return 0;
+}
+
+void netstats_reset(void)
+{
+    core_lock(&g_lock);
+    memset(g_endpoints, 0, sizeof(g_endpoints));
+    g_endpoint_count = 0;
+    core_unlock(&g_lock);
+}
+
+/*
+ * Write every endpoint as a tab-separated row: totals in microseconds
+ * and bytes, then the histogram buckets
+ */
+int netstats_dump(const char *path)
+{
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        CORE_LOG_ERROR("Cannot write %s", path);
+        return -1;
+    }
+
+    fprintf(f, "endpoint\trequests\tfailures\tparses\tbytes");
+    for (int p = 0; p < NET_PHASE_COUNT; p++) {
+        fprintf(f, "\t%s_us", g_phase_names[p]);
+    }
+    for (int i = 0; i < NETSTATS_BUCKETS - 1; i++) {
+        fprintf(f, "\tlt%ums", 1u << i);
+    }
+    fprintf(f, "\tge%ums", 1u << (NETSTATS_BUCKETS - 2));
+    fputc('\n', f);
+
+    for (int i = 0; i < g_endpoint_count; i++) {
+        const netstats_endpoint_t *e = &g_endpoints[i];
+        fprintf(f, "%s\t%lu\t%lu\t%lu\t%llu", e->name, (unsigned long)e->requests,
+                (unsigned long)e->failures, (unsigned long)e->parses,
+                (unsigned long long)e->bytes);
+        for (int p = 0; p < NET_PHASE_COUNT; p++) {
+            fprintf(f, "\t%llu", (unsigned long long)e->phase_us[p]);
+        }
+        for (int b = 0; b < NETSTATS_BUCKETS; b++) {
+            fprintf(f, "\t%lu", (unsigned long)e->histogram[b]);
+        }
+        fputc('\n', f);
+    }
+
+    fclose(f);
+    return 0;
+}
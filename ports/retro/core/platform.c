@@ -0,0 +1,325 @@
+/*
+ * Nedflix retro ports - shared core
+ * Platform shim
+ */
+
+#include "core.h"
+#include <errno.h>
+#include <string.h>
+
+#if defined(NEDFLIX_HOST)
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sched.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+#elif defined(NEDFLIX_DREAMCAST)
+#include <kos.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#elif defined(NEDFLIX_XBOX)
+#include <lwip/netdb.h>
+#include <lwip/sockets.h>
+#include <windows.h>
+#elif defined(NEDFLIX_PS3)
+#include <net/net.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/systime.h>
+#include <sys/thread.h>
+#include <sys/time.h>
+#include <unistd.h>
+#elif defined(NEDFLIX_XBOX360)
+#include <lwip/netdb.h>
+#include <lwip/sockets.h>
+#include <ppc/timebase.h>
+#include <time/time.h>
+#endif
+
+/* Pieces handed to one gather write; the caller sends the rest after */
+#define CORE_SENDV_MAX 32
+
+/* Sockets checked by one core_sock_poll */
+#define CORE_POLL_MAX 16
+
+uint64_t core_now_us(void)
+{
+#if defined(NEDFLIX_HOST)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#elif defined(NEDFLIX_DREAMCAST)
+    return timer_us_gettime64();
+#elif defined(NEDFLIX_XBOX)
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER now;
+    if (freq.QuadPart == 0) QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&now);
+    return (uint64_t)(now.QuadPart / freq.QuadPart) * 1000000 +
+           (uint64_t)(now.QuadPart % freq.QuadPart) * 1000000 / freq.QuadPart;
+#elif defined(NEDFLIX_PS3)
+    return sysGetSystemTime();
+#elif defined(NEDFLIX_XBOX360)
+    return mftb() / (PPC_TIMEBASE_FREQ / 1000000);
+#endif
+}
+
+void core_sleep_us(uint32_t us)
+{
+#if defined(NEDFLIX_HOST)
+    usleep(us);
+#elif defined(NEDFLIX_DREAMCAST)
+    if (us >= 1000) thd_sleep(us / 1000);
+#elif defined(NEDFLIX_XBOX)
+    if (us >= 1000) Sleep(us / 1000);
+#elif defined(NEDFLIX_PS3)
+    if (us > 0) sysUsleep(us);
+#elif defined(NEDFLIX_XBOX360)
+    if (us >= 1000) mdelay(us / 1000);
+#endif
+}
+
+int core_sock_send(int sock, const void *data, size_t len)
+{
+    return (int)send(sock, data, len, 0);
+}
+
+/*
+ * Write as many pieces as one call takes; returns bytes written like
+ * send(). Without writev (KOS, libxenon) the pieces that fit in one
+ * HTTP_SEND_GATHER buffer are copied together, so a request still leaves
+ * in one segment, and a larger piece goes on its own.
+ */
+int core_sock_sendv(int sock, const core_piece_t *piece, int count)
+{
+#if defined(NEDFLIX_HOST) || defined(NEDFLIX_XBOX) || defined(NEDFLIX_PS3)
+    struct iovec iov[CORE_SENDV_MAX];
+    if (count > CORE_SENDV_MAX) count = CORE_SENDV_MAX;
+    for (int i = 0; i < count; i++) {
+        iov[i].iov_base = (void *)piece[i].data;
+        iov[i].iov_len = piece[i].len;
+    }
+#if defined(NEDFLIX_XBOX) && !defined(NEDFLIX_HOST)
+    return lwip_writev(sock, iov, count);
+#else
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = count;
+    return (int)sendmsg(sock, &msg, 0);
+#endif
+#else
+    static char gather[HTTP_SEND_GATHER];
+    size_t used = 0;
+    for (int i = 0; i < count && used + piece[i].len <= sizeof(gather); i++) {
+        memcpy(gather + used, piece[i].data, piece[i].len);
+        used += piece[i].len;
+    }
+    if (used == 0) {
+        return count > 0 ? core_sock_send(sock, piece[0].data, piece[0].len) : 0;
+    }
+    return core_sock_send(sock, gather, used);
+#endif
+}
+
+int core_sock_recv(int sock, void *buf, size_t len)
+{
+    return (int)recv(sock, buf, len, 0);
+}
+
+void core_sock_close(int sock)
+{
+#if defined(NEDFLIX_XBOX) && !defined(NEDFLIX_HOST)
+    lwip_close(sock);
+#else
+    close(sock);
+#endif
+}
+
+int core_sock_connect(uint32_t addr, int port, uint32_t timeout_ms)
+{
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock < 0) {
+        return -1;
+    }
+
+#if defined(NEDFLIX_HOST) || defined(NEDFLIX_PS3)
+    struct timeval tv;
+    tv.tv_sec = timeout_ms / 1000;
+    tv.tv_usec = (timeout_ms % 1000) * 1000;
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+#elif defined(NEDFLIX_XBOX) || defined(NEDFLIX_XBOX360)
+    /* lwIP takes milliseconds as an int */
+    int ms = (int)timeout_ms;
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &ms, sizeof(ms));
+    setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &ms, sizeof(ms));
+#else
+    /* KOS sockets have no timeouts; the Dreamcast keeps its own deadlines */
+    (void)timeout_ms;
+#endif
+
+    struct sockaddr_in sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons(port);
+    sa.sin_addr.s_addr = addr;
+
+    if (connect(sock, (struct sockaddr *)&sa, sizeof(sa)) < 0) {
+        core_sock_close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+int core_sock_connect_start(uint32_t addr, int port, bool *connected)
+{
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock < 0) {
+        return -1;
+    }
+
+#if (defined(NEDFLIX_XBOX) || defined(NEDFLIX_XBOX360)) && !defined(NEDFLIX_HOST)
+    u32_t on = 1;
+    lwip_ioctl(sock, FIONBIO, &on);
+#else
+    fcntl(sock, F_SETFL, O_NONBLOCK);
+#endif
+
+    struct sockaddr_in sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons(port);
+    sa.sin_addr.s_addr = addr;
+
+    *connected = false;
+    if (connect(sock, (struct sockaddr *)&sa, sizeof(sa)) == 0) {
+        *connected = true;
+    } else if (errno != EINPROGRESS && errno != EWOULDBLOCK) {
+        core_sock_close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+int core_sock_connect_result(int sock)
+{
+    int err = 0;
+    socklen_t len = sizeof(err);
+    if (getsockopt(sock, SOL_SOCKET, SO_ERROR, &err, &len) < 0) {
+        return -1;
+    }
+    return err;
+}
+
+static int core_sock_nowait_result(int n)
+{
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        return CORE_SOCK_AGAIN;
+    }
+    return n;
+}
+
+int core_sock_send_nowait(int sock, const void *data, size_t len)
+{
+    return core_sock_nowait_result((int)send(sock, data, len, MSG_DONTWAIT));
+}
+
+int core_sock_recv_nowait(int sock, void *buf, size_t len)
+{
+    return core_sock_nowait_result((int)recv(sock, buf, len, MSG_DONTWAIT));
+}
+
+/*
+ * poll() where the stack has it; PSL1GHT and lwIP get select(), with
+ * every socket below FD_SETSIZE
+ */
+int core_sock_poll(core_poll_t *fds, int count)
+{
+#if defined(NEDFLIX_HOST) || defined(NEDFLIX_DREAMCAST)
+    struct pollfd pfd[CORE_POLL_MAX];
+    if (count > CORE_POLL_MAX) count = CORE_POLL_MAX;
+    for (int i = 0; i < count; i++) {
+        pfd[i].fd = fds[i].sock;
+        pfd[i].events = (fds[i].events & CORE_POLL_READ) ? POLLIN : POLLOUT;
+        pfd[i].revents = 0;
+        fds[i].ready = 0;
+    }
+    int n = poll(pfd, count, 0);
+    for (int i = 0; n > 0 && i < count; i++) {
+        if (pfd[i].revents & POLLIN) fds[i].ready |= CORE_POLL_READ;
+        if (pfd[i].revents & POLLOUT) fds[i].ready |= CORE_POLL_WRITE;
+        if (pfd[i].revents & (POLLERR | POLLHUP)) fds[i].ready |= CORE_POLL_ERROR;
+    }
+    return n;
+#else
+    fd_set rd, wr, ex;
+    int top = -1;
+    FD_ZERO(&rd);
+    FD_ZERO(&wr);
+    FD_ZERO(&ex);
+    for (int i = 0; i < count; i++) {
+        FD_SET(fds[i].sock, (fds[i].events & CORE_POLL_READ) ? &rd : &wr);
+        FD_SET(fds[i].sock, &ex);
+        if (fds[i].sock > top) top = fds[i].sock;
+        fds[i].ready = 0;
+    }
+    struct timeval none = { 0, 0 };
+    int n = select(top + 1, &rd, &wr, &ex, &none);
+    for (int i = 0; n > 0 && i < count; i++) {
+        if (FD_ISSET(fds[i].sock, &rd)) fds[i].ready |= CORE_POLL_READ;
+        if (FD_ISSET(fds[i].sock, &wr)) fds[i].ready |= CORE_POLL_WRITE;
+        if (FD_ISSET(fds[i].sock, &ex)) fds[i].ready |= CORE_POLL_ERROR;
+    }
+    return n;
+#endif
+}
+
+int core_resolve(const char *host, uint32_t *addr)
+{
+    struct hostent *he = gethostbyname(host);
+    if (!he || he->h_addrtype != AF_INET || he->h_length != 4 || !he->h_addr_list[0]) {
+        return -1;
+    }
+    memcpy(addr, he->h_addr_list[0], 4);
+    return 0;
+}
+
+/* Give up the CPU while another thread holds a lock */
+static void core_yield(void)
+{
+#if defined(NEDFLIX_HOST)
+    sched_yield();
+#elif defined(NEDFLIX_DREAMCAST)
+    thd_pass();
+#elif defined(NEDFLIX_XBOX)
+    Sleep(0);
+#elif defined(NEDFLIX_PS3)
+    sysThreadYield();
+#endif
+    /* The 360 port runs a single thread; nothing to yield to */
+}
+
+void core_lock(core_lock_t *lock)
+{
+    while (__sync_lock_test_and_set(lock, 1)) {
+        core_yield();
+    }
+}
+
+void core_unlock(core_lock_t *lock)
+{
+    __sync_lock_release(lock);
+}
@@ -0,0 +1,385 @@
+/*
+ * Nedflix retro ports - shared core
+ * Schema decoders
+ *
+ * Turns API responses into the ports' own structs without building a
+ * document. A schema is a table of JSON_FIELD() entries, one per key a
+ * port keeps; the decoder follows json_push_t events down to each record
+ * object and writes every value it recognises straight into its member.
+ * Memory use is the push parser's token buffer and one scratch struct,
+ * whatever the size of the response, on top of the output itself.
+ *
+ * The format is told from the first byte: a MessagePack response is read
+ * by msgpack_push_t, which reports the same events as json_push_t.
+ *
+ * Keys are looked up with a perfect hash built from the table the first
+ * time it is used: a seed is searched for under which every key lands in
+ * its own slot, so a lookup is one hash and one string compare, and a
+ * key the schema does not list usually fails on an empty slot.
+ */
+
+#include "core.h"
+#include <string.h>
+
+/* Seeds tried per table size before the table is doubled */
+#define SCHEMA_SEED_TRIES 1024
+
+struct json_decoder {
+    json_push_t *json;              /* One of these, once the first byte is in */
+    msgpack_push_t *msgpack;
+    json_decode_t spec;
+    int record_depth;               /* 0 for the root, 2 for array items */
+    bool array_next;                /* The root key just read names the array */
+    bool in_array;
+    bool in_record;
+    void *record;                   /* NULL while skipping a record */
+    const json_field_t *field;      /* Where the next value goes */
+    const json_field_t *root_field; /* Same, for a member of the root */
+    uint64_t scratch[];             /* spec.schema->scratch_size bytes */
+};
+
+/* Decoders may be created on several threads of the PS3 port */
+static core_lock_t g_build_lock = CORE_LOCK_INIT;
+
+/*
+ * FNV-1a, seeded, with the high bits folded down for small masks
+ */
+static uint32_t key_hash(const char *key, size_t len, uint32_t seed)
+{
+    uint32_t h = 2166136261u ^ seed;
+    for (size_t i = 0; i < len; i++) {
+        h = (h ^ (uint8_t)key[i]) * 16777619u;
+    }
+    return h ^ (h >> 16);
+}
+
+/*
+ * Try one seed and table size; fills the slots if no two keys collide
+ */
+static bool try_seed(json_schema_t *schema, uint32_t seed, uint32_t mask)
+{
+    memset(schema->slot, -1, sizeof(schema->slot));
+    for (int i = 0; i < schema->count; i++) {
+        const char *key = schema->fields[i].key;
+        uint32_t h = key_hash(key, strlen(key), seed) & mask;
+        if (schema->slot[h] >= 0) {
+            return false;
+        }
+        schema->slot[h] = (int8_t)i;
+    }
+    return true;
+}
+
+/*
+ * Find a collision-free seed, starting with a table twice the number of
+ * keys. Every table in the ports settles within a few tries. Taking the
+ * lock each time also makes a table another thread built visible here.
+ */
+static void schema_prepare(json_schema_t *schema)
+{
+    core_lock(&g_build_lock);
+    if (!schema->ready) {
+        uint32_t size = 1;
+        while (size < (uint32_t)schema->count * 2) size <<= 1;
+
+        bool found = false;
+        for (; size <= JSON_SCHEMA_SLOTS && !found; size <<= 1) {
+            for (uint32_t seed = 1; seed <= SCHEMA_SEED_TRIES; seed++) {
+                if (try_seed(schema, seed, size - 1)) {
+                    schema->seed = seed;
+                    schema->mask = size - 1;
+                    found = true;
+                    break;
+                }
+            }
+        }
+        if (!found) {
+            /* Only a table with more than half the slots in keys gets here */
+            CORE_LOG_ERROR("Schema of %d keys has no perfect hash", schema->count);
+            memset(schema->slot, -1, sizeof(schema->slot));
+        }
+        schema->ready = true;
+    }
+    core_unlock(&g_build_lock);
+}
+
+/*
+ * Find the field for a key, or NULL if the schema does not list it
+ */
+static const json_field_t *schema_find(const json_schema_t *schema, const char *key, size_t len)
+{
+    int i = schema->slot[key_hash(key, len, schema->seed) & schema->mask];
+    if (i < 0) return NULL;
+
+    const json_field_t *f = &schema->fields[i];
+    if (strncmp(f->key, key, len) != 0 || f->key[len] != '\0') {
+        return NULL;
+    }
+    return f;
+}
+
+/*
+ * Store a whole number in an integer member, clamped to what it can
+ * hold, without going through a double
+ */
+static void store_integer(const json_field_t *f, char *dst, int64_t i)
+{
+    if (f->kind == JSON_FIELD_UINT) {
+        uint64_t max = f->size >= 8 ? UINT64_MAX : (1ull << (f->size * 8)) - 1;
+        uint64_t u = i <= 0 ? 0 : (uint64_t)i > max ? max : (uint64_t)i;
+        switch (f->size) {
+            case 1: *(uint8_t *)dst = (uint8_t)u; break;
+            case 2: *(uint16_t *)dst = (uint16_t)u; break;
+            case 4: *(uint32_t *)dst = (uint32_t)u; break;
+            default: *(uint64_t *)dst = u; break;
+        }
+        return;
+    }
+
+    int64_t max = f->size >= 8 ? INT64_MAX : (int64_t)((1ull << (f->size * 8 - 1)) - 1);
+    i = i > max ? max : i < -max - 1 ? -max - 1 : i;
+    switch (f->size) {
+        case 1: *(int8_t *)dst = (int8_t)i; break;
+        case 2: *(int16_t *)dst = (int16_t)i; break;
+        case 4: *(int32_t *)dst = (int32_t)i; break;
+        default: *(int64_t *)dst = i; break;
+    }
+}
+
+/*
+ * Store a number in an integer or floating-point member, clamped to
+ * what the member can hold
+ */
+static void store_number(const json_field_t *f, char *dst, double v)
+{
+    if (v != v) v = 0.0;    /* NaN, from a string such as "nan" */
+
+    if (f->kind == JSON_FIELD_REAL) {
+        if (f->size == sizeof(float)) *(float *)dst = (float)v;
+        else *(double *)dst = v;
+        return;
+    }
+
+    if (f->kind == JSON_FIELD_UINT) {
+        double max = f->size >= 8 ? 18446744073709549568.0
+                                  : (double)((1ull << (f->size * 8)) - 1);
+        uint64_t u = v <= 0.0 ? 0 : v >= max ? (uint64_t)max : (uint64_t)v;
+        switch (f->size) {
+            case 1: *(uint8_t *)dst = (uint8_t)u; break;
+            case 2: *(uint16_t *)dst = (uint16_t)u; break;
+            case 4: *(uint32_t *)dst = (uint32_t)u; break;
+            default: *(uint64_t *)dst = u; break;
+        }
+        return;
+    }
+
+    double max = f->size >= 8 ? 9223372036854774784.0
+                              : (double)((1ull << (f->size * 8 - 1)) - 1);
+    int64_t i = v >= max ? (int64_t)max : v <= -max - 1.0 ? (int64_t)(-max - 1.0) : (int64_t)v;
+    switch (f->size) {
+        case 1: *(int8_t *)dst = (int8_t)i; break;
+        case 2: *(int16_t *)dst = (int16_t)i; break;
+        case 4: *(int32_t *)dst = (int32_t)i; break;
+        default: *(int64_t *)dst = i; break;
+    }
+}
+
+/*
+ * Store a number read by json_number_scan()
+ */
+static void store_scanned(const json_field_t *f, char *dst, bool is_integer,
+                          int64_t integer, double real)
+{
+    if (is_integer && f->kind != JSON_FIELD_REAL) {
+        store_integer(f, dst, integer);
+    } else {
+        store_number(f, dst, real);
+    }
+}
+
+/*
+ * Write one value to field f of the struct at base. Numbers are also
+ * taken from strings, since some servers send ratings as "7.5"; anything
+ * else of the wrong type is ignored, as are nulls.
+ */
+static void store_value(const json_field_t *f, char *base, const json_event_t *ev)
+{
+    char *dst = base + f->offset;
+
+    switch (ev->type) {
+        case JSON_EVENT_STRING:
+            if (f->kind == JSON_FIELD_STRING) {
+                size_t n = ev->len < f->size ? ev->len : f->size - 1u;
+                memcpy(dst, ev->str, n);
+                dst[n] = '\0';
+            } else if (f->kind != JSON_FIELD_BOOL) {
+                /* Strings from MessagePack are not terminated */
+                char text[32];
+                size_t n = ev->len < sizeof(text) ? ev->len : sizeof(text) - 1;
+                memcpy(text, ev->str, n);
+                text[n] = '\0';
+
+                json_number_t num = { 0.0, 0, false };
+                json_number_scan(text, &num);
+                store_scanned(f, dst, num.is_integer, num.integer, num.real);
+            }
+            break;
+        case JSON_EVENT_NUMBER:
+            if (f->kind != JSON_FIELD_STRING && f->kind != JSON_FIELD_BOOL) {
+                store_scanned(f, dst, ev->is_integer, ev->integer, ev->num);
+            }
+            break;
+        case JSON_EVENT_BOOL:
+            if (f->kind == JSON_FIELD_BOOL) {
+                *(bool *)dst = ev->num != 0.0;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+/*
+ * Follow the parse to each record and fill it in
+ */
+static int decoder_event(const json_event_t *ev, void *user)
+{
+    json_decoder_t *d = (json_decoder_t *)user;
+
+    if (d->in_record) {
+        if (ev->depth == d->record_depth + 1) {
+            if (ev->type == JSON_EVENT_KEY) {
+                d->field = schema_find(d->spec.schema, ev->str, ev->len);
+            } else if (d->field && d->record) {
+                store_value(d->field, d->field->scratch ? (char *)d->scratch : (char *)d->record,
+                            ev);
+            }
+        } else if (ev->depth == d->record_depth && ev->type == JSON_EVENT_OBJECT_END) {
+            d->in_record = false;
+            if (d->record) {
+                return d->spec.done(d->record, d->scratch, d->spec.user);
+            }
+        }
+        return 0;
+    }
+
+    if (ev->depth == d->record_depth && ev->type == JSON_EVENT_OBJECT_START &&
+        (!d->spec.array || d->in_array)) {
+        memset(d->scratch, 0, d->spec.schema->scratch_size);
+        d->record = d->spec.record(d->spec.user);
+        d->field = NULL;
+        d->in_record = true;
+        return 0;
+    }
+
+    if (d->spec.array && ev->depth == 1) {
+        if (ev->type == JSON_EVENT_KEY) {
+            d->array_next = strncmp(ev->str, d->spec.array, ev->len) == 0 &&
+                            d->spec.array[ev->len] == '\0';
+            d->root_field = d->spec.root ? schema_find(d->spec.root, ev->str, ev->len) : NULL;
+        } else {
+            d->in_array = d->array_next && ev->type == JSON_EVENT_ARRAY_START;
+            d->array_next = false;
+            if (d->root_field) {
+                store_value(d->root_field, (char *)d->spec.root_out, ev);
+                d->root_field = NULL;
+            }
+        }
+    }
+    return 0;
+}
+
+/*
+ * Start decoding records as described by spec, which is copied. Returns
+ * NULL when memory runs out.
+ */
+json_decoder_t *json_decoder_create(const json_decode_t *spec)
+{
+    if (!spec || !spec->schema || !spec->record || !spec->done) return NULL;
+    if (spec->root && !spec->root_out) return NULL;
+    schema_prepare(spec->schema);
+    if (spec->root) schema_prepare(spec->root);
+
+    size_t scratch = (spec->schema->scratch_size + 7) & ~(size_t)7;
+    json_decoder_t *d = (json_decoder_t *)core_calloc(1, sizeof(json_decoder_t) + scratch);
+    if (!d) return NULL;
+
+    d->spec = *spec;
+    d->record_depth = spec->array ? 2 : 0;
+    return d;
+}
+
+/*
+ * Decode the next chunk of the response; returns as json_push_feed().
+ * The first byte picks the parser.
+ */
+int json_decoder_feed(json_decoder_t *d, const void *data, size_t len)
+{
+    if (!d->json && !d->msgpack) {
+        if (len == 0) return 0;
+        if (msgpack_sniff(*(const uint8_t *)data)) {
+            d->msgpack = msgpack_push_create(decoder_event, d);
+        } else {
+            d->json = json_push_create(decoder_event, d);
+        }
+        if (!d->json && !d->msgpack) return -1;
+    }
+    return d->msgpack ? msgpack_push_feed(d->msgpack, data, len)
+                      : json_push_feed(d->json, data, len);
+}
+
+/*
+ * True once the whole response has been parsed
+ */
+bool json_decoder_done(const json_decoder_t *d)
+{
+    if (d->msgpack) return msgpack_push_done(d->msgpack);
+    return d->json && json_push_done(d->json);
+}
+
+/* Free a decoder */
+void json_decoder_destroy(json_decoder_t *d)
+{
+    if (!d) return;
+    json_push_destroy(d->json);
+    msgpack_push_destroy(d->msgpack);
+    core_free(d);
+}
+
+/*
+ * Decode a whole response held in memory. Returns 0, or -1 if it was
+ * malformed, cut short, or stopped by done().
+ */
+int json_decode(const json_decode_t *spec, const char *text, size_t len)
+{
+    json_decoder_t *d = json_decoder_create(spec);
+    if (!d) return -1;
+
+    int result = json_decoder_feed(d, text, len);
+    json_decoder_destroy(d);
+    return result == 1 ? 0 : -1;
+}
+
+static void *object_record(void *user)
+{
+    return user;
+}
+
+static int object_done(void *record, void *scratch, void *user)
+{
+    (void)record;
+    (void)scratch;
+    (void)user;
+    return 0;
+}
+
+/*
+ * Decode a response whose root object is the one record, into out.
+ * Members of out whose keys are missing are left as they were. Returns
+ * 0, or -1 if the response was malformed or cut short.
+ */
+int json_decode_object(json_schema_t *schema, const char *text, size_t len, void *out)
+{
+    json_decode_t spec = { schema, NULL, object_record, object_done, out, NULL, NULL };
+    return json_decode(&spec, text, len);
+}
@@ -0,0 +1,82 @@
+/*
+ * Nedflix retro ports - shared core
+ * URL parsing and encoding
+ */
+
+#include "core.h"
+#include <string.h>
+
+/*
+ * Split a URL into host, port and path. The scheme may be left off;
+ * "https://" only changes the default port, as no port speaks TLS.
+ */
+int url_parse(const char *url, char *host, size_t host_len, int *port,
+              char *path, size_t path_len)
+{
+    const char *p = url;
+
+    /* Skip protocol */
+    *port = 80;
+    if (strncmp(p, "http://", 7) == 0) {
+        p += 7;
+    } else if (strncmp(p, "https://", 8) == 0) {
+        p += 8;
+        *port = 443;
+    } else if (strstr(p, "://")) {
+        return -1;
+    }
+
+    /* Extract host */
+    const char *host_end = p;
+    while (*host_end && *host_end != ':' && *host_end != '/') {
+        host_end++;
+    }
+
+    size_t len = host_end - p;
+    if (len == 0 || len >= host_len) return -1;
+    memcpy(host, p, len);
+    host[len] = '\0';
+
+    p = host_end;
+
+    /* Check for port */
+    if (*p == ':') {
+        p++;
+        *port = atoi(p);
+        while (*p && *p != '/') p++;
+    }
+
+    /* Path */
+    if (*p == '/') {
+        strncpy(path, p, path_len - 1);
+        path[path_len - 1] = '\0';
+    } else {
+        strcpy(path, "/");
+    }
+
+    return 0;
+}
+
+/*
+ * URL encode a string
+ */
+void url_encode(const char *src, char *dst, size_t dst_size)
+{
+    static const char *hex = "0123456789ABCDEF";
+    size_t pos = 0;
+
+    while (*src && pos < dst_size - 4) {
+        char c = *src++;
+        if ((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') ||
+            (c >= '0' && c <= '9') || c == '-' || c == '_' || c == '.' || c == '~') {
+            dst[pos++] = c;
+        } else if (c == ' ') {
+            dst[pos++] = '+';
+        } else {
+            dst[pos++] = '%';
+            dst[pos++] = hex[(c >> 4) & 0xF];
+            dst[pos++] = hex[c & 0xF];
+        }
+    }
+    dst[pos] = '\0';
+}
@@ -14,29 +14,52 @@ static struct {
     bool initialized;
 } g_api;
 
-/*
- * URL encode a string
- */
-static void url_encode(const char *src, char *dst, size_t dst_size)
-{
-    static const char *hex = "0123456789ABCDEF";
-    size_t pos = 0;
-
-    while (*src && pos < dst_size - 4) {
-        char c = *src++;
-        if ((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') ||
-            (c >= '0' && c <= '9') || c == '-' || c == '_' || c == '.' || c == '~') {
-            dst[pos++] = c;
-        } else if (c == ' ') {
-            dst[pos++] = '+';
-        } else {
-            dst[pos++] = '%';
-            dst[pos++] = hex[(c >> 4) & 0xF];
-            dst[pos++] = hex[c & 0xF];
-        }
-    }
-    dst[pos] = '\0';
-}
+/* The window must hold the page under the cursor and the one being fetched */
+#if MAX_MEDIA_ITEMS < 2 * MEDIA_PAGE_ITEMS
+#error "MAX_MEDIA_ITEMS must hold at least two MEDIA_PAGE_ITEMS pages"
+#endif
+
+/* Whole pages that fit in a media_list_t */
+#define WINDOW_ITEMS (MAX_MEDIA_ITEMS / MEDIA_PAGE_ITEMS * MEDIA_PAGE_ITEMS)
+
+/* Bitrates (kbps) to ask /api/audio-transcode for, lowest first */
+static const int g_audio_bitrates[] = { 32, 64, 96, 128, 192 };
+#define NUM_AUDIO_BITRATES (int)(sizeof(g_audio_bitrates) / sizeof(g_audio_bitrates[0]))
+
+/* Login and user info replies; the session token is kept to 64 bytes */
+typedef struct {
+    char token[128];
+    char error[96];
+    char username[64];
+} account_reply_t;
+
+static const json_field_t g_account_fields[] = {
+    JSON_FIELD(account_reply_t, token, "token", STRING),
+    JSON_FIELD(account_reply_t, error, "error", STRING),
+    JSON_FIELD(account_reply_t, username, "username", STRING),
+};
+static json_schema_t g_account_schema = JSON_SCHEMA(g_account_fields);
+
+/* Browse and search entries, decoded straight into the list */
+static const json_field_t g_item_fields[] = {
+    JSON_FIELD(media_item_t, name, "name", STRING),
+    JSON_FIELD(media_item_t, path, "path", STRING),
+    JSON_FIELD(media_item_t, duration, "duration", UINT),
+    MEDIA_HINT_FIELDS
+};
+static json_schema_t g_item_schema = JSON_SCHEMA_SCRATCH(g_item_fields, media_hints_t);
+
+/* Size of the whole directory, sent alongside each page of it */
+static const json_field_t g_page_fields[] = {
+    JSON_FIELD(media_list_t, total, "total", INT),
+};
+static json_schema_t g_page_schema = JSON_SCHEMA(g_page_fields);
+
+/* The same, held by a streamed request until its listing replaces the old */
+static const json_field_t g_request_page_fields[] = {
+    JSON_FIELD(api_request_t, total, "total", INT),
+};
+static json_schema_t g_request_page_schema = JSON_SCHEMA(g_request_page_fields);
 
 /*
  * Build full API URL
@@ -50,6 +73,19 @@ static void build_url(char *url, size_t url_size, const char *endpoint, const ch
     }
 }
 
+/*
+ * Store the server URL without a trailing slash
+ */
+static void set_base_url(const char *server_url)
+{
+    strncpy(g_api.base_url, server_url, sizeof(g_api.base_url) - 1);
+
+    size_t len = strlen(g_api.base_url);
+    if (len > 0 && g_api.base_url[len - 1] == '/') {
+        g_api.base_url[len - 1] = '\0';
+    }
+}
+
 /*
  * Initialize API client
  */
@@ -62,13 +98,7 @@ int api_init(const char *server_url)
 
     LOG("Initializing API client for: %s", server_url);
 
-    strncpy(g_api.base_url, server_url, sizeof(g_api.base_url) - 1);
-
-    /* Remove trailing slash */
-    size_t len = strlen(g_api.base_url);
-    if (len > 0 && g_api.base_url[len - 1] == '/') {
-        g_api.base_url[len - 1] = '\0';
-    }
+    set_base_url(server_url);
 
     /* Test connection */
     char url[MAX_URL_LENGTH];
@@ -101,10 +131,53 @@ int api_init(const char *server_url)
  */
 void api_shutdown(void)
 {
+    cache_clear();
     g_api.initialized = false;
     LOG("API client shutdown");
 }
 
+/*
+ * Build the login URL and JSON body
+ */
+static void build_login_request(const char *username, const char *password,
+                                char *body, size_t body_size, char *url, size_t url_size)
+{
+    snprintf(body, body_size,
+             "{\"username\":\"%s\",\"password\":\"%s\"}",
+             username, password);
+    build_url(url, url_size, "/auth/local", NULL);
+}
+
+/*
+ * Pull the session token out of a login response
+ */
+static int parse_login_response(const char *response, size_t len,
+                                char *token_out, size_t token_len)
+{
+    account_reply_t reply;
+    memset(&reply, 0, sizeof(reply));
+
+    if (json_decode_object(&g_account_schema, response, len, &reply) < 0) {
+        LOG_ERROR("Failed to parse login response");
+        return -1;
+    }
+
+    /* Extract token */
+    if (reply.token[0]) {
+        strncpy(token_out, reply.token, token_len - 1);
+        token_out[token_len - 1] = '\0';
+        LOG("Login successful");
+        return 0;
+    }
+
+    /* Check for error message */
+    if (reply.error[0]) {
+        LOG_ERROR("Login failed: %s", reply.error);
+    }
+
+    return -1;
+}
+
 /*
  * Login with username and password
  */
@@ -115,14 +188,9 @@ int api_login(const char *username, const char *password, char *token_out, size_
 
     LOG("Attempting login for user: %s", username);
 
-    /* Build login request body */
     char body[512];
-    snprintf(body, sizeof(body),
-             "{\"username\":\"%s\",\"password\":\"%s\"}",
-             username, password);
-
     char url[MAX_URL_LENGTH];
-    build_url(url, sizeof(url), "/auth/local", NULL);
+    build_login_request(username, password, body, sizeof(body), url, sizeof(url));
 
     char *response = NULL;
     size_t response_len = 0;
@@ -134,33 +202,9 @@ int api_login(const char *username, const char *password, char *token_out, size_
         return -1;
     }
 
-    /* Parse response */
-    json_value_t *json = json_parse(response);
+    result = parse_login_response(response, response_len, token_out, token_len);
     free(response);
-
-    if (!json) {
-        LOG_ERROR("Failed to parse login response");
-        return -1;
-    }
-
-    /* Extract token */
-    const char *token = json_get_string(json, "token");
-    if (token) {
-        strncpy(token_out, token, token_len - 1);
-        token_out[token_len - 1] = '\0';
-        LOG("Login successful");
-        json_free(json);
-        return 0;
-    }
-
-    /* Check for error message */
-    const char *error = json_get_string(json, "error");
-    if (error) {
-        LOG_ERROR("Login failed: %s", error);
-    }
-
-    json_free(json);
-    return -1;
+    return result;
 }
 
 /*
@@ -183,126 +227,243 @@ int api_get_user_info(const char *token, char *username_out, size_t username_len
         return -1;
     }
 
-    json_value_t *json = json_parse(response);
+    account_reply_t reply;
+    memset(&reply, 0, sizeof(reply));
+    result = json_decode_object(&g_account_schema, response, response_len, &reply);
     free(response);
 
-    if (!json) return -1;
+    if (result < 0 || !reply.username[0]) return -1;
 
-    const char *username = json_get_string(json, "username");
-    if (username) {
-        strncpy(username_out, username, username_len - 1);
-        username_out[username_len - 1] = '\0';
-        json_free(json);
-        return 0;
-    }
+    strncpy(username_out, reply.username, username_len - 1);
+    username_out[username_len - 1] = '\0';
+    return 0;
+}
 
-    json_free(json);
-    return -1;
+/*
+ * Build the URL for one page of a directory, starting at entry first
+ */
+static void build_browse_url(const char *path, int32_t first, char *url, size_t url_size)
+{
+    char encoded_path[MAX_PATH_LENGTH * 3];
+    url_encode(path ? path : "/", encoded_path, sizeof(encoded_path));
+
+    char query[512];
+    snprintf(query, sizeof(query), "path=%s&offset=%ld&limit=%d", encoded_path,
+             (long)first, MEDIA_PAGE_ITEMS);
+
+    build_url(url, url_size, "/api/browse", query);
 }
 
 /*
- * Browse directory
+ * The entry at a listing index, or NULL if it is outside the window
  */
-int api_browse(const char *token, const char *path, media_list_t *list)
+media_item_t *media_list_item(const media_list_t *list, int32_t index)
 {
-    if (!g_api.initialized || !list) return -1;
+    int32_t i = index - list->first;
+    if (i < 0 || i >= list->count) return NULL;
+    return (media_item_t *)&list->items[i];
+}
 
-    /* Clear existing list */
+/*
+ * Empty a list for a new listing of unknown size
+ */
+static void reset_list(media_list_t *list)
+{
     list->count = 0;
+    list->first = 0;
+    list->total = -1;
     list->selected_index = 0;
     list->scroll_offset = 0;
+}
 
-    /* Build query parameters */
-    char encoded_path[MAX_PATH_LENGTH * 3];
-    url_encode(path ? path : "/", encoded_path, sizeof(encoded_path));
+/*
+ * A server that does not page sends no total: what arrived is all there is
+ */
+static void settle_total(media_list_t *list)
+{
+    if (list->total < list->first + list->count) {
+        list->total = list->first + list->count;
+    }
+}
+
+/*
+ * Hand the decoder the next free slot, or NULL to skip entries once max
+ * are held
+ */
+static void *next_item(media_list_t *list, int max)
+{
+    if (list->count >= max) return NULL;
+
+    media_item_t *item = &list->items[list->count];
+    memset(item, 0, sizeof(*item));
+    return item;
+}
+
+/*
+ * Settle the type of a decoded item. Search results are always treated
+ * as audio.
+ */
+static void settle_item(media_item_t *item, const media_hints_t *hints, bool search)
+{
+    item->type = search ? MEDIA_TYPE_AUDIO : media_hints_type(hints, item->name);
+    item->is_directory = item->type == MEDIA_TYPE_DIRECTORY;
+}
+
+static void *page_next_item(void *user)
+{
+    return next_item((media_list_t *)user, MEDIA_PAGE_ITEMS);
+}
+
+static void *search_next_item(void *user)
+{
+    return next_item((media_list_t *)user, MAX_MEDIA_ITEMS);
+}
+
+static int browse_item_done(void *record, void *scratch, void *user)
+{
+    settle_item((media_item_t *)record, (const media_hints_t *)scratch, false);
+    ((media_list_t *)user)->count++;
+    return 0;
+}
+
+static int search_item_done(void *record, void *scratch, void *user)
+{
+    settle_item((media_item_t *)record, (const media_hints_t *)scratch, true);
+    ((media_list_t *)user)->count++;
+    return 0;
+}
+
+/*
+ * Fill a media list from the first page of a browse response
+ */
+static int parse_browse_response(const char *response, size_t len, media_list_t *list)
+{
+    json_decode_t spec = { &g_item_schema, "items", page_next_item, browse_item_done, list,
+                           &g_page_schema, list };
+    if (json_decode(&spec, response, len) < 0) {
+        LOG_ERROR("Failed to parse browse response");
+        return -1;
+    }
+    settle_total(list);
+
+    LOG("Loaded %d of %ld items into list", list->count, (long)list->total);
+    return 0;
+}
+
+/*
+ * Build the search URL for a query
+ */
+static void build_search_url(const char *query_str, char *url, size_t url_size)
+{
+    char encoded_query[256];
+    url_encode(query_str, encoded_query, sizeof(encoded_query));
 
     char query[512];
-    snprintf(query, sizeof(query), "path=%s&limit=%d", encoded_path, MAX_MEDIA_ITEMS);
+    snprintf(query, sizeof(query), "q=%s&limit=%d", encoded_query, MAX_MEDIA_ITEMS);
 
-    char url[MAX_URL_LENGTH];
-    build_url(url, sizeof(url), "/api/browse", query);
+    build_url(url, url_size, "/api/search", query);
+}
 
-    LOG("Browsing: %s", path);
+/*
+ * Fill a media list from a search response
+ */
+static int parse_search_response(const char *response, size_t len, media_list_t *list)
+{
+    json_decode_t spec = { &g_item_schema, "results", search_next_item, search_item_done, list,
+                           NULL, NULL };
+    if (json_decode(&spec, response, len) < 0) {
+        return -1;
+    }
+    settle_total(list);
+    return 0;
+}
 
-    char *response = NULL;
-    size_t response_len = 0;
-    int result = http_get_with_auth(url, token, &response, &response_len);
+typedef int (*listing_parser_t)(const char *response, size_t len, media_list_t *list);
 
-    if (result != 0 || !response) {
-        LOG_ERROR("Browse request failed: %d", result);
-        if (response) free(response);
+/*
+ * Answer a 304 with the cached copy of a listing
+ */
+static int restore_listing(const char *url, const char *token, media_list_t *list)
+{
+    reset_list(list);
+    int count = cache_restore(url, token, list->items, sizeof(media_item_t), MAX_MEDIA_ITEMS,
+                              &list->total);
+    if (count < 0) {
+        LOG_ERROR("Not modified, but no longer cached: %s", url);
         return -1;
     }
+    list->count = count;
+    settle_total(list);
+    LOG("Not modified, %d cached items", list->count);
+    return 0;
+}
 
-    json_value_t *json = json_parse(response);
-    free(response);
+/*
+ * Fill list from a conditional GET of a listing: a 304 brings back the
+ * cached copy, a fresh body is parsed and cached with its validators.
+ * list is left alone if the request failed.
+ */
+static int finish_listing(int result, const char *response, size_t response_len, const char *url,
+                          const char *token, const http_validators_t *validators,
+                          listing_parser_t parse, media_list_t *list)
+{
+    if (result == 304) {
+        return restore_listing(url, token, list);
+    }
 
-    if (!json) {
-        LOG_ERROR("Failed to parse browse response");
+    if (result != 0 || !response) {
+        LOG_ERROR("Request failed: %d", result);
         return -1;
     }
 
-    /* Extract files array */
-    json_value_t *files = json_get_array(json, "files");
-    if (!files) {
-        json_free(json);
-        return 0;  /* Empty directory */
+    reset_list(list);
+
+    uint64 parse_start = netstats_now_us();
+    int parsed = parse(response, response_len, list);
+    netstats_parse(url, parse_start);
+    if (parsed < 0) {
+        return -1;
     }
 
-    int file_count = json_array_length(files);
-    LOG("Found %d items", file_count);
+    cache_store(url, token, validators, list->items, sizeof(media_item_t), list->count,
+                list->total);
+    return 0;
+}
 
-    for (int i = 0; i < file_count && list->count < MAX_MEDIA_ITEMS; i++) {
-        json_value_t *file = json_array_get(files, i);
-        if (!file) continue;
+/*
+ * Fetch a listing, revalidating the cached copy if there is one
+ */
+static int get_listing(const char *url, const char *token, listing_parser_t parse,
+                       media_list_t *list)
+{
+    http_validators_t validators;
+    cache_validators(url, token, &validators);
 
-        media_item_t *item = &list->items[list->count];
-        memset(item, 0, sizeof(*item));
+    char *response = NULL;
+    size_t response_len = 0;
+    int result = http_get_conditional(url, token, &validators, &response, &response_len);
 
-        /* Get file properties */
-        const char *name = json_get_string(file, "name");
-        const char *file_path = json_get_string(file, "path");
-        bool is_dir = json_get_bool(file, "isDirectory", false);
-        const char *type = json_get_string(file, "type");
+    result = finish_listing(result, response, response_len, url, token, &validators, parse, list);
+    free(response);
+    return result;
+}
 
-        if (name) {
-            strncpy(item->name, name, sizeof(item->name) - 1);
-        }
-        if (file_path) {
-            strncpy(item->path, file_path, sizeof(item->path) - 1);
-        }
+/*
+ * Browse directory: the first page of it, with the size of the whole
+ */
+int api_browse(const char *token, const char *path, media_list_t *list)
+{
+    if (!g_api.initialized || !list) return -1;
 
-        item->is_directory = is_dir;
+    /* Clear existing list */
+    reset_list(list);
 
-        /* Determine media type */
-        if (is_dir) {
-            item->type = MEDIA_TYPE_DIRECTORY;
-        } else if (type) {
-            if (strcmp(type, "video") == 0) {
-                item->type = MEDIA_TYPE_VIDEO;
-            } else if (strcmp(type, "audio") == 0) {
-                item->type = MEDIA_TYPE_AUDIO;
-            } else {
-                item->type = MEDIA_TYPE_UNKNOWN;
-            }
-        } else {
-            /* Detect by extension */
-            const char *ext = strrchr(name ? name : "", '.');
-            if (ext) {
-                if (strstr(".mp3.m4a.flac.wav.aac.ogg.wma.opus", ext)) {
-                    item->type = MEDIA_TYPE_AUDIO;
-                } else if (strstr(".mp4.mkv.avi.mov.webm.m4v", ext)) {
-                    item->type = MEDIA_TYPE_VIDEO;
-                }
-            }
-        }
+    char url[MAX_URL_LENGTH];
+    build_browse_url(path, 0, url, sizeof(url));
 
-        list->count++;
-    }
+    LOG("Browsing: %s", path);
 
-    json_free(json);
-    LOG("Loaded %d items into list", list->count);
-    return 0;
+    return get_listing(url, token, parse_browse_response, list);
 }
 
 /*
@@ -313,80 +474,539 @@ int api_search(const char *token, const char *query_str, media_list_t *list)
     if (!g_api.initialized || !list || !query_str) return -1;
 
     /* Clear existing list */
-    list->count = 0;
-    list->selected_index = 0;
-    list->scroll_offset = 0;
+    reset_list(list);
 
-    char encoded_query[256];
-    url_encode(query_str, encoded_query, sizeof(encoded_query));
+    char url[MAX_URL_LENGTH];
+    build_search_url(query_str, url, sizeof(url));
 
-    char query[512];
-    snprintf(query, sizeof(query), "q=%s&limit=%d", encoded_query, MAX_MEDIA_ITEMS);
+    LOG("Searching for: %s", query_str);
+
+    return get_listing(url, token, parse_search_response, list);
+}
+
+/*
+ * Highest bitrate the measured throughput carries with headroom to spare.
+ * A modem gets the lowest even when nothing fits.
+ */
+static int pick_audio_bitrate(void)
+{
+    uint32 bytes_per_sec = http_throughput_estimate();
+    if (bytes_per_sec == 0) {
+        return ABR_DEFAULT_KBPS;
+    }
+
+    uint32 budget = bytes_per_sec / 100 * ABR_HEADROOM_PCT;
+    int kbps = g_audio_bitrates[0];
+    for (int i = 0; i < NUM_AUDIO_BITRATES; i++) {
+        if ((uint32)g_audio_bitrates[i] * 125 <= budget) {
+            kbps = g_audio_bitrates[i];
+        }
+    }
+
+    LOG("Throughput %lu B/s, streaming at %d kbps", (unsigned long)bytes_per_sec, kbps);
+    return kbps;
+}
+
+/*
+ * Get streaming URL for a file, at a bitrate chosen from recent throughput
+ */
+int api_get_stream_url(const char *token, const char *path, char *url_out, size_t url_len)
+{
+    if (!g_api.initialized || !path || !url_out) return -1;
+
+    /* Build audio streaming URL */
+    char encoded_path[MAX_PATH_LENGTH * 3];
+    url_encode(path, encoded_path, sizeof(encoded_path));
+
+    /* For Dreamcast, prefer audio transcoding to supported format */
+    snprintf(url_out, url_len, "%s/api/audio-transcode?path=%s&format=mp3&bitrate=%d",
+             g_api.base_url, encoded_path, pick_audio_bitrate());
+
+    LOG("Stream URL: %s", url_out);
+    return 0;
+}
+
+/*
+ * Bitrate (kbps) a stream URL asks for, or 0 for untranscoded audio
+ */
+int api_stream_bitrate(const char *url)
+{
+    const char *param = url ? strstr(url, "bitrate=") : NULL;
+    return param ? atoi(param + 8) : 0;
+}
+
+/*
+ * Rewrite a stream URL to ask for the next bitrate down.
+ * Returns the new bitrate, or -1 if it is already the lowest.
+ */
+int api_stream_step_down(char *url, size_t len)
+{
+    char *param = strstr(url, "bitrate=");
+    if (!param) return -1;
+
+    char *digits = param + 8;
+    int current = atoi(digits);
+    int lower = -1;
+    for (int i = 0; i < NUM_AUDIO_BITRATES && g_audio_bitrates[i] < current; i++) {
+        lower = g_audio_bitrates[i];
+    }
+    if (lower < 0) return -1;
+
+    char *end = digits;
+    while (*end >= '0' && *end <= '9') end++;
+
+    char tail[MAX_URL_LENGTH];
+    strncpy(tail, end, sizeof(tail) - 1);
+    tail[sizeof(tail) - 1] = '\0';
+    snprintf(digits, len - (digits - url), "%d%s", lower, tail);
+    return lower;
+}
+
+/*
+ * Start an asynchronous call, replacing any call still in flight on req
+ */
+static int api_start(api_request_t *req, api_call_t call, const char *method,
+                     const char *url, const char *token, const char *body)
+{
+    api_request_cancel(req);
+
+    http_handle_t http = http_submit(method, url, token, body);
+    if (http < 0) {
+        return -1;
+    }
+
+    req->call = call;
+    req->http = http;
+    return 0;
+}
+
+/*
+ * Start the server reachability check done by api_init()
+ */
+int api_init_async(api_request_t *req, const char *server_url)
+{
+    if (!server_url || strlen(server_url) == 0) {
+        LOG_ERROR("Invalid server URL");
+        return -1;
+    }
+
+    LOG("Initializing API client for: %s", server_url);
+
+    set_base_url(server_url);
+    g_api.initialized = false;
 
     char url[MAX_URL_LENGTH];
-    build_url(url, sizeof(url), "/api/search", query);
+    build_url(url, sizeof(url), "/api/user", NULL);
 
-    LOG("Searching for: %s", query_str);
+    return api_start(req, API_CALL_PING, "GET", url, NULL, NULL);
+}
 
-    char *response = NULL;
-    size_t response_len = 0;
-    int result = http_get_with_auth(url, token, &response, &response_len);
+/*
+ * Start a login; the token is written to token_out when it completes
+ */
+int api_login_async(api_request_t *req, const char *username, const char *password,
+                    char *token_out, size_t token_len)
+{
+    if (!g_api.initialized) return -1;
+    if (!username || !password || !token_out) return -1;
 
-    if (result != 0 || !response) {
-        if (response) free(response);
+    char body[512];
+    char url[MAX_URL_LENGTH];
+    build_login_request(username, password, body, sizeof(body), url, sizeof(url));
+
+    if (api_start(req, API_CALL_LOGIN, "POST", url, NULL, body) < 0) {
         return -1;
     }
+    req->token_out = token_out;
+    req->token_len = token_len;
+    return 0;
+}
 
-    json_value_t *json = json_parse(response);
-    free(response);
+/*
+ * Slot for the next item of a streamed listing. The first item of a new
+ * listing replaces whatever the list held, so the old one stays up until
+ * then; a page goes into the slots set aside for it.
+ */
+static void *listing_item(void *user)
+{
+    api_request_t *req = (api_request_t *)user;
+    media_list_t *list = req->list;
 
-    if (!json) return -1;
+    if (req->streamed++ == 0 && req->call != API_CALL_PAGE) {
+        reset_list(list);
+        list->total = req->total;
+    }
+    if (req->slot >= req->slot_end) return NULL;
 
-    json_value_t *results = json_get_array(json, "results");
-    if (!results) {
-        json_free(json);
-        return 0;
+    media_item_t *item = &list->items[req->slot];
+    memset(item, 0, sizeof(*item));
+    return item;
+}
+
+static int listing_item_done(void *record, void *scratch, void *user)
+{
+    api_request_t *req = (api_request_t *)user;
+    media_list_t *list = req->list;
+
+    settle_item((media_item_t *)record, (const media_hints_t *)scratch,
+                req->call == API_CALL_SEARCH);
+    /* Slots set aside ahead of the window are counted already */
+    if (req->slot++ == list->count) {
+        list->count++;
     }
+    return 0;
+}
+
+/*
+ * Body bytes of a listing, straight from the receive loop
+ */
+static int listing_sink(const char *data, size_t len, void *user)
+{
+    api_request_t *req = (api_request_t *)user;
 
-    int result_count = json_array_length(results);
-    for (int i = 0; i < result_count && list->count < MAX_MEDIA_ITEMS; i++) {
-        json_value_t *item_json = json_array_get(results, i);
-        if (!item_json) continue;
+    if (json_decoder_feed(req->stream, data, len) < 0) {
+        LOG_ERROR("Failed to parse listing: %s", req->url);
+        return -1;
+    }
+    return 0;
+}
 
-        media_item_t *item = &list->items[list->count];
-        memset(item, 0, sizeof(*item));
+/*
+ * Start a listing as a conditional GET against the cached copy. The
+ * body is parsed as it arrives and its items are added to list one by
+ * one, into slots from slot up to slot_end, so the first of them can be
+ * shown while the rest are still on the way. The request keeps the
+ * cache key, since the caller's url and token need not outlive this
+ * call.
+ */
+static int api_start_listing(api_request_t *req, api_call_t call, const char *url,
+                             const char *token, media_list_t *list, int slot, int slot_end)
+{
+    api_request_cancel(req);
 
-        const char *name = json_get_string(item_json, "name");
-        const char *item_path = json_get_string(item_json, "path");
+    if (strlen(url) >= sizeof(req->url) || (token && strlen(token) >= sizeof(req->token))) {
+        return -1;
+    }
+    strcpy(req->url, url);
+    strcpy(req->token, token ? token : "");
+    cache_validators(req->url, req->token, &req->validators);
+
+    json_decode_t spec = { &g_item_schema, call == API_CALL_SEARCH ? "results" : "items",
+                           listing_item, listing_item_done, req,
+                           call == API_CALL_SEARCH ? NULL : &g_request_page_schema, req };
+    req->stream = json_decoder_create(&spec);
+    if (!req->stream) {
+        return -1;
+    }
+    req->call = call;
+    req->list = list;
+    req->streamed = 0;
+    req->slot = slot;
+    req->slot_start = slot;
+    req->slot_end = slot_end;
+    req->total = -1;
+
+    http_handle_t http = http_submit_stream(req->url, token, &req->validators,
+                                            listing_sink, req);
+    if (http < 0) {
+        json_decoder_destroy(req->stream);
+        req->stream = NULL;
+        req->call = API_CALL_NONE;
+        return -1;
+    }
+    req->http = http;
+    return 0;
+}
 
-        if (name) strncpy(item->name, name, sizeof(item->name) - 1);
-        if (item_path) strncpy(item->path, item_path, sizeof(item->path) - 1);
+/*
+ * Settle a streamed listing once the response is complete: a 304 brings
+ * back the cached copy, a whole listing is cached with its validators.
+ * A failed or cut-off listing keeps the items that did arrive but is
+ * not cached.
+ */
+static int finish_streamed_listing(api_request_t *req, int result, bool complete)
+{
+    media_list_t *list = req->list;
 
-        item->is_directory = false;
-        item->type = MEDIA_TYPE_AUDIO;  /* Default for Dreamcast */
+    if (result == 304) {
+        return restore_listing(req->url, req->token, list);
+    }
+    if (result != 0 || !complete) {
+        LOG_ERROR("Request failed: %d", result != 0 ? result : -1);
+        return -1;
+    }
 
-        list->count++;
+    /* An empty listing never replaced the old one */
+    if (req->streamed == 0) {
+        reset_list(list);
+        list->total = req->total;
     }
+    settle_total(list);
+    LOG("Loaded %d of %ld items into list", list->count, (long)list->total);
 
-    json_free(json);
+    cache_store(req->url, req->token, &req->validators, list->items, sizeof(media_item_t),
+                list->count, list->total);
     return 0;
 }
 
 /*
- * Get streaming URL for a file
+ * Start a directory listing with its first page; items are added to
+ * list as they arrive, and the rest is fetched a page at a time with
+ * api_browse_page_async()
  */
-int api_get_stream_url(const char *token, const char *path, char *url_out, size_t url_len)
+int api_browse_async(api_request_t *req, const char *token, const char *path,
+                     media_list_t *list)
 {
-    if (!g_api.initialized || !path || !url_out) return -1;
+    if (!g_api.initialized || !list) return -1;
 
-    /* Build audio streaming URL */
-    char encoded_path[MAX_PATH_LENGTH * 3];
-    url_encode(path, encoded_path, sizeof(encoded_path));
+    char url[MAX_URL_LENGTH];
+    build_browse_url(path, 0, url, sizeof(url));
 
-    /* For Dreamcast, prefer audio transcoding to supported format */
-    snprintf(url_out, url_len, "%s/api/audio-transcode?path=%s&format=mp3&bitrate=128",
-             g_api.base_url, encoded_path);
+    LOG("Browsing: %s", path);
 
-    LOG("Stream URL: %s", url_out);
+    return api_start_listing(req, API_CALL_BROWSE, url, token, list, 0, MEDIA_PAGE_ITEMS);
+}
+
+/*
+ * Page the list should fetch next: the one past whichever end of the
+ * window the selection is within MEDIA_PREFETCH_ITEMS of. Returns its
+ * first listing index, or -1 when the pages around the selection are
+ * all held.
+ */
+int32_t api_browse_next_page(const media_list_t *list)
+{
+    int32_t end = list->first + list->count;
+
+    if (list->selected_index >= end - MEDIA_PREFETCH_ITEMS && end < list->total) {
+        return end;
+    }
+    if (list->selected_index < list->first + MEDIA_PREFETCH_ITEMS && list->first > 0) {
+        return list->first - MEDIA_PAGE_ITEMS;
+    }
+    return -1;
+}
+
+/*
+ * Make room in the window for the page starting at listing index first,
+ * dropping pages from the far end once WINDOW_ITEMS are held. A page
+ * before the window gets blank slots at the front, which it fills as it
+ * arrives. Returns the slot the page starts at, or -1 if the page does
+ * not border the window.
+ */
+static int open_page(media_list_t *list, int32_t first, bool *prepend)
+{
+    if (first == list->first + list->count) {
+        while (list->count + MEDIA_PAGE_ITEMS > WINDOW_ITEMS) {
+            list->count -= MEDIA_PAGE_ITEMS;
+            memmove(list->items, list->items + MEDIA_PAGE_ITEMS,
+                    list->count * sizeof(media_item_t));
+            list->first += MEDIA_PAGE_ITEMS;
+        }
+        *prepend = false;
+        return list->count;
+    }
+
+    if (first >= 0 && first == list->first - MEDIA_PAGE_ITEMS) {
+        int keep = MIN(list->count, WINDOW_ITEMS - MEDIA_PAGE_ITEMS);
+        memmove(list->items + MEDIA_PAGE_ITEMS, list->items, keep * sizeof(media_item_t));
+        memset(list->items, 0, MEDIA_PAGE_ITEMS * sizeof(media_item_t));
+        list->first = first;
+        list->count = keep + MEDIA_PAGE_ITEMS;
+        *prepend = true;
+        return 0;
+    }
+    return -1;
+}
+
+/*
+ * Give back the slots of a page that will not arrive in full, so the
+ * window only ever holds whole pages and the page can be asked for again
+ */
+static void close_page(media_list_t *list, bool prepend, int slot_start)
+{
+    if (prepend) {
+        list->count -= MEDIA_PAGE_ITEMS;
+        memmove(list->items, list->items + MEDIA_PAGE_ITEMS, list->count * sizeof(media_item_t));
+        list->first += MEDIA_PAGE_ITEMS;
+    } else {
+        list->count = slot_start;
+    }
+}
+
+/*
+ * Start fetching the page of list's directory that begins at listing
+ * index first, which must border the window, in the background. Pages
+ * far from it are dropped to make room; its items appear as they
+ * arrive.
+ */
+int api_browse_page_async(api_request_t *req, const char *token, const char *path,
+                          media_list_t *list, int32_t first)
+{
+    if (!g_api.initialized || !list) return -1;
+    api_request_cancel(req);
+
+    char url[MAX_URL_LENGTH];
+    build_browse_url(path, first, url, sizeof(url));
+
+    bool prepend;
+    int slot = open_page(list, first, &prepend);
+    if (slot < 0) {
+        return -1;
+    }
+
+    if (api_start_listing(req, API_CALL_PAGE, url, token, list,
+                          slot, slot + MEDIA_PAGE_ITEMS) < 0) {
+        close_page(list, prepend, slot);
+        return -1;
+    }
+    req->prepend = prepend;
+    return 0;
+}
+
+/*
+ * Settle a page once the response is complete. A 304 brings back the
+ * cached copy; a fresh page is cached with its validators. A page that
+ * failed or was cut off is given up.
+ */
+static int finish_page(api_request_t *req, int result, bool complete)
+{
+    media_list_t *list = req->list;
+    media_item_t *page = &list->items[req->slot_start];
+    int count;
+
+    if (result == 304) {
+        count = cache_restore(req->url, req->token, page, sizeof(media_item_t),
+                              req->slot_end - req->slot_start, &req->total);
+        if (count < 0) {
+            LOG_ERROR("Not modified, but no longer cached: %s", req->url);
+        }
+    } else if (result != 0 || !complete) {
+        LOG_ERROR("Request failed: %d", result != 0 ? result : -1);
+        count = -1;
+    } else {
+        count = req->slot - req->slot_start;
+        cache_store(req->url, req->token, &req->validators, page, sizeof(media_item_t), count,
+                    req->total);
+    }
+
+    if (count < 0) {
+        close_page(list, req->prepend, req->slot_start);
+        return -1;
+    }
+    if (!req->prepend) {
+        list->count = req->slot_start + count;
+    }
+    if (req->total >= 0) {
+        list->total = req->total;
+    }
+    settle_total(list);
+
+    LOG("Holding items %ld-%ld of %ld", (long)list->first,
+        (long)(list->first + list->count - 1), (long)list->total);
     return 0;
 }
+
+/*
+ * Start a search; results are added to list as they arrive
+ */
+int api_search_async(api_request_t *req, const char *token, const char *query_str,
+                     media_list_t *list)
+{
+    if (!g_api.initialized || !list || !query_str) return -1;
+
+    char url[MAX_URL_LENGTH];
+    build_search_url(query_str, url, sizeof(url));
+
+    LOG("Searching for: %s", query_str);
+
+    return api_start_listing(req, API_CALL_SEARCH, url, token, list, 0, MAX_MEDIA_ITEMS);
+}
+
+/*
+ * Check an asynchronous call. Returns API_PENDING while in flight, then
+ * the same result as the blocking call; req is idle again afterwards.
+ */
+int api_request_poll(api_request_t *req)
+{
+    if (req->call == API_CALL_NONE) return -1;
+
+    char *response = NULL;
+    size_t response_len = 0;
+    int result = http_poll_conditional(req->http, &req->validators, &response, &response_len);
+
+    if (result == HTTP_IN_PROGRESS) {
+        return API_PENDING;
+    }
+
+    api_call_t call = req->call;
+    req->call = API_CALL_NONE;
+    req->http = -1;
+
+    switch (call) {
+        case API_CALL_PING:
+            /* 401 Unauthorized is expected without auth - server is reachable */
+            if (result == 0 || result == 401) {
+                LOG("Server reachable");
+                g_api.initialized = true;
+                result = 0;
+            } else {
+                LOG_ERROR("Failed to connect to server: %d", result);
+                result = -1;
+            }
+            break;
+
+        case API_CALL_LOGIN:
+            if (result != 0 || !response) {
+                LOG_ERROR("Login request failed: %d", result);
+                result = -1;
+            } else {
+                result = parse_login_response(response, response_len,
+                                              req->token_out, req->token_len);
+            }
+            break;
+
+        case API_CALL_BROWSE:
+        case API_CALL_SEARCH:
+        case API_CALL_PAGE: {
+            bool complete = json_decoder_done(req->stream);
+            json_decoder_destroy(req->stream);
+            req->stream = NULL;
+
+            result = call == API_CALL_PAGE ? finish_page(req, result, complete)
+                                           : finish_streamed_listing(req, result, complete);
+            break;
+        }
+
+        default:
+            result = -1;
+            break;
+    }
+
+    free(response);
+    return result;
+}
+
+/*
+ * Abandon an asynchronous call
+ */
+void api_request_cancel(api_request_t *req)
+{
+    if (req->call != API_CALL_NONE) {
+        http_cancel(req->http);
+    }
+    if (req->call == API_CALL_PAGE) {
+        close_page(req->list, req->prepend, req->slot_start);
+    }
+    json_decoder_destroy(req->stream);
+    req->stream = NULL;
+    req->call = API_CALL_NONE;
+    req->http = -1;
+}
+
+/*
+ * Check whether a call is in flight
+ */
+bool api_request_pending(const api_request_t *req)
+{
+    return req->call != API_CALL_NONE;
+}
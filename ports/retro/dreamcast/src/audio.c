@@ -48,9 +48,16 @@ static struct {
     double duration;
 
     /* Network streaming state */
-    int socket;
-    size_t content_length;
+    http_stream_t net;
+    size_t skip_bytes;          /* Leading bytes to drop when Range was ignored */
     size_t bytes_received;
+    size_t fill_len[NUM_BUFFERS];
+
+    /* Adaptive bitrate */
+    int stream_kbps;            /* Nominal rate of a transcoded stream, 0 for PCM */
+    uint64 opened_ms;           /* When the stream was last (re)opened */
+    uint64 low_since_ms;        /* When it fell below the low-water mark, 0 if not */
+    size_t low_since_bytes;     /* bytes_received at that point */
 
     /* Decoding state (placeholder for MP3/AAC decoder) */
     void *decoder_ctx;
@@ -121,6 +128,7 @@ int audio_init(void)
 
     memset(&g_audio, 0, sizeof(g_audio));
     g_audio.volume = 100;
+    g_audio.net.socket = -1;
 
     /* Initialize sound system */
     snd_init();
@@ -264,6 +272,60 @@ static int open_wav_file(const char *path)
     return 0;
 }
 
+/*
+ * Frame size and byte rate of the current source.
+ * Transcoded streams are constant bitrate; other network streams are raw
+ * PCM at AUDIO_SAMPLE_RATE, 16-bit, AUDIO_CHANNELS.
+ */
+static void source_format(size_t *frame_bytes, uint32_t *bytes_per_sec)
+{
+    if (g_wav_state.is_open) {
+        *frame_bytes = g_wav_state.channels * (g_wav_state.bits_per_sample / 8);
+        *bytes_per_sec = g_wav_state.sample_rate * *frame_bytes;
+    } else if (g_audio.stream_kbps > 0) {
+        *frame_bytes = 1;
+        *bytes_per_sec = g_audio.stream_kbps * 125;
+    } else {
+        *frame_bytes = AUDIO_CHANNELS * 2;
+        *bytes_per_sec = AUDIO_SAMPLE_RATE * *frame_bytes;
+    }
+}
+
+/*
+ * (Re)open the network stream for current_url at a byte offset
+ */
+static int open_network_stream(size_t offset)
+{
+    const char *token = g_app.settings.session_token[0] ?
+                        g_app.settings.session_token : NULL;
+
+    http_stream_close(&g_audio.net);
+
+    int result = http_stream_open(&g_audio.net, g_audio.current_url, token, offset);
+    if (result != 0) {
+        LOG_ERROR("Failed to open audio stream (%d)", result);
+        return result;
+    }
+
+    /* A server that ignores Range restarts at byte 0 */
+    g_audio.skip_bytes = 0;
+    if (g_audio.net.offset < offset) {
+        g_audio.skip_bytes = offset - g_audio.net.offset;
+        LOG("Server ignored Range, skipping %lu bytes", (unsigned long)g_audio.skip_bytes);
+    }
+
+    if (g_audio.net.total > 0) {
+        size_t frame_bytes;
+        uint32_t bytes_per_sec;
+        source_format(&frame_bytes, &bytes_per_sec);
+        g_audio.duration = (double)g_audio.net.total / bytes_per_sec;
+    }
+
+    g_audio.opened_ms = timer_ms_gettime64();
+    g_audio.low_since_ms = 0;
+    return 0;
+}
+
 /*
  * Fill buffer from local WAV file
  */
@@ -329,23 +391,40 @@ static int fill_buffer(int buf_idx)
      * audio to raw PCM (44100 Hz, stereo, 16-bit) before streaming.
      * This avoids the need for a software decoder on the DC.
      */
-    if (g_audio.socket > 0) {
-        ssize_t bytes = recv(g_audio.socket, g_audio.buffers[buf_idx],
-                             AUDIO_BUFFER_SIZE, MSG_DONTWAIT);
-        if (bytes > 0) {
-            g_audio.bytes_received += bytes;
-            if ((size_t)bytes < AUDIO_BUFFER_SIZE) {
-                memset(g_audio.buffers[buf_idx] + bytes, 0,
-                       AUDIO_BUFFER_SIZE - bytes);
+    if (g_audio.net.priv) {
+        /*
+         * Accumulate until the buffer is full so sample frames stay
+         * aligned; the callback plays silence while it is not ready.
+         */
+        uint8 *buf = g_audio.buffers[buf_idx];
+
+        while (g_audio.fill_len[buf_idx] < AUDIO_BUFFER_SIZE) {
+            uint8 *dst = buf + g_audio.fill_len[buf_idx];
+            int bytes = http_stream_read(&g_audio.net, dst,
+                                         AUDIO_BUFFER_SIZE - g_audio.fill_len[buf_idx]);
+            if (bytes == 0) {
+                return 0;  /* Would block - try again next update */
             }
-        } else if (bytes == 0) {
-            /* Connection closed - end of stream */
-            g_audio.playing = false;
-            memset(g_audio.buffers[buf_idx], 0, AUDIO_BUFFER_SIZE);
-        } else {
-            /* Would block - fill with silence temporarily */
-            memset(g_audio.buffers[buf_idx], 0, AUDIO_BUFFER_SIZE);
+            if (bytes < 0) {
+                /* End of stream */
+                g_audio.playing = false;
+                memset(dst, 0, AUDIO_BUFFER_SIZE - g_audio.fill_len[buf_idx]);
+                break;
+            }
+
+            size_t got = bytes;
+            if (g_audio.skip_bytes > 0) {
+                size_t drop = MIN(got, g_audio.skip_bytes);
+                memmove(dst, dst + drop, got - drop);
+                g_audio.skip_bytes -= drop;
+                got -= drop;
+            }
+
+            g_audio.fill_len[buf_idx] += got;
+            g_audio.bytes_received += got;
         }
+
+        g_audio.fill_len[buf_idx] = 0;
     } else {
         /* No active source - silence */
         memset(g_audio.buffers[buf_idx], 0, AUDIO_BUFFER_SIZE);
@@ -384,19 +463,21 @@ int audio_play(const char *url)
         }
     } else {
         /*
-         * Network streaming:
-         * 1. The Nedflix server should transcode to raw PCM
-         * 2. Open streaming connection
-         * 3. Start receiving audio data
-         *
-         * For network streams, duration comes from server metadata
+         * Network streaming: the Nedflix server transcodes to raw PCM.
+         * Duration comes from the resource size when the server sends one.
          */
         g_audio.duration = 180.0;  /* Default estimate */
+        g_audio.stream_kbps = api_stream_bitrate(url);
+        if (open_network_stream(0) != 0) {
+            return -1;
+        }
     }
 
     /* Pre-fill buffers */
     g_audio.buffer_ready[0] = false;
     g_audio.buffer_ready[1] = false;
+    g_audio.fill_len[0] = 0;
+    g_audio.fill_len[1] = 0;
     g_audio.current_buffer = 0;
     g_audio.buffer_pos = 0;
 
@@ -429,7 +510,7 @@ int audio_play(const char *url)
  */
 void audio_stop(void)
 {
-    if (!g_audio.playing && !g_wav_state.is_open && g_audio.socket <= 0) {
+    if (!g_audio.playing && !g_wav_state.is_open && !g_audio.net.priv) {
         return;
     }
 
@@ -447,6 +528,7 @@ void audio_stop(void)
     /* Clear buffers */
     for (int i = 0; i < NUM_BUFFERS; i++) {
         g_audio.buffer_ready[i] = false;
+        g_audio.fill_len[i] = 0;
         if (g_audio.buffers[i]) {
             memset(g_audio.buffers[i], 0, AUDIO_BUFFER_SIZE);
         }
@@ -465,10 +547,8 @@ void audio_stop(void)
     }
 
     /* Close network connection if open */
-    if (g_audio.socket > 0) {
-        close(g_audio.socket);
-        g_audio.socket = 0;
-    }
+    http_stream_close(&g_audio.net);
+    g_audio.skip_bytes = 0;
 
     /* Clean up decoder context */
     if (g_audio.decoder_ctx) {
@@ -514,15 +594,36 @@ void audio_seek(double seconds)
 
     LOG("Seeking audio to %.1f seconds", seconds);
 
-    /*
-     * In a real implementation:
-     * 1. Calculate byte offset for seek position
-     * 2. Send HTTP Range request for streaming
-     * 3. Flush decoder and buffers
-     * 4. Resume decoding from new position
-     */
+    /* Byte offset of the first whole frame at the target time */
+    size_t frame_bytes;
+    uint32_t bytes_per_sec;
+    source_format(&frame_bytes, &bytes_per_sec);
+    size_t offset = (size_t)(seconds * bytes_per_sec) / frame_bytes * frame_bytes;
 
-    g_audio.position = seconds;
+    /* Flush: the callback plays silence until refilled */
+    mutex_lock(&audio_mutex);
+    for (int i = 0; i < NUM_BUFFERS; i++) {
+        g_audio.buffer_ready[i] = false;
+        g_audio.fill_len[i] = 0;
+    }
+    g_audio.current_buffer = 0;
+    g_audio.buffer_pos = 0;
+    g_audio.position = (double)offset / bytes_per_sec;
+    mutex_unlock(&audio_mutex);
+
+    if (g_wav_state.is_open) {
+        if (offset > g_wav_state.data_size) offset = g_wav_state.data_size;
+        fs_seek(g_wav_state.handle, g_wav_state.data_offset + offset, SEEK_SET);
+        g_wav_state.bytes_played = offset;
+    } else if (open_network_stream(offset) != 0) {
+        /* 416 means the offset is past the end */
+        g_audio.playing = false;
+        return;
+    }
+
+    /* One round trip, then refill straight away */
+    fill_buffer(0);
+    fill_buffer(1);
 }
 
 /*
@@ -545,6 +646,57 @@ int audio_get_volume(void)
     return g_audio.volume;
 }
 
+/*
+ * Adaptive bitrate: step a transcoded stream down when the network stops
+ * keeping up with playback.
+ *
+ * Occupancy is the audio ready to play: whole buffers, less what the
+ * callback has already taken from the current one. A buffer still being
+ * filled does not count. Below ABR_LOW_WATER_PCT of the double buffer for
+ * ABR_LOW_WATER_MS, the stream is reopened one bitrate lower at the same
+ * position. What arrived in the meantime is what the network can really
+ * carry, so it also goes into the throughput estimate for the next track.
+ */
+static void abr_check(void)
+{
+    if (!g_audio.net.priv || g_audio.stream_kbps == 0) return;
+
+    uint64 now = timer_ms_gettime64();
+    if (now - g_audio.opened_ms < ABR_SETTLE_MS) return;
+
+    size_t ready = 0;
+    mutex_lock(&audio_mutex);
+    for (int i = 0; i < NUM_BUFFERS; i++) {
+        if (g_audio.buffer_ready[i]) ready += AUDIO_BUFFER_SIZE;
+    }
+    if (g_audio.buffer_ready[g_audio.current_buffer]) ready -= g_audio.buffer_pos;
+    mutex_unlock(&audio_mutex);
+
+    if (ready >= NUM_BUFFERS * AUDIO_BUFFER_SIZE * ABR_LOW_WATER_PCT / 100) {
+        g_audio.low_since_ms = 0;
+        return;
+    }
+    if (g_audio.low_since_ms == 0) {
+        g_audio.low_since_ms = now;
+        g_audio.low_since_bytes = g_audio.bytes_received;
+        return;
+    }
+    if (now - g_audio.low_since_ms < ABR_LOW_WATER_MS) return;
+
+    http_throughput_sample(g_audio.bytes_received - g_audio.low_since_bytes,
+                           (now - g_audio.low_since_ms) * 1000);
+
+    int kbps = api_stream_step_down(g_audio.current_url, sizeof(g_audio.current_url));
+    if (kbps < 0) {
+        g_audio.low_since_ms = 0;  /* Already the lowest; measure again later */
+        return;
+    }
+
+    LOG("Audio buffer running dry, stepping down to %d kbps", kbps);
+    g_audio.stream_kbps = kbps;
+    audio_seek(g_audio.position);
+}
+
 /*
  * Update audio streaming (call from main loop)
  */
@@ -559,6 +711,8 @@ void audio_update(void)
         }
     }
 
+    abr_check();
+
     /* Poll the stream to keep it running */
     snd_stream_poll(g_audio.stream);
 
@@ -26,6 +26,12 @@ static const char *lib_paths[] = {
     "/TV Shows"
 };
 
+/* In-flight API calls, polled from the state handlers each frame */
+static api_request_t g_connect_req;
+static api_request_t g_browse_req;
+static api_request_t g_page_req;        /* Pages of a long listing, behind the cursor */
+static uint32_t g_page_retry_frame;     /* No page fetch before this frame after a failure */
+
 /* State handlers */
 static void state_init(void);
 static void state_network(void);
@@ -36,6 +42,7 @@ static void state_browsing(void);
 static void state_playing(void);
 static void state_settings(void);
 static void state_error(void);
+static void start_browse(void);
 
 /*
  * Initialize application
@@ -63,6 +70,13 @@ void app_init(void)
         DBG("Audio init failed (non-fatal)");
     }
 
+    /* Built with CAPTURE= or REPLAY=: record HTTP traffic or play it back */
+#if defined(NETREPLAY_CAPTURE)
+    netreplay_capture(NETREPLAY_CAPTURE);
+#elif defined(NETREPLAY_REPLAY)
+    netreplay_replay(NETREPLAY_REPLAY, NETREPLAY_SPEED);
+#endif
+
     /* Start network init */
     g_app.state = STATE_NETWORK_INIT;
 
@@ -88,6 +102,9 @@ void app_run(void)
         /* Update input */
         input_update();
 
+        /* Advance in-flight HTTP requests without blocking the frame */
+        http_update();
+
         /* Global exit check */
         if (input_pressed(DC_BTN_START) && input_held(DC_BTN_A) && input_held(DC_BTN_B)) {
             DBG("Exit requested");
@@ -95,25 +112,34 @@ void app_run(void)
             continue;
         }
 
-        /* Begin frame */
-        ui_begin_frame();
-        ui_draw_background();
-
-        /* Run state handler */
-        switch (g_app.state) {
-            case STATE_INIT:        state_init(); break;
-            case STATE_NETWORK_INIT: state_network(); break;
-            case STATE_CONNECTING:  state_connecting(); break;
-            case STATE_LOGIN:       state_login(); break;
-            case STATE_MENU:        state_menu(); break;
-            case STATE_BROWSING:    state_browsing(); break;
-            case STATE_PLAYING:     state_playing(); break;
-            case STATE_SETTINGS:    state_settings(); break;
-            case STATE_ERROR:       state_error(); break;
+        if (input_held(DC_BTN_START) && input_pressed(DC_BTN_Y)) {
+            g_app.show_netstats = !g_app.show_netstats;
         }
 
-        /* End frame */
-        ui_end_frame();
+        /* The timing screen stands in for the current state until closed */
+        if (g_app.show_netstats) {
+            ui_draw_netstats();
+        } else {
+            /* Begin frame */
+            ui_begin_frame();
+            ui_draw_background();
+
+            /* Run state handler */
+            switch (g_app.state) {
+                case STATE_INIT:        state_init(); break;
+                case STATE_NETWORK_INIT: state_network(); break;
+                case STATE_CONNECTING:  state_connecting(); break;
+                case STATE_LOGIN:       state_login(); break;
+                case STATE_MENU:        state_menu(); break;
+                case STATE_BROWSING:    state_browsing(); break;
+                case STATE_PLAYING:     state_playing(); break;
+                case STATE_SETTINGS:    state_settings(); break;
+                case STATE_ERROR:       state_error(); break;
+            }
+
+            /* End frame */
+            ui_end_frame();
+        }
 
         /* Update audio if playing */
         if (g_app.state == STATE_PLAYING) {
@@ -131,6 +157,9 @@ void app_shutdown(void)
 {
     DBG("Shutting down...");
 
+    api_request_cancel(&g_connect_req);
+    api_request_cancel(&g_browse_req);
+    api_request_cancel(&g_page_req);
     audio_stop();
     audio_shutdown();
     net_shutdown();
@@ -165,7 +194,8 @@ static void state_network(void)
             break;
 
         case 1:
-            if (net_init() == 0) {
+            /* A replay needs no adapter */
+            if (netreplay_replaying() || net_init() == 0) {
                 DBG("Network initialized");
                 phase = 0;
 #if NEDFLIX_CLIENT_MODE
@@ -194,25 +224,29 @@ static void state_network(void)
  */
 static void state_connecting(void)
 {
-    static bool started = false;
-
     ui_draw_loading("Connecting to server...");
 
-    if (!started) {
-        started = true;
-        int result = api_init(g_app.settings.server_url);
-        started = false;
+    if (!api_request_pending(&g_connect_req)) {
+        if (api_init_async(&g_connect_req, g_app.settings.server_url) < 0) {
+            app_set_error("Cannot connect to server.\nCheck URL in settings.");
+        }
+        return;
+    }
+
+    int result = api_request_poll(&g_connect_req);
+    if (result == API_PENDING) {
+        return;
+    }
 
-        if (result == 0) {
-            /* Check for saved session */
-            if (strlen(g_app.settings.session_token) > 0) {
-                g_app.state = STATE_MENU;
-            } else {
-                g_app.state = STATE_LOGIN;
-            }
+    if (result == 0) {
+        /* Check for saved session */
+        if (strlen(g_app.settings.session_token) > 0) {
+            g_app.state = STATE_MENU;
         } else {
-            app_set_error("Cannot connect to server.\nCheck URL in settings.");
+            g_app.state = STATE_LOGIN;
         }
+    } else {
+        app_set_error("Cannot connect to server.\nCheck URL in settings.");
     }
 }
 
@@ -300,16 +334,10 @@ static void state_menu(void)
     if (input_pressed(DC_BTN_A)) {
         if (selected < 4) {
             g_app.current_library = (library_t)selected;
-            strncpy(g_app.media.path, lib_paths[selected], MAX_PATH_LENGTH - 1);
-            g_app.media.count = 0;
-            g_app.media.selected = 0;
-            g_app.media.scroll = 0;
+            strncpy(g_app.media.current_path, lib_paths[selected], MAX_PATH_LENGTH - 1);
 
 #if NEDFLIX_CLIENT_MODE
-            api_browse(g_app.settings.session_token,
-                       g_app.media.path,
-                       g_app.current_library,
-                       &g_app.media);
+            start_browse();
 #endif
             g_app.state = STATE_BROWSING;
         } else {
@@ -322,6 +350,65 @@ static void state_menu(void)
     }
 }
 
+/*
+ * Request the listing for g_app.media.current_path; any listing still
+ * loading is cancelled, along with pages of the old one. The result
+ * lands in g_app.media from state_browsing().
+ */
+static void start_browse(void)
+{
+    api_request_cancel(&g_page_req);
+    g_page_retry_frame = 0;
+
+    /* Nothing of the old listing is shown under the new path */
+    g_app.media.count = 0;
+    g_app.media.first = 0;
+    g_app.media.total = 0;
+    g_app.media.selected_index = 0;
+    g_app.media.scroll_offset = 0;
+
+    if (api_browse_async(&g_browse_req, g_app.settings.session_token,
+                         g_app.media.current_path, &g_app.media) < 0) {
+        ERR("Failed to start browse of %s", g_app.media.current_path);
+    }
+}
+
+/*
+ * Keep the pages around the cursor loaded: once the selection nears an
+ * end of what the list holds, the next page past it is fetched while
+ * browsing goes on, and the page farthest away makes room for it.
+ * Returns true while a page is on its way.
+ */
+static bool update_pages(void)
+{
+    if (api_request_pending(&g_page_req)) {
+        int result = api_request_poll(&g_page_req);
+        if (result == API_PENDING) {
+            return true;
+        }
+        if (result != 0) {
+            ERR("Page of %s failed", g_app.media.current_path);
+            g_page_retry_frame = g_app.frame_count + 120;   /* ~2 seconds at 60fps */
+        }
+        return false;
+    }
+
+    if (api_request_pending(&g_browse_req) || g_app.frame_count < g_page_retry_frame) {
+        return false;
+    }
+
+    int32_t first = api_browse_next_page(&g_app.media);
+    if (first < 0) {
+        return false;
+    }
+    if (api_browse_page_async(&g_page_req, g_app.settings.session_token,
+                              g_app.media.current_path, &g_app.media, first) < 0) {
+        g_page_retry_frame = g_app.frame_count + 120;
+        return false;
+    }
+    return true;
+}
+
 /*
  * STATE: Browsing media
  */
@@ -331,23 +418,44 @@ static void state_browsing(void)
     snprintf(header, sizeof(header), "%s", lib_names[g_app.current_library]);
     ui_draw_header(header);
 
+    /* Pick up the listing once it arrives; input stays live meanwhile */
+    bool loading = false;
+    if (api_request_pending(&g_browse_req)) {
+        int result = api_request_poll(&g_browse_req);
+        if (result == API_PENDING) {
+            loading = true;
+        } else if (result != 0) {
+            ERR("Browse of %s failed", g_app.media.current_path);
+        }
+    }
+
+#if NEDFLIX_CLIENT_MODE
+    if (update_pages()) {
+        loading = true;
+    }
+#endif
+
     /* Draw file list */
     ui_draw_media_list(&g_app.media);
+    if (loading) {
+        ui_draw_text(40, 420, "Loading...", COLOR_TEXT_DIM);
+    }
 
-    /* Navigation */
+    /* Navigation, within the entries the list holds */
+    media_list_t *list = &g_app.media;
     if (input_pressed(DC_BTN_UP)) {
-        if (g_app.media.selected > 0) {
-            g_app.media.selected--;
-            if (g_app.media.selected < g_app.media.scroll) {
-                g_app.media.scroll--;
+        if (list->selected_index > list->first) {
+            list->selected_index--;
+            if (list->selected_index < list->scroll_offset) {
+                list->scroll_offset--;
             }
         }
     }
     if (input_pressed(DC_BTN_DOWN)) {
-        if (g_app.media.selected < g_app.media.count - 1) {
-            g_app.media.selected++;
-            if (g_app.media.selected >= g_app.media.scroll + MAX_ITEMS_VISIBLE) {
-                g_app.media.scroll++;
+        if (list->selected_index < list->first + list->count - 1) {
+            list->selected_index++;
+            if (list->selected_index >= list->scroll_offset + MAX_ITEMS_VISIBLE) {
+                list->scroll_offset++;
             }
         }
     }
@@ -355,35 +463,26 @@ static void state_browsing(void)
     /* Switch library with L/R triggers */
     if (g_app.ltrig > 200 && input_pressed(DC_BTN_LEFT)) {
         g_app.current_library = (g_app.current_library - 1 + LIBRARY_COUNT) % LIBRARY_COUNT;
-        strncpy(g_app.media.path, lib_paths[g_app.current_library], MAX_PATH_LENGTH - 1);
-        g_app.media.count = 0;
+        strncpy(g_app.media.current_path, lib_paths[g_app.current_library], MAX_PATH_LENGTH - 1);
 #if NEDFLIX_CLIENT_MODE
-        api_browse(g_app.settings.session_token, g_app.media.path,
-                   g_app.current_library, &g_app.media);
+        start_browse();
 #endif
     }
     if (g_app.rtrig > 200 && input_pressed(DC_BTN_RIGHT)) {
         g_app.current_library = (g_app.current_library + 1) % LIBRARY_COUNT;
-        strncpy(g_app.media.path, lib_paths[g_app.current_library], MAX_PATH_LENGTH - 1);
-        g_app.media.count = 0;
+        strncpy(g_app.media.current_path, lib_paths[g_app.current_library], MAX_PATH_LENGTH - 1);
 #if NEDFLIX_CLIENT_MODE
-        api_browse(g_app.settings.session_token, g_app.media.path,
-                   g_app.current_library, &g_app.media);
+        start_browse();
 #endif
     }
 
     /* Select item */
-    if (input_pressed(DC_BTN_A) && g_app.media.count > 0) {
-        media_item_t *item = &g_app.media.items[g_app.media.selected];
-
-        if (item->flags & 1) {  /* is_directory */
-            strncpy(g_app.media.path, item->path, MAX_PATH_LENGTH - 1);
-            g_app.media.count = 0;
-            g_app.media.selected = 0;
-            g_app.media.scroll = 0;
+    media_item_t *item = media_list_item(list, list->selected_index);
+    if (input_pressed(DC_BTN_A) && item && item->path[0]) {
+        if (item->is_directory) {
+            strncpy(g_app.media.current_path, item->path, MAX_PATH_LENGTH - 1);
 #if NEDFLIX_CLIENT_MODE
-            api_browse(g_app.settings.session_token, g_app.media.path,
-                       g_app.current_library, &g_app.media);
+            start_browse();
 #endif
         } else {
             /* Play media */
@@ -393,9 +492,9 @@ static void state_browsing(void)
                                    stream_url, sizeof(stream_url)) == 0) {
                 strncpy(g_app.playback.title, item->name, MAX_TITLE_LENGTH - 1);
                 strncpy(g_app.playback.url, stream_url, MAX_URL_LENGTH - 1);
-                g_app.playback.is_audio = (item->type == MEDIA_AUDIO);
+                g_app.playback.is_audio = (item->type == MEDIA_TYPE_AUDIO);
 
-                if (item->type == MEDIA_AUDIO) {
+                if (item->type == MEDIA_TYPE_AUDIO) {
                     if (audio_play_stream(stream_url) == 0) {
                         g_app.playback.playing = true;
                         g_app.state = STATE_PLAYING;
@@ -412,14 +511,11 @@ static void state_browsing(void)
     /* Go back */
     if (input_pressed(DC_BTN_B)) {
         /* Go up one directory or back to menu */
-        char *last_slash = strrchr(g_app.media.path, '/');
-        if (last_slash && last_slash != g_app.media.path) {
+        char *last_slash = strrchr(g_app.media.current_path, '/');
+        if (last_slash && last_slash != g_app.media.current_path) {
             *last_slash = '\0';
-            g_app.media.count = 0;
-            g_app.media.selected = 0;
 #if NEDFLIX_CLIENT_MODE
-            api_browse(g_app.settings.session_token, g_app.media.path,
-                       g_app.current_library, &g_app.media);
+            start_browse();
 #endif
         } else {
             g_app.state = STATE_MENU;
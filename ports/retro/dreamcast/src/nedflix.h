@@ -32,6 +32,8 @@
 #include <stdint.h>
 #include <stddef.h>
 
+#include "core.h"
+
 /* Version */
 #define NEDFLIX_VERSION "1.0.0-dc"
 
@@ -44,18 +46,20 @@
 #define SCREEN_WIDTH  640
 #define SCREEN_HEIGHT 480
 
-/* Memory constraints - be VERY conservative! */
-#define MAX_PATH_LENGTH     256
-#define MAX_URL_LENGTH      384
-#define MAX_TITLE_LENGTH    128
+/* List limits; buffer sizes are in core/core_config.h */
 #define MAX_ITEMS_VISIBLE   8
-#define MAX_MEDIA_ITEMS     50   /* Limited list size to save RAM */
 
 /* Network settings */
-#define HTTP_TIMEOUT_MS     10000
-#define RECV_BUFFER_SIZE    4096
 #define STREAM_BUFFER_SIZE  (256 * 1024)  /* 256KB audio buffer */
 
+
+/* Adaptive bitrate for transcoded audio */
+#define ABR_HEADROOM_PCT      70     /* Stream at most this share of the estimate */
+#define ABR_DEFAULT_KBPS      128    /* Before any transfer has been measured */
+#define ABR_LOW_WATER_PCT     25     /* Buffered audio that counts as running dry */
+#define ABR_LOW_WATER_MS      1500   /* Time spent there before stepping down */
+#define ABR_SETTLE_MS         3000   /* Grace after a stream (re)opens */
+
 /* Colors (PVR format: ARGB) */
 #define COLOR_BLACK       0xFF000000
 #define COLOR_WHITE       0xFFFFFFFF
@@ -79,14 +83,6 @@ typedef enum {
     STATE_ERROR
 } app_state_t;
 
-/* Media types */
-typedef enum {
-    MEDIA_TYPE_UNKNOWN,
-    MEDIA_TYPE_DIRECTORY,
-    MEDIA_TYPE_AUDIO,
-    MEDIA_TYPE_VIDEO
-} media_type_t;
-
 /* Library types */
 typedef enum {
     LIBRARY_MUSIC,      /* Primary - works best on DC */
@@ -138,15 +134,23 @@ typedef struct {
     uint16_t duration;  /* seconds, for audio */
 } media_item_t;
 
-/* Media list */
+/*
+ * Media list: a window onto a listing that may be far longer than
+ * MAX_MEDIA_ITEMS. It holds whole pages of MEDIA_PAGE_ITEMS entries
+ * around the cursor; items[0] is entry first of the listing, and the
+ * selection and scroll position count from the start of the listing.
+ */
 typedef struct {
     media_item_t items[MAX_MEDIA_ITEMS];
-    int16_t count;
-    int16_t selected_index;
-    int16_t scroll_offset;
+    int16_t count;          /* Entries held, from first */
+    int32_t first;
+    int32_t total;          /* Entries in the whole listing */
+    int32_t selected_index;
+    int32_t scroll_offset;
     char current_path[MAX_PATH_LENGTH];
 } media_list_t;
 
+
 /* User settings (fits in VMU) */
 typedef struct {
     char server_url[MAX_URL_LENGTH];
@@ -205,6 +209,9 @@ typedef struct {
     /* Error handling */
     char error_msg[128];
 
+    /* Network timing screen, toggled with START+Y */
+    bool show_netstats;
+
     /* Running flag */
     bool running;
 } app_t;
@@ -246,6 +253,26 @@ int http_get_with_auth(const char *url, const char *token, char **response, size
 int http_post(const char *url, const char *body, char **response, size_t *len);
 int http_post_with_auth(const char *url, const char *token, const char *body, char **response, size_t *len);
 
+int http_get_stream(const char *url, const char *token, http_body_sink_t sink, void *user);
+int http_get_into(const char *url, const char *token, char *buf, size_t buf_size, size_t *len);
+int http_get_conditional(const char *url, const char *token, http_validators_t *validators,
+                         char **response, size_t *len);
+
+/* Non-blocking requests (http_submit etc.) are in core.h */
+
+/* Streaming GET with Range support (audio) */
+typedef struct {
+    int socket;
+    int status;             /* 200, or 206 for a honoured Range */
+    size_t offset;          /* Resource byte offset of the first body byte */
+    size_t total;           /* Full resource size, 0 if unknown */
+    void *priv;             /* Parser state owned by network.c */
+} http_stream_t;
+
+int http_stream_open(http_stream_t *stream, const char *url, const char *token, size_t offset);
+int http_stream_read(http_stream_t *stream, void *buf, size_t len);
+void http_stream_close(http_stream_t *stream);
+
 /* ui.c */
 int ui_init(void);
 void ui_shutdown(void);
@@ -257,6 +284,7 @@ void ui_draw_main_menu(int selected, const char *username);
 void ui_draw_browser(const media_list_t *list, const char *current_path);
 void ui_draw_playback(const char *title, double position, double duration, bool paused, int volume);
 void ui_draw_settings(const user_settings_t *settings, int selected);
+void ui_draw_netstats(void);
 
 /* input.c */
 int input_init(void);
@@ -295,23 +323,56 @@ int api_get_user_info(const char *token, char *username_out, size_t username_len
 int api_browse(const char *token, const char *path, media_list_t *list);
 int api_search(const char *token, const char *query, media_list_t *list);
 int api_get_stream_url(const char *token, const char *path, char *url, size_t len);
+int api_stream_bitrate(const char *url);
+int api_stream_step_down(char *url, size_t len);
+media_item_t *media_list_item(const media_list_t *list, int32_t index);
+
+/* Asynchronous API calls, completed by api_request_poll() once per frame */
+#define API_PENDING 1
+
+typedef enum {
+    API_CALL_NONE,
+    API_CALL_PING,
+    API_CALL_LOGIN,
+    API_CALL_BROWSE,
+    API_CALL_PAGE,
+    API_CALL_SEARCH
+} api_call_t;
+
+typedef struct {
+    api_call_t call;        /* API_CALL_NONE when idle */
+    http_handle_t http;
+    media_list_t *list;     /* Browse/search destination */
+    char *token_out;        /* Login destination */
+    size_t token_len;
+    char url[MAX_URL_LENGTH];           /* Browse/search cache key */
+    char token[64];
+    http_validators_t validators;
+    json_decoder_t *stream;             /* Browse/search items parsed so far */
+    int streamed;
+    int slot;                           /* Where in list->items the next item goes */
+    int slot_start;                     /* Slots this call may fill */
+    int slot_end;
+    bool prepend;                       /* API_CALL_PAGE: the page comes before the window */
+    int32_t total;                      /* Listing size the server sent, -1 until then */
+} api_request_t;
+
+int api_init_async(api_request_t *req, const char *server);
+int api_login_async(api_request_t *req, const char *user, const char *pass, char *token, size_t len);
+int api_browse_async(api_request_t *req, const char *token, const char *path, media_list_t *list);
+int api_search_async(api_request_t *req, const char *token, const char *query, media_list_t *list);
+int api_browse_page_async(api_request_t *req, const char *token, const char *path,
+                          media_list_t *list, int32_t first);
+int32_t api_browse_next_page(const media_list_t *list);
+int api_request_poll(api_request_t *req);
+void api_request_cancel(api_request_t *req);
+bool api_request_pending(const api_request_t *req);
 
 /* config.c */
 int config_load(user_settings_t *s);
 int config_save(const user_settings_t *s);
 void config_defaults(user_settings_t *s);
 
-/* json.c - minimal parser */
-typedef struct json_value json_value_t;
-json_value_t *json_parse(const char *text);
-void json_free(json_value_t *v);
-const char *json_get_string(json_value_t *obj, const char *key);
-int json_get_int(json_value_t *obj, const char *key, int def);
-bool json_get_bool(json_value_t *obj, const char *key, bool def);
-json_value_t *json_get_array(json_value_t *obj, const char *key);
-int json_array_length(json_value_t *arr);
-json_value_t *json_array_get(json_value_t *arr, int i);
-
 /* Utility macros */
 #define MIN(a,b) ((a) < (b) ? (a) : (b))
 #define MAX(a,b) ((a) > (b) ? (a) : (b))
@@ -16,6 +16,7 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <netdb.h>
+#include <errno.h>
 
 /* Network state */
 static struct {
@@ -26,15 +27,6 @@ static struct {
     uint16 server_port;
 } g_net;
 
-/* HTTP response parsing state */
-typedef struct {
-    int status_code;
-    size_t content_length;
-    bool chunked;
-    char *body;
-    size_t body_len;
-} http_response_t;
-
 /*
  * Initialize network subsystem
  */
@@ -91,288 +83,284 @@ void network_shutdown(void)
 {
     if (!g_net.initialized) return;
 
+    http_cancel_all();
     net_shutdown();
     g_net.initialized = false;
     LOG("Network shutdown");
 }
 
+/* Per-request lines of the request being sent; only the main loop sends */
+static http_request_head_t g_request_head;
+
 /*
- * Parse URL into host, port, and path components
+ * Send a request built by the core. KOS has no writev/sendmsg, so the
+ * core gathers the pieces that fit into one segment for a single send;
+ * whatever does not (a large POST body) follows in its own sends.
  */
-static int parse_url(const char *url, char *host, size_t host_len,
-                     uint16 *port, char *path, size_t path_len)
+static int send_request(int sock, const http_request_t *req)
 {
-    /* Skip http:// prefix */
-    const char *p = url;
-    if (strncmp(p, "http://", 7) == 0) {
-        p += 7;
-    }
-
-    /* Find host end (: or / or end) */
-    const char *host_end = p;
-    while (*host_end && *host_end != ':' && *host_end != '/') {
-        host_end++;
+    core_piece_t piece[4];
+    int count = http_build_request(req, &g_request_head, piece);
+    if (count < 0) {
+        return -1;
     }
 
-    /* Copy host */
-    size_t hlen = host_end - p;
-    if (hlen >= host_len) hlen = host_len - 1;
-    strncpy(host, p, hlen);
-    host[hlen] = '\0';
-
-    /* Parse port */
-    *port = 80;  /* Default HTTP port */
-    if (*host_end == ':') {
-        *port = (uint16)atoi(host_end + 1);
-        /* Skip to path */
-        while (*host_end && *host_end != '/') host_end++;
+    if (http_send_pieces(sock, piece, count) < 0) {
+        LOG_ERROR("Failed to send request");
+        return -1;
     }
+    return 0;
+}
 
-    /* Copy path */
-    if (*host_end == '/') {
-        strncpy(path, host_end, path_len - 1);
-        path[path_len - 1] = '\0';
-    } else {
-        strcpy(path, "/");
+/*
+ * Receive a whole HTTP response on a blocking socket
+ */
+static int receive_response(int sock, http_response_t *resp, net_timing_t *timing)
+{
+    while (resp->state != HTTP_PARSE_DONE) {
+        if (http_response_receive(sock, resp, true) < 0) {
+            return -1;
+        }
+        netstats_first_byte(timing);
     }
 
-    return 0;
+    return resp->status_code;
 }
 
 /*
- * Resolve hostname to IP address
+ * Answer a request from the loaded capture instead of the network
  */
-static uint32 resolve_host(const char *hostname)
+static int replay_request(const char *method, const char *url, http_response_t *resp)
 {
-    /* Check if it's already an IP address */
-    struct in_addr addr;
-    if (inet_aton(hostname, &addr)) {
-        return addr.s_addr;
+    const netreplay_exchange_t *x = netreplay_answer(method, url);
+    if (!x) {
+        return -1;
     }
 
-    /* DNS lookup */
-    struct hostent *he = gethostbyname(hostname);
-    if (he && he->h_addr_list[0]) {
-        return *(uint32 *)he->h_addr_list[0];
+    resp->status_code = x->status;
+    resp->validators = x->validators;
+    if (http_response_deliver(resp, x->body, x->body_len) < 0) {
+        return -1;
     }
-
-    LOG_ERROR("Failed to resolve: %s", hostname);
-    return 0;
+    return (x->status >= 200 && x->status < 300) ? 0 : x->status;
 }
 
 /*
- * Connect to server
+ * Run one request on a fresh connection. A conditional GET sends the
+ * given validators along.
  */
-static int connect_to_server(const char *host, uint16 port)
+static int http_do_request(const char *method, const char *url, const char *token,
+                           const char *body, const http_validators_t *conditions,
+                           http_response_t *resp)
 {
-    /* Resolve hostname */
-    uint32 ip = resolve_host(host);
-    if (ip == 0) {
+    if (netreplay_replaying()) {
+        return replay_request(method, url, resp);
+    }
+
+    if (!g_net.initialized) {
+        LOG_ERROR("Network not initialized");
         return -1;
     }
 
-    /* Create socket */
-    int sock = socket(AF_INET, SOCK_STREAM, 0);
-    if (sock < 0) {
-        LOG_ERROR("Failed to create socket");
+    char host[128];
+    char path[512];
+    int port;
+
+    if (url_parse(url, host, sizeof(host), &port, path, sizeof(path)) < 0) {
         return -1;
     }
 
-    /* Connect */
-    struct sockaddr_in server_addr;
-    memset(&server_addr, 0, sizeof(server_addr));
-    server_addr.sin_family = AF_INET;
-    server_addr.sin_port = htons(port);
-    server_addr.sin_addr.s_addr = ip;
+    net_timing_t timing;
+    netstats_start(&timing);
+
+    int sock = http_open(host, port, &timing);
+    if (sock < 0) {
+        netstats_record(url, &timing, false);
+        http_response_capture(method, url, -1, resp, &timing);
+        return -1;
+    }
 
-    if (connect(sock, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0) {
-        LOG_ERROR("Failed to connect to %s:%d", host, port);
+    http_request_t req = { method, host, path, token,
+                           resp->accept_encoding ? HTTP_REQ_ENCODED : 0u, conditions, NULL, body };
+    if (send_request(sock, &req) < 0) {
         close(sock);
+        netstats_record(url, &timing, false);
+        http_response_capture(method, url, -1, resp, &timing);
         return -1;
     }
+    netstats_phase(&timing, NET_PHASE_SEND);
 
-    return sock;
+    uint64 sent_at = timer_ms_gettime64();
+    int status = receive_response(sock, resp, &timing);
+    http_response_release(resp);
+    close(sock);
+
+    timing.bytes = resp->header_bytes + resp->wire_len;
+    netstats_record(url, &timing, status >= 0);
+    http_response_capture(method, url, status, resp, &timing);
+
+    if (status >= 0) {
+        http_throughput_sample(resp->header_bytes + resp->wire_len,
+                               (timer_ms_gettime64() - sent_at) * 1000);
+    }
+
+    if (status < 0) {
+        return -1;
+    }
+    return (status >= 200 && status < 300) ? 0 : status;
 }
 
 /*
- * Send HTTP request
+ * Run a request and return the body in a malloc'd, NUL-terminated buffer.
+ * With validators, the GET is conditional and they are updated from the
+ * response.
  */
-static int send_request(int sock, const char *method, const char *host,
-                        const char *path, const char *auth_token,
-                        const char *body)
+static int http_request_buffered(const char *method, const char *url, const char *token,
+                                 const char *body, http_validators_t *validators,
+                                 char **response, size_t *response_len)
 {
-    char request[1024];
-    int len;
-
-    if (body) {
-        len = snprintf(request, sizeof(request),
-            "%s %s HTTP/1.1\r\n"
-            "Host: %s\r\n"
-            "Connection: close\r\n"
-            "Content-Type: application/json\r\n"
-            "Content-Length: %d\r\n"
-            "%s%s%s"
-            "\r\n"
-            "%s",
-            method, path, host,
-            (int)strlen(body),
-            auth_token ? "Authorization: Bearer " : "",
-            auth_token ? auth_token : "",
-            auth_token ? "\r\n" : "",
-            body);
-    } else {
-        len = snprintf(request, sizeof(request),
-            "%s %s HTTP/1.1\r\n"
-            "Host: %s\r\n"
-            "Connection: close\r\n"
-            "%s%s%s"
-            "\r\n",
-            method, path, host,
-            auth_token ? "Authorization: Bearer " : "",
-            auth_token ? auth_token : "",
-            auth_token ? "\r\n" : "");
-    }
-
-    /* Send request */
-    int sent = 0;
-    while (sent < len) {
-        int n = send(sock, request + sent, len - sent, 0);
-        if (n <= 0) {
-            LOG_ERROR("Failed to send request");
-            return -1;
-        }
-        sent += n;
+    http_response_t resp;
+    memset(&resp, 0, sizeof(resp));
+    resp.mode = HTTP_BODY_ALLOC;
+    resp.accept_encoding = true;
+
+    int result = http_do_request(method, url, token, body, validators, &resp);
+    if (result >= 0 && validators) {
+        http_validators_update(validators, resp.status_code, &resp.validators);
     }
 
-    return 0;
+    if (result < 0 || !resp.body) {
+        free(resp.body);
+        *response = NULL;
+        *response_len = 0;
+        return result;
+    }
+
+    *response = resp.body;
+    *response_len = resp.body_len;
+    return result;
 }
 
 /*
- * Parse HTTP response headers
+ * HTTP GET request
  */
-static int parse_response_headers(const char *data, size_t len, http_response_t *resp)
+int http_get(const char *url, char **response, size_t *response_len)
 {
-    /* Find status code */
-    const char *p = strstr(data, "HTTP/1.");
-    if (!p) return -1;
+    return http_request_buffered("GET", url, NULL, NULL, NULL, response, response_len);
+}
 
-    p = strchr(p, ' ');
-    if (!p) return -1;
+/*
+ * HTTP GET with authentication
+ */
+int http_get_with_auth(const char *url, const char *token,
+                       char **response, size_t *response_len)
+{
+    return http_request_buffered("GET", url, token, NULL, NULL, response, response_len);
+}
 
-    resp->status_code = atoi(p + 1);
+/*
+ * HTTP POST request
+ */
+int http_post(const char *url, const char *body,
+              char **response, size_t *response_len)
+{
+    return http_request_buffered("POST", url, NULL, body, NULL, response, response_len);
+}
 
-    /* Find Content-Length */
-    p = strstr(data, "Content-Length:");
-    if (!p) p = strstr(data, "content-length:");
-    if (p) {
-        p += 15;
-        while (*p == ' ') p++;
-        resp->content_length = atoi(p);
-    }
+/*
+ * HTTP POST with authentication
+ */
+int http_post_with_auth(const char *url, const char *token, const char *body,
+                        char **response, size_t *response_len)
+{
+    return http_request_buffered("POST", url, token, body, NULL, response, response_len);
+}
 
-    /* Check for chunked encoding */
-    p = strstr(data, "Transfer-Encoding:");
-    if (!p) p = strstr(data, "transfer-encoding:");
-    if (p && strstr(p, "chunked")) {
-        resp->chunked = true;
-    }
+/*
+ * Conditional GET. Returns 304 with no body when the copy the validators
+ * describe is still current; otherwise as http_get_with_auth(). The
+ * validators are updated from the response either way.
+ */
+int http_get_conditional(const char *url, const char *token, http_validators_t *validators,
+                         char **response, size_t *response_len)
+{
+    return http_request_buffered("GET", url, token, NULL, validators, response, response_len);
+}
 
-    return 0;
+/*
+ * HTTP GET into a caller-owned buffer (NUL-terminated, no allocation)
+ */
+int http_get_into(const char *url, const char *token,
+                  char *buf, size_t buf_size, size_t *len)
+{
+    if (!buf || buf_size == 0) return -1;
+
+    http_response_t resp;
+    memset(&resp, 0, sizeof(resp));
+    resp.mode = HTTP_BODY_CALLER;
+    resp.accept_encoding = true;
+    resp.body = buf;
+    resp.body_cap = buf_size;
+    buf[0] = '\0';
+
+    int result = http_do_request("GET", url, token, NULL, NULL, &resp);
+    if (len) *len = resp.body_len;
+    return result;
 }
 
 /*
- * Receive HTTP response
+ * HTTP GET streamed to a sink callback as bytes arrive.
+ * Not subject to HTTP_MAX_BUFFERED_BODY; the sink returns <0 to abort.
  */
-static int receive_response(int sock, char **response, size_t *response_len)
+int http_get_stream(const char *url, const char *token,
+                    http_body_sink_t sink, void *user)
 {
-    /* Allocate receive buffer */
-    size_t buf_size = 8192;
-    char *buffer = (char *)malloc(buf_size);
-    if (!buffer) {
-        LOG_ERROR("Failed to allocate receive buffer");
-        return -1;
-    }
+    if (!sink) return -1;
 
-    size_t total = 0;
-    http_response_t resp = {0};
-    bool headers_done = false;
-    const char *body_start = NULL;
-
-    while (1) {
-        /* Grow buffer if needed */
-        if (total >= buf_size - 1) {
-            size_t new_size = buf_size * 2;
-            /* Limit buffer size for Dreamcast memory constraints */
-            if (new_size > 256 * 1024) {
-                LOG_ERROR("Response too large");
-                break;
-            }
-            char *new_buf = (char *)realloc(buffer, new_size);
-            if (!new_buf) {
-                break;
-            }
-            buffer = new_buf;
-            buf_size = new_size;
-        }
+    http_response_t resp;
+    memset(&resp, 0, sizeof(resp));
+    resp.mode = HTTP_BODY_SINK;
+    resp.sink = sink;
+    resp.sink_user = user;
 
-        /* Receive data */
-        int n = recv(sock, buffer + total, buf_size - total - 1, 0);
-        if (n <= 0) {
-            break;  /* Connection closed or error */
-        }
-        total += n;
-        buffer[total] = '\0';
-
-        /* Parse headers if not done yet */
-        if (!headers_done) {
-            body_start = strstr(buffer, "\r\n\r\n");
-            if (body_start) {
-                body_start += 4;
-                parse_response_headers(buffer, body_start - buffer, &resp);
-                headers_done = true;
-
-                /* If we know content length, check if we're done */
-                if (resp.content_length > 0) {
-                    size_t body_received = total - (body_start - buffer);
-                    if (body_received >= resp.content_length) {
-                        break;
-                    }
-                }
-            }
-        } else if (resp.content_length > 0) {
-            /* Check if we've received all content */
-            size_t body_received = total - (body_start - buffer);
-            if (body_received >= resp.content_length) {
-                break;
-            }
-        }
-    }
+    return http_do_request("GET", url, token, NULL, NULL, &resp);
+}
 
-    /* Extract body */
-    if (body_start && total > (size_t)(body_start - buffer)) {
-        size_t body_len = total - (body_start - buffer);
-        *response = (char *)malloc(body_len + 1);
-        if (*response) {
-            memcpy(*response, body_start, body_len);
-            (*response)[body_len] = '\0';
-            *response_len = body_len;
-        }
-    } else {
-        *response = NULL;
-        *response_len = 0;
-    }
+/* Per-stream state kept between http_stream_read() calls */
+typedef struct {
+    http_response_t resp;
+    char pending[RECV_BUFFER_SIZE];  /* Body bytes that arrived with the headers */
+    size_t pending_len;
+    size_t pending_pos;
+} http_stream_priv_t;
 
-    int status = resp.status_code;
-    free(buffer);
+/*
+ * Sink that keeps body bytes received along with the headers
+ */
+static int stream_pending_sink(const char *data, size_t len, void *user)
+{
+    http_stream_priv_t *priv = (http_stream_priv_t *)user;
 
-    return status;
+    if (len > sizeof(priv->pending) - priv->pending_len) return -1;
+    memcpy(priv->pending + priv->pending_len, data, len);
+    priv->pending_len += len;
+    return 0;
 }
 
 /*
- * HTTP GET request
+ * Open a streaming GET starting at a byte offset.
+ * Sends "Range: bytes=<offset>-" when offset > 0 and waits only for the
+ * headers; the body is then pulled with http_stream_read(). On success
+ * stream->offset is where the body actually starts, which is 0 if the
+ * server ignored the Range and answered 200.
+ * Returns 0 on success, the HTTP status for error responses, or -1.
  */
-int http_get(const char *url, char **response, size_t *response_len)
+int http_stream_open(http_stream_t *stream, const char *url, const char *token,
+                     size_t offset)
 {
+    memset(stream, 0, sizeof(*stream));
+    stream->socket = -1;
+
     if (!g_net.initialized) {
         LOG_ERROR("Network not initialized");
         return -1;
@@ -380,122 +368,150 @@ int http_get(const char *url, char **response, size_t *response_len)
 
     char host[128];
     char path[512];
-    uint16 port;
+    int port;
 
-    if (parse_url(url, host, sizeof(host), &port, path, sizeof(path)) < 0) {
+    if (url_parse(url, host, sizeof(host), &port, path, sizeof(path)) < 0) {
         return -1;
     }
 
-    int sock = connect_to_server(host, port);
-    if (sock < 0) {
+    http_stream_priv_t *priv = (http_stream_priv_t *)calloc(1, sizeof(*priv));
+    if (!priv) {
+        LOG_ERROR("Failed to allocate stream state");
         return -1;
     }
+    priv->resp.mode = HTTP_BODY_SINK;
+    priv->resp.sink = stream_pending_sink;
+    priv->resp.sink_user = priv;
 
-    if (send_request(sock, "GET", host, path, NULL, NULL) < 0) {
-        close(sock);
-        return -1;
+    char range[48] = "";
+    if (offset > 0) {
+        snprintf(range, sizeof(range), "Range: bytes=%lu-\r\n", (unsigned long)offset);
     }
 
-    int status = receive_response(sock, response, response_len);
-    close(sock);
-
-    return (status >= 200 && status < 300) ? 0 : status;
-}
-
-/*
- * HTTP GET with authentication
- */
-int http_get_with_auth(const char *url, const char *token,
-                       char **response, size_t *response_len)
-{
-    if (!g_net.initialized) return -1;
-
-    char host[128];
-    char path[512];
-    uint16 port;
-
-    if (parse_url(url, host, sizeof(host), &port, path, sizeof(path)) < 0) {
-        return -1;
-    }
+    /* Streams are timed up to their headers; playback paces the body */
+    net_timing_t timing;
+    netstats_start(&timing);
 
-    int sock = connect_to_server(host, port);
+    int sock = http_open(host, port, &timing);
     if (sock < 0) {
+        netstats_record(url, &timing, false);
+        free(priv);
         return -1;
     }
 
-    if (send_request(sock, "GET", host, path, token, NULL) < 0) {
+    http_request_t req = { "GET", host, path, token, 0, NULL, range, NULL };
+    if (send_request(sock, &req) < 0) {
         close(sock);
+        netstats_record(url, &timing, false);
+        free(priv);
         return -1;
     }
+    netstats_phase(&timing, NET_PHASE_SEND);
 
-    int status = receive_response(sock, response, response_len);
-    close(sock);
-
-    return (status >= 200 && status < 300) ? 0 : status;
-}
-
-/*
- * HTTP POST request
- */
-int http_post(const char *url, const char *body,
-              char **response, size_t *response_len)
-{
-    if (!g_net.initialized) return -1;
-
-    char host[128];
-    char path[512];
-    uint16 port;
-
-    if (parse_url(url, host, sizeof(host), &port, path, sizeof(path)) < 0) {
-        return -1;
+    /* One scratch buffer per recv keeps the spill within priv->pending */
+    char scratch[RECV_BUFFER_SIZE];
+    while (priv->resp.state < HTTP_PARSE_BODY) {
+        int n = recv(sock, scratch, sizeof(scratch), 0);
+        if (n <= 0) {
+            LOG_ERROR("Connection closed before stream headers");
+            close(sock);
+            netstats_record(url, &timing, false);
+            free(priv);
+            return -1;
+        }
+        netstats_first_byte(&timing);
+        if (http_response_feed(&priv->resp, scratch, n) < 0) {
+            close(sock);
+            netstats_record(url, &timing, false);
+            free(priv);
+            return -1;
+        }
     }
 
-    int sock = connect_to_server(host, port);
-    if (sock < 0) {
-        return -1;
-    }
+    http_response_t *resp = &priv->resp;
+    stream->status = resp->status_code;
+    timing.bytes = resp->header_bytes;
+    netstats_record(url, &timing, true);
 
-    if (send_request(sock, "POST", host, path, NULL, body) < 0) {
+    if (resp->status_code == 206) {
+        stream->offset = resp->has_content_range ? resp->range_start : offset;
+        stream->total = resp->range_total;
+    } else if (resp->status_code == 200) {
+        stream->offset = 0;
+        stream->total = resp->has_content_length ? resp->content_length : 0;
+    } else {
+        int status = resp->status_code;
+        LOG_ERROR("Stream request failed: HTTP %d", status);
         close(sock);
-        return -1;
+        free(priv);
+        return status > 0 ? status : -1;
     }
 
-    int status = receive_response(sock, response, response_len);
-    close(sock);
-
-    return (status >= 200 && status < 300) ? 0 : status;
+    stream->socket = sock;
+    stream->priv = priv;
+    return 0;
 }
 
 /*
- * HTTP POST with authentication
+ * Read decoded body bytes from an open stream without blocking.
+ * Returns the number of bytes read, 0 if nothing is available yet,
+ * or -1 at end of stream or on error.
  */
-int http_post_with_auth(const char *url, const char *token, const char *body,
-                        char **response, size_t *response_len)
+int http_stream_read(http_stream_t *stream, void *buf, size_t len)
 {
-    if (!g_net.initialized) return -1;
+    http_stream_priv_t *priv = (http_stream_priv_t *)stream->priv;
+    if (!priv || len == 0) return -1;
 
-    char host[128];
-    char path[512];
-    uint16 port;
+    /* Hand out bytes that came in with the headers first */
+    if (priv->pending_pos < priv->pending_len) {
+        size_t n = priv->pending_len - priv->pending_pos;
+        if (n > len) n = len;
+        memcpy(buf, priv->pending + priv->pending_pos, n);
+        priv->pending_pos += n;
+        return (int)n;
+    }
 
-    if (parse_url(url, host, sizeof(host), &port, path, sizeof(path)) < 0) {
-        return -1;
+    http_response_t *resp = &priv->resp;
+    if (resp->state == HTTP_PARSE_DONE) return -1;
+
+    size_t want = len;
+    if (resp->has_content_length) {
+        size_t left = resp->content_length - resp->body_len;
+        if (want > left) want = left;
     }
 
-    int sock = connect_to_server(host, port);
-    if (sock < 0) {
+    int n = recv(stream->socket, buf, want, MSG_DONTWAIT);
+    if (n == 0) {
+        resp->state = HTTP_PARSE_DONE;
         return -1;
     }
+    if (n < 0) {
+        return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+    }
 
-    if (send_request(sock, "POST", host, path, token, body) < 0) {
-        close(sock);
+    size_t got = n;
+    if (resp->chunked && http_chunk_decode(resp, (char *)buf, n, &got) < 0) {
         return -1;
     }
 
-    int status = receive_response(sock, response, response_len);
-    close(sock);
+    resp->body_len += got;
+    if (resp->has_content_length && resp->body_len >= resp->content_length) {
+        resp->state = HTTP_PARSE_DONE;
+    }
+    return (int)got;
+}
 
-    return (status >= 200 && status < 300) ? 0 : status;
+/*
+ * Close a stream opened with http_stream_open()
+ */
+void http_stream_close(http_stream_t *stream)
+{
+    if (stream->socket >= 0) {
+        close(stream->socket);
+    }
+    free(stream->priv);
+    memset(stream, 0, sizeof(*stream));
+    stream->socket = -1;
 }
 
 /*
@@ -375,7 +375,10 @@ void ui_draw_browser(const media_list_t *list, const char *current_path)
 
     draw_header("Browse", current_path ? current_path : "/");
 
-    if (!list || list->count == 0) {
+    /* Until a listing's size arrives, all that is known is what it has sent */
+    int32_t total = list ? MAX(list->total, list->first + list->count) : 0;
+
+    if (total <= 0) {
         draw_text_centered(SCREEN_HEIGHT / 2, COLOR_TEXT_DIM, "No items found");
     } else {
         int content_y = HEADER_HEIGHT + 10;
@@ -390,9 +393,10 @@ void ui_draw_browser(const media_list_t *list, const char *current_path)
             scroll = list->selected_index - visible_items + 1;
         }
 
-        for (int i = 0; i < visible_items && (scroll + i) < list->count; i++) {
+        /* Rows outside the window are pages still on their way */
+        for (int i = 0; i < visible_items && (scroll + i) < total; i++) {
             int idx = scroll + i;
-            const media_item_t *item = &list->items[idx];
+            const media_item_t *item = media_list_item(list, idx);
             int y = content_y + i * LIST_ITEM_HEIGHT;
 
             /* Item background */
@@ -401,6 +405,11 @@ void ui_draw_browser(const media_list_t *list, const char *current_path)
                 draw_rect(MARGIN_X, y, SCREEN_WIDTH - MARGIN_X * 2, LIST_ITEM_HEIGHT - 2, bg_color);
             }
 
+            if (!item || !item->name[0]) {
+                draw_text(MARGIN_X + 50, y + 5, COLOR_TEXT_DIM, "Loading...");
+                continue;
+            }
+
             /* Icon based on type */
             const char *icon;
             switch (item->type) {
@@ -422,11 +431,12 @@ void ui_draw_browser(const media_list_t *list, const char *current_path)
         }
 
         /* Scrollbar if needed */
-        if (list->count > visible_items) {
+        if (total > visible_items) {
             int sb_height = content_height;
             int sb_y = content_y;
-            int thumb_height = (visible_items * sb_height) / list->count;
-            int thumb_y = sb_y + (scroll * sb_height) / list->count;
+            int thumb_height = MAX(4, (int)(((int64_t)visible_items * sb_height) / total));
+            int thumb_y = sb_y + (int)(((int64_t)scroll * (sb_height - thumb_height)) /
+                                       (total - visible_items));
 
             draw_rect(SCREEN_WIDTH - MARGIN_X + 5, sb_y, 5, sb_height, COLOR_HEADER);
             draw_rect(SCREEN_WIDTH - MARGIN_X + 5, thumb_y, 5, thumb_height, COLOR_ACCENT);
@@ -559,3 +569,36 @@ void ui_draw_settings(const user_settings_t *settings, int selected)
     pvr_list_finish();
     pvr_scene_finish();
 }
+
+/*
+ * Draw network timing screen: per endpoint, request counts and the
+ * histogram percentiles, then average milliseconds per phase
+ */
+void ui_draw_netstats(void)
+{
+    pvr_wait_ready();
+    pvr_scene_begin();
+
+    pvr_list_begin(PVR_LIST_TR_POLY);
+
+    draw_rect(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT, COLOR_BACKGROUND);
+    draw_header("Network", "Average ms per request phase");
+
+    int y = HEADER_HEIGHT + 8;
+    if (netstats_count() == 0) {
+        draw_text(MARGIN_X, y, COLOR_TEXT_DIM, "No requests yet");
+    }
+
+    char line1[64], line2[64];
+    for (int i = 0; i < netstats_count(); i++) {
+        if (netstats_format(i, line1, line2, sizeof(line1)) < 0) break;
+        draw_text(8, y, COLOR_TEXT, line1);
+        draw_text(8, y + 22, COLOR_TEXT_DIM, line2);
+        y += 46;
+    }
+
+    draw_footer("START+Y: Close");
+
+    pvr_list_finish();
+    pvr_scene_finish();
+}
@@ -10,8 +10,55 @@
 static char api_base_url[MAX_URL_LENGTH];
 static bool api_initialized = false;
 
-/* Initialize API with server URL */
-int api_init(const char *server)
+/* Login reply */
+typedef struct {
+    char token[256];
+} login_reply_t;
+
+static const json_field_t g_login_fields[] = {
+    JSON_FIELD(login_reply_t, token, "token", STRING),
+};
+static json_schema_t g_login_schema = JSON_SCHEMA(g_login_fields);
+
+/* Browse and search entries, decoded straight into the list */
+static const json_field_t g_item_fields[] = {
+    JSON_FIELD(media_item_t, name, "name", STRING),
+    JSON_FIELD(media_item_t, path, "path", STRING),
+    JSON_FIELD(media_item_t, duration, "duration", UINT),
+    JSON_FIELD(media_item_t, size, "size", UINT),
+    MEDIA_HINT_FIELDS
+};
+static json_schema_t g_item_schema = JSON_SCHEMA_SCRATCH(g_item_fields, media_hints_t);
+
+/* Details of one item, merged into what the listing gave */
+static const json_field_t g_info_fields[] = {
+    JSON_FIELD(media_item_t, name, "name", STRING),
+    JSON_FIELD(media_item_t, description, "description", STRING),
+    JSON_FIELD(media_item_t, description, "plot", STRING),
+    JSON_FIELD(media_item_t, duration, "duration", UINT),
+    JSON_FIELD(media_item_t, size, "size", UINT),
+    JSON_FIELD(media_item_t, year, "year", INT),
+    JSON_FIELD(media_item_t, rating, "rating", REAL),
+};
+static json_schema_t g_info_schema = JSON_SCHEMA(g_info_fields);
+
+/*
+ * Library listings fetched ahead of time by api_start_session. Each one
+ * is served once by api_browse; later visits go back to the server so
+ * the listing stays fresh.
+ */
+static media_list_t g_prefetch[LIBRARY_COUNT];
+
+static void prefetch_clear(void)
+{
+    for (int i = 0; i < LIBRARY_COUNT; i++) {
+        free(g_prefetch[i].items);
+        memset(&g_prefetch[i], 0, sizeof(g_prefetch[i]));
+    }
+}
+
+/* Store the server URL without a trailing slash */
+static int set_base_url(const char *server)
 {
     if (!server || strlen(server) == 0) {
         printf("API: No server URL\n");
@@ -28,6 +75,80 @@ int api_init(const char *server)
     }
 
     printf("API: Initialized with server %s\n", api_base_url);
+    return 0;
+}
+
+static void build_browse_url(char *url, size_t size, const char *token,
+                             const char *path, library_t lib)
+{
+    const char *lib_names[] = { "music", "audiobooks", "movies", "tvshows" };
+    char encoded_path[MAX_PATH_LENGTH * 3];
+
+    /* Library roots such as "/TV Shows" are not valid in a request line as-is */
+    url_encode(path ? path : "/", encoded_path, sizeof(encoded_path));
+    snprintf(url, size, "%s/api/browse/%s?path=%s&token=%s",
+             api_base_url, lib_names[lib], encoded_path, token ? token : "");
+}
+
+/* Next free slot for the decoder, or NULL once the list is full */
+static void *next_item(void *user)
+{
+    media_list_t *list = (media_list_t *)user;
+    if (list->count >= list->capacity) return NULL;
+
+    media_item_t *m = &list->items[list->count];
+    memset(m, 0, sizeof(media_item_t));
+    return m;
+}
+
+static int item_done(void *record, void *scratch, void *user)
+{
+    media_item_t *m = (media_item_t *)record;
+    m->type = media_hints_type((const media_hints_t *)scratch, m->name);
+    m->is_directory = m->type == MEDIA_TYPE_DIRECTORY;
+    ((media_list_t *)user)->count++;
+    return 0;
+}
+
+/* Allocate the items array of a list on first use */
+static int reserve_items(media_list_t *list)
+{
+    if (!list->items) {
+        list->items = calloc(MAX_MEDIA_ITEMS, sizeof(media_item_t));
+        list->capacity = MAX_MEDIA_ITEMS;
+    }
+    return list->items ? 0 : -1;
+}
+
+/* Fill list from the named array of a listing response body */
+static int parse_listing(const char *response, size_t len, const char *array,
+                         media_list_t *list)
+{
+    if (reserve_items(list) != 0) return -1;
+
+    list->count = 0;
+
+    json_decode_t spec = { &g_item_schema, array, next_item, item_done, list, NULL, NULL };
+    return json_decode(&spec, response, len);
+}
+
+/* Copy the cached copy of a listing into list once the server has answered 304 */
+static int restore_listing(const char *url, media_list_t *list)
+{
+    if (reserve_items(list) != 0) return -1;
+
+    int count = cache_restore(url, NULL, list->items, sizeof(media_item_t), list->capacity, NULL);
+    if (count < 0) return -1;
+    list->count = count;
+    return 0;
+}
+
+/* Initialize API with server URL */
+int api_init(const char *server)
+{
+    if (set_base_url(server) != 0) {
+        return -1;
+    }
 
     /* Test connection */
     char url[MAX_URL_LENGTH];
@@ -47,46 +168,166 @@ int api_init(const char *server)
     return -1;
 }
 
+/*
+ * Keep the root listing of a library fetched at session start, or the
+ * cached copy a 304 vouched for. Takes the response.
+ */
+static void prefetch_settle(library_t lib, const char *path, const char *url, int status,
+                            char *response, size_t len, const http_validators_t *validators)
+{
+    media_list_t *list = &g_prefetch[lib];
+
+    if (status == 304 && restore_listing(url, list) == 0) {
+        strncpy(list->current_path, path, MAX_PATH_LENGTH - 1);
+    } else if (response && status >= 0 && status < 300) {
+        uint64_t parse_start = netstats_now_us();
+        int parsed = parse_listing(response, len, "items", list);
+        netstats_parse(url, parse_start);
+
+        if (parsed == 0) {
+            strncpy(list->current_path, path, MAX_PATH_LENGTH - 1);
+            cache_store(url, NULL, validators, list->items, sizeof(media_item_t),
+                        list->count, list->count);
+        } else {
+            free(list->items);
+            memset(list, 0, sizeof(*list));
+        }
+    }
+    free(response);
+}
+
+/*
+ * Connect and, with a saved session, fetch the root listing of every
+ * library in the same pipelined round trip as the health check, so
+ * entering or switching libraries afterwards needs no network wait.
+ */
+int api_start_session(const char *server, const char *token,
+                      const char *const *library_paths)
+{
+    if (set_base_url(server) != 0) {
+        return -1;
+    }
+
+    prefetch_clear();
+
+    char urls[1 + LIBRARY_COUNT][MAX_URL_LENGTH];
+    http_batch_t batch[1 + LIBRARY_COUNT];
+    http_validators_t validators[1 + LIBRARY_COUNT];
+    int count = 1;
+
+    memset(batch, 0, sizeof(batch));
+    snprintf(urls[0], sizeof(urls[0]), "%s/api/health", api_base_url);
+    if (token && token[0] && library_paths) {
+        for (int lib = 0; lib < LIBRARY_COUNT; lib++) {
+            build_browse_url(urls[count], sizeof(urls[0]), token,
+                             library_paths[lib], (library_t)lib);
+            cache_validators(urls[count], NULL, &validators[count]);
+            batch[count].validators = &validators[count];
+            count++;
+        }
+    }
+    for (int i = 0; i < count; i++) {
+        batch[i].url = urls[i];
+    }
+
+    http_get_pipelined(batch, count);
+
+    int result = -1;
+    if (batch[0].response) {
+        printf("API: Server connection OK\n");
+        api_initialized = true;
+        result = 0;
+
+        for (int i = 1; i < count; i++) {
+            prefetch_settle((library_t)(i - 1), library_paths[i - 1], urls[i], batch[i].status,
+                            batch[i].response, batch[i].len, &validators[i]);
+            batch[i].response = NULL;
+        }
+    } else {
+        printf("API: Server connection failed\n");
+    }
+
+    for (int i = 0; i < count; i++) {
+        free(batch[i].response);
+    }
+    return result;
+}
+
 /* Shutdown API */
 void api_shutdown(void)
 {
+    prefetch_clear();
+    cache_clear();
     api_initialized = false;
     api_base_url[0] = '\0';
 }
 
+/* Hand over a prefetched listing for lib/path, if there is one */
+static int take_prefetched(const char *path, library_t lib, media_list_t *list)
+{
+    media_list_t *cached = &g_prefetch[lib];
+
+    if (!cached->items || !path || strcmp(cached->current_path, path) != 0) {
+        return -1;
+    }
+
+    if (!list->items) {
+        list->items = calloc(MAX_MEDIA_ITEMS, sizeof(media_item_t));
+        list->capacity = MAX_MEDIA_ITEMS;
+        if (!list->items) return -1;
+    }
+
+    list->count = MIN(cached->count, list->capacity);
+    memcpy(list->items, cached->items, list->count * sizeof(media_item_t));
+
+    free(cached->items);
+    memset(cached, 0, sizeof(*cached));
+    return 0;
+}
+
+/* Build the login request */
+static void build_login_request(const char *user, const char *pass,
+                                char *url, size_t url_size, char *body, size_t body_size)
+{
+    snprintf(url, url_size, "%s/api/auth/login", api_base_url);
+    snprintf(body, body_size,
+             "{\"username\":\"%s\",\"password\":\"%s\"}",
+             user, pass);
+}
+
+/* Pick the session token out of a login reply */
+static int parse_login(const char *response, size_t resp_len, char *token, size_t len)
+{
+    login_reply_t reply;
+    memset(&reply, 0, sizeof(reply));
+    if (json_decode_object(&g_login_schema, response, resp_len, &reply) != 0 ||
+        !reply.token[0]) {
+        return -1;
+    }
+
+    strncpy(token, reply.token, len - 1);
+    token[len - 1] = '\0';
+    return 0;
+}
+
 /* Login to server */
 int api_login(const char *user, const char *pass, char *token, size_t len)
 {
     if (!api_initialized) return -1;
 
     char url[MAX_URL_LENGTH];
-    snprintf(url, sizeof(url), "%s/api/auth/login", api_base_url);
-
     char body[512];
-    snprintf(body, sizeof(body),
-             "{\"username\":\"%s\",\"password\":\"%s\"}",
-             user, pass);
+    build_login_request(user, pass, url, sizeof(url), body, sizeof(body));
 
     char *response = NULL;
     size_t resp_len = 0;
 
+    int result = -1;
     if (http_post(url, body, &response, &resp_len) == 0 && response) {
-        json_value_t *json = json_parse(response);
-        if (json) {
-            const char *tok = json_get_string(json, "token");
-            if (tok) {
-                strncpy(token, tok, len - 1);
-                token[len - 1] = '\0';
-                json_free(json);
-                free(response);
-                return 0;
-            }
-            json_free(json);
-        }
-        free(response);
+        result = parse_login(response, resp_len, token, len);
     }
-
-    return -1;
+    free(response);
+    return result;
 }
 
 /* Logout */
@@ -106,16 +347,67 @@ int api_logout(const char *token)
     return 0;
 }
 
+/*
+ * Settle a conditional GET of a listing: a 304 brings back the cached
+ * copy, a fresh body is parsed and cached. Takes the response.
+ */
+static int finish_browse(const char *url, const char *path, int status, char *response,
+                         size_t resp_len, const http_validators_t *validators,
+                         media_list_t *list)
+{
+    if (status == 304 && restore_listing(url, list) == 0) {
+        printf("API: %s not modified, %d cached items\n", path, list->count);
+        free(response);
+        return 0;
+    }
+    if (status != 0 || !response) {
+        free(response);
+        return -1;
+    }
+
+    uint64_t parse_start = netstats_now_us();
+    int result = parse_listing(response, resp_len, "items", list);
+    netstats_parse(url, parse_start);
+    free(response);
+
+    if (result == 0) {
+        cache_store(url, NULL, validators, list->items, sizeof(media_item_t), list->count,
+                    list->count);
+    }
+    return result;
+}
+
 /* Browse media directory */
 int api_browse(const char *token, const char *path, library_t lib, media_list_t *list)
 {
     if (!api_initialized || !list) return -1;
 
-    const char *lib_names[] = { "music", "audiobooks", "movies", "tvshows" };
+    if (take_prefetched(path, lib, list) == 0) {
+        return 0;
+    }
 
     char url[MAX_URL_LENGTH];
-    snprintf(url, sizeof(url), "%s/api/browse/%s?path=%s&token=%s",
-             api_base_url, lib_names[lib], path, token ? token : "");
+    build_browse_url(url, sizeof(url), token, path, lib);
+
+    /* Revalidate the listing from the last visit instead of fetching it again */
+    http_validators_t validators;
+    cache_validators(url, NULL, &validators);
+
+    char *response = NULL;
+    size_t resp_len = 0;
+    int status = http_get_conditional(url, &validators, &response, &resp_len);
+
+    return finish_browse(url, path, status, response, resp_len, &validators, list);
+}
+
+/* Search media */
+int api_search(const char *token, const char *query, media_list_t *list)
+{
+    if (!api_initialized || !list) return -1;
+
+    char url[MAX_URL_LENGTH];
+    snprintf(url, sizeof(url), "%s/api/search?q=%s&token=%s",
+             api_base_url, query, token ? token : "");
 
     char *response = NULL;
     size_t resp_len = 0;
@@ -124,62 +416,119 @@ int api_browse(const char *token, const char *path, library_t lib, media_list_t
         return -1;
     }
 
-    /* Parse JSON response */
-    json_value_t *json = json_parse(response);
+    int result = parse_listing(response, resp_len, "results", list);
     free(response);
+    return result;
+}
+
+/*
+ * Asynchronous calls. Each one is submitted to the core request slots
+ * and completed by api_request_poll() once per frame, after http_update().
+ */
 
-    if (!json) return -1;
+static void api_request_reset(api_request_t *req, api_call_t call)
+{
+    api_request_cancel(req);
+    req->call = call;
+    req->http = -1;
+    for (int lib = 0; lib < LIBRARY_COUNT; lib++) {
+        req->prefetch[lib] = -1;
+    }
+}
 
-    json_value_t *items = json_get_array(json, "items");
-    if (!items) {
-        json_free(json);
+/*
+ * Start api_start_session(). The health check and, with a saved session,
+ * the root listing of every library go out together in separate slots.
+ */
+int api_start_session_async(api_request_t *req, const char *server, const char *token,
+                            const char *const *library_paths)
+{
+    if (set_base_url(server) != 0) {
         return -1;
     }
 
-    int count = json_array_length(items);
-    if (count > MAX_MEDIA_ITEMS) count = MAX_MEDIA_ITEMS;
+    prefetch_clear();
+    api_initialized = false;
+    api_request_reset(req, API_CALL_SESSION);
 
-    /* Allocate/reallocate items array */
-    if (!list->items) {
-        list->items = calloc(MAX_MEDIA_ITEMS, sizeof(media_item_t));
-        list->capacity = MAX_MEDIA_ITEMS;
+    char url[MAX_URL_LENGTH];
+    snprintf(url, sizeof(url), "%s/api/health", api_base_url);
+    req->http = http_submit("GET", url, NULL, NULL);
+    if (req->http < 0) {
+        req->call = API_CALL_NONE;
+        return -1;
     }
 
-    list->count = 0;
-
-    for (int i = 0; i < count; i++) {
-        json_value_t *item = json_array_get(items, i);
-        if (!item) continue;
+    req->library_paths = NULL;
+    if (token && token[0] && library_paths) {
+        /* The listings are cached under their URL, rebuilt from these on completion */
+        strncpy(req->token, token, sizeof(req->token) - 1);
+        req->token[sizeof(req->token) - 1] = '\0';
+        req->library_paths = library_paths;
+
+        for (int lib = 0; lib < LIBRARY_COUNT; lib++) {
+            build_browse_url(url, sizeof(url), token, library_paths[lib], (library_t)lib);
+            cache_validators(url, NULL, &req->prefetch_validators[lib]);
+            /* A listing that finds no free slot is simply not prefetched */
+            req->prefetch[lib] = http_submit_conditional(url, NULL,
+                                                         &req->prefetch_validators[lib]);
+        }
+    }
+    return 0;
+}
 
-        media_item_t *m = &list->items[list->count];
-        memset(m, 0, sizeof(media_item_t));
+/* Start a login; the token is written to token when it completes */
+int api_login_async(api_request_t *req, const char *user, const char *pass,
+                    char *token, size_t len)
+{
+    if (!api_initialized || !token) return -1;
 
-        const char *name = json_get_string(item, "name");
-        const char *item_path = json_get_string(item, "path");
-        const char *type = json_get_string(item, "type");
+    char url[MAX_URL_LENGTH];
+    char body[512];
+    build_login_request(user, pass, url, sizeof(url), body, sizeof(body));
 
-        if (name) strncpy(m->name, name, MAX_TITLE_LENGTH - 1);
-        if (item_path) strncpy(m->path, item_path, MAX_PATH_LENGTH - 1);
+    api_request_reset(req, API_CALL_LOGIN);
+    req->http = http_submit("POST", url, NULL, body);
+    if (req->http < 0) {
+        req->call = API_CALL_NONE;
+        return -1;
+    }
+    req->out = token;
+    req->out_len = len;
+    return 0;
+}
 
-        m->is_directory = json_get_bool(item, "isDirectory", false);
-        m->duration = json_get_int(item, "duration", 0);
-        m->size = json_get_int(item, "size", 0);
+/* Start a browse; a listing prefetched at session start completes at once */
+int api_browse_async(api_request_t *req, const char *token, const char *path, library_t lib,
+                     media_list_t *list)
+{
+    if (!api_initialized || !list) return -1;
 
-        if (type) {
-            if (strcmp(type, "audio") == 0) m->type = MEDIA_TYPE_AUDIO;
-            else if (strcmp(type, "video") == 0) m->type = MEDIA_TYPE_VIDEO;
-            else if (strcmp(type, "directory") == 0) m->type = MEDIA_TYPE_DIRECTORY;
-        }
+    api_request_reset(req, API_CALL_BROWSE);
+    req->list = list;
 
-        list->count++;
+    if (take_prefetched(path, lib, list) == 0) {
+        req->call = API_CALL_DONE;
+        return 0;
     }
 
-    json_free(json);
+    /* The cache key outlives the caller's strings */
+    build_browse_url(req->url, sizeof(req->url), token, path, lib);
+    strncpy(req->path, path ? path : "/", sizeof(req->path) - 1);
+    req->path[sizeof(req->path) - 1] = '\0';
+
+    cache_validators(req->url, NULL, &req->validators);
+    req->http = http_submit_conditional(req->url, NULL, &req->validators);
+    if (req->http < 0) {
+        req->call = API_CALL_NONE;
+        return -1;
+    }
     return 0;
 }
 
-/* Search media */
-int api_search(const char *token, const char *query, media_list_t *list)
+/* Start a search; the list is filled when it completes */
+int api_search_async(api_request_t *req, const char *token, const char *query,
+                     media_list_t *list)
 {
     if (!api_initialized || !list) return -1;
 
@@ -187,21 +536,163 @@ int api_search(const char *token, const char *query, media_list_t *list)
     snprintf(url, sizeof(url), "%s/api/search?q=%s&token=%s",
              api_base_url, query, token ? token : "");
 
+    api_request_reset(req, API_CALL_SEARCH);
+    req->http = http_submit("GET", url, NULL, NULL);
+    if (req->http < 0) {
+        req->call = API_CALL_NONE;
+        return -1;
+    }
+    req->list = list;
+    return 0;
+}
+
+/* Settle whichever parts of a session start have come back */
+static int poll_session(api_request_t *req)
+{
+    bool pending = false;
+
+    if (req->http >= 0) {
+        char *response = NULL;
+        size_t resp_len = 0;
+        int status = http_poll(req->http, &response, &resp_len);
+        free(response);
+
+        if (status == HTTP_IN_PROGRESS) {
+            pending = true;
+        } else {
+            req->http = -1;
+            req->health = status;
+        }
+    }
+
+    for (int lib = 0; lib < LIBRARY_COUNT; lib++) {
+        if (req->prefetch[lib] < 0) continue;
+
+        char *response = NULL;
+        size_t resp_len = 0;
+        int status = http_poll_conditional(req->prefetch[lib], &req->prefetch_validators[lib],
+                                           &response, &resp_len);
+        if (status == HTTP_IN_PROGRESS) {
+            pending = true;
+            continue;
+        }
+        req->prefetch[lib] = -1;
+
+        char url[MAX_URL_LENGTH];
+        build_browse_url(url, sizeof(url), req->token, req->library_paths[lib], (library_t)lib);
+        prefetch_settle((library_t)lib, req->library_paths[lib], url, status, response,
+                        resp_len, &req->prefetch_validators[lib]);
+    }
+
+    if (pending) {
+        return API_PENDING;
+    }
+
+    if (req->health != 0) {
+        printf("API: Server connection failed\n");
+        prefetch_clear();
+        return -1;
+    }
+
+    printf("API: Server connection OK\n");
+    api_initialized = true;
+    return 0;
+}
+
+/*
+ * Complete a call: API_PENDING while it is in flight, then its result
+ * as the blocking call would have returned it
+ */
+int api_request_poll(api_request_t *req)
+{
+    if (req->call == API_CALL_NONE) return -1;
+
+    int result;
+    if (req->call == API_CALL_SESSION) {
+        result = poll_session(req);
+        if (result != API_PENDING) req->call = API_CALL_NONE;
+        return result;
+    }
+    if (req->call == API_CALL_DONE) {
+        req->call = API_CALL_NONE;
+        return 0;
+    }
+
     char *response = NULL;
     size_t resp_len = 0;
+    int status = http_poll_conditional(req->http, &req->validators, &response, &resp_len);
+    if (status == HTTP_IN_PROGRESS) {
+        return API_PENDING;
+    }
 
-    if (http_get(url, &response, &resp_len) != 0) {
-        return -1;
+    api_call_t call = req->call;
+    req->call = API_CALL_NONE;
+    req->http = -1;
+
+    switch (call) {
+        case API_CALL_LOGIN:
+            result = (status == 0 && response)
+                     ? parse_login(response, resp_len, req->out, req->out_len)
+                     : -1;
+            break;
+
+        case API_CALL_BROWSE:
+            /* finish_browse() takes the response */
+            return finish_browse(req->url, req->path, status, response, resp_len,
+                                 &req->validators, req->list);
+
+        case API_CALL_SEARCH:
+            result = (status == 0 && response)
+                     ? parse_listing(response, resp_len, "results", req->list)
+                     : -1;
+            break;
+
+        default:
+            result = -1;
+            break;
     }
 
-    json_value_t *json = json_parse(response);
     free(response);
+    return result;
+}
+
+/* Abandon a call; its destination is left as it was */
+void api_request_cancel(api_request_t *req)
+{
+    if (req->call != API_CALL_NONE) {
+        http_cancel(req->http);
+        if (req->call == API_CALL_SESSION) {
+            for (int lib = 0; lib < LIBRARY_COUNT; lib++) {
+                http_cancel(req->prefetch[lib]);
+            }
+        }
+    }
+    req->call = API_CALL_NONE;
+    req->http = -1;
+}
 
-    if (!json) return -1;
+bool api_request_pending(const api_request_t *req)
+{
+    return req->call != API_CALL_NONE;
+}
 
-    /* Similar parsing as browse */
-    json_free(json);
-    return 0;
+/* Bytes per second each stream quality needs: 1.5, 4 and 8 Mbit/s */
+static const uint32_t quality_rates[] = { 187500, 500000, 1000000 };
+
+/* Best quality the measured throughput carries with headroom; HD until measured */
+static int pick_quality(void)
+{
+    uint32_t bytes_per_sec = http_throughput_estimate();
+    if (bytes_per_sec == 0) return 1;
+
+    uint32_t budget = bytes_per_sec / 100 * ABR_HEADROOM_PCT;
+    int quality = 0;
+    for (int i = 0; i < 3; i++) {
+        if (quality_rates[i] <= budget) quality = i;
+    }
+
+    printf("Throughput %u B/s, streaming quality %d\n", bytes_per_sec, quality);
+    return quality;
 }
 
 /* Get stream URL for media item */
@@ -210,6 +701,7 @@ int api_get_stream_url(const char *token, const char *path, int quality, char *u
     if (!api_initialized) return -1;
 
     const char *quality_names[] = { "sd", "hd", "fhd" };
+    if (quality == VIDEO_QUALITY_AUTO) quality = pick_quality();
     if (quality < 0 || quality > 2) quality = 1;
 
     snprintf(url, len, "%s/api/stream?path=%s&quality=%s&token=%s",
@@ -247,22 +739,7 @@ int api_get_media_info(const char *token, const char *path, media_item_t *item)
         return -1;
     }
 
-    json_value_t *json = json_parse(response);
+    int result = json_decode_object(&g_info_schema, response, resp_len, item);
     free(response);
-
-    if (!json) return -1;
-
-    const char *name = json_get_string(json, "name");
-    const char *desc = json_get_string(json, "description");
-
-    if (name) strncpy(item->name, name, MAX_TITLE_LENGTH - 1);
-    if (desc) strncpy(item->description, desc, sizeof(item->description) - 1);
-
-    item->duration = json_get_int(json, "duration", 0);
-    item->size = json_get_int(json, "size", 0);
-    item->year = json_get_int(json, "year", 0);
-    item->rating = (float)json_get_double(json, "rating", 0.0);
-
-    json_free(json);
-    return 0;
+    return result;
 }
@@ -19,7 +19,7 @@ void config_defaults(user_settings_t *s)
     s->library = LIBRARY_MUSIC;
     s->autoplay = true;
     s->show_subtitles = true;
-    s->video_quality = 1;  /* HD */
+    s->video_quality = VIDEO_QUALITY_AUTO;
     strcpy(s->subtitle_language, "en");
     strcpy(s->audio_language, "en");
     s->enable_surround = false;
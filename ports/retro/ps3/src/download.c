@@ -0,0 +1,741 @@
+/*
+ * Nedflix PS3 - Background download manager
+ *
+ * Each download runs on its own PPU thread so the UI thread never waits
+ * on the network or the disk. Files large enough to benefit are split
+ * into segments fetched over parallel connections with Range requests,
+ * and every segment streams into the file in DOWNLOAD_WRITE_SIZE blocks
+ * at block-aligned offsets.
+ *
+ * Progress is checkpointed to "<file>.part" so an interrupted download
+ * (dropped connection, power off, cancel) picks up where it stopped the
+ * next time the same URL is downloaded to the same path.
+ */
+
+#include "nedflix.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <malloc.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/thread.h>
+#include <sys/mutex.h>
+#include <sys/systime.h>
+
+#define DOWNLOAD_THREAD_PRIO   1500   /* Below the UI thread */
+#define DOWNLOAD_THREAD_STACK  (64 * 1024)
+#define DOWNLOAD_HEAD_MAX      8192
+#define DOWNLOAD_PART_MAGIC    "NDLPART1"
+#define DOWNLOAD_UNUSABLE      (-2)   /* open_range: a response retrying will not fix */
+
+typedef enum {
+    JOB_FREE,
+    JOB_RUNNING,
+    JOB_FINISHED
+} job_state_t;
+
+typedef enum {
+    SEG_RUNNING,
+    SEG_DONE,
+    SEG_FAILED,
+    SEG_CHANGED     /* Server answered a resumed range with the whole, newer file */
+} seg_state_t;
+
+struct download_job;
+
+typedef struct {
+    struct download_job *job;
+    uint64_t start;
+    uint64_t end;                   /* One past the last byte; 0 = read to EOF */
+    volatile uint64_t flushed;      /* Bytes on disk, contiguous from start */
+    volatile uint64_t received;     /* flushed plus bytes waiting in the block buffer */
+    volatile int state;
+    bool started;
+    sys_ppu_thread_t thread;
+} download_segment_t;
+
+typedef struct download_job {
+    volatile int state;
+    int generation;
+    char url[MAX_URL_LENGTH];
+    char path[MAX_PATH_LENGTH];
+    char host[256];
+    char resource[512];
+    int port;
+    char validator[128];            /* ETag or Last-Modified, sent as If-Range */
+    bool ranges;
+    void (*callback)(int);
+    volatile int cancel;
+    volatile int result;
+    volatile uint64_t total;
+    volatile uint32_t bytes_per_sec;
+    int nseg;
+    download_segment_t seg[DOWNLOAD_MAX_SEGMENTS];
+    sys_mutex_t lock;               /* Serializes resume-file writes */
+    sys_ppu_thread_t thread;
+} download_job_t;
+
+/* On-disk resume state, rewritten every DOWNLOAD_CHECKPOINT blocks */
+typedef struct {
+    char magic[8];
+    char url[MAX_URL_LENGTH];
+    char validator[128];
+    uint64_t total;
+    int32_t nseg;
+    int32_t ranges;
+    uint64_t start[DOWNLOAD_MAX_SEGMENTS];
+    uint64_t end[DOWNLOAD_MAX_SEGMENTS];
+    uint64_t flushed[DOWNLOAD_MAX_SEGMENTS];
+} download_part_t;
+
+static download_job_t g_jobs[DOWNLOAD_MAX_JOBS];
+
+static u64 now_ms(void)
+{
+    return sysGetSystemTime() / 1000;
+}
+
+static void part_path(const download_job_t *job, char *out, size_t size)
+{
+    snprintf(out, size, "%s.part", job->path);
+}
+
+/* Record how far every segment got; caller holds job->lock */
+static void part_save(download_job_t *job)
+{
+    download_part_t part;
+    char name[MAX_PATH_LENGTH + 8];
+
+    memset(&part, 0, sizeof(part));
+    memcpy(part.magic, DOWNLOAD_PART_MAGIC, sizeof(part.magic));
+    strncpy(part.url, job->url, sizeof(part.url) - 1);
+    strncpy(part.validator, job->validator, sizeof(part.validator) - 1);
+    part.total = job->total;
+    part.nseg = job->nseg;
+    part.ranges = job->ranges;
+    for (int i = 0; i < job->nseg; i++) {
+        part.start[i] = job->seg[i].start;
+        part.end[i] = job->seg[i].end;
+        part.flushed[i] = job->seg[i].flushed;
+    }
+
+    part_path(job, name, sizeof(name));
+    FILE *f = fopen(name, "wb");
+    if (f) {
+        fwrite(&part, 1, sizeof(part), f);
+        fclose(f);
+    }
+}
+
+/* Restore segment layout and progress from an earlier attempt at this URL */
+static int part_load(download_job_t *job)
+{
+    download_part_t part;
+    char name[MAX_PATH_LENGTH + 8];
+
+    part_path(job, name, sizeof(name));
+    FILE *f = fopen(name, "rb");
+    if (!f) return -1;
+
+    size_t n = fread(&part, 1, sizeof(part), f);
+    fclose(f);
+
+    if (n != sizeof(part) || memcmp(part.magic, DOWNLOAD_PART_MAGIC, sizeof(part.magic)) != 0 ||
+        strcmp(part.url, job->url) != 0 || !part.ranges ||
+        part.nseg < 1 || part.nseg > DOWNLOAD_MAX_SEGMENTS) {
+        return -1;
+    }
+
+    struct stat st;
+    if (stat(job->path, &st) != 0) {
+        return -1;
+    }
+
+    job->total = part.total;
+    job->ranges = true;
+    job->nseg = part.nseg;
+    memcpy(job->validator, part.validator, sizeof(job->validator));
+    job->validator[sizeof(job->validator) - 1] = '\0';
+
+    for (int i = 0; i < job->nseg; i++) {
+        download_segment_t *seg = &job->seg[i];
+        seg->start = part.start[i];
+        seg->end = part.end[i];
+        seg->flushed = part.flushed[i];
+        if (seg->flushed > seg->end - seg->start) {
+            return -1;
+        }
+        seg->received = seg->flushed;
+    }
+
+    printf("Download: resuming %s\n", job->path);
+    return 0;
+}
+
+static void part_remove(download_job_t *job)
+{
+    char name[MAX_PATH_LENGTH + 8];
+    part_path(job, name, sizeof(name));
+    remove(name);
+}
+
+/*
+ * Send a GET for [offset, end) and read the response head into buf.
+ * On success returns the socket, the status code in *status and the
+ * number of body bytes already sitting at the start of buf in *body_len.
+ * With learn set, the response's ETag (or Last-Modified) becomes the
+ * job's If-Range validator. A chunked response gives DOWNLOAD_UNUSABLE.
+ */
+static int open_range(download_job_t *job, uint64_t offset, uint64_t end, bool learn,
+                      char *buf, int *status, size_t *body_len,
+                      uint64_t *range_start, uint64_t *total)
+{
+    int sock = http_connect(job->host, job->port);
+    if (sock < 0) return -1;
+
+    /* Range and If-Range ride with the session headers the API requests use */
+    char range[96 + sizeof(job->validator)] = "";
+    if (job->ranges || end) {
+        int n;
+        if (end) {
+            n = snprintf(range, sizeof(range), "Range: bytes=%llu-%llu\r\n",
+                         (unsigned long long)offset, (unsigned long long)(end - 1));
+        } else {
+            n = snprintf(range, sizeof(range), "Range: bytes=%llu-\r\n",
+                         (unsigned long long)offset);
+        }
+        if (job->validator[0]) {
+            snprintf(range + n, sizeof(range) - n, "If-Range: %s\r\n", job->validator);
+        }
+    }
+
+    http_request_t req = { "GET", job->host, job->resource, NULL, 0, NULL, range, NULL };
+    char request[HTTP_REQUEST_LINE_MAX + HTTP_SESSION_HEADERS_MAX + HTTP_REQUEST_TAIL_MAX];
+    int len = http_format_request(&req, request, sizeof(request));
+    if (len < 0 || send(sock, request, len, 0) != len) {
+        close(sock);
+        return -1;
+    }
+
+    /* Read until the end of the headers */
+    size_t got = 0;
+    char *head_end = NULL;
+    while (!head_end) {
+        if (got >= DOWNLOAD_HEAD_MAX) {
+            close(sock);
+            return -1;
+        }
+        ssize_t n = recv(sock, buf + got, DOWNLOAD_HEAD_MAX - got, 0);
+        if (n <= 0) {
+            close(sock);
+            return -1;
+        }
+        got += n;
+        buf[got] = '\0';
+        head_end = strstr(buf, "\r\n\r\n");
+    }
+
+    size_t head_len = (head_end - buf) + 4;
+    *status = 0;
+    *range_start = 0;
+    *total = 0;
+    sscanf(buf, "HTTP/%*d.%*d %d", status);
+
+    long long content_length = -1;
+    bool chunked = false;
+    char etag[sizeof(job->validator)] = "";
+    char last_modified[sizeof(job->validator)] = "";
+
+    for (char *line = strstr(buf, "\r\n"); line && line < head_end; line = strstr(line, "\r\n")) {
+        line += 2;
+        if (strncasecmp(line, "Content-Length:", 15) == 0) {
+            content_length = strtoll(line + 15, NULL, 10);
+        } else if (strncasecmp(line, "Transfer-Encoding:", 18) == 0) {
+            size_t n = strcspn(line + 18, "\r\n");
+            chunked = http_value_has(line + 18, n, "chunked");
+        } else if (strncasecmp(line, "Content-Range:", 14) == 0) {
+            unsigned long long first = 0, last = 0, size = 0;
+            if (sscanf(line + 14, " bytes %llu-%llu/%llu", &first, &last, &size) >= 2) {
+                *range_start = first;
+                *total = size;
+            }
+        } else if (learn && (strncasecmp(line, "ETag:", 5) == 0 ||
+                             strncasecmp(line, "Last-Modified:", 14) == 0)) {
+            char *dst = (tolower((unsigned char)line[0]) == 'e') ? etag : last_modified;
+            const char *v = strchr(line, ':') + 1;
+            while (*v == ' ') v++;
+            size_t n = strcspn(v, "\r\n");
+            if (n < sizeof(etag)) {
+                memcpy(dst, v, n);
+                dst[n] = '\0';
+            }
+        }
+    }
+    if (chunked) {
+        /* Segments are written to the file as they arrive, framing and all */
+        printf("Download: chunked responses are not supported\n");
+        close(sock);
+        return DOWNLOAD_UNUSABLE;
+    }
+    if (learn) {
+        strcpy(job->validator, etag[0] ? etag : last_modified);
+    }
+    if (*status == 200 && content_length >= 0) {
+        *total = content_length;
+    }
+
+    *body_len = got - head_len;
+    memmove(buf, buf + head_len, *body_len);
+    return sock;
+}
+
+/* Write one block at the segment's current disk position */
+static int flush_block(int fd, download_segment_t *seg, const char *buf, size_t len)
+{
+    if (lseek(fd, seg->start + seg->flushed, SEEK_SET) < 0) {
+        return -1;
+    }
+
+    size_t done = 0;
+    while (done < len) {
+        ssize_t n = write(fd, buf + done, len - done);
+        if (n <= 0) return -1;
+        done += n;
+    }
+
+    seg->flushed += len;
+    return 0;
+}
+
+/*
+ * Segment worker. Fetches [start + flushed, end), reconnecting with a
+ * Range request from the last flushed block whenever the connection
+ * drops, up to DOWNLOAD_MAX_RETRIES times in a row without progress.
+ */
+static void segment_thread(void *arg)
+{
+    download_segment_t *seg = (download_segment_t *)arg;
+    download_job_t *job = seg->job;
+    int fd = -1;
+    char *buf = memalign(128, DOWNLOAD_WRITE_SIZE + 1);
+    int retries = 0;
+    int state = SEG_FAILED;
+
+    if (buf) {
+        fd = open(job->path, O_WRONLY);
+    }
+
+    while (fd >= 0 && !job->cancel && retries <= DOWNLOAD_MAX_RETRIES) {
+        uint64_t offset = seg->start + seg->flushed;
+        if (seg->end && offset >= seg->end) {
+            state = SEG_DONE;
+            break;
+        }
+
+        if (retries > 0) {
+            sysUsleep(retries * 500 * 1000);
+        }
+        retries++;
+
+        int status;
+        size_t fill;
+        uint64_t range_start, total;
+        int sock = open_range(job, offset, seg->end, false, buf, &status, &fill,
+                              &range_start, &total);
+        if (sock == DOWNLOAD_UNUSABLE) break;
+        if (sock < 0) continue;
+
+        if (job->ranges && status == 200) {
+            /* If-Range failed: the file changed since the last attempt */
+            close(sock);
+            state = SEG_CHANGED;
+            break;
+        }
+        if ((job->ranges && (status != 206 || range_start != offset)) ||
+            (!job->ranges && status != 200)) {
+            printf("Download: unexpected status %d\n", status);
+            close(sock);
+            break;
+        }
+        if (!job->ranges && seg->flushed > 0) {
+            /* No ranges: a dropped connection means starting over */
+            seg->flushed = 0;
+        }
+
+        uint64_t remaining = seg->end ? seg->end - offset : (uint64_t)-1;
+        if (fill > remaining) fill = remaining;
+        int blocks = 0;
+        bool eof = false;
+        bool io_failed = false;
+
+        for (;;) {
+            seg->received = seg->flushed + fill;
+            if (fill == remaining) break;
+
+            size_t want = DOWNLOAD_WRITE_SIZE - fill;
+            if (want > remaining - fill) want = remaining - fill;
+
+            ssize_t n = recv(sock, buf + fill, want, 0);
+            if (n <= 0 || job->cancel) {
+                eof = (n == 0);
+                break;
+            }
+            fill += n;
+
+            if (fill == DOWNLOAD_WRITE_SIZE) {
+                if (flush_block(fd, seg, buf, fill) != 0) {
+                    io_failed = true;
+                    break;
+                }
+                remaining -= fill;
+                fill = 0;
+                retries = 0;
+                if (++blocks % DOWNLOAD_CHECKPOINT == 0 && job->ranges) {
+                    sysMutexLock(job->lock, 0);
+                    part_save(job);
+                    sysMutexUnlock(job->lock);
+                }
+            }
+        }
+        close(sock);
+
+        /* Keep whatever arrived; the next request starts right after it */
+        if (!io_failed && fill > 0) {
+            io_failed = (flush_block(fd, seg, buf, fill) != 0);
+            remaining -= fill;
+        }
+        seg->received = seg->flushed;
+
+        if (io_failed) {
+            printf("Download: write failed for %s\n", job->path);
+            break;
+        }
+
+        if (remaining == 0 || (!seg->end && eof && (!job->total || seg->flushed == job->total))) {
+            state = SEG_DONE;
+            break;
+        }
+    }
+
+    if (fd >= 0) close(fd);
+    free(buf);
+    seg->state = state;
+    sysThreadExit(0);
+}
+
+/* Ask for the first byte to learn the size and whether ranges work */
+static int probe(download_job_t *job)
+{
+    char *buf = malloc(DOWNLOAD_HEAD_MAX + 1);
+    if (!buf) return -1;
+
+    int status;
+    size_t fill;
+    uint64_t range_start, total;
+
+    /* A validator left from an earlier attempt would turn this into a full GET */
+    job->validator[0] = '\0';
+    int sock = open_range(job, 0, 1, true, buf, &status, &fill, &range_start, &total);
+    free(buf);
+    if (sock < 0) return -1;
+    close(sock);
+
+    if (status == 206 && total > 0) {
+        job->ranges = true;
+        job->total = total;
+    } else if (status == 200) {
+        job->ranges = false;
+        job->validator[0] = '\0';
+        job->total = total;
+    } else {
+        printf("Download: server returned %d\n", status);
+        return -1;
+    }
+    return 0;
+}
+
+/* Split the file into block-aligned segments */
+static void plan_segments(download_job_t *job)
+{
+    int nseg = 1;
+    if (job->ranges && job->total >= 2 * (uint64_t)DOWNLOAD_SEGMENT_MIN) {
+        nseg = MIN(DOWNLOAD_MAX_SEGMENTS, (int)(job->total / DOWNLOAD_SEGMENT_MIN));
+    }
+
+    uint64_t blocks = (job->total + DOWNLOAD_WRITE_SIZE - 1) / DOWNLOAD_WRITE_SIZE;
+    uint64_t per_seg = (blocks + nseg - 1) / nseg * DOWNLOAD_WRITE_SIZE;
+
+    job->nseg = nseg;
+    for (int i = 0; i < nseg; i++) {
+        download_segment_t *seg = &job->seg[i];
+        seg->start = i * per_seg;
+        seg->end = job->ranges ? MIN(job->total, seg->start + per_seg) : 0;
+        seg->flushed = 0;
+        seg->received = 0;
+    }
+}
+
+/* Run every segment to completion; returns the number that succeeded */
+static int run_segments(download_job_t *job)
+{
+    char name[32];
+
+    for (int i = 0; i < job->nseg; i++) {
+        download_segment_t *seg = &job->seg[i];
+        seg->job = job;
+        seg->state = SEG_RUNNING;
+        snprintf(name, sizeof(name), "nedflix_dl%d", i);
+        seg->started = sysThreadCreate(&seg->thread, segment_thread, seg,
+                                       DOWNLOAD_THREAD_PRIO, DOWNLOAD_THREAD_STACK,
+                                       THREAD_JOINABLE, name) == 0;
+        if (!seg->started) {
+            seg->state = SEG_FAILED;
+        }
+    }
+
+    /* Sample throughput until every segment has stopped */
+    uint64_t last_bytes = 0;
+    u64 last_ms = now_ms();
+    for (int i = 0; i < job->nseg; i++) {
+        last_bytes += job->seg[i].received;
+    }
+
+    for (;;) {
+        bool running = false;
+        uint64_t bytes = 0;
+        for (int i = 0; i < job->nseg; i++) {
+            running |= (job->seg[i].state == SEG_RUNNING);
+            bytes += job->seg[i].received;
+        }
+
+        u64 now = now_ms();
+        if (now - last_ms >= 500) {
+            /* received can step back when an unranged download restarts */
+            uint64_t delta = bytes > last_bytes ? bytes - last_bytes : 0;
+            uint32_t rate = (uint32_t)(delta * 1000 / (now - last_ms));
+            job->bytes_per_sec = job->bytes_per_sec ? (job->bytes_per_sec * 3 + rate) / 4 : rate;
+            last_bytes = bytes;
+            last_ms = now;
+        }
+
+        if (!running) break;
+        sysUsleep(100 * 1000);
+    }
+
+    int done = 0;
+    for (int i = 0; i < job->nseg; i++) {
+        u64 retval;
+        if (job->seg[i].started) {
+            sysThreadJoin(job->seg[i].thread, &retval);
+        }
+        if (job->seg[i].state == SEG_DONE) done++;
+    }
+    return done;
+}
+
+static void job_thread(void *arg)
+{
+    download_job_t *job = (download_job_t *)arg;
+    int result = -1;
+
+    for (int attempt = 0; attempt < 2 && !job->cancel; attempt++) {
+        bool resumed = (attempt == 0 && part_load(job) == 0);
+
+        if (!resumed) {
+            if (probe(job) != 0) break;
+            plan_segments(job);
+
+            int fd = open(job->path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (fd < 0) {
+                printf("Download: cannot create %s\n", job->path);
+                break;
+            }
+            close(fd);
+        }
+
+        if (job->ranges) {
+            sysMutexLock(job->lock, 0);
+            part_save(job);
+            sysMutexUnlock(job->lock);
+        }
+
+        printf("Download: %s, %llu bytes in %d segment(s)\n", job->path,
+               (unsigned long long)job->total, job->nseg);
+
+        int done = run_segments(job);
+
+        bool changed = false;
+        for (int i = 0; i < job->nseg; i++) {
+            changed |= (job->seg[i].state == SEG_CHANGED);
+        }
+
+        if (done == job->nseg) {
+            part_remove(job);
+            result = 0;
+            break;
+        }
+        if (!changed) {
+            if (job->ranges) {
+                sysMutexLock(job->lock, 0);
+                part_save(job);
+                sysMutexUnlock(job->lock);
+            }
+            break;
+        }
+
+        /* The file changed under us: throw the partial copy away, start over */
+        printf("Download: %s changed on the server, restarting\n", job->url);
+        part_remove(job);
+    }
+
+    job->result = result;
+    job->state = JOB_FINISHED;
+    sysThreadExit(0);
+}
+
+/*
+ * Start downloading url to path in the background. Returns a download
+ * id for http_download_progress/http_download_cancel, or -1. callback
+ * receives 0 or -1 from http_download_update on the calling thread.
+ */
+int http_download_async(const char *url, const char *path, void (*callback)(int))
+{
+    if (!url || !path) return -1;
+
+    download_job_t *job = NULL;
+    int idx;
+    for (idx = 0; idx < DOWNLOAD_MAX_JOBS; idx++) {
+        if (g_jobs[idx].state == JOB_FREE) {
+            job = &g_jobs[idx];
+            break;
+        }
+    }
+    if (!job) {
+        printf("Download: too many downloads\n");
+        return -1;
+    }
+
+    int generation = job->generation + 1;
+    memset(job, 0, sizeof(*job));
+    job->generation = generation;
+
+    strncpy(job->url, url, sizeof(job->url) - 1);
+    strncpy(job->path, path, sizeof(job->path) - 1);
+    job->callback = callback;
+
+    if (url_parse(job->url, job->host, sizeof(job->host), &job->port,
+                  job->resource, sizeof(job->resource)) != 0) {
+        return -1;
+    }
+
+    sys_mutex_attr_t attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.attr_protocol = SYS_MUTEX_PROTOCOL_FIFO;
+    attr.attr_recursive = SYS_MUTEX_ATTR_NOT_RECURSIVE;
+    attr.attr_pshared = SYS_MUTEX_ATTR_PSHARED;
+    attr.attr_adaptive = SYS_MUTEX_ATTR_NOT_ADAPTIVE;
+    strcpy(attr.name, "dl_lock");
+    if (sysMutexCreate(&job->lock, &attr) != 0) {
+        return -1;
+    }
+
+    job->state = JOB_RUNNING;
+    if (sysThreadCreate(&job->thread, job_thread, job, DOWNLOAD_THREAD_PRIO,
+                        DOWNLOAD_THREAD_STACK, THREAD_JOINABLE, "nedflix_dl") != 0) {
+        sysMutexDestroy(job->lock);
+        job->state = JOB_FREE;
+        return -1;
+    }
+
+    return (job->generation << 8) | idx;
+}
+
+static download_job_t *find_job(int id)
+{
+    int idx = id & 0xFF;
+    if (id < 0 || idx >= DOWNLOAD_MAX_JOBS) return NULL;
+
+    download_job_t *job = &g_jobs[idx];
+    if (job->state == JOB_FREE || job->generation != (id >> 8)) return NULL;
+    return job;
+}
+
+/* Snapshot of a download's progress; safe to call every frame */
+int http_download_progress(int id, download_progress_t *progress)
+{
+    download_job_t *job = find_job(id);
+    if (!job || !progress) return -1;
+
+    progress->total = job->total;
+    progress->received = 0;
+    progress->segments = job->nseg;
+    for (int i = 0; i < job->nseg; i++) {
+        progress->received += job->seg[i].received;
+    }
+    progress->bytes_per_sec = job->bytes_per_sec;
+    progress->finished = (job->state == JOB_FINISHED);
+    return 0;
+}
+
+/* Stop a download; the partial file and its resume state are kept */
+void http_download_cancel(int id)
+{
+    download_job_t *job = find_job(id);
+    if (job) {
+        job->cancel = 1;
+    }
+}
+
+/*
+ * Reap finished downloads and deliver their callbacks. Call once per
+ * frame from the main loop.
+ */
+void http_download_update(void)
+{
+    uint32_t speed = 0;
+
+    for (int i = 0; i < DOWNLOAD_MAX_JOBS; i++) {
+        download_job_t *job = &g_jobs[i];
+
+        if (job->state == JOB_RUNNING) {
+            speed += job->bytes_per_sec;
+        } else if (job->state == JOB_FINISHED) {
+            u64 retval;
+            sysThreadJoin(job->thread, &retval);
+            sysMutexDestroy(job->lock);
+
+            printf("Download %s: %s\n", job->result == 0 ? "complete" : "failed", job->path);
+            job->state = JOB_FREE;
+            if (job->callback) {
+                job->callback(job->result);
+            }
+        }
+    }
+
+    g_app.net.download_speed = speed / 1024;
+}
+
+/* Cancel everything and wait for the workers to stop */
+void http_download_shutdown(void)
+{
+    for (int i = 0; i < DOWNLOAD_MAX_JOBS; i++) {
+        if (g_jobs[i].state == JOB_RUNNING) {
+            g_jobs[i].cancel = 1;
+        }
+    }
+
+    for (int i = 0; i < DOWNLOAD_MAX_JOBS; i++) {
+        download_job_t *job = &g_jobs[i];
+        if (job->state != JOB_FREE) {
+            u64 retval;
+            sysThreadJoin(job->thread, &retval);
+            sysMutexDestroy(job->lock);
+            job->state = JOB_FREE;
+        }
+    }
+}
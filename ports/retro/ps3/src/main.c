@@ -15,6 +15,7 @@
 #include <string.h>
 #include <malloc.h>
 #include <sys/process.h>
+#include <sys/stat.h>
 #include <sysutil/sysutil.h>
 
 /* Global application instance */
@@ -39,6 +40,13 @@ static const char *lib_paths[] = {
     "/TV Shows"
 };
 
+/* Offline copy in progress, -1 if none */
+static int g_download_id = -1;
+
+/* Server calls in flight, advanced by http_update() each frame */
+static api_request_t g_connect_req;
+static api_request_t g_browse_req;
+
 /* XMB exit callback */
 static void sysutil_callback(u64 status, u64 param, void *userdata)
 {
@@ -103,6 +111,13 @@ void app_init(void)
         printf("Warning: Audio init failed (non-fatal)\n");
     }
 
+    /* Built with CAPTURE= or REPLAY=: record HTTP traffic or play it back */
+#if defined(NETREPLAY_CAPTURE)
+    netreplay_capture(NETREPLAY_CAPTURE);
+#elif defined(NETREPLAY_REPLAY)
+    netreplay_replay(NETREPLAY_REPLAY, NETREPLAY_SPEED);
+#endif
+
     /* Move to network init */
     g_app.state = STATE_NETWORK_INIT;
 
@@ -140,6 +155,9 @@ void app_run(void)
         /* Update input */
         input_update();
 
+        /* Advance in-flight HTTP requests without blocking the frame */
+        http_update();
+
         /* Global exit: PS + Start */
         if (input_held(BTN_PS) && input_pressed(BTN_START)) {
             printf("Exit requested via PS+Start\n");
@@ -147,6 +165,11 @@ void app_run(void)
             continue;
         }
 
+        /* L3 + R3 toggles the network timing overlay */
+        if (input_held(BTN_L3) && input_pressed(BTN_R3)) {
+            g_app.show_netstats = !g_app.show_netstats;
+        }
+
         /* Begin frame */
         ui_begin_frame();
 
@@ -163,6 +186,10 @@ void app_run(void)
             case STATE_ERROR:       state_error(); break;
         }
 
+        if (g_app.show_netstats) {
+            ui_draw_netstats();
+        }
+
         /* End frame */
         ui_end_frame();
 
@@ -171,6 +198,9 @@ void app_run(void)
             audio_update();
         }
 
+        /* Deliver finished background downloads */
+        http_download_update();
+
         g_app.frame_count++;
     }
 }
@@ -184,6 +214,10 @@ void app_shutdown(void)
 
     audio_stop();
     audio_shutdown();
+    http_download_shutdown();
+    api_request_cancel(&g_connect_req);
+    api_request_cancel(&g_browse_req);
+    api_shutdown();
     network_shutdown();
     ui_shutdown();
     input_shutdown();
@@ -217,7 +251,8 @@ static void state_network(void)
             break;
 
         case 1:
-            if (network_init() == 0) {
+            /* A replay needs no network */
+            if (netreplay_replaying() || network_init() == 0) {
                 printf("Network initialized: %s\n", g_app.net.local_ip);
                 phase = 0;
 #if NEDFLIX_CLIENT_MODE
@@ -246,24 +281,30 @@ static void state_network(void)
  */
 static void state_connecting(void)
 {
-    static bool started = false;
-
     ui_draw_loading("Connecting to server...");
 
-    if (!started) {
-        started = true;
-        int result = api_init(g_app.settings.server_url);
-        started = false;
+    if (!api_request_pending(&g_connect_req)) {
+        /* With a saved session this also prefetches every library root */
+        if (api_start_session_async(&g_connect_req, g_app.settings.server_url,
+                                    g_app.settings.session_token, lib_paths) != 0) {
+            app_set_error("Cannot connect to server.\nCheck settings.");
+            return;
+        }
+    }
+
+    int result = api_request_poll(&g_connect_req);
+    if (result == API_PENDING) {
+        return;
+    }
 
-        if (result == 0) {
-            if (strlen(g_app.settings.session_token) > 0) {
-                g_app.state = STATE_MENU;
-            } else {
-                g_app.state = STATE_LOGIN;
-            }
+    if (result == 0) {
+        if (strlen(g_app.settings.session_token) > 0) {
+            g_app.state = STATE_MENU;
         } else {
-            app_set_error("Cannot connect to server.\nCheck settings.");
+            g_app.state = STATE_LOGIN;
         }
+    } else {
+        app_set_error("Cannot connect to server.\nCheck settings.");
     }
 }
 
@@ -315,6 +356,18 @@ static void state_login(void)
     }
 }
 
+#if NEDFLIX_CLIENT_MODE
+/* Fetch the current directory; state_browsing() picks up the result */
+static void start_browse(void)
+{
+    if (api_browse_async(&g_browse_req, g_app.settings.session_token,
+                         g_app.media.current_path, g_app.current_library,
+                         &g_app.media) != 0) {
+        printf("Failed to start browse of %s\n", g_app.media.current_path);
+    }
+}
+#endif
+
 /*
  * STATE: Main menu
  */
@@ -355,10 +408,7 @@ static void state_menu(void)
             g_app.media.scroll_offset = 0;
 
 #if NEDFLIX_CLIENT_MODE
-            api_browse(g_app.settings.session_token,
-                      g_app.media.current_path,
-                      g_app.current_library,
-                      &g_app.media);
+            start_browse();
 #endif
             g_app.state = STATE_BROWSING;
         } else {
@@ -371,6 +421,31 @@ static void state_menu(void)
     }
 }
 
+static void download_done(int result)
+{
+    g_download_id = -1;
+    app_set_status(result == 0 ? "Download complete" : "Download failed");
+}
+
+/* Copy the item to the HDD in the background for offline playback */
+static void start_download(const media_item_t *item)
+{
+    char stream_url[MAX_URL_LENGTH];
+    char dest[MAX_PATH_LENGTH];
+
+    if (api_get_stream_url(g_app.settings.session_token, item->path,
+                          g_app.settings.video_quality, stream_url, sizeof(stream_url)) != 0) {
+        return;
+    }
+
+    const char *base = strrchr(item->path, '/');
+    mkdir(DOWNLOAD_DIR, 0755);
+    snprintf(dest, sizeof(dest), "%s/%s", DOWNLOAD_DIR, base ? base + 1 : item->path);
+
+    g_download_id = http_download_async(stream_url, dest, download_done);
+    app_set_status(g_download_id >= 0 ? "Downloading..." : "Download failed");
+}
+
 /*
  * STATE: Browsing media
  */
@@ -380,7 +455,21 @@ static void state_browsing(void)
     snprintf(header, sizeof(header), "%s", lib_names[g_app.current_library]);
     ui_draw_header(header);
 
+    /* Pick up the listing once it arrives; input stays live meanwhile */
+    bool loading = false;
+    if (api_request_pending(&g_browse_req)) {
+        int result = api_request_poll(&g_browse_req);
+        if (result == API_PENDING) {
+            loading = true;
+        } else if (result != 0) {
+            printf("Browse of %s failed\n", g_app.media.current_path);
+        }
+    }
+
     ui_draw_media_list(&g_app.media);
+    if (loading) {
+        ui_draw_text(50, 590, "Loading...", COLOR_TEXT_DIM);
+    }
 
     /* Navigation */
     if (input_pressed(BTN_UP)) {
@@ -406,8 +495,7 @@ static void state_browsing(void)
         strncpy(g_app.media.current_path, lib_paths[g_app.current_library], MAX_PATH_LENGTH - 1);
         g_app.media.count = 0;
 #if NEDFLIX_CLIENT_MODE
-        api_browse(g_app.settings.session_token, g_app.media.current_path,
-                  g_app.current_library, &g_app.media);
+        start_browse();
 #endif
     }
     if (input_pressed(BTN_R1)) {
@@ -415,8 +503,7 @@ static void state_browsing(void)
         strncpy(g_app.media.current_path, lib_paths[g_app.current_library], MAX_PATH_LENGTH - 1);
         g_app.media.count = 0;
 #if NEDFLIX_CLIENT_MODE
-        api_browse(g_app.settings.session_token, g_app.media.current_path,
-                  g_app.current_library, &g_app.media);
+        start_browse();
 #endif
     }
 
@@ -430,8 +517,7 @@ static void state_browsing(void)
             g_app.media.selected_index = 0;
             g_app.media.scroll_offset = 0;
 #if NEDFLIX_CLIENT_MODE
-            api_browse(g_app.settings.session_token, g_app.media.current_path,
-                      g_app.current_library, &g_app.media);
+            start_browse();
 #endif
         } else {
             char stream_url[MAX_URL_LENGTH];
@@ -467,15 +553,34 @@ static void state_browsing(void)
             g_app.media.count = 0;
             g_app.media.selected_index = 0;
 #if NEDFLIX_CLIENT_MODE
-            api_browse(g_app.settings.session_token, g_app.media.current_path,
-                      g_app.current_library, &g_app.media);
+            start_browse();
 #endif
         } else {
             g_app.state = STATE_MENU;
         }
     }
 
-    ui_draw_text(50, 650, "X:Select  O:Back  L1/R1:Library", COLOR_TEXT_DIM);
+#if NEDFLIX_CLIENT_MODE
+    /* Offline copy */
+    if (input_pressed(BTN_TRIANGLE) && g_app.media.count > 0 && g_download_id < 0) {
+        media_item_t *item = &g_app.media.items[g_app.media.selected_index];
+        if (!item->is_directory) {
+            start_download(item);
+        }
+    }
+#endif
+
+    download_progress_t progress;
+    if (g_download_id >= 0 && http_download_progress(g_download_id, &progress) == 0) {
+        char line[128];
+        int percent = progress.total ? (int)(progress.received * 100 / progress.total) : 0;
+        snprintf(line, sizeof(line), "Downloading %d%%  %u KB/s  (%d connection%s)",
+                 percent, progress.bytes_per_sec / 1024, progress.segments,
+                 progress.segments == 1 ? "" : "s");
+        ui_draw_text(50, 620, line, COLOR_TEXT);
+    }
+
+    ui_draw_text(50, 650, "X:Select  O:Back  L1/R1:Library  Triangle:Download", COLOR_TEXT_DIM);
 }
 
 /*
@@ -547,7 +652,7 @@ static void state_settings(void)
 
     char vol_str[32];
     char quality_str[32];
-    const char *qualities[] = { "SD (480p)", "HD (720p)", "Full HD (1080p)" };
+    const char *qualities[] = { "SD (480p)", "HD (720p)", "Full HD (1080p)", "Auto" };
 
     snprintf(vol_str, sizeof(vol_str), "Volume: %d%%", g_app.settings.volume);
     snprintf(quality_str, sizeof(quality_str), "Quality: %s", qualities[g_app.settings.video_quality]);
@@ -584,7 +689,7 @@ static void state_settings(void)
     }
     if (selected == 2) {
         if (input_pressed(BTN_LEFT) || input_pressed(BTN_RIGHT)) {
-            g_app.settings.video_quality = (g_app.settings.video_quality + 1) % 3;
+            g_app.settings.video_quality = (g_app.settings.video_quality + 1) % (VIDEO_QUALITY_AUTO + 1);
         }
     }
     if (selected == 3) {
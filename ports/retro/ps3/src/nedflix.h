@@ -41,6 +41,8 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#include "core.h"
+
 #define NEDFLIX_VERSION "1.0.0-ps3"
 
 #ifndef NEDFLIX_CLIENT_MODE
@@ -50,16 +52,23 @@
 #define SCREEN_WIDTH  1280
 #define SCREEN_HEIGHT 720
 
-#define MAX_PATH_LENGTH   512
-#define MAX_URL_LENGTH    512
-#define MAX_TITLE_LENGTH  256
 #define MAX_ITEMS_VISIBLE 15
-#define MAX_MEDIA_ITEMS   500
 
-#define HTTP_TIMEOUT_MS    30000
-#define RECV_BUFFER_SIZE   65536
 #define STREAM_BUFFER_SIZE (8 * 1024 * 1024)  /* 8MB - PS3 has plenty */
 
+/* Adaptive quality for video streams */
+#define VIDEO_QUALITY_AUTO    3      /* video_quality setting: pick from throughput */
+#define ABR_HEADROOM_PCT      70     /* Stream at most this share of the estimate */
+
+/* Background downloads (offline copies to the HDD) */
+#define DOWNLOAD_DIR           "/dev_hdd0/game/NEDFLIX01/USRDIR/downloads"
+#define DOWNLOAD_MAX_JOBS      2
+#define DOWNLOAD_MAX_SEGMENTS  4                  /* Parallel connections per file */
+#define DOWNLOAD_SEGMENT_MIN   (16 * 1024 * 1024) /* Files smaller than 2x this use one connection */
+#define DOWNLOAD_WRITE_SIZE    (1024 * 1024)      /* Disk writes happen in whole blocks of this size */
+#define DOWNLOAD_CHECKPOINT    8                  /* Blocks written between resume-file updates */
+#define DOWNLOAD_MAX_RETRIES   5
+
 typedef enum {
     STATE_INIT,
     STATE_NETWORK_INIT,
@@ -72,13 +81,6 @@ typedef enum {
     STATE_ERROR
 } app_state_t;
 
-typedef enum {
-    MEDIA_TYPE_UNKNOWN,
-    MEDIA_TYPE_DIRECTORY,
-    MEDIA_TYPE_AUDIO,
-    MEDIA_TYPE_VIDEO
-} media_type_t;
-
 typedef enum {
     LIBRARY_MUSIC,
     LIBRARY_AUDIOBOOKS,
@@ -139,7 +141,7 @@ typedef struct {
     uint8_t library;
     bool autoplay;
     bool show_subtitles;
-    uint8_t video_quality;  /* 0=SD, 1=HD, 2=Full HD */
+    uint8_t video_quality;  /* 0=SD, 1=HD, 2=Full HD, VIDEO_QUALITY_AUTO */
     char subtitle_language[8];
     char audio_language[8];
     bool enable_surround;
@@ -191,6 +193,7 @@ typedef struct {
     char error_msg[256];
     char status_msg[128];
     bool running;
+    bool show_netstats;         /* Network timing overlay, toggled with L3+R3 */
 
     /* PS3 specific */
     void *gcm_context;
@@ -207,9 +210,27 @@ void app_set_status(const char *msg);
 
 int network_init(void);
 void network_shutdown(void);
+int http_connect(const char *host, int port);
 int http_get(const char *url, char **response, size_t *len);
 int http_post(const char *url, const char *body, char **response, size_t *len);
+
+int http_get_pipelined(http_batch_t *batch, int count);
+int http_get_conditional(const char *url, http_validators_t *validators,
+                         char **response, size_t *len);
+
+typedef struct {
+    uint64_t total;          /* 0 until the size is known */
+    uint64_t received;
+    uint32_t bytes_per_sec;
+    int segments;
+    bool finished;
+} download_progress_t;
+
 int http_download_async(const char *url, const char *path, void (*callback)(int));
+int http_download_progress(int id, download_progress_t *progress);
+void http_download_cancel(int id);
+void http_download_update(void);
+void http_download_shutdown(void);
 
 int ui_init(void);
 void ui_shutdown(void);
@@ -227,6 +248,7 @@ void ui_draw_media_list(const media_list_t *list);
 void ui_draw_media_detail(const media_item_t *item);
 void ui_draw_playback(const playback_t *pb);
 void ui_draw_osk(const char *title, char *output, int max_len);
+void ui_draw_netstats(void);
 
 int input_init(void);
 void input_shutdown(void);
@@ -260,6 +282,7 @@ int video_get_width(void);
 int video_get_height(void);
 
 int api_init(const char *server);
+int api_start_session(const char *server, const char *token, const char *const *library_paths);
 void api_shutdown(void);
 int api_login(const char *user, const char *pass, char *token, size_t len);
 int api_logout(const char *token);
@@ -269,6 +292,47 @@ int api_get_stream_url(const char *token, const char *path, int quality, char *u
 int api_get_subtitles(const char *token, const char *path, const char *lang, char **srt);
 int api_get_media_info(const char *token, const char *path, media_item_t *item);
 
+/* Asynchronous API calls, completed by api_request_poll() once per frame */
+#define API_PENDING 1
+
+typedef enum {
+    API_CALL_NONE,
+    API_CALL_SESSION,
+    API_CALL_LOGIN,
+    API_CALL_BROWSE,
+    API_CALL_SEARCH,
+    API_CALL_DONE           /* Answered without the network */
+} api_call_t;
+
+typedef struct {
+    api_call_t call;        /* API_CALL_NONE when idle */
+    http_handle_t http;
+    media_list_t *list;     /* Browse/search destination */
+    char *out;              /* Login token destination */
+    size_t out_len;
+    char url[MAX_URL_LENGTH];           /* Browse cache key */
+    char path[MAX_PATH_LENGTH];
+    http_validators_t validators;
+    /* Session start: health check result and library root prefetches */
+    int health;
+    char token[256];
+    const char *const *library_paths;
+    http_handle_t prefetch[LIBRARY_COUNT];
+    http_validators_t prefetch_validators[LIBRARY_COUNT];
+} api_request_t;
+
+int api_start_session_async(api_request_t *req, const char *server, const char *token,
+                            const char *const *library_paths);
+int api_login_async(api_request_t *req, const char *user, const char *pass,
+                    char *token, size_t len);
+int api_browse_async(api_request_t *req, const char *token, const char *path, library_t lib,
+                     media_list_t *list);
+int api_search_async(api_request_t *req, const char *token, const char *query,
+                     media_list_t *list);
+int api_request_poll(api_request_t *req);
+void api_request_cancel(api_request_t *req);
+bool api_request_pending(const api_request_t *req);
+
 int config_load(user_settings_t *s);
 int config_save(const user_settings_t *s);
 void config_defaults(user_settings_t *s);
@@ -279,18 +343,6 @@ void spe_decode_shutdown(void);
 int spe_decode_audio(void *input, int in_size, void *output, int *out_size);
 int spe_decode_video(void *input, int in_size, void *output, int *out_size);
 
-typedef struct json_value json_value_t;
-json_value_t *json_parse(const char *text);
-void json_free(json_value_t *v);
-const char *json_get_string(json_value_t *obj, const char *key);
-int json_get_int(json_value_t *obj, const char *key, int def);
-double json_get_double(json_value_t *obj, const char *key, double def);
-bool json_get_bool(json_value_t *obj, const char *key, bool def);
-json_value_t *json_get_object(json_value_t *obj, const char *key);
-json_value_t *json_get_array(json_value_t *obj, const char *key);
-int json_array_length(json_value_t *arr);
-json_value_t *json_array_get(json_value_t *arr, int i);
-
 #define MIN(a,b) ((a) < (b) ? (a) : (b))
 #define MAX(a,b) ((a) > (b) ? (a) : (b))
 #define CLAMP(x,lo,hi) MIN(MAX(x,lo),hi)
@@ -427,6 +427,32 @@ void ui_draw_playback(const playback_t *pb)
     ui_draw_text_centered(screen_height - 50, "X:Pause  O:Stop  L2/R2:Volume  Left/Right:Seek", COLOR_TEXT_DIM);
 }
 
+/* Draw the network timing overlay along the bottom of the screen */
+void ui_draw_netstats(void)
+{
+    int count = netstats_count();
+    int height = 28 + (count > 0 ? count : 1) * 36;
+    int y = screen_height - 80 - height;
+
+    ui_draw_rect(40, y, screen_width - 80, height, COLOR_BLACK);
+    ui_draw_rect(40, y, screen_width - 80, 2, COLOR_RED);
+    ui_draw_text(50, y + 6, "Network (avg ms)", COLOR_RED);
+    y += 28;
+
+    if (count == 0) {
+        ui_draw_text(50, y, "No requests yet", COLOR_TEXT_DIM);
+        return;
+    }
+
+    char line1[80], line2[80];
+    for (int i = 0; i < count; i++) {
+        if (netstats_format(i, line1, line2, sizeof(line1)) < 0) break;
+        ui_draw_text(50, y, line1, COLOR_TEXT);
+        ui_draw_text(50, y + FONT_CHAR_H, line2, COLOR_TEXT_DIM);
+        y += 36;
+    }
+}
+
 /* Draw on-screen keyboard (stub) */
 void ui_draw_osk(const char *title, char *output, int max_len)
 {
@@ -14,29 +14,28 @@ static struct {
     bool initialized;
 } g_api;
 
-/*
- * URL encode a string
- */
-static void url_encode(const char *src, char *dst, size_t dst_size)
-{
-    static const char *hex = "0123456789ABCDEF";
-    size_t pos = 0;
-
-    while (*src && pos < dst_size - 4) {
-        char c = *src++;
-        if ((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') ||
-            (c >= '0' && c <= '9') || c == '-' || c == '_' || c == '.' || c == '~') {
-            dst[pos++] = c;
-        } else if (c == ' ') {
-            dst[pos++] = '+';
-        } else {
-            dst[pos++] = '%';
-            dst[pos++] = hex[(c >> 4) & 0xF];
-            dst[pos++] = hex[c & 0xF];
-        }
-    }
-    dst[pos] = '\0';
-}
+/* Login and user info replies */
+typedef struct {
+    char token[256];
+    char error[128];
+    char username[64];
+} account_reply_t;
+
+static const json_field_t g_account_fields[] = {
+    JSON_FIELD(account_reply_t, token, "token", STRING),
+    JSON_FIELD(account_reply_t, error, "error", STRING),
+    JSON_FIELD(account_reply_t, username, "username", STRING),
+};
+static json_schema_t g_account_schema = JSON_SCHEMA(g_account_fields);
+
+/* Browse and search entries, decoded straight into the list */
+static const json_field_t g_item_fields[] = {
+    JSON_FIELD(media_item_t, name, "name", STRING),
+    JSON_FIELD(media_item_t, path, "path", STRING),
+    JSON_FIELD(media_item_t, size, "size", UINT),
+    MEDIA_HINT_FIELDS
+};
+static json_schema_t g_item_schema = JSON_SCHEMA_SCRATCH(g_item_fields, media_hints_t);
 
 /*
  * Build full API URL
@@ -50,6 +49,19 @@ static void build_url(char *url, size_t url_size, const char *endpoint, const ch
     }
 }
 
+/*
+ * Remember the server URL, without a trailing slash
+ */
+static void set_base_url(const char *server_url)
+{
+    strncpy(g_api.base_url, server_url, sizeof(g_api.base_url) - 1);
+
+    size_t len = strlen(g_api.base_url);
+    if (len > 0 && g_api.base_url[len - 1] == '/') {
+        g_api.base_url[len - 1] = '\0';
+    }
+}
+
 /*
  * Initialize API client
  */
@@ -62,13 +74,7 @@ int api_init(const char *server_url)
 
     LOG("Initializing API client for: %s", server_url);
 
-    strncpy(g_api.base_url, server_url, sizeof(g_api.base_url) - 1);
-
-    /* Remove trailing slash */
-    size_t len = strlen(g_api.base_url);
-    if (len > 0 && g_api.base_url[len - 1] == '/') {
-        g_api.base_url[len - 1] = '\0';
-    }
+    set_base_url(server_url);
 
     /* Test connection with a simple request */
     char url[MAX_URL_LENGTH];
@@ -101,10 +107,71 @@ int api_init(const char *server_url)
  */
 void api_shutdown(void)
 {
+    cache_clear();
     g_api.initialized = false;
     LOG("API client shutdown");
 }
 
+/*
+ * Build the login request
+ */
+static void build_login_request(const char *username, const char *password,
+                                char *body, size_t body_size, char *url, size_t url_size)
+{
+    snprintf(body, body_size,
+             "{\"username\":\"%s\",\"password\":\"%s\"}",
+             username, password);
+
+    build_url(url, url_size, "/auth/local", NULL);
+}
+
+/*
+ * Pick the token out of a login reply
+ */
+static int parse_login_response(const char *response, size_t len,
+                                char *token_out, size_t token_len)
+{
+    account_reply_t reply;
+    memset(&reply, 0, sizeof(reply));
+    if (json_decode_object(&g_account_schema, response, len, &reply) < 0) {
+        LOG_ERROR("Failed to parse login response");
+        return -1;
+    }
+
+    /* Extract token or session info */
+    if (reply.token[0]) {
+        strncpy(token_out, reply.token, token_len - 1);
+        token_out[token_len - 1] = '\0';
+        LOG("Login successful");
+        return 0;
+    }
+
+    /* Check for error message */
+    if (reply.error[0]) {
+        LOG_ERROR("Login failed: %s", reply.error);
+    }
+
+    return -1;
+}
+
+/*
+ * Pick the user name out of a user info reply
+ */
+static int parse_user_response(const char *response, size_t len,
+                               char *username_out, size_t username_len)
+{
+    account_reply_t reply;
+    memset(&reply, 0, sizeof(reply));
+    if (json_decode_object(&g_account_schema, response, len, &reply) < 0 ||
+        !reply.username[0]) {
+        return -1;
+    }
+
+    strncpy(username_out, reply.username, username_len - 1);
+    username_out[username_len - 1] = '\0';
+    return 0;
+}
+
 /*
  * Login with username and password
  */
@@ -115,14 +182,9 @@ int api_login(const char *username, const char *password, char *token_out, size_
 
     LOG("Attempting login for user: %s", username);
 
-    /* Build login request body */
     char body[512];
-    snprintf(body, sizeof(body),
-             "{\"username\":\"%s\",\"password\":\"%s\"}",
-             username, password);
-
     char url[MAX_URL_LENGTH];
-    build_url(url, sizeof(url), "/auth/local", NULL);
+    build_login_request(username, password, body, sizeof(body), url, sizeof(url));
 
     char *response = NULL;
     size_t response_len = 0;
@@ -134,33 +196,9 @@ int api_login(const char *username, const char *password, char *token_out, size_
         return -1;
     }
 
-    /* Parse response */
-    json_value_t *json = json_parse(response);
+    result = parse_login_response(response, response_len, token_out, token_len);
     free(response);
-
-    if (!json) {
-        LOG_ERROR("Failed to parse login response");
-        return -1;
-    }
-
-    /* Extract token or session info */
-    const char *token = json_get_string(json, "token");
-    if (token) {
-        strncpy(token_out, token, token_len - 1);
-        token_out[token_len - 1] = '\0';
-        LOG("Login successful");
-        json_free(json);
-        return 0;
-    }
-
-    /* Check for error message */
-    const char *error = json_get_string(json, "error");
-    if (error) {
-        LOG_ERROR("Login failed: %s", error);
-    }
-
-    json_free(json);
-    return -1;
+    return result;
 }
 
 /*
@@ -183,139 +221,153 @@ int api_get_user_info(const char *token, char *username_out, size_t username_len
         return -1;
     }
 
-    /* Parse response */
-    json_value_t *json = json_parse(response);
+    result = parse_user_response(response, response_len, username_out, username_len);
     free(response);
+    return result;
+}
 
-    if (!json) return -1;
+/*
+ * Hand the decoder the next free slot, or NULL to skip entries once the
+ * list is full
+ */
+static void *next_item(void *user)
+{
+    media_list_t *list = (media_list_t *)user;
+    if (list->count >= list->capacity) return NULL;
 
-    const char *username = json_get_string(json, "username");
-    if (username) {
-        strncpy(username_out, username, username_len - 1);
-        username_out[username_len - 1] = '\0';
-        json_free(json);
-        return 0;
-    }
+    media_item_t *item = &list->items[list->count];
+    memset(item, 0, sizeof(*item));
+    return item;
+}
 
-    json_free(json);
-    return -1;
+static int browse_item_done(void *record, void *scratch, void *user)
+{
+    media_item_t *item = (media_item_t *)record;
+    item->type = media_hints_type((const media_hints_t *)scratch, item->name);
+    item->is_directory = item->type == MEDIA_TYPE_DIRECTORY;
+    ((media_list_t *)user)->count++;
+    return 0;
+}
+
+static int search_item_done(void *record, void *scratch, void *user)
+{
+    media_item_t *item = (media_item_t *)record;
+    (void)scratch;
+    item->is_directory = false;
+    item->type = MEDIA_TYPE_VIDEO;  /* Assume video for search results */
+    ((media_list_t *)user)->count++;
+    return 0;
 }
 
 /*
- * Browse directory
+ * Fill a media list from a browse response
  */
-int api_browse(const char *token, const char *path, library_type_t library, media_list_t *list)
+static int parse_browse_response(const char *response, size_t len, media_list_t *list)
 {
-    if (!g_api.initialized || !list) return -1;
-
-    /* Clear existing list */
-    list->count = 0;
-    list->selected_index = 0;
-    list->scroll_offset = 0;
+    json_decode_t spec = { &g_item_schema, "items", next_item, browse_item_done, list,
+                           NULL, NULL };
+    if (json_decode(&spec, response, len) < 0) {
+        LOG_ERROR("Failed to parse browse response");
+        return -1;
+    }
 
-    /* Build query parameters */
-    char encoded_path[MAX_PATH_LENGTH * 3];
-    url_encode(path ? path : "/", encoded_path, sizeof(encoded_path));
+    LOG("Loaded %d items into list", list->count);
+    return 0;
+}
 
-    char query[1024];
-    snprintf(query, sizeof(query), "path=%s&limit=100", encoded_path);
+/*
+ * Fill a media list from a search response
+ */
+static int parse_search_response(const char *response, size_t len, media_list_t *list)
+{
+    json_decode_t spec = { &g_item_schema, "results", next_item, search_item_done, list,
+                           NULL, NULL };
+    return json_decode(&spec, response, len);
+}
 
-    char url[MAX_URL_LENGTH];
-    build_url(url, sizeof(url), "/api/browse", query);
+typedef int (*listing_parser_t)(const char *response, size_t len, media_list_t *list);
 
-    LOG("Browsing: %s", path);
-
-    char *response = NULL;
-    size_t response_len = 0;
-    int result = http_get_with_auth(url, token, &response, &response_len);
+/*
+ * Settle a listing fetched with a conditional GET: a 304 brings back the
+ * cached copy, a fresh body is parsed and cached with its validators
+ */
+static int finish_listing(int result, char *response, size_t response_len, const char *url,
+                          const char *token, const http_validators_t *validators,
+                          listing_parser_t parse, media_list_t *list)
+{
+    if (result == 304) {
+        free(response);
+        int count = cache_restore(url, token, list->items, sizeof(media_item_t),
+                                  list->capacity, NULL);
+        if (count < 0) {
+            LOG_ERROR("Not modified, but no longer cached: %s", url);
+            return -1;
+        }
+        list->count = count;
+        LOG("Not modified, %d cached items", list->count);
+        return 0;
+    }
 
     if (result != 0 || !response) {
-        LOG_ERROR("Browse request failed: %d", result);
+        LOG_ERROR("Request failed: %d", result);
         if (response) free(response);
         return -1;
     }
 
-    /* Parse response */
-    json_value_t *json = json_parse(response);
+    uint64_t parse_start = netstats_now_us();
+    result = parse(response, response_len, list);
+    netstats_parse(url, parse_start);
     free(response);
 
-    if (!json) {
-        LOG_ERROR("Failed to parse browse response");
-        return -1;
-    }
-
-    /* Extract files array */
-    json_value_t *files = json_get_array(json, "files");
-    if (!files) {
-        json_free(json);
-        return 0;  /* Empty directory */
+    if (result == 0) {
+        cache_store(url, token, validators, list->items, sizeof(media_item_t), list->count,
+                    list->count);
     }
+    return result;
+}
 
-    int file_count = json_array_length(files);
-    LOG("Found %d items", file_count);
+/*
+ * Fetch a listing with a conditional GET
+ */
+static int get_listing(const char *url, const char *token, listing_parser_t parse,
+                       media_list_t *list)
+{
+    http_validators_t validators;
+    cache_validators(url, token, &validators);
 
-    for (int i = 0; i < file_count && list->count < list->capacity; i++) {
-        json_value_t *file = json_array_get(files, i);
-        if (!file) continue;
+    char *response = NULL;
+    size_t response_len = 0;
+    int result = http_get_conditional(url, token, &validators, &response, &response_len);
 
-        media_item_t *item = &list->items[list->count];
-        memset(item, 0, sizeof(*item));
+    return finish_listing(result, response, response_len, url, token, &validators, parse, list);
+}
 
-        /* Get file properties */
-        const char *name = json_get_string(file, "name");
-        const char *file_path = json_get_string(file, "path");
-        bool is_dir = json_get_bool(file, "isDirectory", false);
-        const char *type = json_get_string(file, "type");
+/*
+ * Clear a list and build the URL of a browse
+ */
+static void start_browse(const char *path, media_list_t *list, char *url, size_t url_size)
+{
+    list->count = 0;
+    list->selected_index = 0;
+    list->scroll_offset = 0;
 
-        if (name) {
-            strncpy(item->name, name, sizeof(item->name) - 1);
-        }
-        if (file_path) {
-            strncpy(item->path, file_path, sizeof(item->path) - 1);
-        }
+    /* Build query parameters */
+    char encoded_path[MAX_PATH_LENGTH * 3];
+    url_encode(path ? path : "/", encoded_path, sizeof(encoded_path));
 
-        item->is_directory = is_dir;
-        item->size = json_get_int(file, "size", 0);
-
-        /* Determine media type */
-        if (is_dir) {
-            item->type = MEDIA_TYPE_DIRECTORY;
-        } else if (type) {
-            if (strcmp(type, "video") == 0) {
-                item->type = MEDIA_TYPE_VIDEO;
-            } else if (strcmp(type, "audio") == 0) {
-                item->type = MEDIA_TYPE_AUDIO;
-            } else {
-                item->type = MEDIA_TYPE_UNKNOWN;
-            }
-        } else {
-            /* Detect by extension */
-            const char *ext = strrchr(name ? name : "", '.');
-            if (ext) {
-                if (strstr(".mp4.mkv.avi.mov.webm.m4v.flv.wmv", ext)) {
-                    item->type = MEDIA_TYPE_VIDEO;
-                } else if (strstr(".mp3.m4a.flac.wav.aac.ogg.wma.opus", ext)) {
-                    item->type = MEDIA_TYPE_AUDIO;
-                }
-            }
-        }
+    char query[1024];
+    snprintf(query, sizeof(query), "path=%s&limit=100", encoded_path);
 
-        list->count++;
-    }
+    build_url(url, url_size, "/api/browse", query);
 
-    json_free(json);
-    LOG("Loaded %d items into list", list->count);
-    return 0;
+    LOG("Browsing: %s", path);
 }
 
 /*
- * Search media
+ * Clear a list and build the URL of a search
  */
-int api_search(const char *token, const char *query_str, media_list_t *list)
+static void start_search(const char *query_str, media_list_t *list, char *url, size_t url_size)
 {
-    if (!g_api.initialized || !list || !query_str) return -1;
-
-    /* Clear existing list */
     list->count = 0;
     list->selected_index = 0;
     list->scroll_offset = 0;
@@ -327,54 +379,35 @@ int api_search(const char *token, const char *query_str, media_list_t *list)
     char query[512];
     snprintf(query, sizeof(query), "q=%s&limit=50", encoded_query);
 
-    char url[MAX_URL_LENGTH];
-    build_url(url, sizeof(url), "/api/search", query);
+    build_url(url, url_size, "/api/search", query);
 
     LOG("Searching for: %s", query_str);
+}
 
-    char *response = NULL;
-    size_t response_len = 0;
-    int result = http_get_with_auth(url, token, &response, &response_len);
-
-    if (result != 0 || !response) {
-        if (response) free(response);
-        return -1;
-    }
-
-    /* Parse response - similar to browse */
-    json_value_t *json = json_parse(response);
-    free(response);
-
-    if (!json) return -1;
-
-    json_value_t *results = json_get_array(json, "results");
-    if (!results) {
-        json_free(json);
-        return 0;
-    }
-
-    int result_count = json_array_length(results);
-    for (int i = 0; i < result_count && list->count < list->capacity; i++) {
-        json_value_t *item_json = json_array_get(results, i);
-        if (!item_json) continue;
-
-        media_item_t *item = &list->items[list->count];
-        memset(item, 0, sizeof(*item));
+/*
+ * Browse directory
+ */
+int api_browse(const char *token, const char *path, library_type_t library, media_list_t *list)
+{
+    if (!g_api.initialized || !list) return -1;
 
-        const char *name = json_get_string(item_json, "name");
-        const char *item_path = json_get_string(item_json, "path");
+    char url[MAX_URL_LENGTH];
+    start_browse(path, list, url, sizeof(url));
 
-        if (name) strncpy(item->name, name, sizeof(item->name) - 1);
-        if (item_path) strncpy(item->path, item_path, sizeof(item->path) - 1);
+    return get_listing(url, token, parse_browse_response, list);
+}
 
-        item->is_directory = false;
-        item->type = MEDIA_TYPE_VIDEO;  /* Assume video for search results */
+/*
+ * Search media
+ */
+int api_search(const char *token, const char *query_str, media_list_t *list)
+{
+    if (!g_api.initialized || !list || !query_str) return -1;
 
-        list->count++;
-    }
+    char url[MAX_URL_LENGTH];
+    start_search(query_str, list, url, sizeof(url));
 
-    json_free(json);
-    return 0;
+    return get_listing(url, token, parse_search_response, list);
 }
 
 /*
@@ -474,3 +507,225 @@ int api_save_settings(const char *token, const user_settings_t *settings)
 
     return 0;
 }
+
+/*
+ * Start an asynchronous call, replacing any call still in flight on req
+ */
+static int api_start(api_request_t *req, api_call_t call, const char *method,
+                     const char *url, const char *token, const char *body)
+{
+    api_request_cancel(req);
+
+    http_handle_t http = http_submit(method, url, token, body);
+    if (http < 0) {
+        return -1;
+    }
+
+    req->call = call;
+    req->http = http;
+    return 0;
+}
+
+/*
+ * Start the server reachability check done by api_init()
+ */
+int api_init_async(api_request_t *req, const char *server_url)
+{
+    if (!server_url || strlen(server_url) == 0) {
+        LOG_ERROR("Invalid server URL");
+        return -1;
+    }
+
+    LOG("Initializing API client for: %s", server_url);
+
+    set_base_url(server_url);
+    g_api.initialized = false;
+
+    char url[MAX_URL_LENGTH];
+    build_url(url, sizeof(url), "/api/user", NULL);
+
+    return api_start(req, API_CALL_PING, "GET", url, NULL, NULL);
+}
+
+/*
+ * Start a login; the token is written to token_out when it completes
+ */
+int api_login_async(api_request_t *req, const char *username, const char *password,
+                    char *token_out, size_t token_len)
+{
+    if (!g_api.initialized) return -1;
+    if (!username || !password || !token_out) return -1;
+
+    LOG("Attempting login for user: %s", username);
+
+    char body[512];
+    char url[MAX_URL_LENGTH];
+    build_login_request(username, password, body, sizeof(body), url, sizeof(url));
+
+    if (api_start(req, API_CALL_LOGIN, "POST", url, NULL, body) < 0) {
+        return -1;
+    }
+    req->out = token_out;
+    req->out_len = token_len;
+    return 0;
+}
+
+/*
+ * Start a user info lookup; the name is written to username_out
+ */
+int api_get_user_info_async(api_request_t *req, const char *token,
+                            char *username_out, size_t username_len)
+{
+    if (!g_api.initialized) return -1;
+    if (!token || !username_out) return -1;
+
+    char url[MAX_URL_LENGTH];
+    build_url(url, sizeof(url), "/api/user", NULL);
+
+    if (api_start(req, API_CALL_USER, "GET", url, token, NULL) < 0) {
+        return -1;
+    }
+    req->out = username_out;
+    req->out_len = username_len;
+    return 0;
+}
+
+/*
+ * Start a conditional GET of a listing; the list is filled when it completes
+ */
+static int api_start_listing(api_request_t *req, api_call_t call, const char *url,
+                             const char *token, media_list_t *list)
+{
+    api_request_cancel(req);
+
+    cache_validators(url, token, &req->validators);
+    http_handle_t http = http_submit_conditional(url, token, &req->validators);
+    if (http < 0) {
+        return -1;
+    }
+
+    /* The cache key outlives the caller's strings */
+    strncpy(req->url, url, sizeof(req->url) - 1);
+    req->url[sizeof(req->url) - 1] = '\0';
+    strncpy(req->token, token ? token : "", sizeof(req->token) - 1);
+    req->token[sizeof(req->token) - 1] = '\0';
+
+    req->call = call;
+    req->http = http;
+    req->list = list;
+    return 0;
+}
+
+/*
+ * Start a browse; the list is cleared now and filled when it completes
+ */
+int api_browse_async(api_request_t *req, const char *token, const char *path,
+                     media_list_t *list)
+{
+    if (!g_api.initialized || !list) return -1;
+
+    char url[MAX_URL_LENGTH];
+    start_browse(path, list, url, sizeof(url));
+
+    return api_start_listing(req, API_CALL_BROWSE, url, token, list);
+}
+
+/*
+ * Start a search; the list is cleared now and filled when it completes
+ */
+int api_search_async(api_request_t *req, const char *token, const char *query_str,
+                     media_list_t *list)
+{
+    if (!g_api.initialized || !list || !query_str) return -1;
+
+    char url[MAX_URL_LENGTH];
+    start_search(query_str, list, url, sizeof(url));
+
+    return api_start_listing(req, API_CALL_SEARCH, url, token, list);
+}
+
+/*
+ * Check an asynchronous call. Returns API_PENDING while in flight, then
+ * the same result as the blocking call; req is idle again afterwards.
+ */
+int api_request_poll(api_request_t *req)
+{
+    if (req->call == API_CALL_NONE) return -1;
+
+    char *response = NULL;
+    size_t response_len = 0;
+    int result = http_poll_conditional(req->http, &req->validators, &response, &response_len);
+
+    if (result == HTTP_IN_PROGRESS) {
+        return API_PENDING;
+    }
+
+    api_call_t call = req->call;
+    req->call = API_CALL_NONE;
+    req->http = -1;
+
+    switch (call) {
+        case API_CALL_PING:
+            /* 401 Unauthorized is expected without auth - server is reachable */
+            if (result == 0 || result == 401) {
+                LOG("Server reachable");
+                g_api.initialized = true;
+                result = 0;
+            } else {
+                LOG_ERROR("Failed to connect to server: %d", result);
+                result = -1;
+            }
+            break;
+
+        case API_CALL_LOGIN:
+            if (result != 0 || !response) {
+                LOG_ERROR("Login request failed: %d", result);
+                result = -1;
+            } else {
+                result = parse_login_response(response, response_len, req->out, req->out_len);
+            }
+            break;
+
+        case API_CALL_USER:
+            result = (result == 0 && response)
+                     ? parse_user_response(response, response_len, req->out, req->out_len)
+                     : -1;
+            break;
+
+        case API_CALL_BROWSE:
+        case API_CALL_SEARCH:
+            /* finish_listing() takes the response */
+            return finish_listing(result, response, response_len, req->url, req->token,
+                                  &req->validators,
+                                  call == API_CALL_BROWSE ? parse_browse_response
+                                                          : parse_search_response,
+                                  req->list);
+
+        default:
+            result = -1;
+            break;
+    }
+
+    if (response) free(response);
+    return result;
+}
+
+/*
+ * Abandon an asynchronous call
+ */
+void api_request_cancel(api_request_t *req)
+{
+    if (req->call != API_CALL_NONE) {
+        http_cancel(req->http);
+    }
+    req->call = API_CALL_NONE;
+    req->http = -1;
+}
+
+/*
+ * Check whether a call is in flight
+ */
+bool api_request_pending(const api_request_t *req)
+{
+    return req->call != API_CALL_NONE;
+}
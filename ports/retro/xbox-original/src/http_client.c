@@ -1,6 +1,9 @@
 /*
  * Nedflix for Original Xbox
  * HTTP Client implementation
+ *
+ * Requests go out over HTTP/1.1 keep-alive connections held in a small
+ * per-host pool, so browsing does not pay a TCP handshake on every call.
  */
 
 #include "nedflix.h"
@@ -10,36 +13,114 @@
 
 #ifdef NXDK
 #include <lwip/sockets.h>
-#include <lwip/netdb.h>
-#include <lwip/dns.h>
 #include <lwip/netif.h>
 #include <nxdk/net.h>
 #include <hal/xbox.h>
+#include <windows.h>
+#include <errno.h>
 #else
 /* POSIX sockets for non-Xbox builds */
 #include <sys/socket.h>
-#include <netinet/in.h>
-#include <netdb.h>
 #include <unistd.h>
 #include <errno.h>
+#include <time.h>
 #define closesocket close
 #endif
 
-/* Buffer sizes */
-#define RECV_BUFFER_SIZE  4096
+/* Buffer sizes (RECV_BUFFER_SIZE is in core/core_config.h) */
 #define INITIAL_RESPONSE_SIZE 8192
 
-/* HTTP response structure */
+/* receive_response() result when the peer closed cleanly before sending anything */
+#define HTTP_RECV_STALE   -2
+
+/* A whole response read off a pooled connection (http_coding_t is in core.h) */
 typedef struct {
     int status_code;
-    char *headers;
     char *body;
     size_t body_length;
     size_t content_length;
-} http_response_t;
+    bool has_content_length;
+    bool chunked;
+    bool keep_alive;
+    http_coding_t coding;
+    http_validators_t validators;   /* ETag / Last-Modified, if sent */
+} http_reply_t;
+
+/* Decoded body being assembled from inflate output */
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+} body_buffer_t;
+
+/* Pooled keep-alive connection */
+typedef struct {
+    int sock;
+    char host[256];
+    int port;
+    uint32_t last_used;
+} http_conn_t;
 
 /* Static state */
 static bool g_http_initialized = false;
+static http_conn_t g_pool[HTTP_POOL_SIZE];
+static http_pool_stats_t g_pool_stats;
+
+/*
+ * Millisecond tick counter for idle tracking
+ */
+static uint32_t http_now_ms(void)
+{
+#ifdef NXDK
+    return (uint32_t)GetTickCount();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+#endif
+}
+
+/*
+ * Close a pooled connection and mark the slot free
+ */
+static void pool_close(http_conn_t *conn)
+{
+    if (conn->sock >= 0) {
+        closesocket(conn->sock);
+    }
+    conn->sock = -1;
+    conn->host[0] = '\0';
+    conn->port = 0;
+}
+
+/*
+ * Close every connection that has sat idle longer than the keep-alive window
+ */
+static void pool_expire_idle(uint32_t now)
+{
+    for (int i = 0; i < HTTP_POOL_SIZE; i++) {
+        if (g_pool[i].sock >= 0 && now - g_pool[i].last_used > HTTP_KEEPALIVE_IDLE_MS) {
+            LOG("Closing idle connection to %s:%d", g_pool[i].host, g_pool[i].port);
+            pool_close(&g_pool[i]);
+            g_pool_stats.idle_closed++;
+        }
+    }
+}
+
+/*
+ * Check whether an idle socket has been closed by the server.
+ * A live idle connection has nothing to read, so a zero-byte read (FIN),
+ * unexpected data or a hard error all mean it cannot carry a new request.
+ */
+static bool socket_is_stale(int sock)
+{
+    char c;
+    int n = recv(sock, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+    if (n < 0) {
+        return !(errno == EWOULDBLOCK || errno == EAGAIN);
+    }
+    return true;
+}
 
 /*
  * Initialize HTTP client (network stack)
@@ -53,7 +134,7 @@ int http_init(void)
 #ifdef NXDK
     /* Initialize Xbox network - blocks until DHCP completes or timeout */
     LOG("Initializing network (DHCP)...");
-    if (!nxNetInit(NULL)) {
+    if (!netreplay_replaying() && !nxNetInit(NULL)) {
         LOG_ERROR("Failed to initialize network");
         return -1;
     }
@@ -67,6 +148,13 @@ int http_init(void)
     }
 #endif
 
+    for (int i = 0; i < HTTP_POOL_SIZE; i++) {
+        g_pool[i].sock = -1;
+        g_pool[i].host[0] = '\0';
+        g_pool[i].port = 0;
+    }
+    memset(&g_pool_stats, 0, sizeof(g_pool_stats));
+
     g_http_initialized = true;
     return 0;
 }
@@ -80,6 +168,20 @@ void http_shutdown(void)
         return;
     }
 
+    http_cancel_all();
+    for (int i = 0; i < HTTP_POOL_SIZE; i++) {
+        pool_close(&g_pool[i]);
+    }
+
+    http_pool_stats_t stats;
+    http_get_pool_stats(&stats);
+    LOG("HTTP pool: %u requests, %u reused, %u opened, %u stale retries",
+        (unsigned)stats.requests, (unsigned)stats.connections_reused,
+        (unsigned)stats.connections_opened, (unsigned)stats.stale_retries);
+    LOG("DNS cache: %u lookups, %u hits",
+        (unsigned)stats.dns_lookups, (unsigned)stats.dns_cache_hits);
+    LOG("Request headers built %u times", (unsigned)stats.header_builds);
+
 #ifdef NXDK
     /* Nothing to cleanup for nxdk network */
 #endif
@@ -88,260 +190,586 @@ void http_shutdown(void)
 }
 
 /*
- * Parse URL into components
+ * Get connection pool counters, with the resolver and header counters
+ * the core keeps
  */
-static int parse_url(const char *url, char *host, int *port, char *path)
+void http_get_pool_stats(http_pool_stats_t *stats)
 {
-    const char *p = url;
-
-    /* Skip protocol */
-    if (strncmp(p, "http://", 7) == 0) {
-        p += 7;
-        *port = 80;
-    } else if (strncmp(p, "https://", 8) == 0) {
-        p += 8;
-        *port = 443;  /* Note: HTTPS not supported on Xbox */
-        LOG("Warning: HTTPS not supported, using HTTP");
-        *port = 80;
-    } else {
-        return -1;
+    if (stats) {
+        http_request_stats_t core;
+        http_request_stats(&core);
+        *stats = g_pool_stats;
+        stats->dns_lookups = core.dns_lookups;
+        stats->dns_cache_hits = core.dns_cache_hits;
+        stats->header_builds = core.header_builds;
     }
+}
 
-    /* Extract host */
-    const char *host_end = strchr(p, '/');
-    const char *port_start = strchr(p, ':');
-
-    if (port_start && (!host_end || port_start < host_end)) {
-        /* Host with port */
-        size_t host_len = port_start - p;
-        strncpy(host, p, host_len);
-        host[host_len] = '\0';
-        *port = atoi(port_start + 1);
-        p = host_end ? host_end : p + strlen(p);
-    } else if (host_end) {
-        /* Host without port */
-        size_t host_len = host_end - p;
-        strncpy(host, p, host_len);
-        host[host_len] = '\0';
-        p = host_end;
-    } else {
-        /* Just host */
-        strcpy(host, p);
-        p = "/";
+/*
+ * Open a new connection to host:port, charging the lookup and the
+ * connect to timing
+ */
+static int open_connection(const char *host, int port, net_timing_t *timing)
+{
+    int sock = http_open(host, port, timing);
+    if (sock >= 0) {
+        g_pool_stats.connections_opened++;
     }
+    return sock;
+}
 
-    /* Extract path */
-    if (*p == '/') {
-        strcpy(path, p);
-    } else {
-        strcpy(path, "/");
+/*
+ * Take a connection to host:port out of the pool, or open a new one.
+ * *reused tells the caller whether the socket has carried a request before.
+ */
+static int pool_acquire(const char *host, int port, bool *reused, net_timing_t *timing)
+{
+    pool_expire_idle(http_now_ms());
+
+    for (int i = 0; i < HTTP_POOL_SIZE; i++) {
+        http_conn_t *conn = &g_pool[i];
+        if (conn->sock < 0 || conn->port != port || strcmp(conn->host, host) != 0) {
+            continue;
+        }
+
+        if (socket_is_stale(conn->sock)) {
+            LOG("Pooled connection to %s:%d went stale", host, port);
+            pool_close(conn);
+            continue;
+        }
+
+        int sock = conn->sock;
+        conn->sock = -1;
+        conn->host[0] = '\0';
+        *reused = true;
+        g_pool_stats.connections_reused++;
+        return sock;
     }
 
-    return 0;
+    *reused = false;
+    return open_connection(host, port, timing);
 }
 
 /*
- * Create HTTP request string
+ * Return a connection to the pool, evicting the least recently used one
+ * if every slot is taken
  */
-static char *create_request(const char *method, const char *host, const char *path,
-                            const char *auth_token, const char *body)
+static void pool_release(const char *host, int port, int sock)
 {
-    size_t size = 1024 + (body ? strlen(body) : 0) + (auth_token ? strlen(auth_token) : 0);
-    char *request = (char *)malloc(size);
-    if (!request) return NULL;
-
-    int offset = 0;
+    http_conn_t *slot = NULL;
 
-    /* Request line */
-    offset += snprintf(request + offset, size - offset, "%s %s HTTP/1.1\r\n", method, path);
+    for (int i = 0; i < HTTP_POOL_SIZE; i++) {
+        if (g_pool[i].sock < 0) {
+            slot = &g_pool[i];
+            break;
+        }
+        if (!slot || g_pool[i].last_used < slot->last_used) {
+            slot = &g_pool[i];
+        }
+    }
 
-    /* Headers */
-    offset += snprintf(request + offset, size - offset, "Host: %s\r\n", host);
-    offset += snprintf(request + offset, size - offset, "User-Agent: Nedflix-Xbox/1.0\r\n");
-    offset += snprintf(request + offset, size - offset, "Accept: application/json\r\n");
-    offset += snprintf(request + offset, size - offset, "Connection: close\r\n");
+    pool_close(slot);
+    slot->sock = sock;
+    slot->port = port;
+    strncpy(slot->host, host, sizeof(slot->host) - 1);
+    slot->host[sizeof(slot->host) - 1] = '\0';
+    slot->last_used = http_now_ms();
+}
 
-    if (auth_token && strlen(auth_token) > 0) {
-        offset += snprintf(request + offset, size - offset, "Authorization: Bearer %s\r\n", auth_token);
+/*
+ * Parse status line, the headers that decide how the body is framed, and
+ * the validators a cached copy is revalidated with
+ */
+static int parse_headers(const char *data, size_t header_len, http_reply_t *response)
+{
+    if (header_len < 12 || strncmp(data, "HTTP/1.", 7) != 0) return -1;
+
+    /* HTTP/1.1 defaults to persistent connections, HTTP/1.0 does not */
+    response->keep_alive = (data[7] == '1');
+    response->status_code = atoi(data + 9);
+
+    const char *line = strstr(data, "\r\n");
+    const char *end = data + header_len;
+
+    while (line && line + 2 < end) {
+        line += 2;
+        const char *eol = strstr(line, "\r\n");
+        if (!eol || eol == line) break;
+
+        const char *colon = memchr(line, ':', eol - line);
+        if (colon) {
+            const char *value = colon + 1;
+            while (value < eol && *value == ' ') value++;
+            size_t name_len = colon - line;
+            size_t value_len = eol - value;
+
+            if (http_header_is(line, name_len, "content-length")) {
+                response->content_length = strtoul(value, NULL, 10);
+                response->has_content_length = true;
+            } else if (http_header_is(line, name_len, "transfer-encoding")) {
+                response->chunked = http_value_has(value, value_len, "chunked");
+            } else if (http_header_is(line, name_len, "content-encoding")) {
+                if (http_value_has(value, value_len, "gzip")) {
+                    response->coding = CODING_GZIP;
+                } else if (http_value_has(value, value_len, "deflate")) {
+                    response->coding = CODING_DEFLATE;
+                } else if (!http_value_has(value, value_len, "identity")) {
+                    response->coding = CODING_OTHER;
+                }
+            } else if (http_header_is(line, name_len, "etag")) {
+                http_copy_validator(response->validators.etag, sizeof(response->validators.etag),
+                                    value, value_len);
+            } else if (http_header_is(line, name_len, "last-modified")) {
+                http_copy_validator(response->validators.last_modified,
+                                    sizeof(response->validators.last_modified), value, value_len);
+            } else if (http_header_is(line, name_len, "connection")) {
+                if (http_value_has(value, value_len, "close")) {
+                    response->keep_alive = false;
+                } else if (http_value_has(value, value_len, "keep-alive")) {
+                    response->keep_alive = true;
+                }
+            }
+        }
+        line = eol;
     }
 
-    if (body) {
-        offset += snprintf(request + offset, size - offset, "Content-Type: application/json\r\n");
-        offset += snprintf(request + offset, size - offset, "Content-Length: %zu\r\n", strlen(body));
+    /* These statuses never carry a body */
+    if (response->status_code == 204 || response->status_code == 304 ||
+        (response->status_code >= 100 && response->status_code < 200)) {
+        response->has_content_length = true;
+        response->content_length = 0;
+        response->chunked = false;
     }
 
-    /* End of headers */
-    offset += snprintf(request + offset, size - offset, "\r\n");
-
-    /* Body */
-    if (body) {
-        offset += snprintf(request + offset, size - offset, "%s", body);
+    /* Without framing the body runs until the server closes */
+    if (!response->chunked && !response->has_content_length) {
+        response->keep_alive = false;
     }
 
-    return request;
+    return 0;
 }
 
 /*
- * Parse HTTP response
+ * Walk chunk headers to see whether a chunked body is complete.
+ * *scan holds the offset of the next unvisited chunk header so each call
+ * only looks at newly received bytes. Returns the full encoded length
+ * (including trailers) once complete, or 0 if more data is needed.
  */
-static int parse_response(const char *data, size_t len, http_response_t *response)
+static size_t chunked_body_complete(const char *body, size_t len, size_t *scan)
 {
-    /* Find status code */
-    const char *status_start = strstr(data, "HTTP/1.");
-    if (!status_start) return -1;
-
-    status_start = strchr(status_start, ' ');
-    if (!status_start) return -1;
-    response->status_code = atoi(status_start + 1);
-
-    /* Find Content-Length */
-    const char *cl = strstr(data, "Content-Length:");
-    if (cl) {
-        response->content_length = atoi(cl + 15);
-    }
-
-    /* Find body (after \r\n\r\n) */
-    const char *body_start = strstr(data, "\r\n\r\n");
-    if (body_start) {
-        body_start += 4;
-        response->body_length = len - (body_start - data);
-        response->body = (char *)malloc(response->body_length + 1);
-        if (response->body) {
-            memcpy(response->body, body_start, response->body_length);
-            response->body[response->body_length] = '\0';
+    size_t pos = *scan;
+
+    while (pos < len) {
+        const char *eol = strstr(body + pos, "\r\n");
+        if (!eol) return 0;
+
+        size_t chunk_size = strtoul(body + pos, NULL, 16);
+        size_t data_start = (eol - body) + 2;
+
+        if (chunk_size == 0) {
+            /* Skip optional trailer lines up to the terminating blank line */
+            size_t t = data_start;
+            while (t < len) {
+                const char *tl = strstr(body + t, "\r\n");
+                if (!tl) return 0;
+                if (tl == body + t) return t + 2;
+                t = (tl - body) + 2;
+            }
+            return 0;
         }
+
+        if (data_start > len || chunk_size + 2 > len - data_start) return 0;
+        pos = data_start + chunk_size + 2;
+        *scan = pos;
     }
 
     return 0;
 }
 
 /*
- * Perform HTTP request
+ * Strip chunk framing in place, returning the decoded body length
  */
-static int http_request(const char *method, const char *url, const char *auth_token,
-                        const char *body, char **response, size_t *response_len)
+static size_t dechunk_in_place(char *body, size_t len)
 {
-    char host[256] = {0};
-    char path[512] = {0};
-    int port = 80;
-    int sock = -1;
-
-    /* Parse URL */
-    if (parse_url(url, host, &port, path) != 0) {
-        LOG_ERROR("Invalid URL: %s", url);
-        return -1;
+    size_t in = 0;
+    size_t out = 0;
+
+    while (in < len) {
+        const char *eol = strstr(body + in, "\r\n");
+        if (!eol) break;
+
+        size_t chunk_size = strtoul(body + in, NULL, 16);
+        if (chunk_size == 0) break;
+
+        in = (eol - body) + 2;
+        if (in > len) break;
+        if (chunk_size > len - in) chunk_size = len - in;
+        memmove(body + out, body + in, chunk_size);
+        out += chunk_size;
+        in += chunk_size + 2;
     }
 
-    LOG("HTTP %s %s:%d%s", method, host, port, path);
+    body[out] = '\0';
+    return out;
+}
 
-    /* Resolve hostname */
-    struct hostent *he = gethostbyname(host);
-    if (!he) {
-        LOG_ERROR("DNS lookup failed for %s", host);
+/*
+ * Append inflate output to the decoded body, which is held to
+ * HTTP_MAX_BUFFERED_BODY however small the compressed form was
+ */
+static int body_buffer_sink(const char *data, size_t len, void *user)
+{
+    body_buffer_t *out = (body_buffer_t *)user;
+
+    if (len > HTTP_MAX_BUFFERED_BODY - out->len) {
+        LOG_ERROR("Decoded body over %u bytes", (unsigned)HTTP_MAX_BUFFERED_BODY);
         return -1;
     }
+    if (out->len + len + 1 > out->cap) {
+        size_t new_cap = out->cap;
+        while (out->len + len + 1 > new_cap) new_cap *= 2;
+        new_cap = MIN(new_cap, (size_t)HTTP_MAX_BUFFERED_BODY + 1);
+        char *grown = (char *)realloc(out->data, new_cap);
+        if (!grown) return -1;
+        out->data = grown;
+        out->cap = new_cap;
+    }
+    memcpy(out->data + out->len, data, len);
+    out->len += len;
+    return 0;
+}
 
-    /* Create socket */
-    sock = socket(AF_INET, SOCK_STREAM, 0);
-    if (sock < 0) {
-        LOG_ERROR("Failed to create socket");
+/*
+ * Replace a compressed body with its decoded form.
+ * On success *body is a new NUL-terminated buffer and the old one is freed.
+ */
+static int decode_body(http_coding_t coding, char **body, size_t *body_length)
+{
+    if (coding == CODING_OTHER) {
+        LOG_ERROR("Unsupported Content-Encoding");
         return -1;
     }
 
-    /* Set timeout */
-#ifdef NXDK
-    int timeout = HTTP_CONNECT_TIMEOUT;
-    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
-    setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
-#else
-    struct timeval tv;
-    tv.tv_sec = HTTP_CONNECT_TIMEOUT / 1000;
-    tv.tv_usec = (HTTP_CONNECT_TIMEOUT % 1000) * 1000;
-    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
-    setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
-#endif
-
-    /* Connect */
-    struct sockaddr_in addr;
-    memset(&addr, 0, sizeof(addr));
-    addr.sin_family = AF_INET;
-    addr.sin_port = htons(port);
-    memcpy(&addr.sin_addr, he->h_addr, he->h_length);
-
-    if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
-        LOG_ERROR("Connection failed");
-        closesocket(sock);
+    /* JSON typically deflates 5-10x, so start near the final size */
+    body_buffer_t out;
+    out.cap = MIN(*body_length, HTTP_MAX_BUFFERED_BODY / 8) * 8 + 1;
+    out.len = 0;
+    out.data = (char *)malloc(out.cap);
+    if (!out.data) {
         return -1;
     }
 
-    /* Create and send request */
-    char *request = create_request(method, host, path, auth_token, body);
-    if (!request) {
-        closesocket(sock);
+    inflate_t *z = inflate_create(coding == CODING_GZIP ? INFLATE_GZIP : INFLATE_AUTO,
+                                  body_buffer_sink, &out);
+    if (!z) {
+        free(out.data);
         return -1;
     }
 
-    size_t request_len = strlen(request);
-    if (send(sock, request, request_len, 0) != (int)request_len) {
-        LOG_ERROR("Failed to send request");
-        free(request);
-        closesocket(sock);
+    int result = inflate_feed(z, *body, *body_length);
+    inflate_destroy(z);
+    if (result != 1) {
+        if (result == 0) {
+            LOG_ERROR("Compressed body truncated");
+        }
+        free(out.data);
         return -1;
     }
-    free(request);
 
-    /* Receive response */
+    out.data[out.len] = '\0';
+    free(*body);
+    *body = out.data;
+    *body_length = out.len;
+    return 0;
+}
+
+/*
+ * Read one response off the connection. The body ends at Content-Length,
+ * the last chunk, or connection close, so the socket can be reused after.
+ */
+static int receive_response(int sock, http_reply_t *response, net_timing_t *timing)
+{
     size_t buffer_size = INITIAL_RESPONSE_SIZE;
     char *buffer = (char *)malloc(buffer_size);
     if (!buffer) {
-        closesocket(sock);
         return -1;
     }
 
     size_t total_received = 0;
-    char recv_buf[RECV_BUFFER_SIZE];
-    int recv_len;
-
-    while ((recv_len = recv(sock, recv_buf, sizeof(recv_buf), 0)) > 0) {
-        /* Grow buffer if needed */
-        if (total_received + recv_len >= buffer_size) {
-            buffer_size *= 2;
+    size_t header_len = 0;
+    size_t chunk_scan = 0;
+    size_t body_end = 0;
+    bool complete = false;
+
+    while (!complete) {
+        /* Grow buffer if needed, but never past HTTP_MAX_BUFFERED_BODY of body */
+        if (total_received + RECV_BUFFER_SIZE + 1 > buffer_size) {
+            if (total_received - header_len > HTTP_MAX_BUFFERED_BODY) {
+                LOG_ERROR("Response body over %u bytes", (unsigned)HTTP_MAX_BUFFERED_BODY);
+                free(buffer);
+                return -1;
+            }
+            buffer_size = MIN(buffer_size * 2,
+                              header_len + HTTP_MAX_BUFFERED_BODY + RECV_BUFFER_SIZE + 1);
             char *new_buffer = (char *)realloc(buffer, buffer_size);
             if (!new_buffer) {
                 free(buffer);
-                closesocket(sock);
                 return -1;
             }
             buffer = new_buffer;
         }
 
-        memcpy(buffer + total_received, recv_buf, recv_len);
+        int recv_len = recv(sock, buffer + total_received, RECV_BUFFER_SIZE, 0);
+        if (recv_len <= 0) {
+            /*
+             * Only an orderly close before any byte means the server had
+             * already dropped the connection. A timeout or socket error may
+             * come after the server acted on the request.
+             */
+            if (total_received == 0 && recv_len == 0) {
+                free(buffer);
+                return HTTP_RECV_STALE;
+            }
+            if (total_received == 0) {
+                LOG_ERROR("No response (timeout or socket error)");
+                free(buffer);
+                return -1;
+            }
+            /* Close-delimited bodies end here; framed ones are truncated */
+            if (header_len > 0 && !response->keep_alive &&
+                !response->chunked && !response->has_content_length) {
+                body_end = total_received;
+                complete = true;
+                break;
+            }
+            LOG_ERROR("Connection lost mid-response");
+            free(buffer);
+            return -1;
+        }
+
+        netstats_first_byte(timing);
+        size_t scan_from = total_received > 3 ? total_received - 3 : 0;
         total_received += recv_len;
+        buffer[total_received] = '\0';
+
+        /* Headers are parsed once, as soon as the blank line arrives */
+        if (header_len == 0) {
+            const char *header_end = strstr(buffer + scan_from, "\r\n\r\n");
+            if (!header_end) continue;
+
+            header_len = (header_end - buffer) + 4;
+            if (parse_headers(buffer, header_len, response) != 0) {
+                free(buffer);
+                return -1;
+            }
+            if (response->has_content_length &&
+                response->content_length > HTTP_MAX_BUFFERED_BODY) {
+                LOG_ERROR("Response body over %u bytes", (unsigned)HTTP_MAX_BUFFERED_BODY);
+                free(buffer);
+                return -1;
+            }
+        }
+
+        size_t body_received = total_received - header_len;
+
+        if (response->chunked) {
+            size_t encoded = chunked_body_complete(buffer + header_len, body_received, &chunk_scan);
+            if (encoded > 0) {
+                body_end = header_len + encoded;
+                complete = true;
+            }
+        } else if (response->has_content_length) {
+            if (body_received >= response->content_length) {
+                body_end = header_len + response->content_length;
+                complete = true;
+            }
+        }
     }
 
-    closesocket(sock);
+    timing->bytes = body_end;
+
+    /* Anything past the end of this response means we lost sync */
+    if (body_end < total_received) {
+        response->keep_alive = false;
+    }
 
-    if (total_received == 0) {
-        LOG_ERROR("Empty response");
+    /* Slide the body to the front and hand the buffer itself to the caller */
+    size_t body_length = body_end - header_len;
+    memmove(buffer, buffer + header_len, body_length);
+    buffer[body_length] = '\0';
+
+    if (response->chunked) {
+        body_length = dechunk_in_place(buffer, body_length);
+    }
+    if (body_length > HTTP_MAX_BUFFERED_BODY) {
+        LOG_ERROR("Response body over %u bytes", (unsigned)HTTP_MAX_BUFFERED_BODY);
         free(buffer);
         return -1;
     }
 
-    buffer[total_received] = '\0';
-
-    /* Parse response */
-    http_response_t resp = {0};
-    if (parse_response(buffer, total_received, &resp) != 0) {
-        LOG_ERROR("Failed to parse response");
+    if (response->coding != CODING_IDENTITY && body_length > 0 &&
+        decode_body(response->coding, &buffer, &body_length) < 0) {
         free(buffer);
         return -1;
     }
 
-    free(buffer);
+    response->body = buffer;
+    response->body_length = body_length;
+    return 0;
+}
+
+/*
+ * Answer a request from the loaded capture instead of the network
+ */
+static int replay_request(const char *method, const char *url, http_validators_t *validators,
+                          char **response, size_t *response_len)
+{
+    const netreplay_exchange_t *x = netreplay_answer(method, url);
+    if (!x) {
+        return -1;
+    }
+
+    if (validators) {
+        http_validators_update(validators, x->status, &x->validators);
+    }
+    if (x->status < 200 || x->status >= 300) {
+        return x->status;
+    }
+
+    char *copy = netreplay_body_copy(x);
+    if (!copy) {
+        return -1;
+    }
+    *response = copy;
+    *response_len = x->body_len;
+    return 0;
+}
+
+/*
+ * Perform HTTP request. With validators, the GET is conditional and they
+ * are updated from the response.
+ */
+static int http_request(const char *method, const char *url, const char *auth_token,
+                        const char *body, http_validators_t *validators,
+                        char **response, size_t *response_len)
+{
+    if (netreplay_replaying()) {
+        return replay_request(method, url, validators, response, response_len);
+    }
+
+    char host[256] = {0};
+    char path[512] = {0};
+    int port = 80;
+
+    /* Parse URL */
+    if (url_parse(url, host, sizeof(host), &port, path, sizeof(path)) != 0) {
+        LOG_ERROR("Invalid URL: %s", url);
+        return -1;
+    }
+    if (port == 443 && strncmp(url, "https://", 8) == 0) {
+        LOG("Warning: HTTPS not supported, using HTTP");
+        port = 80;
+    }
+
+    LOG("HTTP %s %s:%d%s", method, host, port, path);
+
+    /* Describe the request; the pieces stay valid for the retry below */
+    http_request_t req = { method, host, path, auth_token,
+                           HTTP_REQ_KEEP_ALIVE | HTTP_REQ_ENCODED, validators, NULL, body };
+    http_request_head_t head;
+    core_piece_t request[4];
+    int request_count = http_build_request(&req, &head, request);
+    if (request_count < 0) {
+        return -1;
+    }
+
+    g_pool_stats.requests++;
+
+    http_reply_t resp;
+    net_timing_t timing;
+    int sock = -1;
+    int result = -1;
+
+    /*
+     * A pooled socket can be closed by the server between our staleness
+     * check and the send. If a reused connection is closed before any
+     * response bytes, retry exactly once on a fresh connection - but only
+     * for GET and HEAD, which are safe to send twice.
+     */
+    bool idempotent = strcmp(method, "GET") == 0 || strcmp(method, "HEAD") == 0;
+
+    for (int attempt = 0; attempt < 2; attempt++) {
+        bool reused = false;
+        memset(&resp, 0, sizeof(resp));
+
+        /* A retry is timed on its own; the stale attempt cost next to nothing */
+        netstats_start(&timing);
+        sock = pool_acquire(host, port, &reused, &timing);
+        if (sock < 0) {
+            break;
+        }
+
+        core_piece_t pending[4];
+        memcpy(pending, request, sizeof(pending));
+
+        if (http_send_pieces(sock, pending, request_count) != 0) {
+            closesocket(sock);
+            sock = -1;
+            if (reused && idempotent && attempt == 0) {
+                g_pool_stats.stale_retries++;
+                continue;
+            }
+            LOG_ERROR("Failed to send request");
+            break;
+        }
+        netstats_phase(&timing, NET_PHASE_SEND);
+
+        result = receive_response(sock, &resp, &timing);
+        if (result == HTTP_RECV_STALE && reused && idempotent && attempt == 0) {
+            closesocket(sock);
+            sock = -1;
+            g_pool_stats.stale_retries++;
+            continue;
+        }
+        break;
+    }
+
+    netstats_record(url, &timing, sock >= 0 && result == 0);
+    if (netreplay_capturing()) {
+        bool ok = sock >= 0 && result == 0;
+        netreplay_record(method, url, ok ? resp.status_code : -1, &resp.validators, &timing,
+                         resp.body, resp.body_length);
+    }
+
+    if (sock < 0) {
+        return -1;
+    }
+
+    if (result != 0) {
+        if (result == HTTP_RECV_STALE) {
+            LOG_ERROR("Empty response");
+        } else {
+            LOG_ERROR("Failed to read response");
+        }
+        closesocket(sock);
+        return -1;
+    }
+
+    if (resp.keep_alive) {
+        pool_release(host, port, sock);
+    } else {
+        closesocket(sock);
+    }
+
+    if (validators) {
+        http_validators_update(validators, resp.status_code, &resp.validators);
+    }
 
     /* Check status code */
     if (resp.status_code < 200 || resp.status_code >= 300) {
-        LOG_ERROR("HTTP error: %d", resp.status_code);
+        if (resp.status_code != 304) {
+            LOG_ERROR("HTTP error: %d", resp.status_code);
+        }
         if (resp.body) free(resp.body);
         return resp.status_code;
     }
@@ -359,15 +787,26 @@ static int http_request(const char *method, const char *url, const char *auth_to
 
 int http_get(const char *url, char **response, size_t *response_len)
 {
-    return http_request("GET", url, NULL, NULL, response, response_len);
+    return http_request("GET", url, NULL, NULL, NULL, response, response_len);
 }
 
 int http_post(const char *url, const char *body, char **response, size_t *response_len)
 {
-    return http_request("POST", url, NULL, body, response, response_len);
+    return http_request("POST", url, NULL, body, NULL, response, response_len);
 }
 
 int http_get_with_auth(const char *url, const char *token, char **response, size_t *response_len)
 {
-    return http_request("GET", url, token, NULL, response, response_len);
+    return http_request("GET", url, token, NULL, NULL, response, response_len);
+}
+
+/*
+ * Conditional GET. Returns 304 with no body when the copy the validators
+ * describe is still current; otherwise as http_get_with_auth(). The
+ * validators are updated from the response either way.
+ */
+int http_get_conditional(const char *url, const char *token, http_validators_t *validators,
+                         char **response, size_t *response_len)
+{
+    return http_request("GET", url, token, NULL, validators, response, response_len);
 }
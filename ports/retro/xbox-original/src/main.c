@@ -33,6 +33,10 @@ static const char *library_paths[] = {
     "/Audiobooks"
 };
 
+/* API calls in flight; http_update() in app_run() moves them along */
+static api_request_t g_connect_req;
+static api_request_t g_browse_req;
+
 /*
  * Forward declarations for state handlers
  */
@@ -79,6 +83,13 @@ void app_init(void)
         return;
     }
 
+    /* Built with CAPTURE= or REPLAY=: record HTTP traffic or play it back */
+#if defined(NETREPLAY_CAPTURE)
+    netreplay_capture(NETREPLAY_CAPTURE);
+#elif defined(NETREPLAY_REPLAY)
+    netreplay_replay(NETREPLAY_REPLAY, NETREPLAY_SPEED);
+#endif
+
     if (http_init() != 0) {
         LOG_ERROR("Failed to initialize network");
         g_app.state = STATE_ERROR;
@@ -92,7 +103,7 @@ void app_init(void)
     }
 
     /* Allocate media list */
-    g_app.media_list.capacity = 100;
+    g_app.media_list.capacity = MAX_MEDIA_ITEMS;
     g_app.media_list.items = (media_item_t *)malloc(sizeof(media_item_t) * g_app.media_list.capacity);
     if (!g_app.media_list.items) {
         LOG_ERROR("Failed to allocate media list");
@@ -127,6 +138,9 @@ void app_shutdown(void)
     /* Stop any playback */
     video_stop();
 
+    api_request_cancel(&g_connect_req);
+    api_request_cancel(&g_browse_req);
+
     /* Free resources */
     if (g_app.media_list.items) {
         free(g_app.media_list.items);
@@ -154,6 +168,9 @@ void app_run(void)
         /* Update input */
         input_update();
 
+        /* Advance in-flight HTTP requests without blocking the frame */
+        http_update();
+
         /* Global controls */
         if (input_button_just_pressed(BTN_BACK) && g_app.state != STATE_ERROR) {
             if (g_app.state == STATE_PLAYING) {
@@ -186,6 +203,11 @@ void app_run(void)
             }
         }
 
+        /* Click both thumbsticks for the network timing overlay */
+        if (input_button_just_pressed(BTN_LEFT_THUMB) && input_button_pressed(BTN_RIGHT_THUMB)) {
+            g_app.show_netstats = !g_app.show_netstats;
+        }
+
         /* Begin rendering */
         ui_begin_frame();
         ui_clear(COLOR_DARK_GRAY);
@@ -215,6 +237,10 @@ void app_run(void)
                 break;
         }
 
+        if (g_app.show_netstats) {
+            ui_draw_netstats();
+        }
+
         /* End rendering */
         ui_end_frame();
 
@@ -234,36 +260,53 @@ static void handle_state_init(void)
     ui_draw_loading("Starting Nedflix...");
 }
 
+static void connect_failed(void)
+{
+    g_app.state = STATE_ERROR;
+    snprintf(g_app.error_message, sizeof(g_app.error_message),
+             "Failed to connect to %s", g_app.settings.server_url);
+}
+
 static void handle_state_connecting(void)
 {
-    static bool connecting = false;
-    static int result = 0;
+    static char username[64];
 
     ui_draw_loading("Connecting to server...");
 
-    if (!connecting) {
-        connecting = true;
-        result = api_init(g_app.settings.server_url);
+    if (!api_request_pending(&g_connect_req)) {
+        if (api_init_async(&g_connect_req, g_app.settings.server_url) < 0) {
+            connect_failed();
+        }
+        return;
     }
 
-    if (result == 0) {
+    api_call_t call = g_connect_req.call;
+    int result = api_request_poll(&g_connect_req);
+    if (result == API_PENDING) {
+        return;
+    }
+
+    if (call == API_CALL_PING) {
+        if (result != 0) {
+            connect_failed();
+            return;
+        }
         /* Connected - check if we have auth token */
-        if (strlen(g_app.settings.auth_token) > 0) {
-            char username[64] = {0};
-            if (api_get_user_info(g_app.settings.auth_token, username, sizeof(username)) == 0) {
-                strncpy(g_app.settings.username, username, sizeof(g_app.settings.username) - 1);
-                g_app.state = STATE_BROWSING;
-                connecting = false;
-                return;
-            }
+        if (strlen(g_app.settings.auth_token) > 0 &&
+            api_get_user_info_async(&g_connect_req, g_app.settings.auth_token,
+                                    username, sizeof(username)) == 0) {
+            return;
         }
         g_app.state = STATE_LOGIN;
-        connecting = false;
+        return;
+    }
+
+    /* The saved token is still good if the server knows its user */
+    if (result == 0) {
+        strncpy(g_app.settings.username, username, sizeof(g_app.settings.username) - 1);
+        g_app.state = STATE_BROWSING;
     } else {
-        g_app.state = STATE_ERROR;
-        snprintf(g_app.error_message, sizeof(g_app.error_message),
-                 "Failed to connect to %s", g_app.settings.server_url);
-        connecting = false;
+        g_app.state = STATE_LOGIN;
     }
 }
 
@@ -313,6 +356,20 @@ static void handle_state_login(void)
     }
 }
 
+/*
+ * Request the listing for g_app.media_list.current_path, replacing one
+ * still loading. It lands in the list from handle_state_browsing().
+ */
+static void start_browse(void)
+{
+#if NEDFLIX_CLIENT_MODE
+    if (api_browse_async(&g_browse_req, g_app.settings.auth_token,
+                         g_app.media_list.current_path, &g_app.media_list) < 0) {
+        LOG_ERROR("Failed to start browse of %s", g_app.media_list.current_path);
+    }
+#endif
+}
+
 static void handle_state_browsing(void)
 {
     /* Draw header with current library */
@@ -320,8 +377,22 @@ static void handle_state_browsing(void)
     snprintf(header, sizeof(header), "Nedflix - %s", library_names[g_app.current_library]);
     ui_draw_header(header);
 
+    /* Pick up the listing once it arrives; input stays live meanwhile */
+    bool loading = false;
+    if (api_request_pending(&g_browse_req)) {
+        int result = api_request_poll(&g_browse_req);
+        if (result == API_PENDING) {
+            loading = true;
+        } else if (result != 0) {
+            LOG_ERROR("Browse of %s failed", g_app.media_list.current_path);
+        }
+    }
+
     /* Draw file list */
     ui_draw_file_list(&g_app.media_list);
+    if (loading) {
+        ui_draw_text(20, SCREEN_HEIGHT - 50, "Loading...", COLOR_TEXT_DIM);
+    }
 
     /* Navigation */
     if (input_button_just_pressed(BTN_DPAD_UP)) {
@@ -349,10 +420,7 @@ static void handle_state_browsing(void)
         g_app.media_list.scroll_offset = 0;
         strncpy(g_app.media_list.current_path, library_paths[g_app.current_library],
                 sizeof(g_app.media_list.current_path) - 1);
-#if NEDFLIX_CLIENT_MODE
-        api_browse(g_app.settings.auth_token, g_app.media_list.current_path,
-                   g_app.current_library, &g_app.media_list);
-#endif
+        start_browse();
     }
     if (input_button_just_pressed(BTN_RIGHT_TRIGGER)) {
         g_app.current_library = (g_app.current_library + 1) % LIBRARY_COUNT;
@@ -361,10 +429,7 @@ static void handle_state_browsing(void)
         g_app.media_list.scroll_offset = 0;
         strncpy(g_app.media_list.current_path, library_paths[g_app.current_library],
                 sizeof(g_app.media_list.current_path) - 1);
-#if NEDFLIX_CLIENT_MODE
-        api_browse(g_app.settings.auth_token, g_app.media_list.current_path,
-                   g_app.current_library, &g_app.media_list);
-#endif
+        start_browse();
     }
 
     /* Select item */
@@ -378,10 +443,7 @@ static void handle_state_browsing(void)
             g_app.media_list.count = 0;
             g_app.media_list.selected_index = 0;
             g_app.media_list.scroll_offset = 0;
-#if NEDFLIX_CLIENT_MODE
-            api_browse(g_app.settings.auth_token, g_app.media_list.current_path,
-                       g_app.current_library, &g_app.media_list);
-#endif
+            start_browse();
         } else if (item->type == MEDIA_TYPE_VIDEO || item->type == MEDIA_TYPE_AUDIO) {
             /* Play media */
             char stream_url[MAX_URL_LENGTH];
@@ -587,6 +649,7 @@ static void handle_state_settings(void)
                 break;
             case 4:  /* Reconnect to Server */
                 config_save(&g_app.settings);
+                api_request_cancel(&g_browse_req);
                 api_shutdown();
                 g_app.state = STATE_CONNECTING;
                 break;
@@ -23,27 +23,7 @@
 #include <string.h>
 #include <stdarg.h>
 
-/*
- * nxdk compatibility: snprintf is not available in nxdk's C library.
- * Provide a simple implementation using vsprintf.
- * Note: This is not buffer-overflow safe like real snprintf,
- * but works for our controlled use cases.
- */
-#ifdef NXDK
-static inline int nxdk_snprintf(char *buf, size_t size, const char *fmt, ...) {
-    va_list args;
-    int ret;
-    va_start(args, fmt);
-    ret = vsprintf(buf, fmt, args);
-    va_end(args);
-    /* Ensure null termination */
-    if (size > 0) {
-        buf[size - 1] = '\0';
-    }
-    return ret;
-}
-#define snprintf nxdk_snprintf
-#endif
+#include "core.h"
 
 /* Version info */
 #define NEDFLIX_VERSION_MAJOR 1
@@ -60,16 +40,14 @@ static inline int nxdk_snprintf(char *buf, size_t size, const char *fmt, ...) {
 #define SCREEN_WIDTH  640
 #define SCREEN_HEIGHT 480
 
-/* UI Constants */
-#define MAX_PATH_LENGTH     260
-#define MAX_URL_LENGTH      512
-#define MAX_TITLE_LENGTH    256
+/* UI Constants; buffer sizes and MAX_MEDIA_ITEMS are in core/core_config.h */
 #define MAX_ITEMS_PER_PAGE  10
 #define MAX_MENU_ITEMS      20
 
-/* Network timeouts (milliseconds) */
-#define HTTP_CONNECT_TIMEOUT  5000
-#define HTTP_READ_TIMEOUT     30000
+/* Keep-alive connection pool (idle window stays under Node's 5s keepAliveTimeout) */
+#define HTTP_POOL_SIZE          4
+#define HTTP_KEEPALIVE_IDLE_MS  4000
+
 
 /* Color definitions (ARGB format for DirectX) */
 #define COLOR_BLACK       0xFF000000
@@ -101,14 +79,6 @@ typedef enum {
     LIBRARY_COUNT
 } library_type_t;
 
-/* Media file types */
-typedef enum {
-    MEDIA_TYPE_UNKNOWN,
-    MEDIA_TYPE_VIDEO,
-    MEDIA_TYPE_AUDIO,
-    MEDIA_TYPE_DIRECTORY
-} media_type_t;
-
 /* Controller button masks */
 typedef enum {
     BTN_A           = 0x0001,
@@ -188,6 +158,7 @@ typedef struct {
     uint32_t last_input_time;
     uint16_t buttons_pressed;
     uint16_t buttons_just_pressed;
+    bool show_netstats;        /* Network timing overlay, toggled with both thumbsticks */
 } app_context_t;
 
 /* Global context (defined in main.c) */
@@ -209,17 +180,21 @@ int http_get(const char *url, char **response, size_t *response_len);
 int http_post(const char *url, const char *body, char **response, size_t *response_len);
 int http_get_with_auth(const char *url, const char *token, char **response, size_t *response_len);
 
-/* json.c */
-typedef struct json_value json_value_t;
-json_value_t *json_parse(const char *text);
-void json_free(json_value_t *value);
-const char *json_get_string(json_value_t *obj, const char *key);
-int json_get_int(json_value_t *obj, const char *key, int default_val);
-bool json_get_bool(json_value_t *obj, const char *key, bool default_val);
-json_value_t *json_get_object(json_value_t *obj, const char *key);
-json_value_t *json_get_array(json_value_t *obj, const char *key);
-int json_array_length(json_value_t *array);
-json_value_t *json_array_get(json_value_t *array, int index);
+int http_get_conditional(const char *url, const char *token, http_validators_t *validators,
+                         char **response, size_t *response_len);
+
+typedef struct {
+    uint32_t requests;            /* Requests issued */
+    uint32_t connections_opened;  /* Fresh TCP connects */
+    uint32_t connections_reused;  /* Requests served on a pooled connection */
+    uint32_t stale_retries;       /* Reused connections found dead and retried */
+    uint32_t idle_closed;         /* Connections dropped after HTTP_KEEPALIVE_IDLE_MS */
+    uint32_t dns_lookups;         /* gethostbyname() calls, from the core's resolver cache */
+    uint32_t dns_cache_hits;      /* Names answered from the resolver cache */
+    uint32_t header_builds;       /* Times the constant request headers were serialized */
+} http_pool_stats_t;
+
+void http_get_pool_stats(http_pool_stats_t *stats);
 
 /* ui.c */
 int ui_init(void);
@@ -237,6 +212,7 @@ void ui_draw_progress_bar(int x, int y, int width, int height, float progress, u
 void ui_draw_loading(const char *message);
 void ui_draw_error(const char *message);
 void ui_draw_playback_hud(playback_state_t *state);
+void ui_draw_netstats(void);
 
 /* On-screen keyboard */
 typedef struct {
@@ -299,6 +275,42 @@ int api_get_stream_url(const char *token, const char *path, char *url_out, size_
 int api_get_audio_tracks(const char *token, const char *path, int *count);
 int api_save_settings(const char *token, const user_settings_t *settings);
 
+/* Asynchronous API calls, completed by api_request_poll() once per frame */
+#define API_PENDING 1
+
+typedef enum {
+    API_CALL_NONE,
+    API_CALL_PING,
+    API_CALL_LOGIN,
+    API_CALL_USER,
+    API_CALL_BROWSE,
+    API_CALL_SEARCH
+} api_call_t;
+
+typedef struct {
+    api_call_t call;        /* API_CALL_NONE when idle */
+    http_handle_t http;
+    media_list_t *list;     /* Browse/search destination */
+    char *out;              /* Login token or user name destination */
+    size_t out_len;
+    char url[MAX_URL_LENGTH];           /* Browse/search cache key */
+    char token[256];
+    http_validators_t validators;
+} api_request_t;
+
+int api_init_async(api_request_t *req, const char *server_url);
+int api_login_async(api_request_t *req, const char *username, const char *password,
+                    char *token_out, size_t token_len);
+int api_get_user_info_async(api_request_t *req, const char *token,
+                            char *username_out, size_t username_len);
+int api_browse_async(api_request_t *req, const char *token, const char *path,
+                     media_list_t *list);
+int api_search_async(api_request_t *req, const char *token, const char *query,
+                     media_list_t *list);
+int api_request_poll(api_request_t *req);
+void api_request_cancel(api_request_t *req);
+bool api_request_pending(const api_request_t *req);
+
 /* Utility macros */
 #define MIN(a, b) ((a) < (b) ? (a) : (b))
 #define MAX(a, b) ((a) > (b) ? (a) : (b))
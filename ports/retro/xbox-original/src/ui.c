@@ -557,6 +557,33 @@ void ui_draw_playback_hud(playback_state_t *state)
     }
 }
 
+/* Draw network timing overlay: per endpoint, counts and percentiles,
+ * then average ms per request phase */
+void ui_draw_netstats(void)
+{
+    int count = netstats_count();
+    int height = 28 + (count > 0 ? count : 1) * 36;
+    int y = SCREEN_HEIGHT - 40 - height;
+
+    ui_draw_rect(16, y, SCREEN_WIDTH - 32, height, COLOR_BLACK);
+    ui_draw_rect(16, y, SCREEN_WIDTH - 32, 2, COLOR_RED);
+    ui_draw_text(24, y + 6, "Network (avg ms)", COLOR_RED);
+    y += 28;
+
+    if (count == 0) {
+        ui_draw_text(24, y, "No requests yet", COLOR_TEXT_DIM);
+        return;
+    }
+
+    char line1[80], line2[80];
+    for (int i = 0; i < count; i++) {
+        if (netstats_format(i, line1, line2, sizeof(line1)) < 0) break;
+        ui_draw_text(24, y, line1, COLOR_TEXT);
+        ui_draw_text(24, y + 16, line2, COLOR_TEXT_DIM);
+        y += 36;
+    }
+}
+
 /*
  * On-Screen Keyboard Implementation
  * A simple QWERTY keyboard for entering text on Xbox with controller
@@ -11,6 +11,246 @@
 static char g_server_url[MAX_URL_LENGTH];
 static bool g_api_initialized = false;
 
+/* Login, user info and stream URL replies */
+typedef struct {
+    char token[256];
+    char username[64];
+    char url[MAX_URL_LENGTH];
+} account_reply_t;
+
+static const json_field_t g_account_fields[] = {
+    JSON_FIELD(account_reply_t, token, "token", STRING),
+    JSON_FIELD(account_reply_t, username, "username", STRING),
+    JSON_FIELD(account_reply_t, url, "url", STRING),
+};
+static json_schema_t g_account_schema = JSON_SCHEMA(g_account_fields);
+
+/* Browse and search entries, decoded straight into the list */
+static const json_field_t g_item_fields[] = {
+    JSON_FIELD(media_item_t, name, "name", STRING),
+    JSON_FIELD(media_item_t, path, "path", STRING),
+    JSON_FIELD(media_item_t, duration, "duration", UINT),
+    JSON_FIELD(media_item_t, size, "size", UINT),
+    MEDIA_HINT_FIELDS
+};
+static json_schema_t g_item_schema = JSON_SCHEMA_SCRATCH(g_item_fields, media_hints_t);
+
+/*
+ * Decode a reply into one of the small fixed replies above
+ */
+static int parse_reply(const char *response, size_t len, account_reply_t *reply)
+{
+    memset(reply, 0, sizeof(*reply));
+    return json_decode_object(&g_account_schema, response, len, reply);
+}
+
+/*
+ * Library listings fetched ahead of time by api_start_session. Each one
+ * is served once by api_browse; later visits go back to the server so
+ * the listing stays fresh.
+ */
+static media_list_t g_prefetch[LIBRARY_COUNT];
+
+static void prefetch_clear(void)
+{
+    for (int i = 0; i < LIBRARY_COUNT; i++) {
+        free(g_prefetch[i].items);
+        memset(&g_prefetch[i], 0, sizeof(g_prefetch[i]));
+    }
+}
+
+/*
+ * Build the browse URL for a directory of a library
+ */
+static void build_browse_url(char *url, size_t size, const char *path, library_t library)
+{
+    const char *lib_names[] = {"music", "audiobooks", "movies", "tvshows"};
+    char encoded_path[MAX_PATH_LENGTH * 3];
+
+    /* Library roots such as "/TV Shows" are not valid in a request line as-is */
+    url_encode(path, encoded_path, sizeof(encoded_path));
+    snprintf(url, size, "%s/api/browse/%s?path=%s",
+             g_server_url, lib_names[library], encoded_path);
+}
+
+/*
+ * Copy the username out of an /api/auth/me response
+ */
+static int parse_user_info(const char *response, size_t resp_len, char *username_out, size_t len)
+{
+    account_reply_t reply;
+    if (parse_reply(response, resp_len, &reply) < 0 || !reply.username[0]) {
+        return -1;
+    }
+
+    strncpy(username_out, reply.username, len - 1);
+    username_out[len - 1] = '\0';
+    return 0;
+}
+
+/*
+ * Next free slot for the decoder, or NULL once the list is full
+ */
+static void *next_item(void *user)
+{
+    media_list_t *list = (media_list_t *)user;
+    if (list->count >= list->capacity) return NULL;
+
+    media_item_t *media = &list->items[list->count];
+    memset(media, 0, sizeof(*media));
+    return media;
+}
+
+/*
+ * Keep an entry only if it has both a name and a path; otherwise its
+ * slot is reused for the next one
+ */
+static int item_done(void *record, void *scratch, void *user)
+{
+    media_item_t *media = (media_item_t *)record;
+    if (media->name[0] && media->path[0]) {
+        media->type = media_hints_type((const media_hints_t *)scratch, media->name);
+        media->is_directory = media->type == MEDIA_TYPE_DIRECTORY;
+        ((media_list_t *)user)->count++;
+    }
+    return 0;
+}
+
+/*
+ * Fill list from the named array of a browse ("items") or search
+ * ("results") response body
+ */
+static int parse_listing(const char *response, size_t len, const char *array,
+                         media_list_t *list)
+{
+    list->count = 0;
+
+    json_decode_t spec = { &g_item_schema, array, next_item, item_done, list, NULL, NULL };
+    return json_decode(&spec, response, len);
+}
+
+/*
+ * Copy the cached copy of a listing into list once the server has answered 304
+ */
+static int restore_listing(const char *url, const char *token, media_list_t *list)
+{
+    int count = cache_restore(url, token, list->items, sizeof(media_item_t), list->capacity,
+                              NULL);
+    if (count < 0) return -1;
+    list->count = count;
+    return 0;
+}
+
+/*
+ * Hand over a prefetched listing for library/path, if there is one
+ */
+static int take_prefetched(const char *path, library_t library, media_list_t *list)
+{
+    media_list_t *cached = &g_prefetch[library];
+
+    if (!cached->items || strcmp(cached->current_path, path) != 0) {
+        return -1;
+    }
+
+    list->count = MIN(cached->count, list->capacity);
+    memcpy(list->items, cached->items, list->count * sizeof(media_item_t));
+
+    free(cached->items);
+    memset(cached, 0, sizeof(*cached));
+    return 0;
+}
+
+/*
+ * Settle a conditional GET of a listing: a 304 brings back the cached
+ * copy, a fresh body is parsed and cached. Takes the response.
+ */
+static int finish_listing(const char *url, const char *token, const char *array, int status,
+                          char *response, size_t resp_len,
+                          const http_validators_t *validators, media_list_t *list)
+{
+    if (status == 304 && restore_listing(url, token, list) == 0) {
+        LOG("Not modified: %s (%d cached items)", url, list->count);
+        free(response);
+        return 0;
+    }
+    if (status != 0 || !response) {
+        free(response);
+        return -1;
+    }
+
+    uint64_t parse_start = netstats_now_us();
+    int result = parse_listing(response, resp_len, array, list);
+    netstats_parse(url, parse_start);
+    free(response);
+
+    if (result == 0) {
+        cache_store(url, token, validators, list->items, sizeof(media_item_t), list->count,
+                    list->count);
+    }
+    return result;
+}
+
+/*
+ * Fetch a listing, revalidating the copy from the last visit instead of
+ * fetching it again
+ */
+static int get_listing(const char *url, const char *token, const char *array,
+                       media_list_t *list)
+{
+    http_validators_t validators;
+    cache_validators(url, token, &validators);
+
+    char *response = NULL;
+    size_t resp_len = 0;
+    int status = http_get_conditional(url, token, &validators, &response, &resp_len);
+
+    return finish_listing(url, token, array, status, response, resp_len, &validators, list);
+}
+
+/*
+ * Keep the root listing of a library fetched at session start, or the
+ * cached copy a 304 vouched for. Takes the response.
+ */
+static void prefetch_settle(library_t library, const char *path, const char *url,
+                            const char *token, int status, char *response, size_t resp_len,
+                            const http_validators_t *validators)
+{
+    media_list_t *list = &g_prefetch[library];
+
+    if (status != 304 && (!response || status < 0 || status >= 300)) {
+        free(response);
+        return;
+    }
+
+    list->items = (media_item_t *)calloc(MAX_MEDIA_ITEMS, sizeof(media_item_t));
+    list->capacity = MAX_MEDIA_ITEMS;
+    if (!list->items) {
+        free(response);
+        return;
+    }
+
+    int restored;
+    if (status == 304) {
+        restored = restore_listing(url, token, list);
+    } else {
+        uint64_t parse_start = netstats_now_us();
+        restored = parse_listing(response, resp_len, "items", list);
+        netstats_parse(url, parse_start);
+    }
+
+    if (restored == 0) {
+        strncpy(list->current_path, path, sizeof(list->current_path) - 1);
+        if (status != 304) {
+            cache_store(url, token, validators, list->items,
+                        sizeof(media_item_t), list->count, list->count);
+        }
+    } else {
+        free(list->items);
+        memset(list, 0, sizeof(*list));
+    }
+    free(response);
+}
+
 /*
  * Initialize API client
  */
@@ -41,15 +281,111 @@ int api_init(const char *server_url)
     return -1;
 }
 
+/*
+ * Connect and, with a saved token, check the session and fetch the root
+ * listing of every library in the same pipelined round trip as the
+ * health check. username_out is left empty when the token is rejected.
+ */
+int api_start_session(const char *server_url, const char *token,
+                      const char *const *library_paths,
+                      char *username_out, size_t len)
+{
+    if (!server_url || strlen(server_url) == 0 || !username_out) {
+        return -1;
+    }
+
+    strncpy(g_server_url, server_url, sizeof(g_server_url) - 1);
+    g_server_url[sizeof(g_server_url) - 1] = '\0';
+    username_out[0] = '\0';
+    prefetch_clear();
+
+    bool have_token = token && token[0];
+    char urls[2 + LIBRARY_COUNT][MAX_URL_LENGTH];
+    http_batch_t batch[2 + LIBRARY_COUNT];
+    http_validators_t validators[2 + LIBRARY_COUNT];
+    int count = 0;
+
+    memset(batch, 0, sizeof(batch));
+    snprintf(urls[count++], sizeof(urls[0]), "%s/api/health", g_server_url);
+    if (have_token) {
+        snprintf(urls[count++], sizeof(urls[0]), "%s/api/auth/me", g_server_url);
+        for (int lib = 0; library_paths && lib < LIBRARY_COUNT; lib++) {
+            build_browse_url(urls[count], sizeof(urls[0]),
+                             library_paths[lib], (library_t)lib);
+            cache_validators(urls[count], token, &validators[count]);
+            batch[count].validators = &validators[count];
+            count++;
+        }
+    }
+    for (int i = 0; i < count; i++) {
+        batch[i].url = urls[i];
+    }
+
+    http_get_pipelined(batch, count, have_token ? token : NULL);
+
+    int result = -1;
+    if (batch[0].response) {
+        g_api_initialized = true;
+        LOG("API initialized: %s", g_server_url);
+        result = 0;
+
+        if (have_token && batch[1].response && batch[1].status < 300 &&
+            parse_user_info(batch[1].response, batch[1].len, username_out, len) == 0) {
+            for (int i = 2; i < count; i++) {
+                prefetch_settle((library_t)(i - 2), library_paths[i - 2], urls[i], token,
+                                batch[i].status, batch[i].response, batch[i].len,
+                                &validators[i]);
+                batch[i].response = NULL;
+            }
+        }
+    } else {
+        LOG_ERROR("Failed to connect to API server");
+    }
+
+    for (int i = 0; i < count; i++) {
+        free(batch[i].response);
+    }
+    return result;
+}
+
 /*
  * Shutdown API client
  */
 void api_shutdown(void)
 {
+    prefetch_clear();
+    cache_clear();
     g_api_initialized = false;
     g_server_url[0] = '\0';
 }
 
+/*
+ * Build the login request
+ */
+static void build_login_request(const char *username, const char *password,
+                                char *url, size_t url_size, char *body, size_t body_size)
+{
+    snprintf(url, url_size, "%s/api/auth/login", g_server_url);
+    snprintf(body, body_size,
+             "{\"username\":\"%s\",\"password\":\"%s\"}",
+             username, password);
+}
+
+/*
+ * Copy the token out of a login response
+ */
+static int parse_login(const char *response, size_t resp_len, char *token_out, size_t len)
+{
+    account_reply_t reply;
+    if (parse_reply(response, resp_len, &reply) < 0 || !reply.token[0]) {
+        return -1;
+    }
+
+    strncpy(token_out, reply.token, len - 1);
+    token_out[len - 1] = '\0';
+    return 0;
+}
+
 /*
  * Login and get auth token
  */
@@ -61,12 +397,8 @@ int api_login(const char *username, const char *password,
     }
 
     char url[MAX_URL_LENGTH];
-    snprintf(url, sizeof(url), "%s/api/auth/login", g_server_url);
-
     char body[512];
-    snprintf(body, sizeof(body),
-             "{\"username\":\"%s\",\"password\":\"%s\"}",
-             username, password);
+    build_login_request(username, password, url, sizeof(url), body, sizeof(body));
 
     char *response = NULL;
     size_t len = 0;
@@ -75,22 +407,9 @@ int api_login(const char *username, const char *password,
         return -1;
     }
 
-    /* Parse token from response */
-    json_value_t *json = json_parse(response);
+    int result = parse_login(response, len, token_out, token_len);
     free(response);
-
-    if (!json) return -1;
-
-    const char *token = json_get_string(json, "token");
-    if (token) {
-        strncpy(token_out, token, token_len - 1);
-        token_out[token_len - 1] = '\0';
-        json_free(json);
-        return 0;
-    }
-
-    json_free(json);
-    return -1;
+    return result;
 }
 
 /*
@@ -112,38 +431,85 @@ int api_get_user_info(const char *token, char *username_out, size_t len)
         return -1;
     }
 
-    json_value_t *json = json_parse(response);
+    int result = parse_user_info(response, resp_len, username_out, len);
     free(response);
+    return result;
+}
 
-    if (!json) return -1;
+/*
+ * Browse media
+ */
+int api_browse(const char *token, const char *path,
+               library_t library, media_list_t *list)
+{
+    if (!g_api_initialized || !token || !path || !list) {
+        return -1;
+    }
 
-    const char *name = json_get_string(json, "username");
-    if (name) {
-        strncpy(username_out, name, len - 1);
-        username_out[len - 1] = '\0';
-        json_free(json);
+    if (take_prefetched(path, library, list) == 0) {
         return 0;
     }
 
-    json_free(json);
-    return -1;
+    char url[MAX_URL_LENGTH];
+    build_browse_url(url, sizeof(url), path, library);
+
+    return get_listing(url, token, "items", list);
 }
 
 /*
- * Browse media
+ * Build the search URL for a query
  */
-int api_browse(const char *token, const char *path,
-               library_t library, media_list_t *list)
+static void build_search_url(char *url, size_t size, const char *query)
 {
-    if (!g_api_initialized || !token || !path || !list) {
+    char encoded_query[256];
+    url_encode(query, encoded_query, sizeof(encoded_query));
+
+    snprintf(url, size, "%s/api/search?q=%s&limit=%d",
+             g_server_url, encoded_query, MAX_MEDIA_ITEMS);
+}
+
+/*
+ * Search media
+ */
+int api_search(const char *token, const char *query, media_list_t *list)
+{
+    if (!g_api_initialized || !token || !query || !list) {
         return -1;
     }
 
-    const char *lib_names[] = {"music", "audiobooks", "movies", "tvshows"};
+    char url[MAX_URL_LENGTH];
+    build_search_url(url, sizeof(url), query);
+
+    return get_listing(url, token, "results", list);
+}
+
+/*
+ * Copy the playable URL out of an /api/stream response
+ */
+static int parse_stream_url(const char *response, size_t resp_len, char *url_out, size_t len)
+{
+    account_reply_t reply;
+    if (parse_reply(response, resp_len, &reply) < 0 || !reply.url[0]) {
+        return -1;
+    }
+
+    strncpy(url_out, reply.url, len - 1);
+    url_out[len - 1] = '\0';
+    return 0;
+}
+
+/*
+ * Get streaming URL for media
+ */
+int api_get_stream_url(const char *token, const char *path,
+                       char *url_out, size_t len)
+{
+    if (!g_api_initialized || !token || !path || !url_out) {
+        return -1;
+    }
 
     char url[MAX_URL_LENGTH];
-    snprintf(url, sizeof(url), "%s/api/browse/%s?path=%s",
-             g_server_url, lib_names[library], path);
+    snprintf(url, sizeof(url), "%s/api/stream?path=%s", g_server_url, path);
 
     char *response = NULL;
     size_t resp_len = 0;
@@ -152,64 +518,159 @@ int api_browse(const char *token, const char *path,
         return -1;
     }
 
-    json_value_t *json = json_parse(response);
+    int result = parse_stream_url(response, resp_len, url_out, len);
     free(response);
+    return result;
+}
+
+/*
+ * Asynchronous calls. Each one is submitted to the core request slots
+ * and completed by api_request_poll() once per frame, after http_update().
+ */
+
+static void api_request_reset(api_request_t *req, api_call_t call, const char *token)
+{
+    api_request_cancel(req);
+    req->call = call;
+    req->http = -1;
+    req->user = -1;
+    for (int lib = 0; lib < LIBRARY_COUNT; lib++) {
+        req->prefetch[lib] = -1;
+    }
 
-    if (!json) return -1;
+    /* The cache key outlives the caller's strings */
+    strncpy(req->token, token ? token : "", sizeof(req->token) - 1);
+    req->token[sizeof(req->token) - 1] = '\0';
+}
 
-    json_value_t *items = json_get_array(json, "items");
-    if (!items) {
-        json_free(json);
+/*
+ * Start api_start_session(). The health check, the session check and
+ * the root listing of every library go out together in separate slots.
+ */
+int api_start_session_async(api_request_t *req, const char *server_url, const char *token,
+                            const char *const *library_paths,
+                            char *username_out, size_t len)
+{
+    if (!server_url || strlen(server_url) == 0 || !username_out) {
         return -1;
     }
 
-    list->count = 0;
-    int item_count = json_array_length(items);
-
-    for (int i = 0; i < item_count && list->count < list->capacity; i++) {
-        json_value_t *item = json_array_get(items, i);
-        if (!item) continue;
-
-        media_item_t *media = &list->items[list->count];
-
-        const char *name = json_get_string(item, "name");
-        const char *item_path = json_get_string(item, "path");
-        const char *type = json_get_string(item, "type");
-
-        if (name && item_path) {
-            strncpy(media->name, name, sizeof(media->name) - 1);
-            strncpy(media->path, item_path, sizeof(media->path) - 1);
-
-            media->is_directory = json_get_bool(item, "isDirectory", false);
-
-            if (type) {
-                if (strcmp(type, "audio") == 0) {
-                    media->type = MEDIA_TYPE_AUDIO;
-                } else if (strcmp(type, "video") == 0) {
-                    media->type = MEDIA_TYPE_VIDEO;
-                } else if (strcmp(type, "directory") == 0) {
-                    media->type = MEDIA_TYPE_DIRECTORY;
-                } else {
-                    media->type = MEDIA_TYPE_UNKNOWN;
-                }
-            }
+    strncpy(g_server_url, server_url, sizeof(g_server_url) - 1);
+    g_server_url[sizeof(g_server_url) - 1] = '\0';
+    username_out[0] = '\0';
+    prefetch_clear();
+    g_api_initialized = false;
+
+    api_request_reset(req, API_CALL_SESSION, token);
+    req->out = username_out;
+    req->out_len = len;
+    req->library_paths = library_paths;
+
+    char url[MAX_URL_LENGTH];
+    snprintf(url, sizeof(url), "%s/api/health", g_server_url);
+    req->http = http_submit("GET", url, NULL, NULL);
+    if (req->http < 0) {
+        req->call = API_CALL_NONE;
+        return -1;
+    }
 
-            media->duration = json_get_int(item, "duration", 0);
-            media->size = json_get_int(item, "size", 0);
+    if (token && token[0]) {
+        snprintf(url, sizeof(url), "%s/api/auth/me", g_server_url);
+        req->user = http_submit("GET", url, token, NULL);
 
-            list->count++;
+        for (int lib = 0; library_paths && lib < LIBRARY_COUNT; lib++) {
+            build_browse_url(url, sizeof(url), library_paths[lib], (library_t)lib);
+            cache_validators(url, token, &req->prefetch_validators[lib]);
+            /* A listing that finds no free slot is simply not prefetched */
+            req->prefetch[lib] = http_submit_conditional(url, token,
+                                                         &req->prefetch_validators[lib]);
         }
     }
+    return 0;
+}
+
+/*
+ * Start a login; the token is written to token_out when it completes
+ */
+int api_login_async(api_request_t *req, const char *username, const char *password,
+                    char *token_out, size_t token_len)
+{
+    if (!g_api_initialized || !username || !password || !token_out) {
+        return -1;
+    }
 
-    json_free(json);
+    char url[MAX_URL_LENGTH];
+    char body[512];
+    build_login_request(username, password, url, sizeof(url), body, sizeof(body));
+
+    api_request_reset(req, API_CALL_LOGIN, NULL);
+    req->http = http_submit("POST", url, NULL, body);
+    if (req->http < 0) {
+        req->call = API_CALL_NONE;
+        return -1;
+    }
+    req->out = token_out;
+    req->out_len = token_len;
     return 0;
 }
 
 /*
- * Get streaming URL for media
+ * Start a conditional GET of a listing; the list is filled when it completes
  */
-int api_get_stream_url(const char *token, const char *path,
-                       char *url_out, size_t len)
+static int api_start_listing(api_request_t *req, api_call_t call, const char *token,
+                             media_list_t *list)
+{
+    cache_validators(req->url, token, &req->validators);
+    req->http = http_submit_conditional(req->url, token, &req->validators);
+    if (req->http < 0) {
+        req->call = API_CALL_NONE;
+        return -1;
+    }
+    req->call = call;
+    req->list = list;
+    return 0;
+}
+
+/*
+ * Start a browse; a listing prefetched at session start completes at once
+ */
+int api_browse_async(api_request_t *req, const char *token, const char *path,
+                     library_t library, media_list_t *list)
+{
+    if (!g_api_initialized || !token || !path || !list) {
+        return -1;
+    }
+
+    api_request_reset(req, API_CALL_BROWSE, token);
+    if (take_prefetched(path, library, list) == 0) {
+        req->call = API_CALL_DONE;
+        return 0;
+    }
+
+    build_browse_url(req->url, sizeof(req->url), path, library);
+    return api_start_listing(req, API_CALL_BROWSE, token, list);
+}
+
+/*
+ * Start a search; the list is filled when it completes
+ */
+int api_search_async(api_request_t *req, const char *token, const char *query,
+                     media_list_t *list)
+{
+    if (!g_api_initialized || !token || !query || !list) {
+        return -1;
+    }
+
+    api_request_reset(req, API_CALL_SEARCH, token);
+    build_search_url(req->url, sizeof(req->url), query);
+    return api_start_listing(req, API_CALL_SEARCH, token, list);
+}
+
+/*
+ * Start a stream URL lookup; the URL is written to url_out when it completes
+ */
+int api_get_stream_url_async(api_request_t *req, const char *token, const char *path,
+                             char *url_out, size_t len)
 {
     if (!g_api_initialized || !token || !path || !url_out) {
         return -1;
@@ -218,26 +679,166 @@ int api_get_stream_url(const char *token, const char *path,
     char url[MAX_URL_LENGTH];
     snprintf(url, sizeof(url), "%s/api/stream?path=%s", g_server_url, path);
 
+    api_request_reset(req, API_CALL_STREAM, NULL);
+    req->http = http_submit("GET", url, token, NULL);
+    if (req->http < 0) {
+        req->call = API_CALL_NONE;
+        return -1;
+    }
+    req->out = url_out;
+    req->out_len = len;
+    return 0;
+}
+
+/*
+ * Settle whichever parts of a session start have come back
+ */
+static int poll_session(api_request_t *req)
+{
+    bool pending = false;
     char *response = NULL;
     size_t resp_len = 0;
 
-    if (http_get_with_auth(url, token, &response, &resp_len) != 0) {
+    if (req->http >= 0) {
+        int status = http_poll(req->http, &response, &resp_len);
+        free(response);
+        if (status == HTTP_IN_PROGRESS) {
+            pending = true;
+        } else {
+            req->http = -1;
+            req->health = status;
+        }
+    }
+
+    if (req->user >= 0) {
+        int status = http_poll(req->user, &response, &resp_len);
+        if (status == HTTP_IN_PROGRESS) {
+            pending = true;
+        } else {
+            req->user = -1;
+            if (status == 0 && response) {
+                parse_user_info(response, resp_len, req->out, req->out_len);
+            }
+            free(response);
+        }
+    }
+
+    for (int lib = 0; lib < LIBRARY_COUNT; lib++) {
+        if (req->prefetch[lib] < 0) continue;
+
+        int status = http_poll_conditional(req->prefetch[lib], &req->prefetch_validators[lib],
+                                           &response, &resp_len);
+        if (status == HTTP_IN_PROGRESS) {
+            pending = true;
+            continue;
+        }
+        req->prefetch[lib] = -1;
+
+        char url[MAX_URL_LENGTH];
+        build_browse_url(url, sizeof(url), req->library_paths[lib], (library_t)lib);
+        prefetch_settle((library_t)lib, req->library_paths[lib], url, req->token, status,
+                        response, resp_len, &req->prefetch_validators[lib]);
+    }
+
+    if (pending) {
+        return API_PENDING;
+    }
+
+    /* Listings fetched with a rejected token are not kept */
+    if (req->health != 0 || !req->out[0]) {
+        prefetch_clear();
+    }
+    if (req->health != 0) {
+        LOG_ERROR("Failed to connect to API server");
         return -1;
     }
 
-    json_value_t *json = json_parse(response);
-    free(response);
+    g_api_initialized = true;
+    LOG("API initialized: %s", g_server_url);
+    return 0;
+}
 
-    if (!json) return -1;
+/*
+ * Complete a call: API_PENDING while it is in flight, then its result
+ * as the blocking call would have returned it
+ */
+int api_request_poll(api_request_t *req)
+{
+    if (req->call == API_CALL_NONE) return -1;
 
-    const char *stream_url = json_get_string(json, "url");
-    if (stream_url) {
-        strncpy(url_out, stream_url, len - 1);
-        url_out[len - 1] = '\0';
-        json_free(json);
+    int result;
+    if (req->call == API_CALL_SESSION) {
+        result = poll_session(req);
+        if (result != API_PENDING) req->call = API_CALL_NONE;
+        return result;
+    }
+    if (req->call == API_CALL_DONE) {
+        req->call = API_CALL_NONE;
         return 0;
     }
 
-    json_free(json);
-    return -1;
+    char *response = NULL;
+    size_t resp_len = 0;
+    int status = http_poll_conditional(req->http, &req->validators, &response, &resp_len);
+    if (status == HTTP_IN_PROGRESS) {
+        return API_PENDING;
+    }
+
+    api_call_t call = req->call;
+    req->call = API_CALL_NONE;
+    req->http = -1;
+
+    switch (call) {
+        case API_CALL_LOGIN:
+            result = (status == 0 && response)
+                     ? parse_login(response, resp_len, req->out, req->out_len)
+                     : -1;
+            break;
+
+        case API_CALL_BROWSE:
+        case API_CALL_SEARCH:
+            /* finish_listing() takes the response */
+            return finish_listing(req->url, req->token,
+                                  call == API_CALL_BROWSE ? "items" : "results",
+                                  status, response, resp_len, &req->validators, req->list);
+
+        case API_CALL_STREAM:
+            result = (status == 0 && response)
+                     ? parse_stream_url(response, resp_len, req->out, req->out_len)
+                     : -1;
+            break;
+
+        default:
+            result = -1;
+            break;
+    }
+
+    free(response);
+    return result;
+}
+
+/*
+ * Abandon a call; its destination is left as it was
+ */
+void api_request_cancel(api_request_t *req)
+{
+    if (req->call == API_CALL_SESSION) {
+        http_cancel(req->user);
+        for (int lib = 0; lib < LIBRARY_COUNT; lib++) {
+            http_cancel(req->prefetch[lib]);
+        }
+    }
+    if (req->call != API_CALL_NONE) {
+        http_cancel(req->http);
+    }
+    req->call = API_CALL_NONE;
+    req->http = -1;
+}
+
+/*
+ * Check whether a call is in flight
+ */
+bool api_request_pending(const api_request_t *req)
+{
+    return req->call != API_CALL_NONE;
 }
@@ -28,6 +28,11 @@ static const char *library_paths[] = {
     "/TV Shows"
 };
 
+/* API calls in flight; http_update() in app_run() moves them along */
+static api_request_t g_connect_req;
+static api_request_t g_browse_req;
+static api_request_t g_stream_req;
+
 /*
  * State handler prototypes
  */
@@ -119,6 +124,13 @@ void app_init(void)
     /* Load saved configuration */
     config_load(&g_app.settings);
 
+    /* Built with CAPTURE= or REPLAY=: record HTTP traffic or play it back */
+#if defined(NETREPLAY_CAPTURE)
+    netreplay_capture(NETREPLAY_CAPTURE);
+#elif defined(NETREPLAY_REPLAY)
+    netreplay_replay(NETREPLAY_REPLAY, NETREPLAY_SPEED);
+#endif
+
     printf("Initialization complete!\n");
     printf("Press A to continue...\n\n");
 
@@ -146,6 +158,10 @@ void app_shutdown(void)
     /* Stop playback */
     audio_stop();
 
+    api_request_cancel(&g_connect_req);
+    api_request_cancel(&g_browse_req);
+    api_request_cancel(&g_stream_req);
+
     /* Free resources */
     if (g_app.media.items) {
         free(g_app.media.items);
@@ -176,6 +192,9 @@ void app_run(void)
         /* Update input */
         input_update();
 
+        /* Advance in-flight HTTP requests without blocking the frame */
+        http_update();
+
         /* Global back button handling */
         if (input_button_just_pressed(BTN_B)) {
             switch (g_app.state) {
@@ -215,6 +234,11 @@ void app_run(void)
             }
         }
 
+        /* Click both thumbsticks for the network timing overlay */
+        if (input_button_just_pressed(BTN_LEFT_THUMB) && input_button_pressed(BTN_RIGHT_THUMB)) {
+            g_app.show_netstats = !g_app.show_netstats;
+        }
+
         /* Begin rendering */
         ui_begin_frame();
         ui_clear(COLOR_DARK_BG);
@@ -250,6 +274,10 @@ void app_run(void)
                 break;
         }
 
+        if (g_app.show_netstats) {
+            ui_draw_netstats();
+        }
+
         /* End rendering */
         ui_end_frame();
 
@@ -282,7 +310,8 @@ static void handle_state_network_init(void)
 
     if (!initializing) {
         initializing = true;
-        result = network_init();
+        /* A replay needs no network */
+        result = netreplay_replaying() ? 0 : network_init();
     }
 
     if (result == 0) {
@@ -309,33 +338,34 @@ static void handle_state_network_init(void)
 
 static void handle_state_connecting(void)
 {
-    static bool connecting = false;
-    static int result = 0;
+    static char username[64];
 
     char msg[128];
     snprintf(msg, sizeof(msg), "Connecting to %s...", g_app.settings.server_url);
     ui_draw_loading(msg);
 
-    if (!connecting) {
-        connecting = true;
-        result = api_init(g_app.settings.server_url);
+    int result = -1;
+    if (!api_request_pending(&g_connect_req)) {
+        /* Health check, session check and library roots all in flight together */
+        result = api_start_session_async(&g_connect_req, g_app.settings.server_url,
+                                         g_app.settings.auth_token, library_paths,
+                                         username, sizeof(username));
+    }
+    if (result == 0 || api_request_pending(&g_connect_req)) {
+        result = api_request_poll(&g_connect_req);
+        if (result == API_PENDING) {
+            return;
+        }
     }
 
     if (result == 0) {
-        connecting = false;
-        if (strlen(g_app.settings.auth_token) > 0) {
-            char username[64] = {0};
-            if (api_get_user_info(g_app.settings.auth_token, username, sizeof(username)) == 0) {
-                strncpy(g_app.settings.username, username, sizeof(g_app.settings.username) - 1);
-                g_app.state = STATE_MENU;
-            } else {
-                g_app.state = STATE_LOGIN;
-            }
+        if (username[0]) {
+            strncpy(g_app.settings.username, username, sizeof(g_app.settings.username) - 1);
+            g_app.state = STATE_MENU;
         } else {
             g_app.state = STATE_LOGIN;
         }
     } else {
-        connecting = false;
         char err[256];
         snprintf(err, sizeof(err), "Failed to connect to %s", g_app.settings.server_url);
         app_set_error(err);
@@ -385,6 +415,18 @@ static void handle_state_login(void)
     ui_draw_text(20, SCREEN_HEIGHT - 30, "A: Select   B: Back", COLOR_TEXT_DIM);
 }
 
+/*
+ * Fetch the current directory; handle_state_browsing() picks up the result
+ */
+static void start_browse(void)
+{
+    if (api_browse_async(&g_browse_req, g_app.settings.auth_token,
+                         g_app.media.current_path, g_app.current_library,
+                         &g_app.media) < 0) {
+        LOG_ERROR("Failed to start browse of %s", g_app.media.current_path);
+    }
+}
+
 static void handle_state_menu(void)
 {
     ui_draw_header("Nedflix");
@@ -426,8 +468,7 @@ static void handle_state_menu(void)
             g_app.media.count = 0;
 
             if (g_app.net.initialized && strlen(g_app.settings.auth_token) > 0) {
-                api_browse(g_app.settings.auth_token, g_app.media.current_path,
-                           g_app.current_library, &g_app.media);
+                start_browse();
             }
             g_app.state = STATE_BROWSING;
         } else if (selected == 4) {
@@ -446,6 +487,17 @@ static void handle_state_browsing(void)
     snprintf(header, sizeof(header), "Nedflix - %s", library_names[g_app.current_library]);
     ui_draw_header(header);
 
+    /* Pick up the listing once it arrives; input stays live meanwhile */
+    bool loading = false;
+    if (api_request_pending(&g_browse_req)) {
+        int result = api_request_poll(&g_browse_req);
+        if (result == API_PENDING) {
+            loading = true;
+        } else if (result != 0) {
+            LOG_ERROR("Browse of %s failed", g_app.media.current_path);
+        }
+    }
+
     ui_draw_file_list(&g_app.media);
 
     /* Navigation */
@@ -487,8 +539,7 @@ static void handle_state_browsing(void)
         g_app.media.selected_index = 0;
         g_app.media.scroll_offset = 0;
         if (g_app.net.initialized) {
-            api_browse(g_app.settings.auth_token, g_app.media.current_path,
-                       g_app.current_library, &g_app.media);
+            start_browse();
         }
     }
     if (input_button_just_pressed(BTN_RB)) {
@@ -498,8 +549,7 @@ static void handle_state_browsing(void)
         g_app.media.selected_index = 0;
         g_app.media.scroll_offset = 0;
         if (g_app.net.initialized) {
-            api_browse(g_app.settings.auth_token, g_app.media.current_path,
-                       g_app.current_library, &g_app.media);
+            start_browse();
         }
     }
 
@@ -513,31 +563,37 @@ static void handle_state_browsing(void)
             g_app.media.selected_index = 0;
             g_app.media.scroll_offset = 0;
             if (g_app.net.initialized) {
-                api_browse(g_app.settings.auth_token, g_app.media.current_path,
-                           g_app.current_library, &g_app.media);
+                start_browse();
             }
         } else if (item->type == MEDIA_TYPE_AUDIO || item->type == MEDIA_TYPE_VIDEO) {
-            char stream_url[MAX_URL_LENGTH];
-            if (api_get_stream_url(g_app.settings.auth_token, item->path,
-                                    stream_url, sizeof(stream_url)) == 0) {
+            if (api_get_stream_url_async(&g_stream_req, g_app.settings.auth_token, item->path,
+                                         g_app.playback.url,
+                                         sizeof(g_app.playback.url)) == 0) {
                 strncpy(g_app.playback.title, item->name,
                         sizeof(g_app.playback.title) - 1);
-                strncpy(g_app.playback.url, stream_url,
-                        sizeof(g_app.playback.url) - 1);
                 g_app.playback.is_audio = (item->type == MEDIA_TYPE_AUDIO);
-
-                if (audio_play(stream_url) == 0) {
-                    g_app.state = STATE_PLAYING;
-                }
             }
         }
     }
 
+    /* Start playback once the stream URL arrives */
+    if (api_request_pending(&g_stream_req)) {
+        int result = api_request_poll(&g_stream_req);
+        if (result == API_PENDING) {
+            loading = true;
+        } else if (result == 0 && audio_play(g_app.playback.url) == 0) {
+            g_app.state = STATE_PLAYING;
+        }
+    }
+    if (loading) {
+        ui_draw_text(20, SCREEN_HEIGHT - 60, "Loading...", COLOR_TEXT_DIM);
+    }
+
     /* Help text */
     ui_draw_text(20, SCREEN_HEIGHT - 30,
                  "A: Select   B: Back   LB/RB: Library   LT/RT: Page", COLOR_TEXT_DIM);
 
-    if (g_app.media.count == 0) {
+    if (g_app.media.count == 0 && !loading) {
         ui_draw_text_centered(SCREEN_HEIGHT / 2, "No items found", COLOR_TEXT_DIM);
     }
 }
@@ -652,6 +708,8 @@ static void handle_state_settings(void)
                 break;
             case 3:  /* Reconnect */
                 config_save(&g_app.settings);
+                api_request_cancel(&g_browse_req);
+                api_request_cancel(&g_stream_req);
                 api_shutdown();
                 g_app.state = STATE_CONNECTING;
                 break;
@@ -60,6 +60,8 @@
 #include <stdint.h>
 #include <malloc.h>
 
+#include "core.h"
+
 /* Version */
 #define NEDFLIX_VERSION "1.0.0-x360"
 
@@ -72,18 +74,13 @@
 #define SCREEN_WIDTH  1280
 #define SCREEN_HEIGHT 720
 
-/* Memory limits - 512MB unified but be conservative */
-#define MAX_PATH_LENGTH     512
-#define MAX_URL_LENGTH      512
-#define MAX_TITLE_LENGTH    256
+/* List limits; buffer sizes are in core/core_config.h */
 #define MAX_ITEMS_VISIBLE   15
-#define MAX_MEDIA_ITEMS     200
 
-/* Network settings */
-#define HTTP_TIMEOUT_MS     15000
-#define RECV_BUFFER_SIZE    32768
+/* Network settings; HTTP timeouts are in core/core_config.h */
 #define STREAM_BUFFER_SIZE  (4 * 1024 * 1024)  /* 4MB streaming buffer */
 
+
 /* Colors (ARGB8888 for framebuffer) */
 #define COLOR_BLACK       0xFF000000
 #define COLOR_WHITE       0xFFFFFFFF
@@ -108,14 +105,6 @@ typedef enum {
     STATE_ERROR
 } app_state_t;
 
-/* Media types */
-typedef enum {
-    MEDIA_TYPE_UNKNOWN,
-    MEDIA_TYPE_DIRECTORY,
-    MEDIA_TYPE_AUDIO,
-    MEDIA_TYPE_VIDEO
-} media_type_t;
-
 /* Library types */
 typedef enum {
     LIBRARY_MUSIC,
@@ -233,6 +222,9 @@ typedef struct {
 
     /* Running flag */
     bool running;
+
+    /* Network timing overlay, toggled by clicking both thumbsticks */
+    bool show_netstats;
 } app_t;
 
 /* Global instance */
@@ -275,6 +267,7 @@ void ui_draw_menu(const char **items, int count, int selected);
 void ui_draw_file_list(media_list_t *list);
 void ui_draw_playback_hud(playback_t *state);
 void ui_draw_progress_bar(int x, int y, int width, int height, float progress, uint32_t fg, uint32_t bg);
+void ui_draw_netstats(void);
 
 /* input.c */
 int input_init(void);
@@ -297,6 +290,10 @@ int http_get(const char *url, char **response, size_t *len);
 int http_post(const char *url, const char *body, char **response, size_t *len);
 int http_get_with_auth(const char *url, const char *token, char **response, size_t *len);
 
+int http_get_pipelined(http_batch_t *batch, int count, const char *token);
+int http_get_conditional(const char *url, const char *token, http_validators_t *validators,
+                         char **response, size_t *len);
+
 /* audio.c */
 int audio_init(void);
 void audio_shutdown(void);
@@ -313,28 +310,66 @@ double audio_get_duration(void);
 
 /* api.c */
 int api_init(const char *server_url);
+int api_start_session(const char *server_url, const char *token,
+                      const char *const *library_paths,
+                      char *username_out, size_t len);
 void api_shutdown(void);
 int api_login(const char *username, const char *password, char *token_out, size_t token_len);
 int api_get_user_info(const char *token, char *username_out, size_t len);
 int api_browse(const char *token, const char *path, library_t library, media_list_t *list);
+int api_search(const char *token, const char *query, media_list_t *list);
 int api_get_stream_url(const char *token, const char *path, char *url_out, size_t len);
 
+/* Asynchronous API calls, completed by api_request_poll() once per frame */
+#define API_PENDING 1
+
+typedef enum {
+    API_CALL_NONE,
+    API_CALL_SESSION,
+    API_CALL_LOGIN,
+    API_CALL_BROWSE,
+    API_CALL_SEARCH,
+    API_CALL_STREAM,
+    API_CALL_DONE           /* Answered without the network */
+} api_call_t;
+
+typedef struct {
+    api_call_t call;        /* API_CALL_NONE when idle */
+    http_handle_t http;
+    media_list_t *list;     /* Browse/search destination */
+    char *out;              /* Token, user name or stream URL destination */
+    size_t out_len;
+    char url[MAX_URL_LENGTH];           /* Browse/search cache key */
+    char token[256];
+    http_validators_t validators;
+    /* Session start: health check result, session check and library root prefetches */
+    int health;
+    http_handle_t user;
+    const char *const *library_paths;
+    http_handle_t prefetch[LIBRARY_COUNT];
+    http_validators_t prefetch_validators[LIBRARY_COUNT];
+} api_request_t;
+
+int api_start_session_async(api_request_t *req, const char *server_url, const char *token,
+                            const char *const *library_paths,
+                            char *username_out, size_t len);
+int api_login_async(api_request_t *req, const char *username, const char *password,
+                    char *token_out, size_t token_len);
+int api_browse_async(api_request_t *req, const char *token, const char *path,
+                     library_t library, media_list_t *list);
+int api_search_async(api_request_t *req, const char *token, const char *query,
+                     media_list_t *list);
+int api_get_stream_url_async(api_request_t *req, const char *token, const char *path,
+                             char *url_out, size_t len);
+int api_request_poll(api_request_t *req);
+void api_request_cancel(api_request_t *req);
+bool api_request_pending(const api_request_t *req);
+
 /* config.c */
 int config_load(user_settings_t *settings);
 int config_save(const user_settings_t *settings);
 void config_set_defaults(user_settings_t *settings);
 
-/* json.c */
-typedef struct json_value json_value_t;
-json_value_t *json_parse(const char *text);
-void json_free(json_value_t *v);
-const char *json_get_string(json_value_t *obj, const char *key);
-int json_get_int(json_value_t *obj, const char *key, int def);
-bool json_get_bool(json_value_t *obj, const char *key, bool def);
-json_value_t *json_get_array(json_value_t *obj, const char *key);
-int json_array_length(json_value_t *arr);
-json_value_t *json_array_get(json_value_t *arr, int idx);
-
 /* Utility macros */
 #define MIN(a, b) ((a) < (b) ? (a) : (b))
 #define MAX(a, b) ((a) > (b) ? (a) : (b))
@@ -430,6 +430,35 @@ void ui_draw_loading(const char *message)
     ui_draw_text_centered(SCREEN_HEIGHT / 2 + 60, spin, COLOR_TEXT_DIM);
 }
 
+/*
+ * Draw the network timing overlay along the bottom of the screen
+ */
+void ui_draw_netstats(void)
+{
+    int line_h = CHAR_HEIGHT * FONT_SCALE + 4;
+    int count = netstats_count();
+    int height = line_h + 8 + (count > 0 ? count : 1) * (2 * line_h + 4);
+    int y = SCREEN_HEIGHT - 40 - height;
+
+    ui_draw_rect(30, y, SCREEN_WIDTH - 60, height, COLOR_BLACK);
+    ui_draw_rect(30, y, SCREEN_WIDTH - 60, 2, COLOR_RED);
+    ui_draw_text(40, y + 6, "Network (avg ms)", COLOR_RED);
+    y += line_h + 8;
+
+    if (count == 0) {
+        ui_draw_text(40, y, "No requests yet", COLOR_TEXT_DIM);
+        return;
+    }
+
+    char line1[80], line2[80];
+    for (int i = 0; i < count; i++) {
+        if (netstats_format(i, line1, line2, sizeof(line1)) < 0) break;
+        ui_draw_text(40, y, line1, COLOR_TEXT);
+        ui_draw_text(40, y + line_h, line2, COLOR_TEXT_DIM);
+        y += 2 * line_h + 4;
+    }
+}
+
 /*
  * Draw error screen
  */
@@ -5,6 +5,7 @@ const https = require('https');
 const http = require('http');
 const fs = require('fs');
 const path = require('path');
+const zlib = require('zlib');
 const session = require('express-session');
 const passport = require('passport');
 const GoogleStrategy = require('passport-google-oauth20').Strategy;
@@ -848,6 +849,12 @@ const libraries = [
     { name: 'Audiobooks', path: `${NFS_MOUNT_PATH}/Audiobooks` }
 ];
 
+// JSON response compression. The window is kept small so the retro
+// clients can inflate with a few KB of history (HTTP_INFLATE_WINDOW_BITS
+// in ports/retro/core/core_config.h must be at least this).
+const JSON_COMPRESS_MIN_BYTES = 1024;
+const JSON_COMPRESS_WINDOW_BITS = parseInt(process.env.JSON_COMPRESS_WINDOW_BITS, 10) || 12;
+
 // Local admin credentials
 const ADMIN_USERNAME = process.env.ADMIN_USERNAME || '';
 const ADMIN_PASSWORD = process.env.ADMIN_PASSWORD || '';
@@ -860,6 +867,31 @@ const sessionUsers = new Map();
 
 // Middleware
 app.use(express.json());
+
+// Compress JSON API responses for clients that send Accept-Encoding
+app.use('/api', (req, res, next) => {
+    const encoding = req.acceptsEncodings('gzip', 'deflate');
+    if (!encoding) return next();
+
+    const sendJson = res.json.bind(res);
+    res.json = (body) => {
+        const text = JSON.stringify(body);
+        if (text === undefined || Buffer.byteLength(text) < JSON_COMPRESS_MIN_BYTES) {
+            return sendJson(body);
+        }
+
+        const options = { windowBits: JSON_COMPRESS_WINDOW_BITS };
+        const compressed = encoding === 'gzip'
+            ? zlib.gzipSync(text, options)
+            : zlib.deflateSync(text, options);
+
+        res.vary('Accept-Encoding');
+        res.set('Content-Type', 'application/json; charset=utf-8');
+        res.set('Content-Encoding', encoding);
+        return res.send(compressed);
+    };
+    next();
+});
 app.use(express.static('public'));
 
 // Security headers
@@ -1228,6 +1260,15 @@ app.get('/api/browse', ensureAuthenticated, async (req, res) => {
             });
         }
 
+        // Optional paging (?offset=&limit=) for clients that keep only part of
+        // a large directory in memory; total is the size of the whole listing
+        const total = fileList.length;
+        const offset = Math.max(0, parseInt(req.query.offset, 10) || 0);
+        const limit = parseInt(req.query.limit, 10);
+        if (offset > 0 || limit > 0) {
+            fileList = fileList.slice(offset, limit > 0 ? offset + limit : undefined);
+        }
+
         // Get cached metadata for all media files
         const mediaPaths = fileList.filter(f => f.isVideo || f.isAudio).map(f => f.path);
         const metadataMap = await metadataService.getCachedMetadataBulkAsync(mediaPaths);
@@ -1269,6 +1310,8 @@ app.get('/api/browse', ensureAuthenticated, async (req, res) => {
             currentPath: normalizedPath,
             parentPath: parentPath,
             canGoUp: normalizedPath !== NFS_MOUNT_PATH,
+            total: total,
+            offset: offset,
             items: fileList
         });
     } catch (error) {